@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file main.c
+ * @brief Implementation of main.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+/*
+ * 系统调用往返开销测试
+ *
+ * null:        走寄存器传参的快速入口
+ * null(frame): 同样的空调用，但强制保存完整 trap frame，作为对照
+ * putc x N:    按字符逐个系统调用输出一行
+ * write:       一次系统调用输出同一行
+ * ring nop:    每次 ring_enter 提交 RING_BATCH 个空操作，按操作计
+ */
+
+#include "syscall.h"
+#include "time_page.h"
+#include "ioring.h"
+
+#define LOOPS      100000
+#define RING_BATCH 32
+
+static const char line[] = "sysbench: the quick brown fox jumps over the lazy dog\r\n";
+
+static uint64_t
+str_len(const char *s)
+{
+    uint64_t n = 0;
+    while (s[n])
+        n++;
+    return n;
+}
+
+static void
+print(const char *s)
+{
+    write(1, s, str_len(s));
+}
+
+static void
+print_u64(uint64_t v)
+{
+    char buf[21];
+    int  i = sizeof(buf);
+
+    do {
+        buf[--i] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    write(1, buf + i, sizeof(buf) - i);
+}
+
+static void
+report(const char *name, uint64_t ns, uint64_t loops)
+{
+    print(name);
+    print(": ");
+    print_u64(ns / loops);
+    print(" ns/call\r\n");
+}
+
+static void
+ring_bench(void)
+{
+    ioring_t *ring = ring_setup();
+    uint64_t  t0, t1;
+
+    if ((int64_t) ring == -1) {
+        print("ring_setup failed\r\n");
+        return;
+    }
+
+    t0 = user_clock_mono_ns();
+    for (int i = 0; i < LOOPS / RING_BATCH; i++) {
+        for (int j = 0; j < RING_BATCH; j++) {
+            ioring_sqe_t *sqe = ioring_get_sqe(ring);
+            sqe->opcode       = IORING_OP_NOP;
+            sqe->user_data    = j;
+        }
+        ioring_advance_sq(ring, RING_BATCH);
+        ring_enter(RING_BATCH, 0, 0);
+
+        while (ioring_peek_cqe(ring))
+            ioring_cqe_seen(ring);
+    }
+    t1 = user_clock_mono_ns();
+    report("ring nop   ", t1 - t0, LOOPS / RING_BATCH * RING_BATCH);
+}
+
+int
+_start()
+{
+    uint64_t t0, t1;
+    uint64_t len = str_len(line);
+
+    t0 = user_clock_mono_ns();
+    for (int i = 0; i < LOOPS; i++)
+        null_syscall();
+    t1 = user_clock_mono_ns();
+    report("null       ", t1 - t0, LOOPS);
+
+    t0 = user_clock_mono_ns();
+    for (int i = 0; i < LOOPS; i++)
+        null_syscall_frame();
+    t1 = user_clock_mono_ns();
+    report("null(frame)", t1 - t0, LOOPS);
+
+    t0 = user_clock_mono_ns();
+    for (uint64_t i = 0; i < len; i++)
+        putc(line[i]);
+    t1 = user_clock_mono_ns();
+    report("putc x N   ", t1 - t0, 1);
+
+    t0 = user_clock_mono_ns();
+    write(1, line, len);
+    t1 = user_clock_mono_ns();
+    report("write      ", t1 - t0, 1);
+
+    ring_bench();
+
+    while (1)
+        sleep(10000000);
+
+    return 0;
+}
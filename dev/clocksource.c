@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file clocksource.c
+ * @brief Implementation of clocksource.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#include "clocksource.h"
+#include "avatar_types.h"
+#include "hrtimer.h"
+#include "io.h"
+#include "mmio.h"
+#include "os_cfg.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "timer.h"
+#include "mem/mem.h"
+
+// 时间页放在内核镜像内：fork 时按内核页共享，进程销毁时也不会被释放。
+// 独占一整页，避免把同一页里的其他内核数据暴露给 EL0
+static union
+{
+    time_page_t page;
+    uint8_t     pad[PAGE_SIZE];
+} _time_area __attribute__((aligned(PAGE_SIZE)));
+
+static time_page_t *const _time_page = &_time_area.page;
+
+// 写者互斥：周期刷新与设置墙上时间
+static spinlock_t _time_lock;
+
+static hrtimer_t _update_timer;
+
+// 选出最大的 shift，使 mult 不超过 32 位，且 CLOCKSOURCE_MAX_SEC 内的计数差乘 mult 不溢出
+static void
+clocksource_calc_mult_shift(uint64_t freq, uint64_t *mult, uint32_t *shift)
+{
+    uint64_t max_cycles = freq * CLOCKSOURCE_MAX_SEC;
+    uint32_t sft;
+    uint64_t m = 0;
+
+    for (sft = 32; sft > 0; sft--) {
+        m = ((NSEC_PER_SEC << sft) + freq / 2) / freq;
+        if (m <= 0xffffffffULL && m <= ~0ULL / max_cycles)
+            break;
+    }
+
+    *mult  = m;
+    *shift = sft;
+}
+
+uint64_t
+clocksource_cyc2ns(uint64_t cycles)
+{
+    // 大数值分成整秒和余数两部分，避免乘法溢出
+    uint64_t freq = _time_page->freq;
+    return (cycles / freq) * NSEC_PER_SEC + (cycles % freq) * NSEC_PER_SEC / freq;
+}
+
+// 把基准推进到当前时刻，保持 (cycles - cycle_base) 足够小
+static void
+clocksource_update(uint64_t now)
+{
+    uint64_t daif = spin_lock_irqsave(&_time_lock);
+
+    write_seqcount_begin(&_time_page->seq);
+    uint64_t delta = now - _time_page->cycle_base;
+    _time_page->base_ns += (delta * _time_page->mult) >> _time_page->shift;
+    _time_page->cycle_base = now;
+    write_seqcount_end(&_time_page->seq);
+
+    spin_unlock_irqrestore(&_time_lock, daif);
+}
+
+static hrtimer_restart_t
+clocksource_update_fn(hrtimer_t *timer)
+{
+    clocksource_update(read_cntpct_el0());
+    hrtimer_forward_now(timer, _time_page->freq * CLOCKSOURCE_UPDATE_SEC);
+    return HRTIMER_RESTART;
+}
+
+uint64_t
+ktime_get_ns(void)
+{
+    return time_page_mono_ns(_time_page);
+}
+
+uint64_t
+ktime_get_real_ns(void)
+{
+    return time_page_real_ns(_time_page);
+}
+
+// 设置墙上时间，只修改偏移，单调时间不受影响
+void
+clocksource_set_realtime(uint64_t real_ns)
+{
+    uint64_t mono = ktime_get_ns();
+    uint64_t daif = spin_lock_irqsave(&_time_lock);
+
+    write_seqcount_begin(&_time_page->seq);
+    _time_page->wall_offset_ns = real_ns - mono;
+    write_seqcount_end(&_time_page->seq);
+
+    spin_unlock_irqrestore(&_time_lock, daif);
+}
+
+// 启动核调用一次：标定换算参数，从 PL031 RTC 取初始墙上时间，并启动周期刷新
+// 需要在 hrtimer_init_local 之后调用
+void
+clocksource_init(void)
+{
+    uint64_t freq = read_cntfrq_el0();
+    if (!freq)
+        freq = TIMER_FREQUENCY_HZ;
+
+    spinlock_init(&_time_lock);
+    seqcount_init(&_time_page->seq);
+
+    uint64_t now = read_cntpct_el0();
+
+    _time_page->freq = freq;
+    clocksource_calc_mult_shift(freq, &_time_page->mult, &_time_page->shift);
+    _time_page->cycle_base = now;
+    _time_page->base_ns    = clocksource_cyc2ns(now);
+
+    uint32_t rtc_sec           = mmio_read32((void *) RTC_BASE_ADDR);
+    _time_page->wall_offset_ns = (uint64_t) rtc_sec * NSEC_PER_SEC - _time_page->base_ns;
+
+    logger_info("clocksource: cntpct %llu Hz, mult %llu, shift %u, rtc %u s\n",
+                freq,
+                _time_page->mult,
+                _time_page->shift,
+                rtc_sec);
+
+    hrtimer_init(&_update_timer, clocksource_update_fn, NULL);
+    hrtimer_start(&_update_timer, now + freq * CLOCKSOURCE_UPDATE_SEC);
+}
+
+// 每核调用：EL1 内核允许 EL0 直接读取 CNTPCT/CNTVCT
+void
+clocksource_init_local(void)
+{
+    if (get_el() != 1)
+        return;
+
+    uint64_t cntkctl;
+    __asm__ __volatile__("mrs %0, cntkctl_el1" : "=r"(cntkctl));
+    cntkctl |= (1 << 0) | (1 << 1);  // EL0PCTEN | EL0VCTEN
+    __asm__ __volatile__("msr cntkctl_el1, %0\n"
+                         "isb"
+                         :
+                         : "r"(cntkctl)
+                         : "memory");
+}
+
+// 把时间页只读映射到进程空间
+int32_t
+clocksource_map_time_page(pte_t *page_dir)
+{
+    uint64_t paddr = virt_to_phys(_time_page);
+    return memory_create_map(page_dir, TIME_PAGE_USER_VA, paddr, 1, 3);
+}
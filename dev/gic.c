@@ -18,6 +18,9 @@
 #include "io.h"
 #include "mmio.h"
 
+// GICv3 的实现见 gicv3.c
+#if GIC_VERSION != 3
+
 struct gic_t _gicv2;
 
 void
@@ -57,6 +60,8 @@ gicc_el2_init()
     // 设置优先级 为 0xf8
     write32(0xff - 7, (void *) GICC_PMR);
     logger_gic_debug("GIC: Set PMR to 0x%x\n", 0xff - 7);
+    // BPR 取最小值，使 IRQ_PRIO_* 各档位分属不同抢占组，允许嵌套
+    write32(0, (void *) GICC_BPR);
 
     // EOImodeNS, bit [9] Controls the behavior of Non-secure accesses to GICC_EOIR GICC_AEOIR, and GICC_DIR
     // 写 EOI 只清除 pending，需要写 DIR 手动清除 active
@@ -194,6 +199,25 @@ gic_ipi_send_single(int32_t irq, int32_t cpu)
     logger_gic_debug("GIC: Sent IPI %d to CPU %d\n", irq, cpu);
 }
 
+// 发送给 CPU 位图中的所有核，一次 GICD_SGIR 写入完成
+void
+gic_ipi_send_mask(int32_t irq, uint32_t cpu_mask)
+{
+    if (cpu_mask & ~0xffU) {
+        logger_error("GIC: Invalid CPU mask 0x%x for IPI (max 8 CPUs)\n", cpu_mask);
+        cpu_mask &= 0xff;
+    }
+    if (irq >= 16) {
+        logger_error("GIC: Invalid SGI IRQ %d for IPI (max 15)\n", irq);
+        return;
+    }
+    if (cpu_mask == 0)
+        return;
+
+    write32((cpu_mask << 16) | irq, (void *) GICD_SGIR);
+    logger_gic_debug("GIC: Sent IPI %d to CPU mask 0x%x\n", irq, cpu_mask);
+}
+
 // The number of implemented CPU interfaces.
 uint32_t
 cpu_num(void)
@@ -390,7 +414,7 @@ gic_set_icfgr(uint32_t int_id, uint8_t cfg)
                      (cfg & 0x2) ? "edge-triggered" : "level-sensitive");
 }
 
-uint32_t
+gic_lr_t
 gic_make_virtual_hardware_interrupt(uint32_t vector, uint32_t pintvec, int32_t pri, bool grp1)
 {
     uint32_t mask = 0x90000000;  // grp0 hw pending
@@ -399,7 +423,7 @@ gic_make_virtual_hardware_interrupt(uint32_t vector, uint32_t pintvec, int32_t p
     return mask;
 }
 
-uint32_t
+gic_lr_t
 gic_make_virtual_software_interrupt(uint32_t vector, int32_t pri, bool grp1)
 {
     uint32_t mask = 0x10000000;  // grp0  pending
@@ -407,7 +431,7 @@ gic_make_virtual_software_interrupt(uint32_t vector, int32_t pri, bool grp1)
     return mask;
 }
 
-uint32_t
+gic_lr_t
 gic_make_virtual_software_sgi(uint32_t vector, int32_t cpu_id, int32_t pri, bool grp1)
 {
     uint32_t mask = 0x10000000;  // grp0  pending
@@ -420,30 +444,48 @@ gic_make_virtual_software_sgi(uint32_t vector, int32_t cpu_id, int32_t pri, bool
 // 下面是关于 GICH 的函数
 // ===================================
 
-uint32_t
+gic_lr_t
 gic_read_lr(int32_t n)
 {
     return read32((void *) GICH_LR(n));
 }
 
 int32_t
-gic_lr_read_pri(uint32_t lr_value)
+gic_lr_read_pri(gic_lr_t lr_value)
 {
     return (lr_value & (0xf8 << 20)) >> 20;
 }
 
 uint32_t
-gic_lr_read_vid(uint32_t lr_value)
+gic_lr_read_vid(gic_lr_t lr_value)
 {
     return lr_value & 0x1ff;
 }
 
+uint32_t
+gic_lr_read_state(gic_lr_t lr_value)
+{
+    return (lr_value >> 28) & 0x3;
+}
+
+gic_lr_t
+gic_lr_clear_pending(gic_lr_t lr_value)
+{
+    return lr_value & ~(1U << 28);
+}
+
 uint32_t
 gic_apr()
 {
     return read32((void *) GICH_APR);
 }
 
+void
+gic_write_apr(uint32_t apr)
+{
+    write32(apr, (void *) GICH_APR);
+}
+
 uint32_t
 gic_elsr0()
 {
@@ -456,8 +498,32 @@ gic_elsr1()
     return read32((void *) GICH_ELSR1);
 }
 
+uint32_t
+gic_read_vmcr(void)
+{
+    return read32((void *) GICH_VMCR);
+}
+
+void
+gic_write_vmcr(uint32_t vmcr)
+{
+    write32(vmcr, (void *) GICH_VMCR);
+}
+
+uint32_t
+gic_read_hcr(void)
+{
+    return read32((void *) GICH_HCR);
+}
+
+void
+gic_write_hcr(uint32_t hcr)
+{
+    write32(hcr, (void *) GICH_HCR);
+}
+
 void
-gic_write_lr(int32_t n, uint32_t mask)
+gic_write_lr(int32_t n, gic_lr_t mask)
 {
     if (n < 0 || n >= GICH_LR_NUM) {
         logger_error("GIC: Invalid LR index %d (max %d)\n", n, GICH_LR_NUM - 1);
@@ -484,4 +550,13 @@ gic_clear_np_int(void)
 {
     write32(read32((void *) GICH_HCR) & ~(1 << 3), (void *) GICH_HCR);
     logger_gic_debug("GIC: Disabled non-priority interrupts in hypervisor\n");
-}
\ No newline at end of file
+}
+
+// GICv2 没有亲和性路由，CPU 接口编号即为 Aff0
+uint32_t
+gic_cpu_affinity(int32_t cpu)
+{
+    return (uint32_t) cpu & 0xff;
+}
+
+#endif  // GIC_VERSION != 3
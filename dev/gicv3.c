@@ -0,0 +1,800 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file gicv3.c
+ * @brief Implementation of gicv3.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+/*   ============= gicv3.c ================*/
+
+#include "gic.h"
+#include "avatar_types.h"
+#include "io.h"
+#include "mmio.h"
+#include "thread.h"
+#include "mem/barrier.h"
+
+// GICv2 的实现见 gic.c
+#if GIC_VERSION == 3
+
+// 与 gic.c 保持同名，其余代码只通过 gic_* 接口访问
+struct gic_t _gicv2;
+
+// 最多探测的 redistributor 帧数，防止 GICR_TYPER.Last 缺失时越界
+#define GICR_PROBE_MAX 128
+
+#define ICC_SRE_SRE    (1U << 0)
+#define ICC_SRE_DFB    (1U << 1)
+#define ICC_SRE_DIB    (1U << 2)
+#define ICC_SRE_ENABLE (1U << 3)  // 允许低异常级别访问 ICC_SRE_EL1
+
+#define ICC_CTLR_EOIMODE (1U << 1)  // 写 EOIR 只降优先级，需要写 DIR 清除 active
+
+#define ICH_HCR_EN   (1U << 0)
+#define ICH_HCR_NPIE (1U << 3)
+
+#define ICH_VMCR_VENG0 (1U << 0)
+#define ICH_VMCR_VENG1 (1U << 1)
+
+#define ICH_LR_VINTID_MASK    0xffffffffULL
+#define ICH_LR_PINTID_SHIFT   32
+#define ICH_LR_PRIORITY_SHIFT 48
+#define ICH_LR_GROUP          (1ULL << 60)
+#define ICH_LR_HW             (1ULL << 61)
+#define ICH_LR_STATE_SHIFT    62
+#define ICH_LR_PENDING        (1ULL << ICH_LR_STATE_SHIFT)
+
+#define gicv3_read_sysreg(reg)                                                                     \
+    ({                                                                                             \
+        uint64_t __val;                                                                            \
+        __asm__ __volatile__("mrs %0, " #reg : "=r"(__val));                                       \
+        __val;                                                                                     \
+    })
+
+#define gicv3_write_sysreg(val, reg)                                                               \
+    __asm__ __volatile__("msr " #reg ", %0" : : "r"((uint64_t) (val)) : "memory")
+
+// 每个物理 CPU 的 redistributor 基地址和亲和性，由各核自己在初始化时填写
+static uint64_t _gicr_base[SMP_NUM];
+static uint32_t _cpu_affinity[SMP_NUM];
+static uint32_t _gicr_nr;
+
+static inline uint32_t
+mpidr_to_affinity(uint64_t mpidr)
+{
+    return (uint32_t) (((mpidr >> 32) & 0xff) << 24) | (uint32_t) (mpidr & 0xffffff);
+}
+
+static inline uint64_t
+affinity_to_irouter(uint32_t aff)
+{
+    return ((uint64_t) (aff >> 24) << 32) | (aff & 0xffffff);
+}
+
+static inline uint32_t
+irouter_to_affinity(uint64_t irouter)
+{
+    return (uint32_t) (((irouter >> 32) & 0xff) << 24) | (uint32_t) (irouter & 0xffffff);
+}
+
+static inline uint64_t
+gicr_rd_base(int32_t cpu)
+{
+    return _gicr_base[cpu];
+}
+
+static void
+gicd_wait_rwp(void)
+{
+    while (read32((void *) GICD_CTLR) & GICD_CTLR_RWP) {
+        ;
+    }
+}
+
+static void
+gicr_wait_rwp(uint64_t rd)
+{
+    // GICR_CTLR.RWP 为 bit [3]
+    while (read32((void *) (rd + GICR_CTLR)) & (1U << 3)) {
+        ;
+    }
+}
+
+// 按 GICR_TYPER 中的亲和性找到当前 CPU 的 redistributor
+static uint64_t
+gicr_probe(uint32_t aff)
+{
+    uint64_t rd = GICR_BASE_ADDR;
+
+    for (int32_t i = 0; i < GICR_PROBE_MAX; i++, rd += GICR_STRIDE) {
+        uint64_t typer = read64((void *) (rd + GICR_TYPER));
+        if (GICR_TYPER_AFFINITY(typer) == aff)
+            return rd;
+        if (typer & GICR_TYPER_LAST)
+            break;
+    }
+    return 0;
+}
+
+// 统计 redistributor 数量，即实现的 CPU 接口数量
+static uint32_t
+gicr_count(void)
+{
+    uint64_t rd = GICR_BASE_ADDR;
+    uint32_t nr = 0;
+
+    for (int32_t i = 0; i < GICR_PROBE_MAX; i++, rd += GICR_STRIDE) {
+        nr++;
+        if (read64((void *) (rd + GICR_TYPER)) & GICR_TYPER_LAST)
+            break;
+    }
+    return nr;
+}
+
+// 唤醒 redistributor，否则该 CPU 收不到任何中断
+static void
+gicr_wakeup(uint64_t rd)
+{
+    uint32_t waker = read32((void *) (rd + GICR_WAKER));
+    write32(waker & ~GICR_WAKER_PROC_SLEEP, (void *) (rd + GICR_WAKER));
+    while (read32((void *) (rd + GICR_WAKER)) & GICR_WAKER_CHILD_ASLEEP) {
+        ;
+    }
+}
+
+// 当前核的 redistributor 初始化：SGI/PPI 全部放到 Group1，关闭并设置默认优先级
+static void
+gicr_init_local(void)
+{
+    uint32_t cpu   = get_current_cpu_id();
+    uint64_t mpidr = gicv3_read_sysreg(mpidr_el1);
+    uint32_t aff   = mpidr_to_affinity(mpidr);
+    uint64_t rd    = gicr_probe(aff);
+
+    if (cpu >= SMP_NUM) {
+        logger_error("GIC: CPU %d exceeds SMP_NUM %d\n", cpu, SMP_NUM);
+        return;
+    }
+    if (rd == 0) {
+        logger_error("GIC: No redistributor found for CPU %d (aff 0x%x)\n", cpu, aff);
+        return;
+    }
+
+    _gicr_base[cpu]    = rd;
+    _cpu_affinity[cpu] = aff;
+    logger_gic_debug("GIC: CPU %d redistributor at 0x%llx, aff 0x%x\n", cpu, rd, aff);
+
+    gicr_wakeup(rd);
+
+    // 单安全状态下 Group0 以 FIQ 形式送达，这里统一使用 Group1 (IRQ)
+    write32(0xffffffff, (void *) (rd + GICR_IGROUPR0));
+    write32(0, (void *) (rd + GICR_IGRPMODR0));
+
+    write32(0xffffffff, (void *) (rd + GICR_ICENABLER0));
+    for (int32_t i = 0; i < GIC_NR_PRIVATE_IRQS / 4; i++)
+        write32(GICD_INT_DEF_PRI_X4, (void *) (rd + GICR_IPRIORITYR + 4 * i));
+    gicr_wait_rwp(rd);
+}
+
+// 系统寄存器 CPU 接口初始化
+static void
+icc_init_local(bool el2)
+{
+    if (el2) {
+        // 打开 EL2 的系统寄存器接口，并允许 guest 使用 ICC_SRE_EL1
+        gicv3_write_sysreg(ICC_SRE_SRE | ICC_SRE_DFB | ICC_SRE_DIB | ICC_SRE_ENABLE, icc_sre_el2);
+    } else {
+        gicv3_write_sysreg(gicv3_read_sysreg(icc_sre_el1) | ICC_SRE_SRE, icc_sre_el1);
+    }
+    isb();
+
+    // 设置优先级 为 0xf8
+    gicv3_write_sysreg(0xff - 7, icc_pmr_el1);
+    gicv3_write_sysreg(0, icc_bpr1_el1);
+
+    // 与 GICv2 的 EOImodeNS 一致：EOIR 只做优先级下降，DIR 清除 active
+    gicv3_write_sysreg(ICC_CTLR_EOIMODE, icc_ctlr_el1);
+    gicv3_write_sysreg(1, icc_igrpen1_el1);
+    isb();
+}
+
+// 分发器初始化：开启亲和性路由，SPI 全部放到 Group1 并路由到启动核
+static void
+gicd_init(void)
+{
+    _gicv2.irq_nr = GICD_TYPER_IRQS(read32((void *) GICD_TYPER));
+    if (_gicv2.irq_nr > 1020) {
+        logger_warn("GIC: IRQ number %d exceeds maximum, capping to 1020\n", _gicv2.irq_nr);
+        _gicv2.irq_nr = 1020;
+    }
+    logger_gic_debug("GIC: Detected %d IRQ lines\n", _gicv2.irq_nr);
+
+    write32(0, (void *) GICD_CTLR);
+    gicd_wait_rwp();
+
+    uint64_t boot_route = affinity_to_irouter(mpidr_to_affinity(gicv3_read_sysreg(mpidr_el1)));
+    for (uint32_t i = GIC_FIRST_SPI; i < _gicv2.irq_nr; i += 32) {
+        write32(0xffffffff, (void *) GICD_ICENABLER(i / 32));
+        write32(0xffffffff, (void *) GICD_IGROUPR(i / 32));
+    }
+    for (uint32_t i = GIC_FIRST_SPI; i < _gicv2.irq_nr; i += 4)
+        write32(GICD_INT_DEF_PRI_X4, (void *) GICD_IPRIORITYR(i / 4));
+    for (uint32_t i = GIC_FIRST_SPI; i < _gicv2.irq_nr; i++)
+        write64(boot_route, (void *) GICD_IROUTER(i));
+    gicd_wait_rwp();
+
+    write32(GICD_CTLR_ARE | GICD_CTRL_ENABLE_GROUP0 | GICD_CTRL_ENABLE_GROUP1,
+            (void *) GICD_CTLR);
+    gicd_wait_rwp();
+    logger_gic_debug("GIC: GICD enabled with affinity routing\n");
+
+    _gicr_nr = gicr_count();
+}
+
+void
+gic_test_init(void)
+{
+    logger_info("GIC: GICv%d, GICD enable %s\n",
+                GICD_PIDR2_ARCH(read32((void *) GICD_PIDR2)),
+                read32((void *) GICD_CTLR) ? "ok" : "error");
+    logger_info("GIC: ICC_SRE %s\n",
+                (gicv3_read_sysreg(icc_sre_el1) & ICC_SRE_SRE) ? "ok" : "error");
+    logger_info("GIC: IRQ numbers: %d\n", _gicv2.irq_nr);
+    logger_info("GIC: CPU count: %d\n", cpu_num());
+}
+
+// ===========================================
+// 下面是gic的初始化函数，包括el1kernel的初始化和hypervisor的初始化
+// ===========================================
+
+// el1 kernel 每核的 redistributor + ICC 初始化。smp启动副核执行
+void
+gicc_init()
+{
+    logger_gic_debug("GIC: Initializing GICv3 CPU interface for EL1 kernel\n");
+    gicr_init_local();
+    icc_init_local(false);
+}
+
+// el2 hypervisor 每核初始化。smp启动副核执行
+void
+gicc_el2_init()
+{
+    logger_gic_debug("GIC: Initializing GICv3 CPU interface for EL2 hypervisor\n");
+    gicr_init_local();
+    icc_init_local(true);
+
+    gicv3_write_sysreg(ICH_HCR_EN, ich_hcr_el2);
+    gicv3_write_sysreg(ICH_VMCR_VENG0 | ICH_VMCR_VENG1, ich_vmcr_el2);
+    isb();
+    logger_gic_debug("GIC: ICH initialized for virtualization\n");
+}
+
+// gicd g0, g1  gicc enable。smp启动首核执行
+void
+gic_init(void)
+{
+    logger_info("GIC: Initializing GICv3 distributor and CPU interface\n");
+
+    gicd_init();
+    gicc_init();
+
+    gic_test_init();
+    logger_info("GIC: Initialization completed successfully\n");
+}
+
+// gicd, gicr, icc, ich enable。 smp启动首核执行
+void
+gic_virtual_init(void)
+{
+    logger_info("GIC: Initializing GICv3 for virtualization\n");
+
+    gicd_init();
+    gicc_el2_init();
+
+    gic_test_init();
+
+    logger_info("GIC: ICH enable %s, %d list registers\n",
+                (gicv3_read_sysreg(ich_hcr_el2) & ICH_HCR_EN) ? "ok" : "error",
+                (int32_t) (gicv3_read_sysreg(ich_vtr_el2) & 0x1f) + 1);
+    logger_info("GIC: Virtualization initialization completed\n");
+}
+
+// ===========================================
+// 下面是一些get、set函数。 读取寄存器值
+// ===========================================
+
+uint32_t
+gic_get_typer(void)
+{
+    return read32((void *) GICD_TYPER);
+}
+
+uint32_t
+gic_get_iidr(void)
+{
+    return read32((void *) GICD_IIDR);
+}
+
+uint32_t
+gic_read_iar(void)
+{
+    uint32_t iar = (uint32_t) gicv3_read_sysreg(icc_iar1_el1);
+    dsb(sy);
+    return iar;
+}
+
+uint32_t
+gic_iar_irqnr(uint32_t iar)
+{
+    return iar & 0xffffff;
+}
+
+void
+gic_write_eoir(uint32_t irqstat)
+{
+    gicv3_write_sysreg(irqstat, icc_eoir1_el1);
+    isb();
+}
+
+void
+gic_write_dir(uint32_t irqstat)
+{
+    gicv3_write_sysreg(irqstat, icc_dir_el1);
+    isb();
+}
+
+// 向 Aff3.Aff2.Aff1 相同的一组 CPU 发送 SGI，targets 为 Aff0 位图
+static void
+gicv3_send_sgi(int32_t irq, uint32_t cluster_aff, uint16_t targets)
+{
+    uint64_t sgi1r = ((uint64_t) ((cluster_aff >> 24) & 0xff) << 48) |
+                     ((uint64_t) ((cluster_aff >> 16) & 0xff) << 32) | ((uint64_t) irq << 24) |
+                     ((uint64_t) ((cluster_aff >> 8) & 0xff) << 16) | targets;
+
+    // 保证之前的内存写对目标核可见
+    dsb(ishst);
+    gicv3_write_sysreg(sgi1r, icc_sgi1r_el1);
+    isb();
+}
+
+// 发送给特定的核（某个核），按亲和性寻址，不受 8 核限制
+void
+gic_ipi_send_single(int32_t irq, int32_t cpu)
+{
+    if (cpu < 0 || cpu >= SMP_NUM || _gicr_base[cpu] == 0) {
+        logger_error("GIC: Invalid CPU ID %d for IPI\n", cpu);
+        return;
+    }
+    if (irq >= 16) {
+        logger_error("GIC: Invalid SGI IRQ %d for IPI (max 15)\n", irq);
+        return;
+    }
+
+    uint32_t aff = _cpu_affinity[cpu];
+    gicv3_send_sgi(irq, aff & ~0xffU, 1U << (aff & 0xf));
+    logger_gic_debug("GIC: Sent IPI %d to CPU %d\n", irq, cpu);
+}
+
+// 发送给 CPU 位图中的所有核，同一 cluster 的核合并为一次 ICC_SGI1R_EL1 写入
+void
+gic_ipi_send_mask(int32_t irq, uint32_t cpu_mask)
+{
+    if (irq >= 16) {
+        logger_error("GIC: Invalid SGI IRQ %d for IPI (max 15)\n", irq);
+        return;
+    }
+
+    for (int32_t first = 0; first < SMP_NUM; first++) {
+        if (!(cpu_mask & (1U << first)) || _gicr_base[first] == 0)
+            continue;
+
+        uint32_t cluster = _cpu_affinity[first] & ~0xffU;
+        uint16_t targets = 0;
+        for (int32_t cpu = first; cpu < SMP_NUM; cpu++) {
+            if ((cpu_mask & (1U << cpu)) && _gicr_base[cpu] &&
+                (_cpu_affinity[cpu] & ~0xffU) == cluster) {
+                targets |= 1U << (_cpu_affinity[cpu] & 0xf);
+                cpu_mask &= ~(1U << cpu);
+            }
+        }
+        gicv3_send_sgi(irq, cluster, targets);
+    }
+    logger_gic_debug("GIC: Sent IPI %d to CPU mask\n", irq);
+}
+
+// The number of implemented CPU interfaces (redistributors).
+uint32_t
+cpu_num(void)
+{
+    return _gicr_nr;
+}
+
+// SGI/PPI 在当前核的 redistributor，SPI 在分发器
+void
+gic_enable_int(int32_t vector, int32_t enabled)
+{
+    int32_t  reg  = vector >> 5;
+    uint32_t mask = 1U << (vector & 0x1f);
+
+    if (vector < GIC_NR_PRIVATE_IRQS) {
+        uint64_t rd = gicr_rd_base(get_current_cpu_id());
+        write32(mask, (void *) (rd + (enabled ? GICR_ISENABLER0 : GICR_ICENABLER0)));
+        if (!enabled)
+            gicr_wait_rwp(rd);
+    } else {
+        if (enabled) {
+            write32(mask, (void *) GICD_ISENABLER(reg));
+        } else {
+            write32(mask, (void *) GICD_ICENABLER(reg));
+            gicd_wait_rwp();
+        }
+    }
+    logger_gic_debug("GIC: %s int: %d\n", enabled ? "enable" : "disable", vector);
+}
+
+int32_t
+gic_get_enable(int32_t vector)
+{
+    uint32_t mask = 1U << (vector & 0x1f);
+    uint32_t val;
+
+    if (vector < GIC_NR_PRIVATE_IRQS)
+        val = read32((void *) (gicr_rd_base(get_current_cpu_id()) + GICR_ISENABLER0));
+    else
+        val = read32((void *) GICD_ISENABLER(vector >> 5));
+
+    logger_gic_debug("GIC: int %d is %s\n", vector, val & mask ? "enabled" : "disabled");
+    return (val & mask) != 0;
+}
+
+void
+gic_set_active(int32_t int_id, int32_t act)
+{
+    if (int_id < 0 || int_id >= _gicv2.irq_nr) {
+        logger_error("GIC: Invalid interrupt ID %d for set_active\n", int_id);
+        return;
+    }
+
+    uint32_t mask = 1U << (int_id % 32);
+    if (int_id < GIC_NR_PRIVATE_IRQS) {
+        uint64_t rd = gicr_rd_base(get_current_cpu_id());
+        write32(mask, (void *) (rd + (act ? GICR_ISACTIVER0 : GICR_ICACTIVER0)));
+    } else if (act) {
+        write32(mask, (void *) GICD_ISACTIVER(int_id / 32));
+    } else {
+        write32(mask, (void *) GICD_ICACTIVER(int_id / 32));
+    }
+    logger_gic_debug("GIC: Set IRQ %d active state to %d\n", int_id, act);
+}
+
+// SGI/PPI 的 pending 位在目标核的 redistributor 中，不再有 SPENDSGIR
+void
+gic_set_pending(int32_t int_id, int32_t pend, int32_t target_cpu)
+{
+    if (int_id < 0 || int_id >= _gicv2.irq_nr) {
+        logger_error("GIC: Invalid interrupt ID %d for set_pending\n", int_id);
+        return;
+    }
+
+    uint32_t mask = 1U << (int_id % 32);
+    if (int_id < GIC_NR_PRIVATE_IRQS) {
+        if (target_cpu < 0 || target_cpu >= SMP_NUM || _gicr_base[target_cpu] == 0) {
+            logger_error("GIC: Invalid CPU ID %d for private pending\n", target_cpu);
+            return;
+        }
+        uint64_t rd = gicr_rd_base(target_cpu);
+        write32(mask, (void *) (rd + (pend ? GICR_ISPENDR0 : GICR_ICPENDR0)));
+        logger_gic_debug("GIC: Set IRQ %d pending=%d for CPU %d\n", int_id, pend, target_cpu);
+    } else {
+        if (pend)
+            write32(mask, (void *) GICD_ISPENDER(int_id / 32));
+        else
+            write32(mask, (void *) GICD_ICPENDER(int_id / 32));
+        logger_gic_debug("GIC: Set IRQ %d pending=%d\n", int_id, pend);
+    }
+}
+
+static uint64_t
+gic_ipriority_addr(uint32_t vector)
+{
+    if (vector < GIC_NR_PRIVATE_IRQS)
+        return gicr_rd_base(get_current_cpu_id()) + GICR_IPRIORITYR + (vector & ~3U);
+    return GICD_IPRIORITYR(vector >> 2);
+}
+
+// Set the interrupt priority
+void
+gic_set_ipriority(uint32_t vector, uint32_t pri)
+{
+    uint32_t m    = vector & 3;
+    uint64_t addr = gic_ipriority_addr(vector);
+    uint32_t val  = read32((void *) addr);
+
+    // 与 GICv2 保持相同的优先级编码
+    uint8_t priority = (pri << 3) | (1 << 7);
+    val &= ~(0xFF << (8 * m));
+    val |= (priority << (8 * m));
+
+    write32(val, (void *) addr);
+    logger_gic_debug("GIC: set int: %d(m: %u) priority: 0x%x\n", vector, m, pri);
+}
+
+// Get the interrupt priority
+int32_t
+gic_get_ipriority(int32_t vector)
+{
+    uint32_t reg_val = read32((void *) gic_ipriority_addr(vector));
+    return (reg_val >> ((vector & 0x3) * 8)) & 0xFF;
+}
+
+// 返回与 GICv2 GICD_ITARGETSR 相同格式的 CPU 位图
+int32_t
+gic_get_target(int32_t int_id)
+{
+    if (int_id < GIC_FIRST_SPI)
+        return 1 << get_current_cpu_id();
+
+    uint32_t aff = irouter_to_affinity(read64((void *) GICD_IROUTER(int_id)));
+    for (int32_t cpu = 0; cpu < SMP_NUM; cpu++) {
+        if (_gicr_base[cpu] && _cpu_affinity[cpu] == aff)
+            return 1 << cpu;
+    }
+    return 0;
+}
+
+// target 为 CPU 位图；亲和性路由只能指定一个目标，取最低位的 CPU
+void
+gic_set_target(int32_t int_id, uint8_t target)
+{
+    if (int_id < GIC_FIRST_SPI || int_id >= _gicv2.irq_nr) {
+        logger_error("GIC: Invalid SPI interrupt ID %d for set_target\n", int_id);
+        return;
+    }
+
+    int32_t cpu = 0;
+    while (cpu < SMP_NUM && !(target & (1U << cpu)))
+        cpu++;
+    if (cpu >= SMP_NUM || _gicr_base[cpu] == 0) {
+        logger_warn("GIC: Setting target to 0x%x for IRQ %d (no CPU selected)\n", target, int_id);
+        return;
+    }
+
+    write64(affinity_to_irouter(_cpu_affinity[cpu]), (void *) GICD_IROUTER(int_id));
+    logger_gic_debug("GIC: Route IRQ %d to CPU %d (aff 0x%x)\n", int_id, cpu, _cpu_affinity[cpu]);
+}
+
+// Set the interrupt configuration (edge/level)
+void
+gic_set_icfgr(uint32_t int_id, uint8_t cfg)
+{
+    if (int_id < 16) {
+        logger_warn("GIC: Cannot configure SGI %d (SGIs are always edge-triggered)\n", int_id);
+        return;
+    }
+
+    if (int_id >= _gicv2.irq_nr) {
+        logger_error("GIC: Invalid interrupt ID %d for configuration\n", int_id);
+        return;
+    }
+
+    uint32_t bit_offset = (int_id * 2) % 32;
+    uint32_t mask       = 0b11 << bit_offset;
+    uint64_t addr;
+
+    if (int_id < GIC_NR_PRIVATE_IRQS)
+        addr = gicr_rd_base(get_current_cpu_id()) + GICR_ICFGR1;
+    else
+        addr = GICD_ICFGR((int_id * 2) / 32);
+
+    uint32_t val = read32((void *) addr);
+    val          = (val & ~mask) | (((uint32_t) (cfg & 0x3) << bit_offset) & mask);
+    write32(val, (void *) addr);
+
+    logger_gic_debug("GIC: Set IRQ %d configuration to %s\n",
+                     int_id,
+                     (cfg & 0x2) ? "edge-triggered" : "level-sensitive");
+}
+
+/*
+ * ICH_LR<n>_EL2:
+ *   [31:0] vINTID  [44:32] pINTID  [55:48] Priority  [60] Group  [61] HW  [63:62] State
+ * GICv3 guest 只使用 Group1 (ICC_IAR1_EL1)，因此 Group 位固定置 1，grp1 参数仅为兼容 GICv2
+ */
+gic_lr_t
+gic_make_virtual_hardware_interrupt(uint32_t vector, uint32_t pintvec, int32_t pri, bool grp1)
+{
+    (void) grp1;
+    return ICH_LR_PENDING | ICH_LR_HW | ICH_LR_GROUP |
+           ((gic_lr_t) (pri & 0xff) << ICH_LR_PRIORITY_SHIFT) |
+           ((gic_lr_t) (pintvec & 0x1fff) << ICH_LR_PINTID_SHIFT) | (vector & ICH_LR_VINTID_MASK);
+}
+
+gic_lr_t
+gic_make_virtual_software_interrupt(uint32_t vector, int32_t pri, bool grp1)
+{
+    (void) grp1;
+    return ICH_LR_PENDING | ICH_LR_GROUP | ((gic_lr_t) (pri & 0xff) << ICH_LR_PRIORITY_SHIFT) |
+           (vector & ICH_LR_VINTID_MASK);
+}
+
+// GICv3 的 LR 没有 SGI 源 CPU 字段，guest 通过亲和性路由区分目标
+gic_lr_t
+gic_make_virtual_software_sgi(uint32_t vector, int32_t cpu_id, int32_t pri, bool grp1)
+{
+    (void) cpu_id;
+    return gic_make_virtual_software_interrupt(vector, pri, grp1);
+}
+
+// ===================================
+// 下面是关于 ICH 系统寄存器的函数
+// ===================================
+
+#define ICH_LR_CASE_READ(n)                                                                        \
+    case n:                                                                                        \
+        return gicv3_read_sysreg(ich_lr##n##_el2)
+
+#define ICH_LR_CASE_WRITE(n, v)                                                                    \
+    case n:                                                                                        \
+        gicv3_write_sysreg(v, ich_lr##n##_el2);                                                    \
+        break
+
+gic_lr_t
+gic_read_lr(int32_t n)
+{
+    switch (n) {
+        ICH_LR_CASE_READ(0);
+        ICH_LR_CASE_READ(1);
+        ICH_LR_CASE_READ(2);
+        ICH_LR_CASE_READ(3);
+        ICH_LR_CASE_READ(4);
+        ICH_LR_CASE_READ(5);
+        ICH_LR_CASE_READ(6);
+        ICH_LR_CASE_READ(7);
+        ICH_LR_CASE_READ(8);
+        ICH_LR_CASE_READ(9);
+        ICH_LR_CASE_READ(10);
+        ICH_LR_CASE_READ(11);
+        ICH_LR_CASE_READ(12);
+        ICH_LR_CASE_READ(13);
+        ICH_LR_CASE_READ(14);
+        ICH_LR_CASE_READ(15);
+        default:
+            logger_error("GIC: Invalid LR index %d\n", n);
+            return 0;
+    }
+}
+
+void
+gic_write_lr(int32_t n, gic_lr_t mask)
+{
+    if (n < 0 || n >= GICH_LR_NUM) {
+        logger_error("GIC: Invalid LR index %d (max %d)\n", n, GICH_LR_NUM - 1);
+        return;
+    }
+
+    switch (n) {
+        ICH_LR_CASE_WRITE(0, mask);
+        ICH_LR_CASE_WRITE(1, mask);
+        ICH_LR_CASE_WRITE(2, mask);
+        ICH_LR_CASE_WRITE(3, mask);
+        ICH_LR_CASE_WRITE(4, mask);
+        ICH_LR_CASE_WRITE(5, mask);
+        ICH_LR_CASE_WRITE(6, mask);
+        ICH_LR_CASE_WRITE(7, mask);
+        ICH_LR_CASE_WRITE(8, mask);
+        ICH_LR_CASE_WRITE(9, mask);
+        ICH_LR_CASE_WRITE(10, mask);
+        ICH_LR_CASE_WRITE(11, mask);
+        ICH_LR_CASE_WRITE(12, mask);
+        ICH_LR_CASE_WRITE(13, mask);
+        ICH_LR_CASE_WRITE(14, mask);
+        ICH_LR_CASE_WRITE(15, mask);
+        default:
+            break;
+    }
+}
+
+int32_t
+gic_lr_read_pri(gic_lr_t lr_value)
+{
+    return (int32_t) ((lr_value >> ICH_LR_PRIORITY_SHIFT) & 0xff);
+}
+
+uint32_t
+gic_lr_read_vid(gic_lr_t lr_value)
+{
+    return (uint32_t) (lr_value & ICH_LR_VINTID_MASK);
+}
+
+uint32_t
+gic_lr_read_state(gic_lr_t lr_value)
+{
+    return (uint32_t) (lr_value >> ICH_LR_STATE_SHIFT) & 0x3;
+}
+
+gic_lr_t
+gic_lr_clear_pending(gic_lr_t lr_value)
+{
+    return lr_value & ~ICH_LR_PENDING;
+}
+
+// guest 只使用 Group1，活动优先级保存在 ICH_AP1R0_EL2
+uint32_t
+gic_apr()
+{
+    return (uint32_t) gicv3_read_sysreg(ich_ap1r0_el2);
+}
+
+void
+gic_write_apr(uint32_t apr)
+{
+    gicv3_write_sysreg(apr, ich_ap1r0_el2);
+}
+
+uint32_t
+gic_elsr0()
+{
+    return (uint32_t) gicv3_read_sysreg(ich_elrsr_el2);
+}
+
+// ICH_ELRSR_EL2 最多覆盖 16 个 LR
+uint32_t
+gic_elsr1()
+{
+    return 0;
+}
+
+uint32_t
+gic_read_vmcr(void)
+{
+    return (uint32_t) gicv3_read_sysreg(ich_vmcr_el2);
+}
+
+void
+gic_write_vmcr(uint32_t vmcr)
+{
+    gicv3_write_sysreg(vmcr, ich_vmcr_el2);
+}
+
+uint32_t
+gic_read_hcr(void)
+{
+    return (uint32_t) gicv3_read_sysreg(ich_hcr_el2);
+}
+
+void
+gic_write_hcr(uint32_t hcr)
+{
+    gicv3_write_sysreg(hcr, ich_hcr_el2);
+}
+
+void
+gic_set_np_int(void)
+{
+    gic_write_hcr(gic_read_hcr() | ICH_HCR_NPIE);
+    logger_gic_debug("GIC: Enabled non-priority interrupts in hypervisor\n");
+}
+
+void
+gic_clear_np_int(void)
+{
+    gic_write_hcr(gic_read_hcr() & ~ICH_HCR_NPIE);
+    logger_gic_debug("GIC: Disabled non-priority interrupts in hypervisor\n");
+}
+
+uint32_t
+gic_cpu_affinity(int32_t cpu)
+{
+    if (cpu < 0 || cpu >= SMP_NUM)
+        return 0;
+    return _cpu_affinity[cpu];
+}
+
+#endif  // GIC_VERSION == 3
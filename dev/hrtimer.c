@@ -0,0 +1,242 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file hrtimer.c
+ * @brief Implementation of hrtimer.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#include "hrtimer.h"
+#include "avatar_types.h"
+#include "io.h"
+#include "os_cfg.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "timer.h"
+#include "task/task.h"
+
+typedef struct
+{
+    spinlock_t lock;
+    hrtimer_t *head;     // 按 expires 升序排列
+    uint64_t   armed;    // 比较器当前编程的到期时刻，0 表示未启用
+    bool       resched;  // 回调请求在中断结束时调度
+} hrtimer_base_t;
+
+static hrtimer_base_t _hrtimer_base[SMP_NUM];
+
+static uint64_t _hrtimer_freq = TIMER_FREQUENCY_HZ;
+
+// 把比较器编程为 cval；cval 已过期时会立即触发中断
+static void
+hrtimer_program(hrtimer_base_t *base, uint64_t cval)
+{
+    base->armed = cval;
+#if HV == 1
+    write_cnthp_cval_el2(cval);
+    write_cnthp_ctl_el2(0b1);
+#else
+    write_cntp_cval_el0(cval);
+    write_cntp_ctl_el0(0b1);
+#endif
+}
+
+static void
+hrtimer_disarm(hrtimer_base_t *base)
+{
+    base->armed = 0;
+#if HV == 1
+    write_cnthp_ctl_el2(0);
+#else
+    write_cntp_ctl_el0(0);
+#endif
+}
+
+// 按 expires 插入队列，相同到期时间的按插入顺序排列。返回是否成为新的队首
+static bool
+hrtimer_enqueue(hrtimer_base_t *base, hrtimer_t *timer)
+{
+    hrtimer_t **pp = &base->head;
+
+    while (*pp && (*pp)->expires <= timer->expires)
+        pp = &(*pp)->next;
+
+    timer->next   = *pp;
+    *pp           = timer;
+    timer->queued = true;
+    return pp == &base->head;
+}
+
+static void
+hrtimer_dequeue(hrtimer_base_t *base, hrtimer_t *timer)
+{
+    hrtimer_t **pp = &base->head;
+
+    while (*pp && *pp != timer)
+        pp = &(*pp)->next;
+    if (*pp)
+        *pp = timer->next;
+
+    timer->next   = NULL;
+    timer->queued = false;
+}
+
+// 让比较器跟随队首，队列为空时关闭
+static void
+hrtimer_reprogram(hrtimer_base_t *base)
+{
+    if (!base->head)
+        hrtimer_disarm(base);
+    else if (base->head->expires != base->armed)
+        hrtimer_program(base, base->head->expires);
+}
+
+// 每核调用一次，在安装定时器中断之前
+void
+hrtimer_init_local(void)
+{
+    hrtimer_base_t *base = &_hrtimer_base[get_current_cpu_id()];
+
+    uint64_t freq = read_cntfrq_el0();
+    if (freq)
+        _hrtimer_freq = freq;
+
+    spinlock_init(&base->lock);
+    base->head    = NULL;
+    base->resched = false;
+    hrtimer_disarm(base);
+}
+
+void
+hrtimer_init(hrtimer_t *timer, hrtimer_fn_t fn, void *data)
+{
+    timer->next    = NULL;
+    timer->expires = 0;
+    timer->fn      = fn;
+    timer->data    = data;
+    timer->cpu     = 0;
+    timer->queued  = false;
+}
+
+// 在当前 CPU 上启动定时器，expires 为 CNTPCT 绝对值。已在队列中的定时器会被重新排队
+void
+hrtimer_start(hrtimer_t *timer, uint64_t expires)
+{
+    hrtimer_base_t *base;
+    uint64_t        daif;
+
+    if (timer->queued)
+        hrtimer_cancel(timer);
+
+    timer->cpu     = get_current_cpu_id();
+    timer->expires = expires;
+
+    base = &_hrtimer_base[timer->cpu];
+    daif = spin_lock_irqsave(&base->lock);
+    if (hrtimer_enqueue(base, timer))
+        hrtimer_reprogram(base);
+    spin_unlock_irqrestore(&base->lock, daif);
+}
+
+void
+hrtimer_start_us(hrtimer_t *timer, uint64_t us)
+{
+    hrtimer_start(timer, read_cntpct_el0() + hrtimer_us_to_ticks(us));
+}
+
+// 取消定时器，返回定时器是否还在队列中。不等待正在执行的回调
+bool
+hrtimer_cancel(hrtimer_t *timer)
+{
+    hrtimer_base_t *base       = &_hrtimer_base[timer->cpu];
+    uint64_t        daif       = spin_lock_irqsave(&base->lock);
+    bool            was_queued = timer->queued;
+
+    if (was_queued) {
+        bool was_head = (base->head == timer);
+        hrtimer_dequeue(base, timer);
+        // 只有本核的比较器可以在这里改写，远端核在下次中断时自行跟上
+        if (was_head && timer->cpu == get_current_cpu_id())
+            hrtimer_reprogram(base);
+    }
+    spin_unlock_irqrestore(&base->lock, daif);
+    return was_queued;
+}
+
+// 周期定时器在回调中使用：把 expires 向后推进到当前时刻之后，跳过错过的周期
+void
+hrtimer_forward_now(hrtimer_t *timer, uint64_t interval)
+{
+    uint64_t now = read_cntpct_el0();
+
+    if (!interval)
+        return;
+
+    timer->expires += interval;
+    if (timer->expires <= now) {
+        uint64_t missed = (now - timer->expires) / interval + 1;
+        timer->expires += missed * interval;
+    }
+}
+
+void
+hrtimer_request_resched(void)
+{
+    _hrtimer_base[get_current_cpu_id()].resched = true;
+}
+
+// 分成整秒和余数两部分计算，避免大数值相乘溢出
+uint64_t
+hrtimer_us_to_ticks(uint64_t us)
+{
+    return (us / 1000000) * _hrtimer_freq + (us % 1000000) * _hrtimer_freq / 1000000;
+}
+
+uint64_t
+hrtimer_ticks_to_us(uint64_t ticks)
+{
+    return (ticks / _hrtimer_freq) * 1000000 + (ticks % _hrtimer_freq) * 1000000 / _hrtimer_freq;
+}
+
+// 定时器中断：执行所有到期的回调，比较器编程为新的队首，最后按需调度
+void
+hrtimer_interrupt(uint64_t *ctx)
+{
+    (void) ctx;
+    hrtimer_base_t *base = &_hrtimer_base[get_current_cpu_id()];
+    bool            resched;
+
+    spin_lock(&base->lock);
+    base->armed = 0;
+
+    uint64_t now = read_cntpct_el0();
+    while (base->head && base->head->expires <= now) {
+        hrtimer_t *timer = base->head;
+        hrtimer_dequeue(base, timer);
+
+        spin_unlock(&base->lock);
+        hrtimer_restart_t ret = timer->fn(timer);
+        spin_lock(&base->lock);
+
+        // 回调里可能已经用 hrtimer_start 重新排队
+        if (ret == HRTIMER_RESTART && !timer->queued)
+            hrtimer_enqueue(base, timer);
+
+        now = read_cntpct_el0();
+    }
+
+    hrtimer_reprogram(base);
+
+    resched       = base->resched;
+    base->resched = false;
+    spin_unlock(&base->lock);
+
+    // schedule 可能切换栈，必须放在比较器编程之后
+    if (resched)
+        schedule();
+}
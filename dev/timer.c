@@ -12,6 +12,8 @@
 
 
 #include "timer.h"
+#include "hrtimer.h"
+#include "clocksource.h"
 #include "gic.h"
 #include "avatar_types.h"
 #include "io.h"
@@ -21,27 +23,33 @@
 #include "vmm/vgic.h"
 #include "os_cfg.h"
 
-static uint64_t test_num = 0;
-
 extern void
 v_timer_tick(uint64_t now);
 
+// 每核一个周期性的调度 tick，挂在 hrtimer 队列上
+static hrtimer_t _tick_timer[SMP_NUM];
 
-void
-handle_timer_interrupt(uint64_t *sp)
+static hrtimer_restart_t
+tick_timer_fn(hrtimer_t *timer)
 {
-#if HV == 1
-    // Hypervisor Timer - 设置定时值
-    write_cnthp_tval_el2(TIMER_TVAL_VALUE);
-#else
-    // Physical Timer - 设置定时值
-    write_cntp_tval_el0(TIMER_TVAL_VALUE);
-#endif
-
-    // if (get_current_cpu_id() == 0) {
-    timer_tick_schedule(sp);
+    if (sched_tick())
+        hrtimer_request_resched();
     v_timer_tick(read_cntpct_el0());
-    // }
+
+    hrtimer_forward_now(timer, TIMER_TVAL_VALUE);
+    return HRTIMER_RESTART;
+}
+
+// 每核初始化 hrtimer 队列，并启动调度 tick
+static void
+timer_init_local(void)
+{
+    hrtimer_t *tick = &_tick_timer[get_current_cpu_id()];
+
+    hrtimer_init_local();
+    clocksource_init_local();
+    hrtimer_init(tick, tick_timer_fn, NULL);
+    hrtimer_start(tick, read_cntpct_el0() + TIMER_TVAL_VALUE);
 }
 
 void
@@ -52,16 +60,11 @@ timer_init_second()
     logger("timer frq: %d\n", frq);
 
 #if HV == 1
-    // Hypervisor Timer 初始化
     logger("Initializing Hypervisor Timer (Vector %d)\n", TIMER_VECTOR);
-    write_cnthp_tval_el2(TIMER_TVAL_VALUE);
-    write_cnthp_ctl_el2(0b1);  // 启用 Hypervisor Timer
 #else
-    // Physical Timer 初始化
     logger("Initializing Physical Timer (Vector %d)\n", TIMER_VECTOR);
-    write_cntp_tval_el0(TIMER_TVAL_VALUE);
-    write_cntp_ctl_el0(0b1);  // 启用 Physical Timer
 #endif
+    timer_init_local();
 
     gic_enable_int(TIMER_VECTOR, 1);
 
@@ -69,7 +72,7 @@ timer_init_second()
         logger("timer enabled successfully ...\n");
     }
     // gic_set_target(TIMER_VECTOR, 0b00000010);
-    gic_set_ipriority(TIMER_VECTOR, 1);
+    gic_set_ipriority(TIMER_VECTOR, IRQ_PRIO_SCHED);
 }
 
 // 每个pe都要配置
@@ -81,19 +84,16 @@ timer_init()
     logger("timer frq: %d\n", frq);
 
 #if HV == 1
-    // Hypervisor Timer 初始化
     logger("Initializing Hypervisor Timer (Vector %d)\n", TIMER_VECTOR);
-    write_cnthp_tval_el2(TIMER_TVAL_VALUE);
-    write_cnthp_ctl_el2(0b1);  // 启用 Hypervisor Timer
 #else
-    // Physical Timer 初始化
     logger("Initializing Physical Timer (Vector %d)\n", TIMER_VECTOR);
-    write_cntp_tval_el0(TIMER_TVAL_VALUE);
-    write_cntp_ctl_el0(0b1);  // 启用 Physical Timer
 #endif
+    timer_init_local();
+    clocksource_init();
 
-    // 统一使用 handle_timer_interrupt，它内部会根据HV宏选择正确的寄存器
-    irq_install(TIMER_VECTOR, handle_timer_interrupt);
+    // 比较器由 hrtimer 按队首到期时间 one-shot 编程（HV=1 为 CNTHP，否则为 CNTP）
+    // tick 处理会调度切走，属于最低优先级且不可抢占
+    irq_install_prio(TIMER_VECTOR, hrtimer_interrupt, IRQ_PRIO_SCHED, 0);
 
     gic_enable_int(TIMER_VECTOR, 1);
 
@@ -101,5 +101,4 @@ timer_init()
         logger("timer enabled successfully ...\n");
     }
     // gic_set_target(TIMER_VECTOR, 0b00000001);
-    gic_set_ipriority(TIMER_VECTOR, 1);
-}
\ No newline at end of file
+}
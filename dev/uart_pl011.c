@@ -117,10 +117,14 @@ void
 uart_interrupt_handler(uint64_t *stack_pointer)
 {
     uint32_t mis = mmio_read32((void *) UART_MIS);
+    uint64_t daif;
+
+    // 本处理函数可被高优先级中断抢占，而 uart_putchar 等也会在中断里获取这些锁，
+    // 所以每段临界区都关本核 IRQ；临界区之间允许抢占
 
     // Handle transmit interrupt
     if (mis & UART_INT_TX) {
-        spin_lock(&tx_buffer.lock);
+        daif = spin_lock_irqsave(&tx_buffer.lock);
 
         // Send as many characters as possible
         while (!uart_tx_fifo_full() && !buffer_is_empty(&tx_buffer)) {
@@ -135,7 +139,7 @@ uart_interrupt_handler(uint64_t *stack_pointer)
             uart_disable_tx_interrupt();
         }
 
-        spin_unlock(&tx_buffer.lock);
+        spin_unlock_irqrestore(&tx_buffer.lock, daif);
 
         // Clear TX interrupt
         mmio_write32(UART_INT_TX, (void *) UART_ICR);
@@ -143,10 +147,9 @@ uart_interrupt_handler(uint64_t *stack_pointer)
 
     // Handle receive interrupt
     if (mis & (UART_INT_RX | UART_INT_RT)) {
-        spin_lock(&rx_buffer.lock);
-
-        // Read all available characters
+        // Read all available characters, one critical section per character
         while (!uart_rx_fifo_empty()) {
+            daif   = spin_lock_irqsave(&rx_buffer.lock);
             char c = (char) mmio_read32((void *) UART_DR);
             if (!buffer_is_full(&rx_buffer)) {
                 buffer_put(&rx_buffer, c);
@@ -158,9 +161,9 @@ uart_interrupt_handler(uint64_t *stack_pointer)
 
             /* Forward character to virtual UARTs */
             vpl011_handle_physical_uart_rx(c);
-        }
 
-        spin_unlock(&rx_buffer.lock);
+            spin_unlock_irqrestore(&rx_buffer.lock, daif);
+        }
 
         // Clear RX interrupts
         mmio_write32(UART_INT_RX | UART_INT_RT, (void *) UART_ICR);
@@ -202,13 +205,13 @@ uart_init(void)
     // Enable RX interrupts (TX interrupts enabled on demand)
     uart_enable_rx_interrupt();
 
-    // Install interrupt handler
-    irq_install(UART_IRQ, uart_interrupt_handler);
+    // Install interrupt handler. Draining the FIFOs can take a while, so let
+    // higher-priority interrupts preempt it between characters.
+    irq_install_prio(UART_IRQ, uart_interrupt_handler, IRQ_PRIO_DEVICE, IRQ_F_PREEMPTIBLE);
 
     // Enable UART interrupt in GIC
     gic_enable_int(UART_IRQ, 1);
     gic_set_target(33, 0b00000001);
-    gic_set_ipriority(UART_IRQ, 0);
 
     uart_initialized = true;
 
@@ -223,7 +226,7 @@ uart_putchar_nb(char c)
         return false;
     }
 
-    spin_lock(&tx_buffer.lock);
+    uint64_t daif = spin_lock_irqsave(&tx_buffer.lock);
 
     bool success = false;
 
@@ -240,7 +243,7 @@ uart_putchar_nb(char c)
         }
     }
 
-    spin_unlock(&tx_buffer.lock);
+    spin_unlock_irqrestore(&tx_buffer.lock, daif);
     return success;
 }
 
@@ -284,9 +287,9 @@ uart_getchar_nb(char *c)
         return false;
     }
 
-    spin_lock(&rx_buffer.lock);
+    uint64_t daif = spin_lock_irqsave(&rx_buffer.lock);
     bool success = buffer_get(&rx_buffer, c);
-    spin_unlock(&rx_buffer.lock);
+    spin_unlock_irqrestore(&rx_buffer.lock, daif);
 
     return success;
 }
@@ -299,9 +302,9 @@ uart_rx_available(void)
         return false;
     }
 
-    spin_lock(&rx_buffer.lock);
+    uint64_t daif = spin_lock_irqsave(&rx_buffer.lock);
     bool available = !buffer_is_empty(&rx_buffer);
-    spin_unlock(&rx_buffer.lock);
+    spin_unlock_irqrestore(&rx_buffer.lock, daif);
 
     return available;
 }
@@ -314,9 +317,9 @@ uart_tx_buffer_usage(void)
         return 0;
     }
 
-    spin_lock(&tx_buffer.lock);
+    uint64_t daif = spin_lock_irqsave(&tx_buffer.lock);
     uint32_t usage = tx_buffer.count;
-    spin_unlock(&tx_buffer.lock);
+    spin_unlock_irqrestore(&tx_buffer.lock, daif);
 
     return usage;
 }
@@ -131,6 +131,26 @@ avatar_virtio_block_read(uint64_t sector, void *buffer, uint32_t sector_count)
     return 0;
 }
 
+/**
+ * 分散读取：多段不连续的扇区一起提交给设备
+ * 碎片化的文件不再是每个片段一次同步往返
+ */
+int
+avatar_virtio_block_read_segments(const virtio_blk_seg_t *segs, uint32_t nsegs)
+{
+    if (!g_virtio_block_initialized) {
+        logger_error("VirtIO Block device not initialized\n");
+        return -1;
+    }
+
+    if (!segs || nsegs == 0) {
+        logger_error("Invalid parameters for block read\n");
+        return -1;
+    }
+
+    return virtio_blk_read_segments(&g_virtio_block_device, segs, nsegs);
+}
+
 /**
  * 向 VirtIO Block 设备写入数据
  * 这个函数可以被 Avatar VMM 后端调用，将 Guest 的数据写入存储
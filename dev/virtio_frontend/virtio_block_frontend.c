@@ -624,6 +624,118 @@ read_complete:
     return 0;
 }
 
+// 轮询直到 count 个请求完成
+static int
+virtio_blk_wait(virtio_blk_device_t *blk_dev, uint32_t count)
+{
+    uint32_t timeout = 50000 * count;
+
+    while (count > 0 && timeout-- > 0) {
+        if (virtio_queue_get_buf(blk_dev->dev, 0, NULL) >= 0) {
+            count--;
+            continue;
+        }
+        for (volatile int i = 0; i < 5; i++)
+            ;
+    }
+    return count == 0 ? 0 : -1;
+}
+
+// 分散读：每段（超过 VIRTIO_BLK_MAX_REQ_SECTORS 时再拆开）一个请求，
+// 一批最多 VIRTIO_BLK_MAX_INFLIGHT 个请求放进队列后只通知一次设备，再等整批完成
+int
+virtio_blk_read_segments(virtio_blk_device_t    *blk_dev,
+                         const virtio_blk_seg_t *segs,
+                         uint32_t                nsegs)
+{
+    if (!blk_dev || !blk_dev->dev || !segs) {
+        logger_error("Invalid parameters\n");
+        return -1;
+    }
+
+    virtio_blk_req_t *reqs =
+        (virtio_blk_req_t *) kalloc(sizeof(virtio_blk_req_t) * VIRTIO_BLK_MAX_INFLIGHT, 8);
+    uint8_t *status = (uint8_t *) kalloc(VIRTIO_BLK_MAX_INFLIGHT, 8);
+
+    if (!reqs || !status) {
+        logger_error("Failed to allocate request structures\n");
+        if (reqs)
+            kfree(reqs);
+        if (status)
+            kfree(status);
+        return -1;
+    }
+
+    virtio_queue_t *queue = &blk_dev->dev->queues[0];
+    uint32_t        seg   = 0;
+    uint32_t        done  = 0;  // 当前段已提交的扇区数
+    int             ret   = 0;
+
+    while (seg < nsegs && ret == 0) {
+        uint32_t inflight = 0;
+
+        while (seg < nsegs && inflight < VIRTIO_BLK_MAX_INFLIGHT && queue->num_free >= 3) {
+            uint32_t count = segs[seg].count - done;
+            if (count > VIRTIO_BLK_MAX_REQ_SECTORS)
+                count = VIRTIO_BLK_MAX_REQ_SECTORS;
+
+            reqs[inflight].type     = VIRTIO_BLK_T_IN;
+            reqs[inflight].reserved = 0;
+            reqs[inflight].sector   = segs[seg].sector + done;
+            status[inflight]        = 0xff;
+
+            uint64_t buffers[3];
+            uint32_t lengths[3];
+
+            buffers[0] = (uint64_t) &reqs[inflight];
+            lengths[0] = sizeof(virtio_blk_req_t);
+            buffers[1] = (uint64_t) ((uint8_t *) segs[seg].buffer + done * blk_dev->block_size);
+            lengths[1] = count * blk_dev->block_size;
+            buffers[2] = (uint64_t) &status[inflight];
+            lengths[2] = 1;
+
+            if (virtio_queue_add_buf(blk_dev->dev, 0, buffers, lengths, 1, 2) < 0) {
+                logger_error("Failed to add buffer to queue\n");
+                ret = -1;
+                break;
+            }
+            inflight++;
+
+            done += count;
+            if (done == segs[seg].count) {
+                seg++;
+                done = 0;
+            }
+        }
+
+        if (inflight == 0) {
+            ret = -1;
+            break;
+        }
+
+        // 已经放进队列的请求无论如何都要等它们完成，请求头和状态字节才能释放
+        virtio_queue_kick(blk_dev->dev, 0);
+        if (virtio_blk_wait(blk_dev, inflight) < 0) {
+            logger_error("Timeout waiting for block read completion\n");
+            ret = -1;
+            break;
+        }
+
+        for (uint32_t i = 0; i < inflight; i++) {
+            if (status[i] != VIRTIO_BLK_S_OK) {
+                logger_error("Block read of sector %llu failed with status: %d\n",
+                             reqs[i].sector,
+                             status[i]);
+                ret = -1;
+            }
+        }
+    }
+
+    kfree(reqs);
+    kfree(status);
+    return ret;
+}
+
 // 向设备写入扇区
 int
 virtio_blk_write_sector(virtio_blk_device_t *blk_dev,
@@ -19,8 +19,10 @@
 
 #include "fs/fat32.h"
 #include "fs/fat32_file.h"
+#include "fs/fat32_dcache.h"
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
+#include "task/mutex.h"
 #include "io.h"
 
 /* ============================================================================
@@ -29,6 +31,9 @@
 
 fat32_context_t g_fat32_context;
 
+// 全零即未加锁状态，不依赖 fat32_init 的调用时机
+static mutex_t g_fat32_lock;
+
 /* ============================================================================
  * 文件系统管理函数实现
  * ============================================================================ */
@@ -91,6 +96,10 @@ fat32_format_and_mount(const char *volume_label)
         return FAT32_ERROR_ALREADY_EXISTS;
     }
 
+    // 格式化直接改写磁盘，缓存中的旧内容全部作废
+    fat32_cache_invalidate_all(g_fat32_context.cache_mgr);
+    fat32_dcache_clear();
+
     // 格式化磁盘
     fat32_error_t result = fat32_disk_format(g_fat32_context.disk, volume_label);
     if (result != FAT32_OK) {
@@ -128,6 +137,13 @@ fat32_mount(void)
         return result;
     }
 
+    result = fat32_fat_table_load(g_fat32_context.disk, &g_fat32_context.fs_info);
+    if (result != FAT32_OK) {
+        logger_error("FAT32: Failed to load FAT table\n");
+        return result;
+    }
+    fat32_dcache_clear();
+
     g_fat32_context.mounted = 1;
 
     logger_info("FAT32: File system mounted successfully\n");
@@ -143,27 +159,63 @@ fat32_unmount(void)
         return FAT32_OK;
     }
 
-    // 刷新缓存
-    fat32_error_t result = fat32_cache_flush(g_fat32_context.cache_mgr,
-                                             g_fat32_context.disk,
-                                             &g_fat32_context.fs_info);
-    if (result != FAT32_OK) {
-        logger("FAT32: Warning - Failed to flush cache during unmount\n");
+    // 更新FSInfo并把缓存中的脏数据写回磁盘
+    if (fat32_sync() != FAT32_OK) {
+        logger("FAT32: Warning - Failed to sync during unmount\n");
     }
 
-    // 更新FSInfo
-    result = fat32_boot_write_fsinfo(g_fat32_context.disk, &g_fat32_context.fs_info);
+    fat32_lock();
+    fat32_fat_table_release();
+    fat32_dcache_clear();
+    g_fat32_context.mounted = 0;
+    fat32_unlock();
+
+    logger("FAT32: File system unmounted successfully\n");
+    return FAT32_OK;
+}
+
+fat32_error_t
+fat32_sync(void)
+{
+    if (!g_fat32_context.initialized || !g_fat32_context.mounted) {
+        return FAT32_OK;
+    }
+
+    fat32_lock();
+
+    // 延迟分配的文件数据先分配簇，FAT 表的改动一起写回
+    fat32_error_t result = fat32_file_flush_all(g_fat32_context.disk, &g_fat32_context.fs_info);
     if (result != FAT32_OK) {
-        logger("FAT32: Warning - Failed to update FSInfo during unmount\n");
+        logger("FAT32: Warning - Failed to flush open files\n");
     }
 
-    // 同步磁盘
-    fat32_disk_sync(g_fat32_context.disk);
+    // FAT 表在内存中，修改过的扇区这时才写到磁盘（含所有 FAT 副本）
+    fat32_error_t fat_result =
+        fat32_fat_table_flush(g_fat32_context.disk, &g_fat32_context.fs_info);
+    if (fat_result != FAT32_OK) {
+        logger("FAT32: Warning - Failed to write FAT table\n");
+        result = fat_result;
+    }
 
-    g_fat32_context.mounted = 0;
+    // FSInfo 也经过缓存写入，要在刷新缓存之前更新
+    fat32_error_t fsinfo_result =
+        fat32_boot_write_fsinfo(g_fat32_context.disk, &g_fat32_context.fs_info);
+    if (fsinfo_result != FAT32_OK) {
+        logger("FAT32: Warning - Failed to update FSInfo\n");
+        result = fsinfo_result;
+    }
 
-    logger("FAT32: File system unmounted successfully\n");
-    return FAT32_OK;
+    fat32_error_t flush_result = fat32_cache_flush(g_fat32_context.cache_mgr,
+                                                   g_fat32_context.disk,
+                                                   &g_fat32_context.fs_info);
+    if (flush_result != FAT32_OK) {
+        logger("FAT32: Warning - Failed to flush cache\n");
+        result = flush_result;
+    }
+
+    fat32_disk_sync(g_fat32_context.disk);
+    fat32_unlock();
+    return result;
 }
 
 fat32_error_t
@@ -189,6 +241,18 @@ fat32_cleanup(void)
     return FAT32_OK;
 }
 
+void
+fat32_lock(void)
+{
+    mutex_lock(&g_fat32_lock);
+}
+
+void
+fat32_unlock(void)
+{
+    mutex_unlock(&g_fat32_lock);
+}
+
 /* ============================================================================
  * 兼容性接口函数实现
  * ============================================================================ */
@@ -201,11 +265,13 @@ fat32_open(const char *name)
     }
 
     fat32_file_handle_t *handle;
-    fat32_error_t        result = fat32_file_open(g_fat32_context.disk,
+    fat32_lock();
+    fat32_error_t result = fat32_file_open(g_fat32_context.disk,
                                            &g_fat32_context.fs_info,
                                            name,
                                            FAT32_O_RDWR | FAT32_O_CREAT,
                                            &handle);
+    fat32_unlock();
 
     if (result != FAT32_OK) {
         return -1;
@@ -224,11 +290,13 @@ fat32_open_readonly(const char *name)
     }
 
     fat32_file_handle_t *handle;
-    fat32_error_t        result = fat32_file_open(g_fat32_context.disk,
+    fat32_lock();
+    fat32_error_t result = fat32_file_open(g_fat32_context.disk,
                                            &g_fat32_context.fs_info,
                                            name,
                                            FAT32_O_RDONLY,
                                            &handle);
+    fat32_unlock();
 
     if (result != FAT32_OK) {
         return -1;
@@ -247,7 +315,9 @@ fat32_close(int32_t fd)
     }
 
     fat32_file_handle_t *handle = (fat32_file_handle_t *) (uintptr_t) fd;
+    fat32_lock();
     fat32_error_t result = fat32_file_close(g_fat32_context.disk, &g_fat32_context.fs_info, handle);
+    fat32_unlock();
 
     return (result == FAT32_OK) ? 0 : -1;
 }
@@ -261,12 +331,14 @@ fat32_read(int32_t fd, void *buf, size_t count)
 
     fat32_file_handle_t *handle = (fat32_file_handle_t *) (uintptr_t) fd;
     uint32_t             bytes_read;
-    fat32_error_t        result = fat32_file_read(g_fat32_context.disk,
+    fat32_lock();
+    fat32_error_t result = fat32_file_read(g_fat32_context.disk,
                                            &g_fat32_context.fs_info,
                                            handle,
                                            buf,
                                            (uint32_t) count,
                                            &bytes_read);
+    fat32_unlock();
 
     return (result == FAT32_OK) ? bytes_read : 0;
 }
@@ -280,12 +352,14 @@ fat32_write(int32_t fd, const void *buf, size_t count)
 
     fat32_file_handle_t *handle = (fat32_file_handle_t *) (uintptr_t) fd;
     uint32_t             bytes_written;
-    fat32_error_t        result = fat32_file_write(g_fat32_context.disk,
+    fat32_lock();
+    fat32_error_t result = fat32_file_write(g_fat32_context.disk,
                                             &g_fat32_context.fs_info,
                                             handle,
                                             buf,
                                             (uint32_t) count,
                                             &bytes_written);
+    fat32_unlock();
 
     if (result != FAT32_OK) {
         logger("FAT32: Write failed: %s\n", fat32_get_error_string(result));
@@ -295,6 +369,24 @@ fat32_write(int32_t fd, const void *buf, size_t count)
     return bytes_written;
 }
 
+int32_t
+fat32_preallocate(int32_t fd, size_t size)
+{
+    if (!fat32_is_mounted() || fd <= 0 || size > 0xFFFFFFFF) {
+        return -1;
+    }
+
+    fat32_file_handle_t *handle = (fat32_file_handle_t *) (uintptr_t) fd;
+    fat32_lock();
+    fat32_error_t result = fat32_file_preallocate(g_fat32_context.disk,
+                                                  &g_fat32_context.fs_info,
+                                                  handle,
+                                                  (uint32_t) size);
+    fat32_unlock();
+
+    return (result == FAT32_OK) ? 0 : -1;
+}
+
 off_t
 fat32_lseek(int32_t fd, off_t offset, int32_t whence)
 {
@@ -304,7 +396,9 @@ fat32_lseek(int32_t fd, off_t offset, int32_t whence)
 
     fat32_file_handle_t *handle = (fat32_file_handle_t *) (uintptr_t) fd;
     uint32_t             new_position;
-    fat32_error_t        result = fat32_file_seek(handle, (int32_t) offset, whence, &new_position);
+    fat32_lock();
+    fat32_error_t result = fat32_file_seek(handle, (int32_t) offset, whence, &new_position);
+    fat32_unlock();
 
     return (result == FAT32_OK) ? (off_t) new_position : -1;
 }
@@ -316,7 +410,9 @@ fat32_unlink(const char *name)
         return -1;
     }
 
+    fat32_lock();
     fat32_error_t result = fat32_file_delete(g_fat32_context.disk, &g_fat32_context.fs_info, name);
+    fat32_unlock();
 
     return (result == FAT32_OK) ? 0 : -1;
 }
@@ -453,6 +549,12 @@ fat32_print_cache_stats(void)
         logger("Used cache blocks: %u\n", used_blocks);
         logger("Dirty cache blocks: %u\n", dirty_blocks);
         logger("Cache utilization: %u%%\n", (used_blocks * 100) / total_blocks);
+        logger("Hits: %llu, misses: %llu, write-backs: %llu, read-ahead: %llu\n",
+               g_fat32_context.cache_mgr->hits,
+               g_fat32_context.cache_mgr->misses,
+               g_fat32_context.cache_mgr->writebacks,
+               g_fat32_context.cache_mgr->readahead);
+        fat32_dcache_print_stats();
         logger("==============================\n");
     } else {
         logger("FAT32: Failed to get cache statistics\n");
@@ -588,21 +690,23 @@ fat32_mkdir(const char *dirname)
 
     // 查找父目录
     uint32_t parent_cluster;
+    fat32_lock();
     result = fat32_file_find_directory(g_fat32_context.disk,
                                        &g_fat32_context.fs_info,
                                        dir_path,
                                        &parent_cluster);
-    if (result != FAT32_OK) {
-        return result;
-    }
 
     // 在父目录中创建新目录
     uint32_t new_dir_cluster;
-    return fat32_dir_create_directory(g_fat32_context.disk,
-                                      &g_fat32_context.fs_info,
-                                      parent_cluster,
-                                      dir_name,
-                                      &new_dir_cluster);
+    if (result == FAT32_OK) {
+        result = fat32_dir_create_directory(g_fat32_context.disk,
+                                            &g_fat32_context.fs_info,
+                                            parent_cluster,
+                                            dir_name,
+                                            &new_dir_cluster);
+    }
+    fat32_unlock();
+    return result;
 }
 
 fat32_error_t
@@ -622,19 +726,21 @@ fat32_rmdir(const char *dirname)
 
     // 查找父目录
     uint32_t parent_cluster;
+    fat32_lock();
     result = fat32_file_find_directory(g_fat32_context.disk,
                                        &g_fat32_context.fs_info,
                                        dir_path,
                                        &parent_cluster);
-    if (result != FAT32_OK) {
-        return result;
-    }
 
     // 在父目录中删除目录
-    return fat32_dir_remove_directory(g_fat32_context.disk,
-                                      &g_fat32_context.fs_info,
-                                      parent_cluster,
-                                      dir_name);
+    if (result == FAT32_OK) {
+        result = fat32_dir_remove_directory(g_fat32_context.disk,
+                                            &g_fat32_context.fs_info,
+                                            parent_cluster,
+                                            dir_name);
+    }
+    fat32_unlock();
+    return result;
 }
 
 fat32_error_t
@@ -650,12 +756,14 @@ fat32_listdir(const char        *dirname,
     *entry_count = 0;
 
     // 查找目录的簇号
-    uint32_t      dir_cluster;
+    uint32_t dir_cluster;
+    fat32_lock();
     fat32_error_t result = fat32_file_find_directory(g_fat32_context.disk,
                                                      &g_fat32_context.fs_info,
                                                      dirname,
                                                      &dir_cluster);
     if (result != FAT32_OK) {
+        fat32_unlock();
         return result;
     }
 
@@ -664,15 +772,15 @@ fat32_listdir(const char        *dirname,
 
     while (!iterator.end_of_dir && *entry_count < max_entries) {
         fat32_dir_entry_t dir_entry;
-        fat32_error_t     result = fat32_dir_iterator_next(g_fat32_context.disk,
-                                                       &g_fat32_context.fs_info,
-                                                       &iterator,
-                                                       &dir_entry);
+        result = fat32_dir_iterator_next(g_fat32_context.disk,
+                                         &g_fat32_context.fs_info,
+                                         &iterator,
+                                         &dir_entry);
         if (result != FAT32_OK) {
             if (result == FAT32_ERROR_END_OF_FILE) {
-                break;
+                result = FAT32_OK;
             }
-            return result;
+            break;
         }
 
         // 跳过空闲、已删除、长文件名和卷标目录项
@@ -684,8 +792,9 @@ fat32_listdir(const char        *dirname,
         entries[*entry_count] = dir_entry;
         (*entry_count)++;
     }
+    fat32_unlock();
 
-    return FAT32_OK;
+    return result;
 }
 
 fat32_error_t
@@ -695,7 +804,11 @@ fat32_stat(const char *filepath, fat32_dir_entry_t *file_info)
         return FAT32_ERROR_INVALID_PARAM;
     }
 
-    return fat32_file_stat(g_fat32_context.disk, &g_fat32_context.fs_info, filepath, file_info);
+    fat32_lock();
+    fat32_error_t result =
+        fat32_file_stat(g_fat32_context.disk, &g_fat32_context.fs_info, filepath, file_info);
+    fat32_unlock();
+    return result;
 }
 
 fat32_error_t
@@ -705,5 +818,9 @@ fat32_rename(const char *old_name, const char *new_name)
         return FAT32_ERROR_INVALID_PARAM;
     }
 
-    return fat32_file_rename(g_fat32_context.disk, &g_fat32_context.fs_info, old_name, new_name);
+    fat32_lock();
+    fat32_error_t result =
+        fat32_file_rename(g_fat32_context.disk, &g_fat32_context.fs_info, old_name, new_name);
+    fat32_unlock();
+    return result;
 }
@@ -18,6 +18,7 @@
  */
 
 #include "fs/fat32_boot.h"
+#include "fs/fat32_cache.h"
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
 #include "io.h"
@@ -33,7 +34,7 @@ fat32_boot_read_boot_sector(fat32_disk_t *disk, fat32_fs_info_t *fs_info)
     avatar_assert(fs_info != NULL);
 
     // 读取引导扇区
-    fat32_error_t result = fat32_disk_read_sectors(disk, 0, 1, &fs_info->boot_sector);
+    fat32_error_t result = fat32_cache_read_sectors(disk, 0, 1, &fs_info->boot_sector);
     if (result != FAT32_OK) {
         logger("FAT32: Failed to read boot sector\n");
         return result;
@@ -181,7 +182,7 @@ fat32_boot_read_fsinfo(fat32_disk_t *disk, fat32_fs_info_t *fs_info)
     }
 
     // 读取FSInfo扇区
-    fat32_error_t result = fat32_disk_read_sectors(disk, fsinfo_sector, 1, &fs_info->fsinfo);
+    fat32_error_t result = fat32_cache_read_sectors(disk, fsinfo_sector, 1, &fs_info->fsinfo);
     if (result != FAT32_OK) {
         logger("FAT32: Failed to read FSInfo sector %u\n", fsinfo_sector);
         return result;
@@ -232,7 +233,7 @@ fat32_boot_write_fsinfo(fat32_disk_t *disk, const fat32_fs_info_t *fs_info)
     fsinfo.next_free  = fs_info->next_free_cluster;
 
     // 写入FSInfo扇区
-    fat32_error_t result = fat32_disk_write_sectors(disk, fsinfo_sector, 1, &fsinfo);
+    fat32_error_t result = fat32_cache_write_sectors(disk, fsinfo_sector, 1, &fsinfo);
     if (result != FAT32_OK) {
         logger("FAT32: Failed to write FSInfo sector %u\n", fsinfo_sector);
         return result;
@@ -12,42 +12,77 @@
 
 /**
  * @file fat32_cache.c
- * @brief FAT32缓存管理实现
- * 
- * 本文件实现了FAT32文件系统的缓存管理功能。
- * 简化实现，主要提供基本的缓存接口。
+ * @brief FAT32缓冲区缓存实现
+ *
+ * 缓冲区头一次分配好，数据区按页（每页 8 个扇区）随使用增长，直到达到
+ * FAT32_CACHE_SIZE_MB。缓冲区满后从 LRU 链首淘汰，脏缓冲先与相邻的脏扇区合并写回。
+ * 所有操作在 cache_mgr->lock 下进行，磁盘 I/O 是同步轮询的，持锁期间完成。
  */
 
 #include "fs/fat32_cache.h"
 #include "fs/fat32_boot.h"
+#include "fs/fat32_fat.h"
+#include "fs/fat32.h"
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
 #include "mem/mem.h"
 #include "io.h"
 
+#define FAT32_CACHE_BUFS_PER_PAGE (PAGE_SIZE / FAT32_SECTOR_SIZE)
+#define FAT32_CACHE_BUF_PAGES                                                                      \
+    (UP2(FAT32_CACHE_BUFFERS * sizeof(fat32_buf_t), PAGE_SIZE) / PAGE_SIZE)
+#define FAT32_CACHE_HASH_PAGES                                                                     \
+    (UP2(FAT32_CACHE_HASH_BUCKETS * sizeof(fat32_buf_t *), PAGE_SIZE) / PAGE_SIZE)
+#define FAT32_CACHE_WB_PAGES      (FAT32_CACHE_WB_BATCH * FAT32_SECTOR_SIZE / PAGE_SIZE)
+#define FAT32_CACHE_RA_PAGES      (FAT32_CACHE_RA_BATCH * FAT32_SECTOR_SIZE / PAGE_SIZE)
+
 /* ============================================================================
  * 全局变量
  * ============================================================================ */
 
 static fat32_cache_manager_t g_cache_manager;
 
+// 合并写回用的中转缓冲区，持锁使用
+static uint8_t *g_cache_wb_buffer;
+
+// 预读用的中转缓冲区，持锁使用。淘汰时可能写回，不能与 g_cache_wb_buffer 共用
+static uint8_t *g_cache_ra_buffer;
+
 /* ============================================================================
  * 私有函数声明
  * ============================================================================ */
 
-static fat32_cache_block_t *
-fat32_cache_find_block(fat32_cache_manager_t *cache_mgr, uint32_t cluster_num);
-static fat32_cache_block_t *
-fat32_cache_alloc_block(fat32_cache_manager_t *cache_mgr);
+static fat32_buf_t *
+fat32_cache_lookup(fat32_cache_manager_t *cache_mgr, uint32_t sector);
+static void
+fat32_cache_hash_insert(fat32_cache_manager_t *cache_mgr, fat32_buf_t *buf);
+static void
+fat32_cache_hash_remove(fat32_cache_manager_t *cache_mgr, fat32_buf_t *buf);
+static fat32_buf_t *
+fat32_cache_get_free_buf(fat32_cache_manager_t *cache_mgr, fat32_disk_t *disk);
+static fat32_error_t
+fat32_cache_write_back(fat32_cache_manager_t *cache_mgr, fat32_disk_t *disk, fat32_buf_t *buf);
 static fat32_error_t
-fat32_cache_load_cluster(fat32_cache_block_t   *block,
-                         fat32_disk_t          *disk,
-                         const fat32_fs_info_t *fs_info,
-                         uint32_t               cluster_num);
+fat32_cache_flush_locked(fat32_cache_manager_t *cache_mgr, fat32_disk_t *disk);
 static fat32_error_t
-fat32_cache_write_back_block(fat32_cache_block_t   *block,
-                             fat32_disk_t          *disk,
-                             const fat32_fs_info_t *fs_info);
+fat32_cache_read(fat32_disk_t *disk,
+                 uint32_t      sector_num,
+                 uint32_t      sector_count,
+                 void         *buffer,
+                 bool          fill);
+
+static inline uint32_t
+fat32_cache_hash_index(uint32_t sector)
+{
+    return (sector ^ (sector >> 12)) & (FAT32_CACHE_HASH_BUCKETS - 1);
+}
+
+static inline void
+fat32_cache_touch(fat32_cache_manager_t *cache_mgr, fat32_buf_t *buf)
+{
+    list_delete(&cache_mgr->lru, &buf->lru_node);
+    list_insert_last(&cache_mgr->lru, &buf->lru_node);
+}
 
 /* ============================================================================
  * 缓存管理函数实现
@@ -62,30 +97,43 @@ fat32_cache_init(fat32_cache_manager_t *cache_mgr)
         return FAT32_OK;
     }
 
-    // 初始化缓存管理器
     memset(cache_mgr, 0, sizeof(fat32_cache_manager_t));
 
-    // 为每个缓存块分配内存
-    for (int i = 0; i < FAT32_CACHE_SIZE; i++) {
-        cache_mgr->blocks[i].data = (uint8_t *) kalloc_pages(FAT32_CACHE_BLOCK_SIZE / PAGE_SIZE);
-        if (cache_mgr->blocks[i].data == NULL) {
-            // 分配失败，清理已分配的内存
-            for (int j = 0; j < i; j++) {
-                kfree_pages(cache_mgr->blocks[j].data, FAT32_CACHE_BLOCK_SIZE / PAGE_SIZE);
-            }
-            return FAT32_ERROR_DISK_ERROR;
+    cache_mgr->bufs   = (fat32_buf_t *) kalloc_pages(FAT32_CACHE_BUF_PAGES);
+    cache_mgr->hash   = (fat32_buf_t **) kalloc_pages(FAT32_CACHE_HASH_PAGES);
+    g_cache_wb_buffer = (uint8_t *) kalloc_pages(FAT32_CACHE_WB_PAGES);
+    g_cache_ra_buffer = (uint8_t *) kalloc_pages(FAT32_CACHE_RA_PAGES);
+    if (cache_mgr->bufs == NULL || cache_mgr->hash == NULL || g_cache_wb_buffer == NULL ||
+        g_cache_ra_buffer == NULL) {
+        if (cache_mgr->bufs != NULL) {
+            kfree_pages(cache_mgr->bufs, FAT32_CACHE_BUF_PAGES);
         }
-
-        cache_mgr->blocks[i].cluster_num = 0;
-        cache_mgr->blocks[i].status      = FAT32_CACHE_FREE;
-        cache_mgr->blocks[i].access_time = 0;
-        cache_mgr->blocks[i].in_use      = 0;
+        if (cache_mgr->hash != NULL) {
+            kfree_pages(cache_mgr->hash, FAT32_CACHE_HASH_PAGES);
+        }
+        if (g_cache_wb_buffer != NULL) {
+            kfree_pages(g_cache_wb_buffer, FAT32_CACHE_WB_PAGES);
+            g_cache_wb_buffer = NULL;
+        }
+        if (g_cache_ra_buffer != NULL) {
+            kfree_pages(g_cache_ra_buffer, FAT32_CACHE_RA_PAGES);
+            g_cache_ra_buffer = NULL;
+        }
+        memset(cache_mgr, 0, sizeof(fat32_cache_manager_t));
+        return FAT32_ERROR_DISK_ERROR;
     }
 
-    cache_mgr->access_counter = 0;
-    cache_mgr->initialized    = 1;
+    memset(cache_mgr->bufs, 0, FAT32_CACHE_BUFFERS * sizeof(fat32_buf_t));
+    memset(cache_mgr->hash, 0, FAT32_CACHE_HASH_BUCKETS * sizeof(fat32_buf_t *));
+    list_init(&cache_mgr->lru);
+    spinlock_init(&cache_mgr->lock);
 
-    logger("FAT32: Cache manager initialized with %d blocks\n", FAT32_CACHE_SIZE);
+    cache_mgr->capacity    = FAT32_CACHE_BUFFERS;
+    cache_mgr->initialized = 1;
+
+    logger("FAT32: Buffer cache initialized, up to %u sectors (%u MB)\n",
+           cache_mgr->capacity,
+           FAT32_CACHE_SIZE_MB);
     return FAT32_OK;
 }
 
@@ -100,19 +148,24 @@ fat32_cache_cleanup(fat32_cache_manager_t *cache_mgr,
         return FAT32_OK;
     }
 
-    // 刷新所有脏缓存块
+    // 刷新所有脏缓冲区
     fat32_error_t result = fat32_cache_flush(cache_mgr, disk, fs_info);
     if (result != FAT32_OK) {
         logger("FAT32: Warning - Failed to flush cache during cleanup\n");
     }
 
-    // 释放所有缓存块内存
-    for (int i = 0; i < FAT32_CACHE_SIZE; i++) {
-        if (cache_mgr->blocks[i].data != NULL) {
-            kfree_pages(cache_mgr->blocks[i].data, FAT32_CACHE_BLOCK_SIZE / PAGE_SIZE);
-            cache_mgr->blocks[i].data = NULL;
-        }
+    // 数据区按页顺序分配，每页的第一个缓冲区指向页首；失效后 nbufs 会回到 0，
+    // 所以按 data 是否存在释放
+    for (uint32_t i = 0; i < FAT32_CACHE_BUFFERS && cache_mgr->bufs[i].data != NULL;
+         i += FAT32_CACHE_BUFS_PER_PAGE) {
+        kfree_pages(cache_mgr->bufs[i].data, 1);
     }
+    kfree_pages(cache_mgr->bufs, FAT32_CACHE_BUF_PAGES);
+    kfree_pages(cache_mgr->hash, FAT32_CACHE_HASH_PAGES);
+    kfree_pages(g_cache_wb_buffer, FAT32_CACHE_WB_PAGES);
+    kfree_pages(g_cache_ra_buffer, FAT32_CACHE_RA_PAGES);
+    g_cache_wb_buffer = NULL;
+    g_cache_ra_buffer = NULL;
 
     memset(cache_mgr, 0, sizeof(fat32_cache_manager_t));
 
@@ -121,177 +174,323 @@ fat32_cache_cleanup(fat32_cache_manager_t *cache_mgr,
 }
 
 fat32_error_t
-fat32_cache_read_cluster(fat32_cache_manager_t *cache_mgr,
-                         fat32_disk_t          *disk,
-                         const fat32_fs_info_t *fs_info,
-                         uint32_t               cluster_num,
-                         void                  *buffer)
+fat32_cache_read_sectors(fat32_disk_t *disk,
+                         uint32_t      sector_num,
+                         uint32_t      sector_count,
+                         void         *buffer)
 {
-    avatar_assert(cache_mgr != NULL);
+    return fat32_cache_read(disk, sector_num, sector_count, buffer, true);
+}
+
+fat32_error_t
+fat32_cache_read_direct(fat32_disk_t *disk,
+                        uint32_t      sector_num,
+                        uint32_t      sector_count,
+                        void         *buffer)
+{
+    return fat32_cache_read(disk, sector_num, sector_count, buffer, false);
+}
+
+/**
+ * 已缓存的扇区（可能是脏的）从缓存复制，连续未命中的扇区一次读进调用者缓冲区。
+ * fill 为真时把不太长的未命中段也放进缓存。
+ */
+static fat32_error_t
+fat32_cache_read(fat32_disk_t *disk,
+                 uint32_t      sector_num,
+                 uint32_t      sector_count,
+                 void         *buffer,
+                 bool          fill)
+{
+    fat32_cache_manager_t *cache_mgr = &g_cache_manager;
+
     avatar_assert(disk != NULL);
-    avatar_assert(fs_info != NULL);
     avatar_assert(buffer != NULL);
 
     if (!cache_mgr->initialized) {
-        return FAT32_ERROR_DISK_ERROR;
+        return fat32_disk_read_sectors(disk, sector_num, sector_count, buffer);
     }
 
-    // 查找缓存块
-    fat32_cache_block_t *block = fat32_cache_find_block(cache_mgr, cluster_num);
+    uint8_t      *dst    = (uint8_t *) buffer;
+    fat32_error_t result = FAT32_OK;
+    uint32_t      i      = 0;
+
+    spin_lock(&cache_mgr->lock);
+    while (i < sector_count) {
+        fat32_buf_t *buf = fat32_cache_lookup(cache_mgr, sector_num + i);
+        if (buf != NULL) {
+            memcpy(dst + i * FAT32_SECTOR_SIZE, buf->data, FAT32_SECTOR_SIZE);
+            fat32_cache_touch(cache_mgr, buf);
+            cache_mgr->hits++;
+            i++;
+            continue;
+        }
 
-    if (block == NULL) {
-        // 缓存未命中，分配新的缓存块
-        block = fat32_cache_alloc_block(cache_mgr);
-        if (block == NULL) {
-            // 缓存已满，直接从磁盘读取（简化处理）
-            uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
-            return fat32_disk_read_sectors(disk,
-                                           first_sector,
-                                           fs_info->sectors_per_cluster,
-                                           buffer);
+        // 收集连续未命中的扇区，一次读入调用者缓冲区
+        uint32_t run = 1;
+        while (i + run < sector_count &&
+               fat32_cache_lookup(cache_mgr, sector_num + i + run) == NULL) {
+            run++;
         }
+        cache_mgr->misses += run;
 
-        // 从磁盘加载数据到缓存
-        fat32_error_t result = fat32_cache_load_cluster(block, disk, fs_info, cluster_num);
+        result = fat32_disk_read_sectors(disk, sector_num + i, run, dst + i * FAT32_SECTOR_SIZE);
         if (result != FAT32_OK) {
-            block->status = FAT32_CACHE_FREE;
-            return result;
+            break;
         }
-    }
-
-    // 更新访问时间
-    block->access_time = ++cache_mgr->access_counter;
 
-    // 复制数据到用户缓冲区
-    memcpy(buffer, block->data, fs_info->bytes_per_cluster);
+        // 大块顺序读（如 guest 镜像）不进缓存，避免冲掉元数据
+        if (fill && run <= FAT32_CACHE_BYPASS_SECTORS) {
+            for (uint32_t j = 0; j < run; j++) {
+                buf = fat32_cache_get_free_buf(cache_mgr, disk);
+                if (buf == NULL) {
+                    break;
+                }
+                buf->sector = sector_num + i + j;
+                buf->dirty  = 0;
+                memcpy(buf->data, dst + (i + j) * FAT32_SECTOR_SIZE, FAT32_SECTOR_SIZE);
+                fat32_cache_hash_insert(cache_mgr, buf);
+                list_insert_last(&cache_mgr->lru, &buf->lru_node);
+            }
+        }
+        i += run;
+    }
+    spin_unlock(&cache_mgr->lock);
 
-    return FAT32_OK;
+    return result;
 }
 
 fat32_error_t
-fat32_cache_write_cluster(fat32_cache_manager_t *cache_mgr,
-                          fat32_disk_t          *disk,
-                          const fat32_fs_info_t *fs_info,
-                          uint32_t               cluster_num,
-                          const void            *buffer)
+fat32_cache_write_sectors(fat32_disk_t *disk,
+                          uint32_t      sector_num,
+                          uint32_t      sector_count,
+                          const void   *buffer)
 {
-    avatar_assert(cache_mgr != NULL);
+    fat32_cache_manager_t *cache_mgr = &g_cache_manager;
+
     avatar_assert(disk != NULL);
-    avatar_assert(fs_info != NULL);
     avatar_assert(buffer != NULL);
 
     if (!cache_mgr->initialized) {
-        return FAT32_ERROR_DISK_ERROR;
+        return fat32_disk_write_sectors(disk, sector_num, sector_count, buffer);
     }
 
-    // 查找缓存块
-    fat32_cache_block_t *block = fat32_cache_find_block(cache_mgr, cluster_num);
+    const uint8_t *src    = (const uint8_t *) buffer;
+    fat32_error_t  result = FAT32_OK;
 
-    if (block == NULL) {
-        // 缓存未命中，分配新的缓存块
-        block = fat32_cache_alloc_block(cache_mgr);
-        if (block == NULL) {
-            // 缓存已满，直接写入磁盘（简化处理）
-            uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
-            return fat32_disk_write_sectors(disk,
-                                            first_sector,
-                                            fs_info->sectors_per_cluster,
-                                            buffer);
-        }
+    spin_lock(&cache_mgr->lock);
 
-        block->cluster_num = cluster_num;
-        block->in_use      = 1;
+    if (sector_count > FAT32_CACHE_BYPASS_SECTORS) {
+        // 大块写直接落盘，已缓存的扇区同步成新内容
+        result = fat32_disk_write_sectors(disk, sector_num, sector_count, buffer);
+        if (result == FAT32_OK) {
+            for (uint32_t i = 0; i < sector_count; i++) {
+                fat32_buf_t *buf = fat32_cache_lookup(cache_mgr, sector_num + i);
+                if (buf == NULL) {
+                    continue;
+                }
+                memcpy(buf->data, src + i * FAT32_SECTOR_SIZE, FAT32_SECTOR_SIZE);
+                if (buf->dirty) {
+                    buf->dirty = 0;
+                    cache_mgr->dirty_count--;
+                }
+            }
+        }
+        spin_unlock(&cache_mgr->lock);
+        return result;
     }
 
-    // 复制数据到缓存块
-    memcpy(block->data, buffer, fs_info->bytes_per_cluster);
+    for (uint32_t i = 0; i < sector_count; i++) {
+        fat32_buf_t *buf = fat32_cache_lookup(cache_mgr, sector_num + i);
+        if (buf != NULL) {
+            fat32_cache_touch(cache_mgr, buf);
+        } else {
+            buf = fat32_cache_get_free_buf(cache_mgr, disk);
+            if (buf == NULL) {
+                // 腾不出缓冲区时退回直接写
+                result = fat32_disk_write_sectors(disk,
+                                                  sector_num + i,
+                                                  1,
+                                                  src + i * FAT32_SECTOR_SIZE);
+                if (result != FAT32_OK) {
+                    break;
+                }
+                continue;
+            }
+            buf->sector = sector_num + i;
+            buf->dirty  = 0;
+            fat32_cache_hash_insert(cache_mgr, buf);
+            list_insert_last(&cache_mgr->lru, &buf->lru_node);
+        }
 
-    // 标记为脏块
-    fat32_cache_mark_dirty(block);
+        memcpy(buf->data, src + i * FAT32_SECTOR_SIZE, FAT32_SECTOR_SIZE);
+        if (!buf->dirty) {
+            buf->dirty = 1;
+            cache_mgr->dirty_count++;
+        }
+    }
 
-    // 更新访问时间
-    block->access_time = ++cache_mgr->access_counter;
+    // 限制脏数据量，掉电时丢失的内容有上限，淘汰时也不必总是先写回
+    if (result == FAT32_OK && cache_mgr->dirty_count > FAT32_CACHE_DIRTY_LIMIT) {
+        result = fat32_cache_flush_locked(cache_mgr, disk);
+    }
 
-    return FAT32_OK;
+    spin_unlock(&cache_mgr->lock);
+    return result;
 }
 
 fat32_error_t
-fat32_cache_flush(fat32_cache_manager_t *cache_mgr,
-                  fat32_disk_t          *disk,
-                  const fat32_fs_info_t *fs_info)
+fat32_cache_read_segments(fat32_disk_t *disk, const fat32_disk_seg_t *segs, uint32_t nsegs)
 {
-    avatar_assert(cache_mgr != NULL);
+    fat32_cache_manager_t *cache_mgr = &g_cache_manager;
+
     avatar_assert(disk != NULL);
-    avatar_assert(fs_info != NULL);
+    avatar_assert(segs != NULL);
 
     if (!cache_mgr->initialized) {
-        return FAT32_OK;
+        return fat32_disk_read_segments(disk, segs, nsegs);
     }
 
-    fat32_error_t result = FAT32_OK;
-
-    // 遍历所有缓存块，写回脏块
-    for (int i = 0; i < FAT32_CACHE_SIZE; i++) {
-        fat32_cache_block_t *block = &cache_mgr->blocks[i];
+    fat32_disk_seg_t miss[FAT32_CACHE_SG_SEGS];
+    uint32_t         nmiss  = 0;
+    fat32_error_t    result = FAT32_OK;
+
+    spin_lock(&cache_mgr->lock);
+    for (uint32_t s = 0; s < nsegs && result == FAT32_OK; s++) {
+        uint8_t *dst = (uint8_t *) segs[s].buffer;
+        uint32_t i   = 0;
+
+        while (i < segs[s].count) {
+            fat32_buf_t *buf = fat32_cache_lookup(cache_mgr, segs[s].sector + i);
+            if (buf != NULL) {
+                memcpy(dst + i * FAT32_SECTOR_SIZE, buf->data, FAT32_SECTOR_SIZE);
+                fat32_cache_touch(cache_mgr, buf);
+                cache_mgr->hits++;
+                i++;
+                continue;
+            }
 
-        if (block->in_use && fat32_cache_is_dirty_block(block)) {
-            fat32_error_t write_result = fat32_cache_write_back_block(block, disk, fs_info);
-            if (write_result != FAT32_OK) {
-                logger("FAT32: Failed to write back cache block for cluster %u\n",
-                       block->cluster_num);
-                result = write_result;  // 记录错误但继续处理其他块
-            } else {
-                fat32_cache_mark_clean(block);
+            uint32_t run = 1;
+            while (i + run < segs[s].count &&
+                   fat32_cache_lookup(cache_mgr, segs[s].sector + i + run) == NULL) {
+                run++;
+            }
+            cache_mgr->misses += run;
+
+            // 攒够一批再提交，所有未命中的段一起交给设备
+            miss[nmiss].sector = segs[s].sector + i;
+            miss[nmiss].count  = run;
+            miss[nmiss].buffer = dst + i * FAT32_SECTOR_SIZE;
+            if (++nmiss == FAT32_CACHE_SG_SEGS) {
+                result = fat32_disk_read_segments(disk, miss, nmiss);
+                nmiss  = 0;
+                if (result != FAT32_OK) {
+                    break;
+                }
             }
+            i += run;
         }
     }
+    if (result == FAT32_OK && nmiss > 0) {
+        result = fat32_disk_read_segments(disk, miss, nmiss);
+    }
+    spin_unlock(&cache_mgr->lock);
 
     return result;
 }
 
 fat32_error_t
-fat32_cache_flush_cluster(fat32_cache_manager_t *cache_mgr,
-                          fat32_disk_t          *disk,
-                          const fat32_fs_info_t *fs_info,
-                          uint32_t               cluster_num)
+fat32_cache_prefetch(fat32_disk_t *disk, uint32_t sector_num, uint32_t sector_count)
 {
-    avatar_assert(cache_mgr != NULL);
+    fat32_cache_manager_t *cache_mgr = &g_cache_manager;
+
     avatar_assert(disk != NULL);
-    avatar_assert(fs_info != NULL);
 
     if (!cache_mgr->initialized) {
         return FAT32_OK;
     }
 
-    fat32_cache_block_t *block = fat32_cache_find_block(cache_mgr, cluster_num);
-    if (block != NULL && fat32_cache_is_dirty_block(block)) {
-        fat32_error_t result = fat32_cache_write_back_block(block, disk, fs_info);
-        if (result == FAT32_OK) {
-            fat32_cache_mark_clean(block);
+    fat32_error_t result = FAT32_OK;
+    uint32_t      i      = 0;
+
+    spin_lock(&cache_mgr->lock);
+    while (i < sector_count) {
+        if (fat32_cache_lookup(cache_mgr, sector_num + i) != NULL) {
+            i++;
+            continue;
         }
-        return result;
+
+        uint32_t run = 1;
+        while (i + run < sector_count && run < FAT32_CACHE_RA_BATCH &&
+               fat32_cache_lookup(cache_mgr, sector_num + i + run) == NULL) {
+            run++;
+        }
+
+        result = fat32_disk_read_sectors(disk, sector_num + i, run, g_cache_ra_buffer);
+        if (result != FAT32_OK) {
+            break;
+        }
+
+        for (uint32_t j = 0; j < run; j++) {
+            fat32_buf_t *buf = fat32_cache_get_free_buf(cache_mgr, disk);
+            if (buf == NULL) {
+                spin_unlock(&cache_mgr->lock);
+                return FAT32_ERROR_DISK_ERROR;
+            }
+            buf->sector = sector_num + i + j;
+            buf->dirty  = 0;
+            memcpy(buf->data, g_cache_ra_buffer + j * FAT32_SECTOR_SIZE, FAT32_SECTOR_SIZE);
+            fat32_cache_hash_insert(cache_mgr, buf);
+            list_insert_last(&cache_mgr->lru, &buf->lru_node);
+        }
+        cache_mgr->readahead += run;
+        i += run;
     }
+    spin_unlock(&cache_mgr->lock);
 
-    return FAT32_OK;
+    return result;
 }
 
 fat32_error_t
-fat32_cache_invalidate_cluster(fat32_cache_manager_t *cache_mgr, uint32_t cluster_num)
+fat32_cache_flush(fat32_cache_manager_t *cache_mgr,
+                  fat32_disk_t          *disk,
+                  const fat32_fs_info_t *fs_info)
 {
     avatar_assert(cache_mgr != NULL);
+    avatar_assert(disk != NULL);
 
     if (!cache_mgr->initialized) {
         return FAT32_OK;
     }
 
-    fat32_cache_block_t *block = fat32_cache_find_block(cache_mgr, cluster_num);
-    if (block != NULL) {
-        block->status      = FAT32_CACHE_FREE;
-        block->in_use      = 0;
-        block->cluster_num = 0;
+    spin_lock(&cache_mgr->lock);
+    fat32_error_t result = fat32_cache_flush_locked(cache_mgr, disk);
+    spin_unlock(&cache_mgr->lock);
+
+    return result;
+}
+
+void
+fat32_cache_invalidate_all(fat32_cache_manager_t *cache_mgr)
+{
+    avatar_assert(cache_mgr != NULL);
+
+    if (!cache_mgr->initialized) {
+        return;
     }
 
-    return FAT32_OK;
+    spin_lock(&cache_mgr->lock);
+    for (uint32_t i = 0; i < cache_mgr->nbufs; i++) {
+        cache_mgr->bufs[i].in_use    = 0;
+        cache_mgr->bufs[i].dirty     = 0;
+        cache_mgr->bufs[i].hash_next = NULL;
+    }
+    memset(cache_mgr->hash, 0, FAT32_CACHE_HASH_BUCKETS * sizeof(fat32_buf_t *));
+    list_init(&cache_mgr->lru);
+    cache_mgr->dirty_count = 0;
+    // 缓冲区重新从头分配，已有的数据页留给它们继续使用
+    cache_mgr->nbufs = 0;
+    spin_unlock(&cache_mgr->lock);
 }
 
 fat32_error_t
@@ -306,28 +505,16 @@ fat32_cache_get_stats(const fat32_cache_manager_t *cache_mgr,
         return FAT32_ERROR_DISK_ERROR;
     }
 
-    uint32_t used = 0, dirty = 0;
-
-    for (int i = 0; i < FAT32_CACHE_SIZE; i++) {
-        const fat32_cache_block_t *block = &cache_mgr->blocks[i];
-        if (block->in_use) {
-            used++;
-            if (fat32_cache_is_dirty_block(block)) {
-                dirty++;
-            }
-        }
-    }
-
     if (total_blocks != NULL) {
-        *total_blocks = FAT32_CACHE_SIZE;
+        *total_blocks = cache_mgr->capacity;
     }
 
     if (used_blocks != NULL) {
-        *used_blocks = used;
+        *used_blocks = (uint32_t) cache_mgr->lru.count;
     }
 
     if (dirty_blocks != NULL) {
-        *dirty_blocks = dirty;
+        *dirty_blocks = cache_mgr->dirty_count;
     }
 
     return FAT32_OK;
@@ -359,105 +546,149 @@ fat32_cleanup_global_cache(fat32_disk_t *disk, const fat32_fs_info_t *fs_info)
  * 私有函数实现
  * ============================================================================ */
 
-static fat32_cache_block_t *
-fat32_cache_find_block(fat32_cache_manager_t *cache_mgr, uint32_t cluster_num)
+static fat32_buf_t *
+fat32_cache_lookup(fat32_cache_manager_t *cache_mgr, uint32_t sector)
 {
-    avatar_assert(cache_mgr != NULL);
+    fat32_buf_t *buf = cache_mgr->hash[fat32_cache_hash_index(sector)];
 
-    for (int i = 0; i < FAT32_CACHE_SIZE; i++) {
-        fat32_cache_block_t *block = &cache_mgr->blocks[i];
-        if (block->in_use && block->cluster_num == cluster_num) {
-            return block;
-        }
+    while (buf != NULL && buf->sector != sector) {
+        buf = buf->hash_next;
     }
+    return buf;
+}
 
-    return NULL;
+static void
+fat32_cache_hash_insert(fat32_cache_manager_t *cache_mgr, fat32_buf_t *buf)
+{
+    uint32_t index = fat32_cache_hash_index(buf->sector);
+
+    buf->hash_next         = cache_mgr->hash[index];
+    buf->in_use            = 1;
+    cache_mgr->hash[index] = buf;
 }
 
-static fat32_cache_block_t *
-fat32_cache_alloc_block(fat32_cache_manager_t *cache_mgr)
+static void
+fat32_cache_hash_remove(fat32_cache_manager_t *cache_mgr, fat32_buf_t *buf)
 {
-    avatar_assert(cache_mgr != NULL);
+    fat32_buf_t **pp = &cache_mgr->hash[fat32_cache_hash_index(buf->sector)];
 
-    // 首先查找空闲块
-    for (int i = 0; i < FAT32_CACHE_SIZE; i++) {
-        fat32_cache_block_t *block = &cache_mgr->blocks[i];
-        if (fat32_cache_is_free_block(block)) {
-            return block;
-        }
+    while (*pp != NULL && *pp != buf) {
+        pp = &(*pp)->hash_next;
     }
+    if (*pp != NULL) {
+        *pp = buf->hash_next;
+    }
+    buf->hash_next = NULL;
+    buf->in_use    = 0;
+}
 
-    // 没有空闲块，使用简单的LRU策略找到最久未访问的块
-    fat32_cache_block_t *lru_block   = &cache_mgr->blocks[0];
-    uint32_t             oldest_time = lru_block->access_time;
-
-    for (int i = 1; i < FAT32_CACHE_SIZE; i++) {
-        fat32_cache_block_t *block = &cache_mgr->blocks[i];
-        if (block->access_time < oldest_time) {
-            oldest_time = block->access_time;
-            lru_block   = block;
+/**
+ * 取一个不在散列表中的缓冲区：先按页扩充数据区，到达上限后淘汰最久未用的缓冲区。
+ * 返回 NULL 表示淘汰的脏缓冲写回失败，调用者应直接访问磁盘。
+ */
+static fat32_buf_t *
+fat32_cache_get_free_buf(fat32_cache_manager_t *cache_mgr, fat32_disk_t *disk)
+{
+    if (cache_mgr->nbufs < cache_mgr->capacity) {
+        if (cache_mgr->nbufs % FAT32_CACHE_BUFS_PER_PAGE == 0 &&
+            cache_mgr->bufs[cache_mgr->nbufs].data == NULL) {
+            uint8_t *page = (uint8_t *) kalloc_pages(1);
+            if (page == NULL) {
+                // 内存不足，缓存就停在当前大小
+                cache_mgr->capacity = cache_mgr->nbufs;
+                logger_warn("FAT32: Buffer cache limited to %u sectors\n", cache_mgr->capacity);
+            } else {
+                for (uint32_t i = 0; i < FAT32_CACHE_BUFS_PER_PAGE; i++) {
+                    cache_mgr->bufs[cache_mgr->nbufs + i].data = page + i * FAT32_SECTOR_SIZE;
+                }
+            }
+        }
+        if (cache_mgr->nbufs < cache_mgr->capacity) {
+            return &cache_mgr->bufs[cache_mgr->nbufs++];
         }
     }
 
-    // 如果LRU块是脏块，需要先写回（简化实现中忽略错误）
-    if (fat32_cache_is_dirty_block(lru_block)) {
-        logger("FAT32: Warning - Evicting dirty cache block for cluster %u\n",
-               lru_block->cluster_num);
-        // 在实际实现中应该写回磁盘
+    list_node_t *node = list_first(&cache_mgr->lru);
+    if (node == NULL) {
+        return NULL;
     }
 
-    // 重置块状态
-    lru_block->status      = FAT32_CACHE_FREE;
-    lru_block->cluster_num = 0;
-    lru_block->in_use      = 0;
+    fat32_buf_t *buf = list_node_parent(node, fat32_buf_t, lru_node);
+    if (buf->dirty && fat32_cache_write_back(cache_mgr, disk, buf) != FAT32_OK) {
+        return NULL;
+    }
 
-    return lru_block;
+    fat32_cache_hash_remove(cache_mgr, buf);
+    list_delete(&cache_mgr->lru, &buf->lru_node);
+    return buf;
 }
 
+/**
+ * 写回 buf 以及前后扇区号相邻的脏缓冲区，合并成一次磁盘写。
+ * 目录项和数据可能引用刚分配的簇，内存中的 FAT 表改动要先写到磁盘
+ */
 static fat32_error_t
-fat32_cache_load_cluster(fat32_cache_block_t   *block,
-                         fat32_disk_t          *disk,
-                         const fat32_fs_info_t *fs_info,
-                         uint32_t               cluster_num)
+fat32_cache_write_back(fat32_cache_manager_t *cache_mgr, fat32_disk_t *disk, fat32_buf_t *buf)
 {
-    avatar_assert(block != NULL);
-    avatar_assert(disk != NULL);
-    avatar_assert(fs_info != NULL);
-
-    // 计算簇对应的扇区
-    uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
+    uint32_t     start = buf->sector;
+    uint32_t     count = 1;
+    fat32_buf_t *run[FAT32_CACHE_WB_BATCH];
 
-    // 从磁盘读取数据
-    fat32_error_t result =
-        fat32_disk_read_sectors(disk, first_sector, fs_info->sectors_per_cluster, block->data);
+    fat32_error_t result = fat32_fat_table_flush(disk, &fat32_get_context()->fs_info);
     if (result != FAT32_OK) {
         return result;
     }
 
-    // 设置块状态
-    block->cluster_num = cluster_num;
-    block->status      = FAT32_CACHE_CLEAN;
-    block->in_use      = 1;
+    // 先向前找到这段连续脏扇区的起点
+    while (count < FAT32_CACHE_WB_BATCH && start > 0) {
+        fat32_buf_t *prev = fat32_cache_lookup(cache_mgr, start - 1);
+        if (prev == NULL || !prev->dirty) {
+            break;
+        }
+        start--;
+        count++;
+    }
+
+    count = 0;
+    while (count < FAT32_CACHE_WB_BATCH) {
+        fat32_buf_t *b = fat32_cache_lookup(cache_mgr, start + count);
+        if (b == NULL || !b->dirty) {
+            break;
+        }
+        memcpy(g_cache_wb_buffer + count * FAT32_SECTOR_SIZE, b->data, FAT32_SECTOR_SIZE);
+        run[count++] = b;
+    }
+
+    result = fat32_disk_write_sectors(disk, start, count, g_cache_wb_buffer);
+    if (result != FAT32_OK) {
+        logger("FAT32: Failed to write back sectors %u-%u\n", start, start + count - 1);
+        return result;
+    }
 
+    for (uint32_t i = 0; i < count; i++) {
+        run[i]->dirty = 0;
+    }
+    cache_mgr->dirty_count -= count;
+    cache_mgr->writebacks++;
     return FAT32_OK;
 }
 
 static fat32_error_t
-fat32_cache_write_back_block(fat32_cache_block_t   *block,
-                             fat32_disk_t          *disk,
-                             const fat32_fs_info_t *fs_info)
+fat32_cache_flush_locked(fat32_cache_manager_t *cache_mgr, fat32_disk_t *disk)
 {
-    avatar_assert(block != NULL);
-    avatar_assert(disk != NULL);
-    avatar_assert(fs_info != NULL);
+    fat32_error_t result = FAT32_OK;
 
-    if (!block->in_use) {
-        return FAT32_ERROR_INVALID_PARAM;
-    }
+    for (uint32_t i = 0; i < cache_mgr->nbufs && cache_mgr->dirty_count > 0; i++) {
+        fat32_buf_t *buf = &cache_mgr->bufs[i];
+        if (!buf->in_use || !buf->dirty) {
+            continue;
+        }
 
-    // 计算簇对应的扇区
-    uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, block->cluster_num);
+        fat32_error_t write_result = fat32_cache_write_back(cache_mgr, disk, buf);
+        if (write_result != FAT32_OK) {
+            result = write_result;  // 记录错误但继续处理其他缓冲区
+        }
+    }
 
-    // 写入磁盘
-    return fat32_disk_write_sectors(disk, first_sector, fs_info->sectors_per_cluster, block->data);
+    return result;
 }
@@ -0,0 +1,203 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file fat32_dcache.c
+ * @brief FAT32目录项缓存实现
+ *
+ * 缓存项放在静态数组里，按（父目录簇号，短名）散列查找，LRU 链表满时回收最久
+ * 未用的一项。负项只记名字，目录中新建同名目录项时被 fat32_dcache_update 改写
+ * 成正项。同一目录中名字唯一，所以按名字定位的缓存项就足以反映目录项的变化。
+ */
+
+#include "fs/fat32_dcache.h"
+#include "fs/fat32_dir.h"
+#include "lib/avatar_string.h"
+#include "lib/list.h"
+#include "io.h"
+
+typedef struct _fat32_dentry_t
+{
+    uint32_t                parent;       // 父目录起始簇号
+    uint32_t                entry_index;  // 目录项序号，负项无意义
+    uint8_t                 name[11];     // 8.3 短名
+    bool                    negative;     // 目录中没有这个名字
+    fat32_dir_entry_t       entry;        // 目录项内容
+    struct _fat32_dentry_t *hash_next;    // 散列桶链
+    list_node_t             node;         // 在用时挂在 LRU 链表（链首最久未用），否则在空闲链表
+} fat32_dentry_t;
+
+static fat32_dentry_t  g_dentries[FAT32_DCACHE_ENTRIES];
+static fat32_dentry_t *g_dcache_hash[FAT32_DCACHE_BUCKETS];
+static list_t          g_dcache_lru;
+static list_t          g_dcache_free;
+static bool            g_dcache_ready;
+static uint64_t        g_dcache_hits;
+static uint64_t        g_dcache_misses;
+
+static uint32_t
+dcache_hash(uint32_t parent, const uint8_t *name)
+{
+    uint32_t h = 2166136261u ^ parent;
+
+    for (int32_t i = 0; i < 11; i++)
+        h = (h ^ name[i]) * 16777619u;
+    return h & (FAT32_DCACHE_BUCKETS - 1);
+}
+
+// 与 fat32_dir_find_entry 跳过的目录项一致
+static bool
+dcache_is_live(const fat32_dir_entry_t *dir_entry)
+{
+    return !fat32_dir_is_free_entry(dir_entry) && !fat32_dir_is_deleted_entry(dir_entry) &&
+           !fat32_dir_is_long_name_entry(dir_entry) && !fat32_dir_is_volume_label(dir_entry);
+}
+
+static fat32_dentry_t *
+dcache_find(uint32_t parent, const uint8_t *name)
+{
+    fat32_dentry_t *d = g_dcache_hash[dcache_hash(parent, name)];
+
+    while (d && (d->parent != parent || memcmp(d->name, name, 11) != 0))
+        d = d->hash_next;
+    return d;
+}
+
+static void
+dcache_remove(fat32_dentry_t *d)
+{
+    fat32_dentry_t **link = &g_dcache_hash[dcache_hash(d->parent, d->name)];
+
+    while (*link != d)
+        link = &(*link)->hash_next;
+    *link = d->hash_next;
+
+    list_delete(&g_dcache_lru, &d->node);
+    list_insert_last(&g_dcache_free, &d->node);
+}
+
+static fat32_dentry_t *
+dcache_alloc(uint32_t parent, const uint8_t *name)
+{
+    if (!g_dcache_ready)
+        fat32_dcache_clear();
+
+    if (list_is_empty(&g_dcache_free))
+        dcache_remove(list_node_parent(list_first(&g_dcache_lru), fat32_dentry_t, node));
+
+    fat32_dentry_t *d = list_node_parent(list_delete_first(&g_dcache_free), fat32_dentry_t, node);
+    uint32_t        h = dcache_hash(parent, name);
+
+    d->parent = parent;
+    memcpy(d->name, name, 11);
+    d->hash_next     = g_dcache_hash[h];
+    g_dcache_hash[h] = d;
+    list_insert_last(&g_dcache_lru, &d->node);
+    return d;
+}
+
+fat32_dcache_result_t
+fat32_dcache_lookup(uint32_t           parent,
+                    const uint8_t     *short_name,
+                    fat32_dir_entry_t *dir_entry,
+                    uint32_t          *entry_index)
+{
+    fat32_dentry_t *d = dcache_find(parent, short_name);
+
+    if (!d) {
+        g_dcache_misses++;
+        return FAT32_DCACHE_MISS;
+    }
+
+    g_dcache_hits++;
+    list_delete(&g_dcache_lru, &d->node);
+    list_insert_last(&g_dcache_lru, &d->node);
+
+    if (d->negative)
+        return FAT32_DCACHE_NEGATIVE;
+
+    *dir_entry = d->entry;
+    if (entry_index)
+        *entry_index = d->entry_index;
+    return FAT32_DCACHE_HIT;
+}
+
+void
+fat32_dcache_insert(uint32_t                 parent,
+                    const uint8_t           *short_name,
+                    const fat32_dir_entry_t *dir_entry,
+                    uint32_t                 entry_index)
+{
+    fat32_dentry_t *d = dcache_find(parent, short_name);
+
+    if (d) {
+        list_delete(&g_dcache_lru, &d->node);
+        list_insert_last(&g_dcache_lru, &d->node);
+    } else {
+        d = dcache_alloc(parent, short_name);
+    }
+
+    d->negative = dir_entry == NULL;
+    if (dir_entry) {
+        d->entry       = *dir_entry;
+        d->entry_index = entry_index;
+    }
+}
+
+void
+fat32_dcache_update(uint32_t                 parent,
+                    uint32_t                 entry_index,
+                    const fat32_dir_entry_t *old_entry,
+                    const fat32_dir_entry_t *new_entry)
+{
+    bool new_live = dcache_is_live(new_entry);
+
+    // 旧名字被删除或改名，这个目录里已经没有它了
+    if (dcache_is_live(old_entry) &&
+        (!new_live || memcmp(old_entry->name, new_entry->name, 11) != 0)) {
+        fat32_dentry_t *d = dcache_find(parent, old_entry->name);
+        if (d && !d->negative && d->entry_index == entry_index)
+            d->negative = true;
+    }
+
+    if (new_live)
+        fat32_dcache_insert(parent, new_entry->name, new_entry, entry_index);
+}
+
+void
+fat32_dcache_invalidate_dir(uint32_t parent)
+{
+    list_node_t *node = list_first(&g_dcache_lru);
+
+    while (node) {
+        fat32_dentry_t *d = list_node_parent(node, fat32_dentry_t, node);
+        node              = list_node_next(node);
+        if (d->parent == parent)
+            dcache_remove(d);
+    }
+}
+
+void
+fat32_dcache_clear(void)
+{
+    memset(g_dcache_hash, 0, sizeof(g_dcache_hash));
+    list_init(&g_dcache_lru);
+    list_init(&g_dcache_free);
+    for (uint32_t i = 0; i < FAT32_DCACHE_ENTRIES; i++) {
+        list_node_init(&g_dentries[i].node);
+        list_insert_last(&g_dcache_free, &g_dentries[i].node);
+    }
+    g_dcache_ready = true;
+}
+
+void
+fat32_dcache_print_stats(void)
+{
+    logger("Dentry cache: %u/%u entries, hits: %llu, misses: %llu\n",
+           (uint32_t) list_count(&g_dcache_lru),
+           FAT32_DCACHE_ENTRIES,
+           g_dcache_hits,
+           g_dcache_misses);
+}
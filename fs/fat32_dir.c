@@ -20,6 +20,8 @@
 #include "fs/fat32_dir.h"
 #include "fs/fat32_fat.h"
 #include "fs/fat32_boot.h"
+#include "fs/fat32_cache.h"
+#include "fs/fat32_dcache.h"
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
 #include "mem/mem.h"
@@ -150,13 +152,20 @@ fat32_dir_write_entry(fat32_disk_t            *disk,
         return result;
     }
 
-    // 修改目录项数据
+    // 修改目录项数据，保留旧内容给目录项缓存
+    fat32_dir_entry_t old_entry;
+    memcpy(&old_entry,
+           cluster_buffer + entry_in_cluster * FAT32_DIR_ENTRY_SIZE,
+           FAT32_DIR_ENTRY_SIZE);
     memcpy(cluster_buffer + entry_in_cluster * FAT32_DIR_ENTRY_SIZE,
            dir_entry,
            FAT32_DIR_ENTRY_SIZE);
 
     // 写回簇数据
     result = fat32_dir_write_cluster_data(disk, fs_info, target_cluster, cluster_buffer);
+    if (result == FAT32_OK) {
+        fat32_dcache_update(dir_cluster, entry_index, &old_entry, dir_entry);
+    }
 
     kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
     return result;
@@ -187,6 +196,15 @@ fat32_dir_find_entry(fat32_disk_t          *disk,
         return result;
     }
 
+    switch (fat32_dcache_lookup(dir_cluster, short_name, dir_entry, entry_index)) {
+        case FAT32_DCACHE_HIT:
+            return FAT32_OK;
+        case FAT32_DCACHE_NEGATIVE:
+            return FAT32_ERROR_NOT_FOUND;
+        default:
+            break;
+    }
+
     // 遍历目录查找文件
     fat32_dir_iterator_t iterator;
     fat32_dir_iterator_init(&iterator, dir_cluster);
@@ -212,6 +230,7 @@ fat32_dir_find_entry(fat32_disk_t          *disk,
 
         // 比较文件名
         if (fat32_dir_compare_short_names(current_entry.name, short_name) == 0) {
+            fat32_dcache_insert(dir_cluster, short_name, &current_entry, current_index);
             *dir_entry = current_entry;
             if (entry_index != NULL) {
                 *entry_index = current_index;
@@ -222,6 +241,7 @@ fat32_dir_find_entry(fat32_disk_t          *disk,
         current_index++;
     }
 
+    fat32_dcache_insert(dir_cluster, short_name, NULL, 0);
     return FAT32_ERROR_NOT_FOUND;
 }
 
@@ -703,7 +723,7 @@ fat32_dir_read_cluster_data(fat32_disk_t          *disk,
     uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
 
     // 读取整个簇的数据
-    return fat32_disk_read_sectors(disk, first_sector, fs_info->sectors_per_cluster, buffer);
+    return fat32_cache_read_sectors(disk, first_sector, fs_info->sectors_per_cluster, buffer);
 }
 
 static fat32_error_t
@@ -724,7 +744,7 @@ fat32_dir_write_cluster_data(fat32_disk_t          *disk,
     uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
 
     // 写入整个簇的数据
-    return fat32_disk_write_sectors(disk, first_sector, fs_info->sectors_per_cluster, buffer);
+    return fat32_cache_write_sectors(disk, first_sector, fs_info->sectors_per_cluster, buffer);
 }
 
 static fat32_error_t
@@ -844,6 +864,8 @@ fat32_dir_create_directory(fat32_disk_t    *disk,
     }
 
     kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
+    // 簇号可能属于之前被删除的目录，丢弃残留的缓存项
+    fat32_dcache_invalidate_dir(dir_cluster);
 
     // 在父目录中创建目录项
     uint32_t entry_index;
@@ -906,6 +928,7 @@ fat32_dir_remove_directory(fat32_disk_t    *disk,
         if (result != FAT32_OK) {
             return result;
         }
+        fat32_dcache_invalidate_dir(dir_cluster);
     }
 
     // 删除目录项
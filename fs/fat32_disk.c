@@ -23,6 +23,7 @@
 #include "mem/mem.h"
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
+#include "spinlock.h"
 #include "io.h"
 
 /* ============================================================================
@@ -32,6 +33,10 @@
 static fat32_disk_t g_fat32_disk;            // 全局磁盘实例
 static uint8_t      g_use_virtio_block = 0;  // 是否使用VirtIO块设备
 
+// 块设备只有一个请求队列。文件系统调用者和 EL2 的 stage-2 缺页处理都会提交请求，
+// 请求以轮询方式完成，整个请求期间关中断持有这把锁
+static spinlock_t g_disk_lock;
+
 /* ============================================================================
  * 私有函数声明
  * ============================================================================ */
@@ -157,7 +162,10 @@ fat32_disk_read_sectors(fat32_disk_t *disk,
 
     if (g_use_virtio_block) {
         // 使用VirtIO块设备读取
-        if (avatar_virtio_block_read((uint64_t) sector_num, buffer, sector_count) != 0) {
+        uint64_t daif = spin_lock_irqsave(&g_disk_lock);
+        int      ret  = avatar_virtio_block_read((uint64_t) sector_num, buffer, sector_count);
+        spin_unlock_irqrestore(&g_disk_lock, daif);
+        if (ret != 0) {
             logger("FAT32: VirtIO block read failed at sector %u, count %u\n",
                    sector_num,
                    sector_count);
@@ -177,6 +185,62 @@ fat32_disk_read_sectors(fat32_disk_t *disk,
     return FAT32_OK;
 }
 
+fat32_error_t
+fat32_disk_read_segments(fat32_disk_t *disk, const fat32_disk_seg_t *segs, uint32_t nsegs)
+{
+    avatar_assert(disk != NULL);
+    avatar_assert(segs != NULL);
+
+    if (!disk->initialized) {
+        disk->error_count++;
+        return FAT32_ERROR_DISK_ERROR;
+    }
+
+    for (uint32_t i = 0; i < nsegs; i++) {
+        if (segs[i].count == 0 || segs[i].sector + segs[i].count > disk->total_sectors) {
+            logger("FAT32: Read beyond disk boundary: sector %u + %u > %u\n",
+                   segs[i].sector,
+                   segs[i].count,
+                   disk->total_sectors);
+            disk->error_count++;
+            return FAT32_ERROR_INVALID_PARAM;
+        }
+    }
+
+    if (!g_use_virtio_block) {
+        for (uint32_t i = 0; i < nsegs; i++) {
+            fat32_error_t result =
+                fat32_disk_read_sectors(disk, segs[i].sector, segs[i].count, segs[i].buffer);
+            if (result != FAT32_OK) {
+                return result;
+            }
+        }
+        return FAT32_OK;
+    }
+
+    // 转换成块设备的段描述，每次转换 VIRTIO_BLK_MAX_INFLIGHT 段
+    virtio_blk_seg_t vsegs[VIRTIO_BLK_MAX_INFLIGHT];
+    for (uint32_t i = 0; i < nsegs; i += VIRTIO_BLK_MAX_INFLIGHT) {
+        uint32_t n = nsegs - i < VIRTIO_BLK_MAX_INFLIGHT ? nsegs - i : VIRTIO_BLK_MAX_INFLIGHT;
+        for (uint32_t j = 0; j < n; j++) {
+            vsegs[j].sector = segs[i + j].sector;
+            vsegs[j].buffer = segs[i + j].buffer;
+            vsegs[j].count  = segs[i + j].count;
+        }
+        uint64_t daif = spin_lock_irqsave(&g_disk_lock);
+        int      ret  = avatar_virtio_block_read_segments(vsegs, n);
+        spin_unlock_irqrestore(&g_disk_lock, daif);
+        if (ret != 0) {
+            logger("FAT32: VirtIO scatter read of %u segments failed\n", n);
+            disk->error_count++;
+            return FAT32_ERROR_DISK_ERROR;
+        }
+    }
+
+    disk->read_count += nsegs;
+    return FAT32_OK;
+}
+
 fat32_error_t
 fat32_disk_write_sectors(fat32_disk_t *disk,
                          uint32_t      sector_num,
@@ -204,7 +268,10 @@ fat32_disk_write_sectors(fat32_disk_t *disk,
 
     if (g_use_virtio_block) {
         // 使用VirtIO块设备写入
-        if (avatar_virtio_block_write((uint64_t) sector_num, buffer, sector_count) != 0) {
+        uint64_t daif = spin_lock_irqsave(&g_disk_lock);
+        int      ret  = avatar_virtio_block_write((uint64_t) sector_num, buffer, sector_count);
+        spin_unlock_irqrestore(&g_disk_lock, daif);
+        if (ret != 0) {
             logger("FAT32: VirtIO block write failed at sector %u, count %u\n",
                    sector_num,
                    sector_count);
@@ -15,6 +15,16 @@
  * @brief FAT32文件分配表管理实现
  * 
  * 本文件实现了FAT32文件分配表的管理功能。
+ *
+ * FAT 表在挂载时放进内存：表不大时一次全部读入，否则按窗口（一页，8 个扇区）在第一次
+ * 访问时读入。表项读写只访问内存，修改过的扇区记在位图里，sync 时一次写回所有 FAT 副本。
+ * FAT 扇区不经过缓冲区缓存，避免同一份数据缓存两次。
+ *
+ * 挂载时还会扫描一遍 FAT 建立空闲簇位图（每簇一位，1 表示空闲），分配时按 64 位字
+ * 查找。表项在空闲和已用之间变化时由 fat32_fat_write_entry 同步更新位图。
+ *
+ * 多簇分配按段进行：优先从文件最后一个簇的下一个簇接着分配，接不上时在位图中按最佳
+ * 适配找一段，尽量让大文件保持连续，读取时能合并成少数几次大块读。
  */
 
 #include "fs/fat32_fat.h"
@@ -23,6 +33,467 @@
 #include "mem/mem.h"
 #include "io.h"
 
+#define FAT32_FAT_WINDOW_SECTORS (PAGE_SIZE / FAT32_SECTOR_SIZE)
+#define FAT32_FAT_WINDOW_ENTRIES (PAGE_SIZE / sizeof(uint32_t))
+#define FAT32_FAT_SCAN_PAGES     16  // 建位图时每次读入的页数
+#define FAT32_FAT_RUN_CLASSES    16  // 按长度的 log2 分级记录连续空闲段的查找起点
+
+/**
+ * @brief 内存中的 FAT 表
+ */
+typedef struct
+{
+    uint32_t **windows;      // 每个窗口一页，未读入时为 NULL
+    uint32_t  *flat;         // 整表预读时的连续内存，windows 指向其中
+    uint64_t  *dirty;        // 每个 FAT 扇区一位
+    uint32_t   nwindows;     // 窗口数
+    uint32_t   fat_sectors;  // 每份 FAT 的扇区数
+    uint32_t   dirty_count;  // 脏扇区数
+    uint64_t  *free_map;     // 空闲簇位图，按簇号索引
+    uint32_t   map_words;    // free_map 的字数
+    uint32_t   run_hint[FAT32_FAT_RUN_CLASSES];  // 此前没有长度 >= 2^k 的空闲段
+    uint8_t    ready;        // 已挂载
+} fat32_fat_table_t;
+
+static fat32_fat_table_t g_fat_table;
+
+static inline uint32_t
+fat32_fat_pages(uint32_t bytes)
+{
+    return UP2(bytes, PAGE_SIZE) / PAGE_SIZE;
+}
+
+/* ============================================================================
+ * 空闲簇位图
+ * ============================================================================ */
+
+static inline bool
+fat32_fat_map_test(uint32_t cluster_num)
+{
+    return (g_fat_table.free_map[cluster_num / 64] >> (cluster_num % 64)) & 1;
+}
+
+static inline void
+fat32_fat_map_set(uint32_t cluster_num, bool is_free)
+{
+    fat32_fat_table_t *t   = &g_fat_table;
+    uint64_t           bit = 1ULL << (cluster_num % 64);
+
+    if (!is_free) {
+        t->free_map[cluster_num / 64] &= ~bit;
+        return;
+    }
+
+    t->free_map[cluster_num / 64] |= bit;
+
+    // 新空闲簇可能和左边的空闲段连成一段；左边那段若在 run_hint[k] 之前，长度必然
+    // 不足 2^k，合并后的起点不会早于 cluster_num - (2^k - 1)
+    for (uint32_t k = 0; k < FAT32_FAT_RUN_CLASSES; k++) {
+        uint32_t lowest = cluster_num > (1U << k) + 1 ? cluster_num - ((1U << k) - 1) : 2;
+        if (t->run_hint[k] > lowest) {
+            t->run_hint[k] = lowest;
+        }
+    }
+}
+
+// 从 pos 开始按字查找下一个空闲簇，不绕回；没有时返回位图长度
+static uint32_t
+fat32_fat_next_free(uint32_t pos)
+{
+    fat32_fat_table_t *t     = &g_fat_table;
+    uint32_t           limit = t->map_words * 64;
+
+    if (pos >= limit) {
+        return limit;
+    }
+
+    uint32_t w    = pos / 64;
+    uint64_t word = t->free_map[w] & (~0ULL << (pos % 64));
+    while (word == 0) {
+        if (++w >= t->map_words) {
+            return limit;
+        }
+        word = t->free_map[w];
+    }
+    return w * 64 + __builtin_ctzll(word);
+}
+
+// 从 start 开始查找第一个空闲簇，到末尾后绕回开头；没有空闲簇时返回 0
+static uint32_t
+fat32_fat_find_free(uint32_t start)
+{
+    fat32_fat_table_t *t = &g_fat_table;
+
+    if (t->free_map == NULL) {
+        return 0;
+    }
+
+    uint32_t cluster = fat32_fat_next_free(start);
+    if (cluster == t->map_words * 64) {
+        cluster = fat32_fat_next_free(0);
+    }
+    // 簇 0、1 的位始终为 0，返回 0 不会与有效簇号混淆
+    return cluster < t->map_words * 64 ? cluster : 0;
+}
+
+// 从空闲簇 start 开始的连续空闲簇数，数到 max 以上即停
+static uint32_t
+fat32_fat_free_run_length(uint32_t start, uint32_t max)
+{
+    fat32_fat_table_t *t     = &g_fat_table;
+    uint32_t           limit = t->map_words * 64;
+    uint32_t           len   = 0;
+
+    while (len < max && start + len < limit) {
+        uint32_t pos  = start + len;
+        uint64_t used = ~t->free_map[pos / 64] >> (pos % 64);
+        if (used == 0) {
+            len += 64 - pos % 64;
+            continue;
+        }
+        len += __builtin_ctzll(used);
+        break;
+    }
+    return len;
+}
+
+/*
+ * 最佳适配：找不短于 count 的最短空闲段，没有时返回最长的空闲段，长度写入 *run_len。
+ * run_hint[k] 之前没有长度不小于 2^k 的空闲段，从对应级别的提示处开始扫描即可。
+ */
+static uint32_t
+fat32_fat_best_fit(uint32_t count, uint32_t *run_len)
+{
+    fat32_fat_table_t *t           = &g_fat_table;
+    uint32_t           limit       = t->map_words * 64;
+    uint32_t           cls         = 31 - __builtin_clz(count);
+    uint32_t           best        = 0;
+    uint32_t           best_len    = 0;
+    uint32_t           largest     = 0;
+    uint32_t           largest_len = 0;
+    bool               hint_moved  = false;
+
+    if (t->free_map == NULL) {
+        *run_len = 0;
+        return 0;
+    }
+    if (cls >= FAT32_FAT_RUN_CLASSES) {
+        cls = FAT32_FAT_RUN_CLASSES - 1;
+    }
+
+    for (uint32_t pos = t->run_hint[cls]; pos < limit;) {
+        uint32_t start = fat32_fat_next_free(pos);
+        if (start >= limit) {
+            break;
+        }
+        uint32_t len = fat32_fat_free_run_length(start, 0xFFFFFFFF);
+
+        if (len >= (1U << cls) && !hint_moved) {
+            t->run_hint[cls] = start;
+            hint_moved       = true;
+        }
+        if (len >= count && (best == 0 || len < best_len)) {
+            best     = start;
+            best_len = len;
+            if (len == count) {
+                break;  // 正好合适
+            }
+        }
+        if (len > largest_len) {
+            largest     = start;
+            largest_len = len;
+        }
+        pos = start + len;
+    }
+    if (!hint_moved) {
+        t->run_hint[cls] = limit;
+    }
+
+    // 提示之前的空闲段都短于 2^cls，提示之后也没有这么长的段时才需要从头找最长段
+    if (best == 0 && largest_len < (1U << cls)) {
+        for (uint32_t pos = 2; pos < limit;) {
+            uint32_t start = fat32_fat_next_free(pos);
+            if (start >= limit) {
+                break;
+            }
+            uint32_t len = fat32_fat_free_run_length(start, 0xFFFFFFFF);
+            if (len > largest_len) {
+                largest     = start;
+                largest_len = len;
+            }
+            pos = start + len;
+        }
+    }
+
+    if (best != 0) {
+        *run_len = best_len;
+        return best;
+    }
+    *run_len = largest_len;
+    return largest;
+}
+
+// 扫描整个 FAT 建立空闲簇位图，并以扫描结果校正空闲簇计数
+static fat32_error_t
+fat32_fat_build_free_map(fat32_disk_t *disk, fat32_fs_info_t *fs_info)
+{
+    fat32_fat_table_t *t          = &g_fat_table;
+    uint32_t           end        = fs_info->total_clusters + 2;
+    uint32_t           free_count = 0;
+    uint32_t          *bounce     = NULL;
+
+    // FAT 比簇数小说明卷已损坏，只处理 FAT 能覆盖的部分
+    if (end > t->fat_sectors * (FAT32_SECTOR_SIZE / 4)) {
+        end = t->fat_sectors * (FAT32_SECTOR_SIZE / 4);
+    }
+
+    t->map_words = UP2(end, 64) / 64;
+    t->free_map  = (uint64_t *) kalloc_pages(fat32_fat_pages(t->map_words * sizeof(uint64_t)));
+    if (t->free_map == NULL) {
+        return FAT32_ERROR_NO_SPACE;
+    }
+    memset(t->free_map, 0, t->map_words * sizeof(uint64_t));
+
+    // 按需读入的表在这里只借一块中转缓冲区扫描，不把窗口留在内存里
+    if (t->flat == NULL) {
+        bounce = (uint32_t *) kalloc_pages(FAT32_FAT_SCAN_PAGES);
+        if (bounce == NULL) {
+            return FAT32_ERROR_NO_SPACE;
+        }
+    }
+
+    uint32_t step = FAT32_FAT_SCAN_PAGES * FAT32_FAT_WINDOW_ENTRIES;
+    for (uint32_t base = 0; base < end; base += step) {
+        uint32_t        n = end - base < step ? end - base : step;
+        const uint32_t *entries;
+
+        if (bounce == NULL) {
+            entries = t->flat + base;
+        } else {
+            uint32_t first = base / (FAT32_SECTOR_SIZE / 4);
+            uint32_t count = UP2(n * 4, FAT32_SECTOR_SIZE) / FAT32_SECTOR_SIZE;
+            fat32_error_t result =
+                fat32_disk_read_sectors(disk, fs_info->fat_start_sector + first, count, bounce);
+            if (result != FAT32_OK) {
+                kfree_pages(bounce, FAT32_FAT_SCAN_PAGES);
+                return result;
+            }
+            entries = bounce;
+        }
+
+        for (uint32_t i = 0; i < n; i++) {
+            if (base + i >= 2 && (entries[i] & 0x0FFFFFFF) == FAT32_FREE_CLUSTER) {
+                fat32_fat_map_set(base + i, true);
+                free_count++;
+            }
+        }
+    }
+
+    if (bounce != NULL) {
+        kfree_pages(bounce, FAT32_FAT_SCAN_PAGES);
+    }
+
+    fs_info->free_cluster_count = free_count;
+    if (!fat32_fat_is_valid_cluster(fs_info, fs_info->next_free_cluster)) {
+        fs_info->next_free_cluster = 2;
+    }
+    for (uint32_t i = 0; i < FAT32_FAT_RUN_CLASSES; i++) {
+        t->run_hint[i] = 2;
+    }
+    return FAT32_OK;
+}
+
+/* ============================================================================
+ * 内存 FAT 表管理
+ * ============================================================================ */
+
+fat32_error_t
+fat32_fat_table_load(fat32_disk_t *disk, fat32_fs_info_t *fs_info)
+{
+    fat32_fat_table_t *t = &g_fat_table;
+
+    avatar_assert(disk != NULL);
+    avatar_assert(fs_info != NULL);
+
+    fat32_fat_table_release();
+
+    uint32_t fat_sectors = fs_info->boot_sector.fat_size_32;
+    uint32_t nwindows    = UP2(fat_sectors, FAT32_FAT_WINDOW_SECTORS) / FAT32_FAT_WINDOW_SECTORS;
+    uint32_t map_words   = UP2(fat_sectors, 64) / 64;
+
+    fat32_error_t result;
+
+    if (fat_sectors == 0) {
+        return FAT32_ERROR_CORRUPTED;
+    }
+
+    t->windows = (uint32_t **) kalloc_pages(fat32_fat_pages(nwindows * sizeof(uint32_t *)));
+    t->dirty   = (uint64_t *) kalloc_pages(fat32_fat_pages(map_words * sizeof(uint64_t)));
+    if (t->windows == NULL || t->dirty == NULL) {
+        goto nomem;
+    }
+    memset(t->windows, 0, nwindows * sizeof(uint32_t *));
+    memset(t->dirty, 0, map_words * sizeof(uint64_t));
+    t->nwindows    = nwindows;
+    t->fat_sectors = fat_sectors;
+    t->dirty_count = 0;
+
+    // 表不大时整表读入，之后不会再因为 FAT 读盘
+    if (fat_sectors <= FAT32_FAT_PRELOAD_KB * 1024 / FAT32_SECTOR_SIZE) {
+        t->flat = (uint32_t *) kalloc_pages(nwindows);
+        if (t->flat == NULL) {
+            goto nomem;
+        }
+        memset(t->flat, 0, (uint64_t) nwindows * PAGE_SIZE);
+
+        result = fat32_disk_read_sectors(disk, fs_info->fat_start_sector, fat_sectors, t->flat);
+        if (result != FAT32_OK) {
+            fat32_fat_table_release();
+            return result;
+        }
+        for (uint32_t i = 0; i < nwindows; i++) {
+            t->windows[i] = t->flat + i * FAT32_FAT_WINDOW_ENTRIES;
+        }
+    }
+
+    result = fat32_fat_build_free_map(disk, fs_info);
+    if (result != FAT32_OK) {
+        fat32_fat_table_release();
+        return result;
+    }
+
+    t->ready = 1;
+    logger_info("FAT32: FAT table %u KB, %s, %u free clusters\n",
+                fat_sectors * FAT32_SECTOR_SIZE / 1024,
+                t->flat != NULL ? "preloaded" : "loaded on demand",
+                fs_info->free_cluster_count);
+    return FAT32_OK;
+
+nomem:
+    logger_error("FAT32: Out of memory for FAT table\n");
+    fat32_fat_table_release();
+    return FAT32_ERROR_NO_SPACE;
+}
+
+fat32_error_t
+fat32_fat_table_flush(fat32_disk_t *disk, const fat32_fs_info_t *fs_info)
+{
+    fat32_fat_table_t *t = &g_fat_table;
+
+    avatar_assert(disk != NULL);
+    avatar_assert(fs_info != NULL);
+
+    if (!t->ready || t->dirty_count == 0) {
+        return FAT32_OK;
+    }
+
+    uint32_t sector = 0;
+    while (sector < t->fat_sectors) {
+        uint64_t word = t->dirty[sector / 64] >> (sector % 64);
+        if (word == 0) {
+            sector = (sector / 64 + 1) * 64;
+            continue;
+        }
+        sector += __builtin_ctzll(word);
+        if (sector >= t->fat_sectors) {
+            break;
+        }
+
+        // 连续的脏扇区合并写；按需读入的窗口各自独立，写到窗口边界为止
+        uint32_t run = 1;
+        while (sector + run < t->fat_sectors &&
+               ((t->dirty[(sector + run) / 64] >> ((sector + run) % 64)) & 1) &&
+               (t->flat != NULL || (sector + run) % FAT32_FAT_WINDOW_SECTORS != 0)) {
+            run++;
+        }
+
+        uint8_t *src = (uint8_t *) t->windows[sector / FAT32_FAT_WINDOW_SECTORS] +
+                       (sector % FAT32_FAT_WINDOW_SECTORS) * FAT32_SECTOR_SIZE;
+        for (uint8_t fat_num = 0; fat_num < fs_info->boot_sector.num_fats; fat_num++) {
+            uint32_t      target = fs_info->fat_start_sector + fat_num * t->fat_sectors + sector;
+            fat32_error_t result = fat32_disk_write_sectors(disk, target, run, src);
+            if (result != FAT32_OK) {
+                logger("FAT32: Failed to write FAT %u sector %u\n", fat_num, target);
+                return result;
+            }
+        }
+
+        for (uint32_t i = sector; i < sector + run; i++) {
+            t->dirty[i / 64] &= ~(1ULL << (i % 64));
+        }
+        t->dirty_count -= run;
+        sector += run;
+    }
+
+    return FAT32_OK;
+}
+
+void
+fat32_fat_table_release(void)
+{
+    fat32_fat_table_t *t = &g_fat_table;
+
+    if (t->dirty_count != 0) {
+        logger_warn("FAT32: Dropping %u unflushed FAT sectors\n", t->dirty_count);
+    }
+
+    if (t->windows != NULL) {
+        if (t->flat != NULL) {
+            kfree_pages(t->flat, t->nwindows);
+        } else {
+            for (uint32_t i = 0; i < t->nwindows; i++) {
+                if (t->windows[i] != NULL) {
+                    kfree_pages(t->windows[i], 1);
+                }
+            }
+        }
+        kfree_pages(t->windows, fat32_fat_pages(t->nwindows * sizeof(uint32_t *)));
+    }
+    if (t->dirty != NULL) {
+        kfree_pages(t->dirty,
+                    fat32_fat_pages(UP2(t->fat_sectors, 64) / 64 * sizeof(uint64_t)));
+    }
+    if (t->free_map != NULL) {
+        kfree_pages(t->free_map, fat32_fat_pages(t->map_words * sizeof(uint64_t)));
+    }
+
+    memset(t, 0, sizeof(fat32_fat_table_t));
+}
+
+// 返回表项在内存中的位置，所在窗口还没读入时先读入
+static uint32_t *
+fat32_fat_entry_slot(fat32_disk_t *disk, const fat32_fs_info_t *fs_info, uint32_t cluster_num)
+{
+    fat32_fat_table_t *t      = &g_fat_table;
+    uint32_t           window = cluster_num / FAT32_FAT_WINDOW_ENTRIES;
+
+    if (!t->ready || cluster_num / (FAT32_SECTOR_SIZE / 4) >= t->fat_sectors) {
+        return NULL;
+    }
+
+    if (t->windows[window] == NULL) {
+        uint32_t first = window * FAT32_FAT_WINDOW_SECTORS;
+        uint32_t count = t->fat_sectors - first;
+        if (count > FAT32_FAT_WINDOW_SECTORS) {
+            count = FAT32_FAT_WINDOW_SECTORS;
+        }
+
+        uint32_t *page = (uint32_t *) kalloc_pages(1);
+        if (page == NULL) {
+            return NULL;
+        }
+        memset(page, 0, PAGE_SIZE);
+        if (fat32_disk_read_sectors(disk, fs_info->fat_start_sector + first, count, page) !=
+            FAT32_OK) {
+            kfree_pages(page, 1);
+            return NULL;
+        }
+        t->windows[window] = page;
+    }
+
+    return &t->windows[window][cluster_num % FAT32_FAT_WINDOW_ENTRIES];
+}
+
 /* ============================================================================
  * FAT表操作函数实现
  * ============================================================================ */
@@ -42,19 +513,13 @@ fat32_fat_read_entry(fat32_disk_t          *disk,
         return FAT32_ERROR_INVALID_PARAM;
     }
 
-    // 计算FAT表项所在的扇区和偏移
-    uint32_t fat_sector = fat32_fat_get_entry_sector(fs_info, cluster_num);
-    uint32_t fat_offset = fat32_fat_get_entry_offset(cluster_num);
-
-    // 读取扇区数据
-    uint8_t       sector_buffer[FAT32_SECTOR_SIZE];
-    fat32_error_t result = fat32_disk_read_sectors(disk, fat_sector, 1, sector_buffer);
-    if (result != FAT32_OK) {
-        return result;
+    uint32_t *slot = fat32_fat_entry_slot(disk, fs_info, cluster_num);
+    if (slot == NULL) {
+        return FAT32_ERROR_DISK_ERROR;
     }
 
     // 提取FAT表项值（小端序）
-    *fat_entry = *(uint32_t *) (sector_buffer + fat_offset) & 0x0FFFFFFF;
+    *fat_entry = *slot & 0x0FFFFFFF;
 
     return FAT32_OK;
 }
@@ -73,31 +538,27 @@ fat32_fat_write_entry(fat32_disk_t          *disk,
         return FAT32_ERROR_INVALID_PARAM;
     }
 
-    // 计算FAT表项所在的扇区和偏移
-    uint32_t fat_sector = fat32_fat_get_entry_sector(fs_info, cluster_num);
-    uint32_t fat_offset = fat32_fat_get_entry_offset(cluster_num);
+    uint32_t *slot = fat32_fat_entry_slot(disk, fs_info, cluster_num);
+    if (slot == NULL) {
+        return FAT32_ERROR_DISK_ERROR;
+    }
 
-    // 读取扇区数据
-    uint8_t       sector_buffer[FAT32_SECTOR_SIZE];
-    fat32_error_t result = fat32_disk_read_sectors(disk, fat_sector, 1, sector_buffer);
-    if (result != FAT32_OK) {
-        return result;
+    // 表项在空闲和已用之间变化时同步位图
+    bool was_free = (*slot & 0x0FFFFFFF) == FAT32_FREE_CLUSTER;
+    bool is_free  = (fat_entry & 0x0FFFFFFF) == FAT32_FREE_CLUSTER;
+    if (was_free != is_free && cluster_num < g_fat_table.map_words * 64) {
+        fat32_fat_map_set(cluster_num, is_free);
     }
 
     // 修改FAT表项值（保留高4位，只修改低28位）
-    uint32_t *entry_ptr = (uint32_t *) (sector_buffer + fat_offset);
-    *entry_ptr          = (*entry_ptr & 0xF0000000) | (fat_entry & 0x0FFFFFFF);
-
-    // 写入所有FAT表副本
-    for (uint8_t fat_num = 0; fat_num < fs_info->boot_sector.num_fats; fat_num++) {
-        uint32_t fat_start = fs_info->fat_start_sector + fat_num * fs_info->boot_sector.fat_size_32;
-        uint32_t target_sector = fat_start + (fat_sector - fs_info->fat_start_sector);
-
-        result = fat32_disk_write_sectors(disk, target_sector, 1, sector_buffer);
-        if (result != FAT32_OK) {
-            logger("FAT32: Failed to write FAT %u sector %u\n", fat_num, target_sector);
-            return result;
-        }
+    *slot = (*slot & 0xF0000000) | (fat_entry & 0x0FFFFFFF);
+
+    // 只记下脏扇区，所有 FAT 副本在 sync 时一起写
+    uint32_t sector = cluster_num * 4 / FAT32_SECTOR_SIZE;
+    uint64_t bit    = 1ULL << (sector % 64);
+    if (!(g_fat_table.dirty[sector / 64] & bit)) {
+        g_fat_table.dirty[sector / 64] |= bit;
+        g_fat_table.dirty_count++;
     }
 
     return FAT32_OK;
@@ -114,50 +575,32 @@ fat32_fat_allocate_cluster(fat32_disk_t *disk, fat32_fs_info_t *fs_info, uint32_
     avatar_assert(fs_info != NULL);
     avatar_assert(cluster_num != NULL);
 
-    uint32_t start_cluster   = fs_info->next_free_cluster;
-    uint32_t current_cluster = start_cluster;
-    uint32_t fat_entry;
-
-    // 从next_free_cluster开始查找空闲簇
-    do {
-        fat32_error_t result = fat32_fat_read_entry(disk, fs_info, current_cluster, &fat_entry);
-        if (result != FAT32_OK) {
-            return result;
-        }
-
-        if (fat32_fat_is_free_cluster(fat_entry)) {
-            // 找到空闲簇，标记为簇链结束
-            result = fat32_fat_write_entry(disk, fs_info, current_cluster, FAT32_EOC_MAX);
-            if (result != FAT32_OK) {
-                return result;
-            }
-
-            *cluster_num = current_cluster;
-
-            // 更新FSInfo信息
-            if (fs_info->free_cluster_count != 0xFFFFFFFF) {
-                fs_info->free_cluster_count--;
-            }
+    // 从next_free_cluster开始在位图中查找空闲簇
+    uint32_t cluster = fat32_fat_find_free(fs_info->next_free_cluster);
+    if (cluster == 0) {
+        return FAT32_ERROR_NO_SPACE;
+    }
 
-            // 更新下一个空闲簇提示
-            fs_info->next_free_cluster = current_cluster + 1;
-            if (fs_info->next_free_cluster >= fs_info->total_clusters + 2) {
-                fs_info->next_free_cluster = 2;
-            }
+    // 标记为簇链结束
+    fat32_error_t result = fat32_fat_write_entry(disk, fs_info, cluster, FAT32_EOC_MAX);
+    if (result != FAT32_OK) {
+        return result;
+    }
 
-            return FAT32_OK;
-        }
+    *cluster_num = cluster;
 
-        // 移动到下一个簇
-        current_cluster++;
-        if (current_cluster >= fs_info->total_clusters + 2) {
-            current_cluster = 2;
-        }
+    // 更新FSInfo信息
+    if (fs_info->free_cluster_count != 0xFFFFFFFF) {
+        fs_info->free_cluster_count--;
+    }
 
-    } while (current_cluster != start_cluster);
+    // 更新下一个空闲簇提示
+    fs_info->next_free_cluster = cluster + 1;
+    if (fs_info->next_free_cluster >= fs_info->total_clusters + 2) {
+        fs_info->next_free_cluster = 2;
+    }
 
-    // 没有找到空闲簇
-    return FAT32_ERROR_NO_SPACE;
+    return FAT32_OK;
 }
 
 fat32_error_t
@@ -190,51 +633,135 @@ fat32_fat_free_cluster(fat32_disk_t *disk, fat32_fs_info_t *fs_info, uint32_t cl
 }
 
 fat32_error_t
-fat32_fat_allocate_cluster_chain(fat32_disk_t    *disk,
-                                 fat32_fs_info_t *fs_info,
-                                 uint32_t         cluster_count,
-                                 uint32_t        *first_cluster)
+fat32_fat_allocate_extent(fat32_disk_t    *disk,
+                          fat32_fs_info_t *fs_info,
+                          uint32_t         goal,
+                          uint32_t         max_count,
+                          uint32_t        *first_cluster,
+                          uint32_t        *count)
 {
     avatar_assert(disk != NULL);
     avatar_assert(fs_info != NULL);
     avatar_assert(first_cluster != NULL);
-    avatar_assert(cluster_count > 0);
+    avatar_assert(count != NULL);
+    avatar_assert(max_count > 0);
 
-    if (cluster_count == 1) {
-        return fat32_fat_allocate_cluster(disk, fs_info, first_cluster);
-    }
+    uint32_t start;
+    uint32_t len;
 
-    // 分配第一个簇
-    fat32_error_t result = fat32_fat_allocate_cluster(disk, fs_info, first_cluster);
-    if (result != FAT32_OK) {
-        return result;
+    // 目标簇空闲时从它接着分配，文件的最后一段继续向后延伸
+    if (fat32_fat_is_valid_cluster(fs_info, goal) && goal < g_fat_table.map_words * 64 &&
+        fat32_fat_map_test(goal)) {
+        start = goal;
+        len   = fat32_fat_free_run_length(goal, max_count);
+    } else {
+        start = fat32_fat_best_fit(max_count, &len);
     }
 
-    uint32_t prev_cluster = *first_cluster;
+    if (start == 0) {
+        return FAT32_ERROR_NO_SPACE;
+    }
+    if (len > max_count) {
+        len = max_count;
+    }
 
-    // 分配剩余的簇并连接成链
-    for (uint32_t i = 1; i < cluster_count; i++) {
-        uint32_t new_cluster;
-        result = fat32_fat_allocate_cluster(disk, fs_info, &new_cluster);
+    for (uint32_t i = 0; i < len; i++) {
+        uint32_t      next   = i + 1 < len ? start + i + 1 : FAT32_EOC_MAX;
+        fat32_error_t result = fat32_fat_write_entry(disk, fs_info, start + i, next);
         if (result != FAT32_OK) {
-            // 分配失败，释放已分配的簇
-            fat32_fat_free_cluster_chain(disk, fs_info, *first_cluster);
+            // 空闲簇计数还没有扣减，直接把已写的表项改回空闲
+            while (i-- > 0) {
+                fat32_fat_write_entry(disk, fs_info, start + i, FAT32_FREE_CLUSTER);
+            }
             return result;
         }
+    }
 
-        // 连接到簇链
-        result = fat32_fat_write_entry(disk, fs_info, prev_cluster, new_cluster);
+    if (fs_info->free_cluster_count != 0xFFFFFFFF) {
+        fs_info->free_cluster_count -= len;
+    }
+    if (fs_info->next_free_cluster >= start && fs_info->next_free_cluster < start + len) {
+        fs_info->next_free_cluster = start + len;
+        if (fs_info->next_free_cluster >= fs_info->total_clusters + 2) {
+            fs_info->next_free_cluster = 2;
+        }
+    }
+
+    *first_cluster = start;
+    *count         = len;
+    return FAT32_OK;
+}
+
+fat32_error_t
+fat32_fat_append_clusters(fat32_disk_t    *disk,
+                          fat32_fs_info_t *fs_info,
+                          uint32_t         last_cluster,
+                          uint32_t         cluster_count,
+                          uint32_t        *first_new)
+{
+    avatar_assert(disk != NULL);
+    avatar_assert(fs_info != NULL);
+    avatar_assert(cluster_count > 0);
+
+    if (last_cluster != 0 && !fat32_fat_is_valid_cluster(fs_info, last_cluster)) {
+        return FAT32_ERROR_INVALID_PARAM;
+    }
+
+    fat32_error_t result;
+    uint32_t      first     = 0;
+    uint32_t      last      = last_cluster;
+    uint32_t      remaining = cluster_count;
+
+    // 每一段都以上一段末尾的下一个簇为目标，接不上时再按最佳适配另找一段
+    while (remaining > 0) {
+        uint32_t start;
+        uint32_t n;
+
+        result = fat32_fat_allocate_extent(disk, fs_info, last + 1, remaining, &start, &n);
         if (result != FAT32_OK) {
-            // 连接失败，释放已分配的簇
-            fat32_fat_free_cluster(disk, fs_info, new_cluster);
-            fat32_fat_free_cluster_chain(disk, fs_info, *first_cluster);
-            return result;
+            goto fail;
+        }
+
+        if (last != 0) {
+            result = fat32_fat_write_entry(disk, fs_info, last, start);
+            if (result != FAT32_OK) {
+                fat32_fat_free_cluster_chain(disk, fs_info, start);
+                goto fail;
+            }
         }
 
-        prev_cluster = new_cluster;
+        if (first == 0) {
+            first = start;
+        }
+        last = start + n - 1;
+        remaining -= n;
     }
 
+    if (first_new != NULL) {
+        *first_new = first;
+    }
     return FAT32_OK;
+
+fail:
+    // 释放这次追加的所有簇，原簇链恢复原样
+    if (first != 0) {
+        if (last_cluster != 0) {
+            fat32_fat_write_entry(disk, fs_info, last_cluster, FAT32_EOC_MAX);
+        }
+        fat32_fat_free_cluster_chain(disk, fs_info, first);
+    }
+    return result;
+}
+
+fat32_error_t
+fat32_fat_allocate_cluster_chain(fat32_disk_t    *disk,
+                                 fat32_fs_info_t *fs_info,
+                                 uint32_t         cluster_count,
+                                 uint32_t        *first_cluster)
+{
+    avatar_assert(first_cluster != NULL);
+
+    return fat32_fat_append_clusters(disk, fs_info, 0, cluster_count, first_cluster);
 }
 
 fat32_error_t
@@ -326,21 +853,8 @@ fat32_fat_extend_cluster_chain(fat32_disk_t    *disk,
         return FAT32_ERROR_INVALID_PARAM;
     }
 
-    // 分配新簇
-    fat32_error_t result = fat32_fat_allocate_cluster(disk, fs_info, new_cluster);
-    if (result != FAT32_OK) {
-        return result;
-    }
-
-    // 将last_cluster指向新簇
-    result = fat32_fat_write_entry(disk, fs_info, last_cluster, *new_cluster);
-    if (result != FAT32_OK) {
-        // 分配失败，释放新簇
-        fat32_fat_free_cluster(disk, fs_info, *new_cluster);
-        return result;
-    }
-
-    return FAT32_OK;
+    // 优先紧接在 last_cluster 之后分配
+    return fat32_fat_append_clusters(disk, fs_info, last_cluster, 1, new_cluster);
 }
 
 fat32_error_t
@@ -22,6 +22,8 @@
 #include "fs/fat32_fat.h"
 #include "fs/fat32_dir.h"
 #include "fs/fat32_boot.h"
+#include "fs/fat32_cache.h"
+#include "fs/fat32_pagecache.h"
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
 #include "mem/mem.h"
@@ -70,14 +72,38 @@ fat32_file_extend_if_needed(fat32_disk_t        *disk,
                             fat32_file_handle_t *file_handle,
                             uint32_t             required_size);
 
+static fat32_error_t
+fat32_file_release_tail(fat32_disk_t        *disk,
+                        fat32_fs_info_t     *fs_info,
+                        fat32_file_handle_t *file_handle,
+                        uint32_t             keep_clusters);
+
 static fat32_error_t
 fat32_file_read_multi_clusters(fat32_disk_t          *disk,
                                const fat32_fs_info_t *fs_info,
-                               uint32_t               start_cluster,
+                               fat32_file_handle_t   *file_handle,
+                               uint32_t               cluster_index,
+                               uint32_t               cluster_count,
                                void                  *buffer,
-                               uint32_t               max_bytes,
-                               uint32_t              *bytes_read,
-                               uint32_t              *next_cluster);
+                               uint32_t              *clusters_read,
+                               uint32_t              *last_cluster);
+
+static void
+fat32_file_readahead(fat32_disk_t          *disk,
+                     const fat32_fs_info_t *fs_info,
+                     fat32_file_handle_t   *file_handle,
+                     uint32_t               size);
+
+static fat32_error_t
+fat32_file_write_direct(fat32_disk_t        *disk,
+                        fat32_fs_info_t     *fs_info,
+                        fat32_file_handle_t *file_handle,
+                        const void          *buffer,
+                        uint32_t             size,
+                        uint32_t            *bytes_written);
+
+static fat32_error_t
+fat32_file_delay_append(fat32_file_handle_t *file_handle, const uint8_t *buffer, uint32_t size);
 
 /* ============================================================================
  * 文件句柄管理函数实现
@@ -136,12 +162,162 @@ fat32_file_handle_free(fat32_file_handle_t *file_handle)
         return FAT32_ERROR_INVALID_PARAM;
     }
 
+    fat32_file_map_reset(file_handle);
+    if (file_handle->delay_buf != NULL) {
+        kfree_pages(file_handle->delay_buf, FAT32_DELALLOC_MAX / PAGE_SIZE);
+    }
     memset(file_handle, 0, sizeof(fat32_file_handle_t));
     file_handle->in_use = 0;
 
     return FAT32_OK;
 }
 
+/* ============================================================================
+ * 区段表
+ * ============================================================================ */
+
+#define FAT32_EXTENTS_PER_PAGE (PAGE_SIZE / sizeof(fat32_extent_t))
+
+void
+fat32_file_map_reset(fat32_file_handle_t *file_handle)
+{
+    avatar_assert(file_handle != NULL);
+
+    if (file_handle->extents != NULL) {
+        kfree_pages(file_handle->extents, file_handle->extent_pages);
+    }
+    file_handle->extents         = NULL;
+    file_handle->extent_count    = 0;
+    file_handle->extent_pages    = 0;
+    file_handle->mapped_clusters = 0;
+}
+
+// 把簇接到区段表末尾，与最后一个区段连续时直接并入
+static fat32_error_t
+fat32_file_map_push(fat32_file_handle_t *file_handle, uint32_t cluster)
+{
+    if (file_handle->extent_count > 0) {
+        fat32_extent_t *last = &file_handle->extents[file_handle->extent_count - 1];
+        if (last->cluster + last->length == cluster) {
+            last->length++;
+            file_handle->mapped_clusters++;
+            return FAT32_OK;
+        }
+    }
+
+    if (file_handle->extent_count == file_handle->extent_pages * FAT32_EXTENTS_PER_PAGE) {
+        uint32_t        pages = file_handle->extent_pages ? file_handle->extent_pages * 2 : 1;
+        fat32_extent_t *grown = (fat32_extent_t *) kalloc_pages(pages);
+        if (grown == NULL) {
+            return FAT32_ERROR_NO_SPACE;
+        }
+        if (file_handle->extents != NULL) {
+            memcpy(grown,
+                   file_handle->extents,
+                   file_handle->extent_count * sizeof(fat32_extent_t));
+            kfree_pages(file_handle->extents, file_handle->extent_pages);
+        }
+        file_handle->extents      = grown;
+        file_handle->extent_pages = pages;
+    }
+
+    fat32_extent_t *extent = &file_handle->extents[file_handle->extent_count++];
+    extent->file_index     = file_handle->mapped_clusters;
+    extent->cluster        = cluster;
+    extent->length         = 1;
+    file_handle->mapped_clusters++;
+    return FAT32_OK;
+}
+
+// 沿簇链把区段表补到簇链末尾。簇链只在末尾增长，已有的区段不会失效；截短时先重置
+static fat32_error_t
+fat32_file_map_extend(fat32_disk_t          *disk,
+                      const fat32_fs_info_t *fs_info,
+                      fat32_file_handle_t   *file_handle)
+{
+    uint32_t      cluster = file_handle->first_cluster;
+    fat32_error_t result;
+
+    if (file_handle->first_cluster < 2) {
+        return FAT32_OK;
+    }
+
+    if (file_handle->mapped_clusters > 0) {
+        const fat32_extent_t *last = &file_handle->extents[file_handle->extent_count - 1];
+        result = fat32_fat_get_next_cluster(disk,
+                                            fs_info,
+                                            last->cluster + last->length - 1,
+                                            &cluster);
+        if (result != FAT32_OK) {
+            return result;
+        }
+    }
+
+    while (cluster != 0) {
+        result = fat32_file_map_push(file_handle, cluster);
+        if (result != FAT32_OK) {
+            return result;
+        }
+
+        // 防止无限循环（检测簇链损坏）
+        if (file_handle->mapped_clusters > fs_info->total_clusters) {
+            return FAT32_ERROR_CORRUPTED;
+        }
+
+        result = fat32_fat_get_next_cluster(disk, fs_info, cluster, &cluster);
+        if (result != FAT32_OK) {
+            return result;
+        }
+    }
+
+    return FAT32_OK;
+}
+
+fat32_error_t
+fat32_file_map_cluster(fat32_disk_t          *disk,
+                       const fat32_fs_info_t *fs_info,
+                       fat32_file_handle_t   *file_handle,
+                       uint32_t               cluster_index,
+                       uint32_t              *cluster,
+                       uint32_t              *run_length)
+{
+    avatar_assert(disk != NULL);
+    avatar_assert(fs_info != NULL);
+    avatar_assert(file_handle != NULL);
+    avatar_assert(cluster != NULL);
+
+    if (cluster_index >= file_handle->mapped_clusters) {
+        fat32_error_t result = fat32_file_map_extend(disk, fs_info, file_handle);
+        if (result != FAT32_OK) {
+            return result;
+        }
+        if (cluster_index >= file_handle->mapped_clusters) {
+            return FAT32_ERROR_END_OF_FILE;
+        }
+    }
+
+    // 二分查找 file_index 不大于 cluster_index 的最后一个区段
+    uint32_t lo = 0;
+    uint32_t hi = file_handle->extent_count - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (file_handle->extents[mid].file_index <= cluster_index) {
+            lo = mid;
+        } else {
+            hi = mid - 1;
+        }
+    }
+
+    const fat32_extent_t *extent = &file_handle->extents[lo];
+    uint32_t              delta  = cluster_index - extent->file_index;
+
+    *cluster = extent->cluster + delta;
+    if (run_length != NULL) {
+        *run_length = extent->length - delta;
+    }
+    return FAT32_OK;
+}
+
 /* ============================================================================
  * 文件操作函数实现
  * ============================================================================ */
@@ -201,6 +377,7 @@ fat32_file_open(fat32_disk_t         *disk,
             if (dir_entry.file_size > 0) {
                 uint32_t first_cluster = fat32_dir_get_first_cluster(&dir_entry);
                 if (first_cluster >= 2) {
+                    fat32_pagecache_invalidate(first_cluster);
                     fat32_fat_free_cluster_chain(disk, fs_info, first_cluster);
                 }
                 dir_entry.file_size = 0;
@@ -257,17 +434,10 @@ fat32_file_open(fat32_disk_t         *disk,
     if (flags & FAT32_O_APPEND) {
         handle->file_position = handle->file_size;
         // 定位到文件末尾的簇
-        if (handle->file_size > 0 && handle->first_cluster >= 2) {
-            uint32_t cluster_index = handle->file_size / fs_info->bytes_per_cluster;
-            result                 = fat32_fat_get_cluster_at_index(disk,
-                                                    fs_info,
-                                                    handle->first_cluster,
-                                                    cluster_index,
-                                                    &handle->current_cluster);
-            if (result != FAT32_OK) {
-                handle->current_cluster = handle->first_cluster;
-            }
-            handle->cluster_offset = handle->file_size % fs_info->bytes_per_cluster;
+        if (fat32_file_seek(handle, 0, FAT32_SEEK_END, NULL) != FAT32_OK) {
+            handle->current_cluster = handle->first_cluster;
+            handle->cluster_offset  = 0;
+            handle->file_position   = 0;
         }
     }
 
@@ -294,15 +464,31 @@ fat32_file_close(fat32_disk_t *disk, fat32_fs_info_t *fs_info, fat32_file_handle
         return FAT32_ERROR_INVALID_PARAM;
     }
 
+    // 延迟分配的数据先分配簇，目录项里的首簇和大小才完整
+    fat32_error_t result = fat32_file_flush(disk, fs_info, file_handle);
+    if (result != FAT32_OK) {
+        logger("FAT32: Warning - Failed to flush file '%s'\n", file_handle->filename);
+    }
+
+    // 预分配但没有写到的簇还给空闲空间
+    if (file_handle->preallocated) {
+        uint32_t keep = (file_handle->file_size + fs_info->bytes_per_cluster - 1) /
+                        fs_info->bytes_per_cluster;
+        if (fat32_file_release_tail(disk, fs_info, file_handle, keep) != FAT32_OK) {
+            logger("FAT32: Warning - Failed to release preallocated clusters of '%s'\n",
+                   file_handle->filename);
+        }
+    }
+
     // 如果文件被修改过，更新目录项
     if (file_handle->modified && fat32_file_is_writable(file_handle)) {
         // 直接更新目录项，使用保存的目录信息
         fat32_dir_entry_t dir_entry;
-        fat32_error_t     result = fat32_dir_read_entry(disk,
-                                                    fs_info,
-                                                    file_handle->dir_cluster,
-                                                    file_handle->dir_entry_index,
-                                                    &dir_entry);
+        result = fat32_dir_read_entry(disk,
+                                      fs_info,
+                                      file_handle->dir_cluster,
+                                      file_handle->dir_entry_index,
+                                      &dir_entry);
         if (result == FAT32_OK) {
             // 更新文件大小和起始簇
             dir_entry.file_size = file_handle->file_size;
@@ -323,12 +509,12 @@ fat32_file_close(fat32_disk_t *disk, fat32_fs_info_t *fs_info, fat32_file_handle
                        fat32_get_error_string(result));
             }
         }
-    }
 
-    // 刷新缓存数据
-    fat32_error_t result = fat32_file_flush(disk, fs_info, file_handle);
-    if (result != FAT32_OK) {
-        logger("FAT32: Warning - Failed to flush file '%s'\n", file_handle->filename);
+        // 关闭时落盘：FAT 表先写，目录项和数据随后经缓存写回
+        if (fat32_fat_table_flush(disk, fs_info) != FAT32_OK ||
+            fat32_cache_flush(fat32_get_cache_manager(), disk, fs_info) != FAT32_OK) {
+            logger("FAT32: Warning - Failed to sync '%s' on close\n", file_handle->filename);
+        }
     }
 
     logger("FAT32: File '%s' closed (size: %u bytes)\n",
@@ -383,13 +569,27 @@ fat32_file_read(fat32_disk_t          *disk,
         return FAT32_OK;
     }
 
+    fat32_file_readahead(disk, fs_info, file_handle, bytes_to_read);
+
     uint32_t current_cluster = file_handle->current_cluster;
     uint32_t cluster_offset  = file_handle->cluster_offset;
 
-    // 优化：尝试多簇批量读取
-    const uint32_t MULTI_CLUSTER_READ_SIZE = 32;  // 一次读取32个簇(16KB)
-
     while (total_read < bytes_to_read && current_cluster >= 2) {
+        // 上次写到簇末尾时停在簇尾，先移到下一个簇
+        if (cluster_offset >= fs_info->bytes_per_cluster) {
+            uint32_t      next_cluster;
+            fat32_error_t result =
+                fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
+            if (result != FAT32_OK) {
+                return result;
+            }
+            if (next_cluster == 0) {
+                break;
+            }
+            current_cluster = next_cluster;
+            cluster_offset  = 0;
+        }
+
         uint32_t bytes_in_cluster     = bytes_to_read - total_read;
         uint32_t remaining_in_cluster = fs_info->bytes_per_cluster - cluster_offset;
 
@@ -397,20 +597,26 @@ fat32_file_read(fat32_disk_t          *disk,
             bytes_in_cluster = remaining_in_cluster;
         }
 
-        // 如果是从簇开始读取且需要读取大量数据，尝试多簇读取
-        if (cluster_offset == 0 &&
-            bytes_to_read - total_read >= MULTI_CLUSTER_READ_SIZE * fs_info->bytes_per_cluster) {
-            uint32_t      multi_cluster_bytes_read;
+        // 从簇开始且剩余至少两个整簇时，按区段一次提交所有整簇，簇不必连续
+        uint32_t whole = (bytes_to_read - total_read) / fs_info->bytes_per_cluster;
+        if (cluster_offset == 0 && whole >= 2) {
+            uint32_t      index = (file_handle->file_position + total_read) /
+                                  fs_info->bytes_per_cluster;
+            uint32_t      clusters_read;
             fat32_error_t result = fat32_file_read_multi_clusters(disk,
                                                                   fs_info,
-                                                                  current_cluster,
+                                                                  file_handle,
+                                                                  index,
+                                                                  whole,
                                                                   read_buffer + total_read,
-                                                                  bytes_to_read - total_read,
-                                                                  &multi_cluster_bytes_read,
+                                                                  &clusters_read,
                                                                   &current_cluster);
-            if (result == FAT32_OK && multi_cluster_bytes_read > 0) {
-                total_read += multi_cluster_bytes_read;
-                cluster_offset = multi_cluster_bytes_read % fs_info->bytes_per_cluster;
+            if (result != FAT32_OK) {
+                return result;
+            }
+            if (clusters_read > 0) {
+                total_read += clusters_read * fs_info->bytes_per_cluster;
+                cluster_offset = fs_info->bytes_per_cluster;
                 continue;
             }
         }
@@ -489,106 +695,54 @@ fat32_file_write(fat32_disk_t        *disk,
         return FAT32_OK;
     }
 
-    // 计算写入后的文件大小
-    uint32_t end_position = file_handle->file_position + size;
-
-    // 如果需要扩展文件，先分配足够的簇
-    if (end_position > file_handle->file_size) {
-        fat32_error_t result =
-            fat32_file_extend_if_needed(disk, fs_info, file_handle, end_position);
+    // 已有延迟数据而这次不是接着追加，或者缓冲区放不下，先落盘
+    fat32_error_t result;
+    if (file_handle->delay_len > 0 &&
+        (file_handle->file_position != file_handle->file_size ||
+         file_handle->delay_len + size > FAT32_DELALLOC_MAX)) {
+        result = fat32_file_flush(disk, fs_info, file_handle);
         if (result != FAT32_OK) {
             return result;
         }
     }
 
-    const uint8_t *write_buffer    = (const uint8_t *) buffer;
-    uint32_t       total_written   = 0;
-    uint32_t       current_cluster = file_handle->current_cluster;
-    uint32_t       cluster_offset  = file_handle->cluster_offset;
-
-    // 如果文件为空或当前簇无效，需要分配第一个簇
-    if (current_cluster < 2) {
-        if (file_handle->first_cluster < 2) {
-            // 分配第一个簇
-            fat32_error_t result = fat32_fat_allocate_cluster(disk, fs_info, &current_cluster);
-            if (result != FAT32_OK) {
-                return result;
-            }
-            file_handle->first_cluster   = current_cluster;
-            file_handle->current_cluster = current_cluster;
-        } else {
-            current_cluster              = file_handle->first_cluster;
-            file_handle->current_cluster = current_cluster;
+    // 簇链已有的容量
+    uint32_t capacity = 0;
+    if (file_handle->first_cluster >= 2) {
+        result = fat32_file_map_extend(disk, fs_info, file_handle);
+        if (result != FAT32_OK) {
+            return result;
         }
-        cluster_offset              = 0;
-        file_handle->cluster_offset = 0;
+        capacity = file_handle->mapped_clusters * fs_info->bytes_per_cluster;
     }
 
-    while (total_written < size && current_cluster >= 2) {
-        uint32_t bytes_in_cluster     = size - total_written;
-        uint32_t remaining_in_cluster = fs_info->bytes_per_cluster - cluster_offset;
+    // 大块写或覆盖写照常分配；小块追加时簇链内放得下的部分直接写，超出的部分延迟分配
+    uint32_t end_position = file_handle->file_position + size;
+    if (size > FAT32_DELALLOC_MAX || file_handle->file_position != file_handle->file_size ||
+        end_position <= capacity) {
+        return fat32_file_write_direct(disk, fs_info, file_handle, buffer, size, bytes_written);
+    }
 
-        if (bytes_in_cluster > remaining_in_cluster) {
-            bytes_in_cluster = remaining_in_cluster;
+    uint32_t head = capacity > file_handle->file_position ? capacity - file_handle->file_position
+                                                          : 0;
+    if (head > 0) {
+        result = fat32_file_write_direct(disk, fs_info, file_handle, buffer, head, bytes_written);
+        if (result != FAT32_OK || *bytes_written < head) {
+            return result;
         }
+    }
 
-        uint32_t      cluster_bytes_written;
-        fat32_error_t result = fat32_file_write_cluster_data(disk,
-                                                             fs_info,
-                                                             current_cluster,
-                                                             cluster_offset,
-                                                             write_buffer + total_written,
-                                                             bytes_in_cluster,
-                                                             &cluster_bytes_written);
+    const uint8_t *tail    = (const uint8_t *) buffer + head;
+    uint32_t       written = size - head;
+    if (fat32_file_delay_append(file_handle, tail, written) != FAT32_OK) {
+        // 分配不到缓冲区时照常写
+        result = fat32_file_write_direct(disk, fs_info, file_handle, tail, size - head, &written);
         if (result != FAT32_OK) {
-            break;
-        }
-
-        total_written += cluster_bytes_written;
-        cluster_offset += cluster_bytes_written;
-
-        // 如果写满了当前簇，移动到下一个簇
-        if (cluster_offset >= fs_info->bytes_per_cluster) {
-            uint32_t next_cluster;
-            result = fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
-            if (result != FAT32_OK) {
-                break;
-            }
-
-            if (next_cluster == 0) {
-                // 需要分配新簇
-                result =
-                    fat32_fat_extend_cluster_chain(disk, fs_info, current_cluster, &next_cluster);
-                if (result != FAT32_OK) {
-                    break;
-                }
-            }
-
-            current_cluster = next_cluster;
-            cluster_offset  = 0;
-        }
-
-        if (cluster_bytes_written < bytes_in_cluster) {
-            break;  // 写入不完整
+            return result;
         }
     }
 
-    // 更新文件句柄状态
-    file_handle->file_position += total_written;
-    file_handle->current_cluster = current_cluster;
-    file_handle->cluster_offset  = cluster_offset;
-
-    // 更新文件大小
-    if (file_handle->file_position > file_handle->file_size) {
-        file_handle->file_size = file_handle->file_position;
-    }
-
-    // 标记文件为已修改
-    if (total_written > 0) {
-        file_handle->modified = 1;
-    }
-
-    *bytes_written = total_written;
+    *bytes_written = head + written;
     return FAT32_OK;
 }
 
@@ -638,19 +792,55 @@ fat32_file_seek(fat32_file_handle_t *file_handle,
         target_position = file_handle->file_size;
     }
 
-    // 更新文件位置
-    file_handle->file_position = target_position;
+    // 有延迟分配的数据时位置就在文件末尾；要离开末尾，先让簇链覆盖整个文件
+    if (file_handle->delay_len > 0) {
+        if (target_position != file_handle->file_position) {
+            fat32_error_t result =
+                fat32_file_flush(g_fat32_context.disk, &g_fat32_context.fs_info, file_handle);
+            if (result != FAT32_OK) {
+                return result;
+            }
+        } else {
+            if (new_position != NULL) {
+                *new_position = target_position;
+            }
+            return FAT32_OK;
+        }
+    }
 
-    // 重新计算当前簇和偏移（简化实现）
+    // 重新计算当前簇和偏移：在区段表中查找目标位置所在的簇
     if (target_position == 0 || file_handle->first_cluster < 2) {
         file_handle->current_cluster = file_handle->first_cluster;
         file_handle->cluster_offset  = 0;
     } else {
-        // 简化实现：重置到文件开头，实际应该优化定位算法
-        file_handle->current_cluster = file_handle->first_cluster;
-        file_handle->cluster_offset  = target_position % 4096;  // 使用固定的簇大小
+        const fat32_fs_info_t *fs_info = &g_fat32_context.fs_info;
+        uint32_t               bpc     = fs_info->bytes_per_cluster;
+        uint32_t               index   = target_position / bpc;
+        uint32_t               offset  = target_position % bpc;
+
+        // 恰好在簇边界上的文件末尾：停在上一簇的末尾，写入时再扩展簇链
+        if (offset == 0 && target_position == file_handle->file_size) {
+            index--;
+            offset = bpc;
+        }
+
+        uint32_t      cluster;
+        fat32_error_t result = fat32_file_map_cluster(g_fat32_context.disk,
+                                                      fs_info,
+                                                      file_handle,
+                                                      index,
+                                                      &cluster,
+                                                      NULL);
+        if (result != FAT32_OK) {
+            return result;
+        }
+        file_handle->current_cluster = cluster;
+        file_handle->cluster_offset  = offset;
     }
 
+    // 更新文件位置
+    file_handle->file_position = target_position;
+
     if (new_position != NULL) {
         *new_position = target_position;
     }
@@ -817,29 +1007,49 @@ fat32_file_read_cluster_data(fat32_disk_t          *disk,
         return FAT32_OK;
     }
 
-    // 分配簇缓冲区
-    uint8_t *cluster_buffer =
-        (uint8_t *) kalloc_pages((fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
-    if (cluster_buffer == NULL) {
-        return FAT32_ERROR_DISK_ERROR;
-    }
+    // 整扇区直接读进调用者缓冲区，只有不足一个扇区的头尾经过中转
+    uint32_t      sector = fat32_boot_cluster_to_sector(fs_info, cluster_num) +
+                           offset / FAT32_SECTOR_SIZE;
+    uint32_t      skip   = offset % FAT32_SECTOR_SIZE;
+    uint32_t      left   = bytes_to_read;
+    uint8_t      *dst    = (uint8_t *) buffer;
+    uint8_t       partial[FAT32_SECTOR_SIZE];
+    fat32_error_t result;
 
-    // 计算簇对应的扇区
-    uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
+    while (left > 0) {
+        if (skip == 0 && left >= FAT32_SECTOR_SIZE) {
+            uint32_t count = left / FAT32_SECTOR_SIZE;
+            // 读整簇时不进缓存，零散的扇区照常缓存
+            if (count == fs_info->sectors_per_cluster) {
+                result = fat32_cache_read_direct(disk, sector, count, dst);
+            } else {
+                result = fat32_cache_read_sectors(disk, sector, count, dst);
+            }
+            if (result != FAT32_OK) {
+                return result;
+            }
+            sector += count;
+            dst += count * FAT32_SECTOR_SIZE;
+            left -= count * FAT32_SECTOR_SIZE;
+            continue;
+        }
 
-    // 读取整个簇
-    fat32_error_t result =
-        fat32_disk_read_sectors(disk, first_sector, fs_info->sectors_per_cluster, cluster_buffer);
-    if (result != FAT32_OK) {
-        kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
-        return result;
+        uint32_t n = FAT32_SECTOR_SIZE - skip;
+        if (n > left) {
+            n = left;
+        }
+        result = fat32_cache_read_sectors(disk, sector, 1, partial);
+        if (result != FAT32_OK) {
+            return result;
+        }
+        memcpy(dst, partial + skip, n);
+        sector++;
+        dst += n;
+        left -= n;
+        skip = 0;
     }
 
-    // 复制所需的数据
-    memcpy(buffer, cluster_buffer + offset, bytes_to_read);
     *bytes_read = bytes_to_read;
-
-    kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
     return FAT32_OK;
 }
 
@@ -875,44 +1085,48 @@ fat32_file_write_cluster_data(fat32_disk_t    *disk,
         return FAT32_OK;
     }
 
-    // 分配簇缓冲区
-    uint8_t *cluster_buffer =
-        (uint8_t *) kalloc_pages((fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
-    if (cluster_buffer == NULL) {
-        return FAT32_ERROR_DISK_ERROR;
-    }
-
-    // 计算簇对应的扇区
-    uint32_t first_sector = fat32_boot_cluster_to_sector(fs_info, cluster_num);
+    // 只改写涉及的扇区：整扇区直接从调用者缓冲区写入缓存，不足一个扇区的头尾先读出原内容
+    uint32_t       sector = fat32_boot_cluster_to_sector(fs_info, cluster_num) +
+                            offset / FAT32_SECTOR_SIZE;
+    uint32_t       skip   = offset % FAT32_SECTOR_SIZE;
+    uint32_t       left   = bytes_to_write;
+    const uint8_t *src    = (const uint8_t *) buffer;
+    uint8_t        partial[FAT32_SECTOR_SIZE];
+    fat32_error_t  result;
 
-    fat32_error_t result;
+    while (left > 0) {
+        if (skip == 0 && left >= FAT32_SECTOR_SIZE) {
+            uint32_t count = left / FAT32_SECTOR_SIZE;
+            result         = fat32_cache_write_sectors(disk, sector, count, src);
+            if (result != FAT32_OK) {
+                return result;
+            }
+            sector += count;
+            src += count * FAT32_SECTOR_SIZE;
+            left -= count * FAT32_SECTOR_SIZE;
+            continue;
+        }
 
-    // 如果不是写整个簇，需要先读取原有数据
-    if (offset != 0 || bytes_to_write != fs_info->bytes_per_cluster) {
-        result = fat32_disk_read_sectors(disk,
-                                         first_sector,
-                                         fs_info->sectors_per_cluster,
-                                         cluster_buffer);
+        uint32_t n = FAT32_SECTOR_SIZE - skip;
+        if (n > left) {
+            n = left;
+        }
+        result = fat32_cache_read_sectors(disk, sector, 1, partial);
         if (result != FAT32_OK) {
-            kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
             return result;
         }
-    }
-
-    // 复制新数据
-    memcpy(cluster_buffer + offset, buffer, bytes_to_write);
-
-    // 写回整个簇
-    result =
-        fat32_disk_write_sectors(disk, first_sector, fs_info->sectors_per_cluster, cluster_buffer);
-    if (result != FAT32_OK) {
-        kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
-        return result;
+        memcpy(partial + skip, src, n);
+        result = fat32_cache_write_sectors(disk, sector, 1, partial);
+        if (result != FAT32_OK) {
+            return result;
+        }
+        sector++;
+        src += n;
+        left -= n;
+        skip = 0;
     }
 
     *bytes_written = bytes_to_write;
-
-    kfree_pages(cluster_buffer, (fs_info->bytes_per_cluster + PAGE_SIZE - 1) / PAGE_SIZE);
     return FAT32_OK;
 }
 
@@ -945,46 +1159,98 @@ fat32_file_extend_if_needed(fat32_disk_t        *disk,
         return FAT32_OK;  // 当前簇数足够
     }
 
-    uint32_t clusters_to_add = required_clusters - current_clusters;
-
     if (file_handle->first_cluster < 2) {
-        // 文件还没有分配簇，分配第一个簇链
+        // 文件还没有分配簇，按最终大小一次分配
         return fat32_fat_allocate_cluster_chain(disk,
                                                 fs_info,
                                                 required_clusters,
                                                 &file_handle->first_cluster);
-    } else {
-        // 找到簇链的最后一个簇
-        uint32_t last_cluster = file_handle->first_cluster;
-        uint32_t next_cluster;
+    }
 
-        while (1) {
-            fat32_error_t result =
-                fat32_fat_get_next_cluster(disk, fs_info, last_cluster, &next_cluster);
-            if (result != FAT32_OK) {
-                return result;
-            }
+    // 区段表补到簇链末尾就得到最后一个簇；预分配过的文件簇链可能已经够长
+    fat32_error_t result = fat32_file_map_extend(disk, fs_info, file_handle);
+    if (result != FAT32_OK) {
+        return result;
+    }
 
-            if (next_cluster == 0) {
-                break;  // 找到最后一个簇
-            }
+    uint32_t chain_length = file_handle->mapped_clusters;
+    if (chain_length >= required_clusters) {
+        return FAT32_OK;
+    }
+
+    const fat32_extent_t *tail         = &file_handle->extents[file_handle->extent_count - 1];
+    uint32_t              last_cluster = tail->cluster + tail->length - 1;
+
+    // 在簇链末尾按段追加，尽量紧接最后一个簇
+    return fat32_fat_append_clusters(disk,
+                                     fs_info,
+                                     last_cluster,
+                                     required_clusters - chain_length,
+                                     NULL);
+}
+
+// 只保留簇链的前 keep_clusters 个簇，其余释放；keep_clusters 为 0 时释放整条链
+static fat32_error_t
+fat32_file_release_tail(fat32_disk_t        *disk,
+                        fat32_fs_info_t     *fs_info,
+                        fat32_file_handle_t *file_handle,
+                        uint32_t             keep_clusters)
+{
+    if (file_handle->first_cluster < 2) {
+        return FAT32_OK;
+    }
+
+    // 簇链要被截短，区段表作废
+    fat32_file_map_reset(file_handle);
+
+    if (keep_clusters == 0) {
+        fat32_error_t result =
+            fat32_fat_free_cluster_chain(disk, fs_info, file_handle->first_cluster);
+        if (result != FAT32_OK) {
+            return result;
+        }
+        file_handle->first_cluster   = 0;
+        file_handle->current_cluster = 0;
+        file_handle->cluster_offset  = 0;
+        return FAT32_OK;
+    }
+
+    // 找到第keep_clusters个簇
+    uint32_t current_cluster = file_handle->first_cluster;
+    uint32_t cluster_index   = 0;
 
-            last_cluster = next_cluster;
+    while (current_cluster >= 2 && cluster_index < keep_clusters - 1) {
+        uint32_t      next_cluster;
+        fat32_error_t result =
+            fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
+        if (result != FAT32_OK) {
+            return result;
         }
 
-        // 在簇链末尾添加新簇
-        for (uint32_t i = 0; i < clusters_to_add; i++) {
-            uint32_t      new_cluster;
-            fat32_error_t result =
-                fat32_fat_extend_cluster_chain(disk, fs_info, last_cluster, &new_cluster);
-            if (result != FAT32_OK) {
-                return result;
-            }
-            last_cluster = new_cluster;
+        if (next_cluster == 0) {
+            break;  // 簇链结束
         }
+
+        current_cluster = next_cluster;
+        cluster_index++;
     }
 
-    return FAT32_OK;
+    // 获取要释放的簇链
+    uint32_t      next_cluster;
+    fat32_error_t result =
+        fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
+    if (result != FAT32_OK || next_cluster == 0) {
+        return result;
+    }
+
+    // 将当前簇标记为簇链结束
+    result = fat32_fat_write_entry(disk, fs_info, current_cluster, FAT32_EOC_MAX);
+    if (result != FAT32_OK) {
+        return result;
+    }
+
+    // 释放后续簇
+    return fat32_fat_free_cluster_chain(disk, fs_info, next_cluster);
 }
 
 static fat32_error_t
@@ -1116,6 +1382,7 @@ fat32_file_delete(fat32_disk_t *disk, fat32_fs_info_t *fs_info, const char *file
     // 释放文件占用的簇
     uint32_t first_cluster = fat32_dir_get_first_cluster(&dir_entry);
     if (first_cluster >= 2) {
+        fat32_pagecache_invalidate(first_cluster);
         result = fat32_fat_free_cluster_chain(disk, fs_info, first_cluster);
         if (result != FAT32_OK) {
             return result;
@@ -1137,7 +1404,7 @@ fat32_file_rename(fat32_disk_t    *disk,
     return FAT32_ERROR_ACCESS_DENIED;
 }
 
-// not implemented
+// 为延迟分配的尾部数据分配簇并写入磁盘
 fat32_error_t
 fat32_file_flush(fat32_disk_t *disk, fat32_fs_info_t *fs_info, fat32_file_handle_t *file_handle)
 {
@@ -1149,12 +1416,92 @@ fat32_file_flush(fat32_disk_t *disk, fat32_fs_info_t *fs_info, fat32_file_handle
         return FAT32_ERROR_INVALID_PARAM;
     }
 
-    // 简化实现中没有缓存，直接返回成功
-    // 实际实现中需要将缓存的数据写入磁盘
+    if (file_handle->delay_len == 0) {
+        return FAT32_OK;
+    }
+
+    // 延迟的数据从簇链末尾（簇边界）开始，到文件末尾结束
+    uint32_t      bpc    = fs_info->bytes_per_cluster;
+    uint32_t      index  = (file_handle->file_size - file_handle->delay_len) / bpc;
+    uint32_t      needed = (file_handle->file_size + bpc - 1) / bpc;
+    fat32_error_t result;
+
+    // 最终长度已知，一次分配全部簇；上次刷新中途失败时簇可能已经分配过
+    if (file_handle->first_cluster < 2) {
+        result = fat32_fat_allocate_cluster_chain(disk,
+                                                  fs_info,
+                                                  needed,
+                                                  &file_handle->first_cluster);
+    } else {
+        result = fat32_file_map_extend(disk, fs_info, file_handle);
+        if (result == FAT32_OK && file_handle->mapped_clusters < needed) {
+            const fat32_extent_t *tail = &file_handle->extents[file_handle->extent_count - 1];
+
+            result = fat32_fat_append_clusters(disk,
+                                               fs_info,
+                                               tail->cluster + tail->length - 1,
+                                               needed - file_handle->mapped_clusters,
+                                               NULL);
+        }
+    }
+    if (result != FAT32_OK) {
+        return result;
+    }
 
+    // 按区段成块写入缓存，最后一个扇区不足的部分补零
+    uint32_t len = file_handle->delay_len;
+    uint32_t pad = (FAT32_SECTOR_SIZE - len % FAT32_SECTOR_SIZE) % FAT32_SECTOR_SIZE;
+    memset(file_handle->delay_buf + len, 0, pad);
+    for (uint32_t done = 0; done < len;) {
+        uint32_t cluster, run;
+        result = fat32_file_map_cluster(disk, fs_info, file_handle, index, &cluster, &run);
+        if (result != FAT32_OK) {
+            return result;
+        }
+
+        uint32_t bytes = run * bpc < len - done ? run * bpc : len - done;
+
+        result = fat32_cache_write_sectors(disk,
+                                           fat32_boot_cluster_to_sector(fs_info, cluster),
+                                           (bytes + FAT32_SECTOR_SIZE - 1) / FAT32_SECTOR_SIZE,
+                                           file_handle->delay_buf + done);
+        if (result != FAT32_OK) {
+            return result;
+        }
+        done += bytes;
+        index += run;
+    }
+    file_handle->delay_len = 0;
+
+    // 位置仍在文件末尾，按 fat32_file_seek 的约定停在最后一簇的簇尾
+    uint32_t cluster;
+    index  = (file_handle->file_size - 1) / bpc;
+    result = fat32_file_map_cluster(disk, fs_info, file_handle, index, &cluster, NULL);
+    if (result != FAT32_OK) {
+        return result;
+    }
+    file_handle->current_cluster = cluster;
+    file_handle->cluster_offset  = file_handle->file_size - index * bpc;
     return FAT32_OK;
 }
 
+fat32_error_t
+fat32_file_flush_all(fat32_disk_t *disk, fat32_fs_info_t *fs_info)
+{
+    fat32_error_t result = FAT32_OK;
+
+    for (int i = 0; i < FAT32_MAX_OPEN_FILES; i++) {
+        if (!g_file_handles[i].in_use || g_file_handles[i].delay_len == 0) {
+            continue;
+        }
+        fat32_error_t r = fat32_file_flush(disk, fs_info, &g_file_handles[i]);
+        if (r != FAT32_OK && result == FAT32_OK) {
+            result = r;
+        }
+    }
+    return result;
+}
+
 fat32_error_t
 fat32_file_stat(fat32_disk_t          *disk,
                 const fat32_fs_info_t *fs_info,
@@ -1203,6 +1550,11 @@ fat32_file_truncate(fat32_disk_t        *disk,
         return FAT32_ERROR_ACCESS_DENIED;
     }
 
+    fat32_error_t result = fat32_file_flush(disk, fs_info, file_handle);
+    if (result != FAT32_OK) {
+        return result;
+    }
+
     if (new_size == file_handle->file_size) {
         return FAT32_OK;  // 无需改变
     }
@@ -1213,66 +1565,12 @@ fat32_file_truncate(fat32_disk_t        *disk,
     }
 
     // 缩小文件
-    if (new_size == 0) {
-        // 截断为空文件，释放所有簇
-        if (file_handle->first_cluster >= 2) {
-            fat32_error_t result =
-                fat32_fat_free_cluster_chain(disk, fs_info, file_handle->first_cluster);
-            if (result != FAT32_OK) {
-                return result;
-            }
-            file_handle->first_cluster = 0;
-        }
-        file_handle->current_cluster = 0;
-        file_handle->cluster_offset  = 0;
-    } else {
-        // 计算新文件大小需要的簇数
-        uint32_t clusters_needed =
-            (new_size + fs_info->bytes_per_cluster - 1) / fs_info->bytes_per_cluster;
-
-        // 找到第clusters_needed个簇
-        uint32_t current_cluster = file_handle->first_cluster;
-        uint32_t cluster_index   = 0;
-
-        while (current_cluster >= 2 && cluster_index < clusters_needed - 1) {
-            uint32_t      next_cluster;
-            fat32_error_t result =
-                fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
-            if (result != FAT32_OK) {
-                return result;
-            }
-
-            if (next_cluster == 0) {
-                break;  // 簇链结束
-            }
-
-            current_cluster = next_cluster;
-            cluster_index++;
-        }
-
-        if (current_cluster >= 2) {
-            // 获取要释放的簇链
-            uint32_t      next_cluster;
-            fat32_error_t result =
-                fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
-            if (result != FAT32_OK) {
-                return result;
-            }
-
-            // 将当前簇标记为簇链结束
-            result = fat32_fat_write_entry(disk, fs_info, current_cluster, FAT32_EOC_MAX);
-            if (result != FAT32_OK) {
-                return result;
-            }
-
-            // 释放后续簇
-            if (next_cluster >= 2) {
-                result = fat32_fat_free_cluster_chain(disk, fs_info, next_cluster);
-                if (result != FAT32_OK) {
-                    return result;
-                }
-            }
-        }
+    fat32_pagecache_invalidate(file_handle->first_cluster);
+    uint32_t clusters_needed =
+        (new_size + fs_info->bytes_per_cluster - 1) / fs_info->bytes_per_cluster;
+    result = fat32_file_release_tail(disk, fs_info, file_handle, clusters_needed);
+    if (result != FAT32_OK) {
+        return result;
     }
 
     // 更新文件大小
@@ -1288,12 +1586,13 @@ fat32_file_truncate(fat32_disk_t        *disk,
             file_handle->current_cluster = file_handle->first_cluster;
             file_handle->cluster_offset  = 0;
         } else {
-            uint32_t      cluster_index = file_handle->file_position / fs_info->bytes_per_cluster;
-            fat32_error_t result        = fat32_fat_get_cluster_at_index(disk,
-                                                                  fs_info,
-                                                                  file_handle->first_cluster,
-                                                                  cluster_index,
-                                                                  &file_handle->current_cluster);
+            uint32_t cluster_index = file_handle->file_position / fs_info->bytes_per_cluster;
+            result                 = fat32_file_map_cluster(disk,
+                                            fs_info,
+                                            file_handle,
+                                            cluster_index,
+                                            &file_handle->current_cluster,
+                                            NULL);
             if (result == FAT32_OK) {
                 file_handle->cluster_offset =
                     file_handle->file_position % fs_info->bytes_per_cluster;
@@ -1304,89 +1603,332 @@ fat32_file_truncate(fat32_disk_t        *disk,
     return FAT32_OK;
 }
 
+fat32_error_t
+fat32_file_preallocate(fat32_disk_t        *disk,
+                       fat32_fs_info_t     *fs_info,
+                       fat32_file_handle_t *file_handle,
+                       uint32_t             size)
+{
+    avatar_assert(disk != NULL);
+    avatar_assert(fs_info != NULL);
+    avatar_assert(file_handle != NULL);
+
+    if (!fat32_file_is_valid_handle(file_handle)) {
+        return FAT32_ERROR_INVALID_PARAM;
+    }
+
+    if (!fat32_file_is_writable(file_handle)) {
+        return FAT32_ERROR_ACCESS_DENIED;
+    }
+
+    fat32_error_t result = fat32_file_flush(disk, fs_info, file_handle);
+    if (result != FAT32_OK) {
+        return result;
+    }
+
+    // 按最终大小一次分配，之后的写入不再逐簇扩展
+    uint32_t first = file_handle->first_cluster;
+    result         = fat32_file_extend_if_needed(disk, fs_info, file_handle, size);
+    if (result != FAT32_OK) {
+        return result;
+    }
+
+    if (size > file_handle->file_size) {
+        file_handle->preallocated = 1;
+    }
+    // 新分配了首簇时要写回目录项
+    if (file_handle->first_cluster != first) {
+        file_handle->modified = 1;
+    }
+
+    return FAT32_OK;
+}
+
 /**
- * 多簇批量读取函数 - 性能优化
+ * 分散读取整簇
+ *
+ * 从第 cluster_index 簇起读 cluster_count 个整簇。区段表给出每段物理连续的簇，
+ * 每段对应一个磁盘段，碎片文件的多个段攒成一批交给缓存层一起提交，设备上同时
+ * 有多个请求在途，不再因为簇不连续而退回逐簇读。簇链比预期短时读到链尾为止。
+ *
+ * last_cluster 返回读到的最后一簇，调用者据此停在簇尾。
  */
 static fat32_error_t
 fat32_file_read_multi_clusters(fat32_disk_t          *disk,
                                const fat32_fs_info_t *fs_info,
-                               uint32_t               start_cluster,
+                               fat32_file_handle_t   *file_handle,
+                               uint32_t               cluster_index,
+                               uint32_t               cluster_count,
                                void                  *buffer,
-                               uint32_t               max_bytes,
-                               uint32_t              *bytes_read,
-                               uint32_t              *next_cluster)
+                               uint32_t              *clusters_read,
+                               uint32_t              *last_cluster)
 {
     avatar_assert(disk != NULL);
     avatar_assert(fs_info != NULL);
     avatar_assert(buffer != NULL);
-    avatar_assert(bytes_read != NULL);
-    avatar_assert(next_cluster != NULL);
+    avatar_assert(clusters_read != NULL);
+    avatar_assert(last_cluster != NULL);
 
-    *bytes_read   = 0;
-    *next_cluster = start_cluster;
+    fat32_disk_seg_t segs[FAT32_CACHE_SG_SEGS];
+    uint32_t         nsegs = 0;
+    uint32_t         done  = 0;
+    fat32_error_t    result;
 
-    if (!fat32_fat_is_valid_cluster(fs_info, start_cluster)) {
-        return FAT32_ERROR_INVALID_PARAM;
+    *clusters_read = 0;
+
+    while (done < cluster_count) {
+        uint32_t index = cluster_index + done;
+        uint32_t cluster;
+        uint32_t run;
+
+        result = fat32_file_map_cluster(disk, fs_info, file_handle, index, &cluster, &run);
+        if (result == FAT32_ERROR_END_OF_FILE) {
+            break;
+        }
+        if (result != FAT32_OK) {
+            return result;
+        }
+        if (run > cluster_count - done) {
+            run = cluster_count - done;
+        }
+
+        segs[nsegs].sector = fat32_boot_cluster_to_sector(fs_info, cluster);
+        segs[nsegs].count  = run * fs_info->sectors_per_cluster;
+        segs[nsegs].buffer = (uint8_t *) buffer + done * fs_info->bytes_per_cluster;
+        nsegs++;
+
+        done += run;
+        *last_cluster = cluster + run - 1;
+
+        if (nsegs == FAT32_CACHE_SG_SEGS) {
+            result = fat32_cache_read_segments(disk, segs, nsegs);
+            if (result != FAT32_OK) {
+                return result;
+            }
+            nsegs = 0;
+        }
     }
 
-    // 计算最多可以读取多少个簇
-    uint32_t max_clusters = max_bytes / fs_info->bytes_per_cluster;
-    if (max_clusters == 0) {
-        return FAT32_OK;
+    if (nsegs > 0) {
+        result = fat32_cache_read_segments(disk, segs, nsegs);
+        if (result != FAT32_OK) {
+            return result;
+        }
     }
 
-    // 限制最大批量读取数量
-    const uint32_t MAX_BATCH_CLUSTERS = 32;
-    if (max_clusters > MAX_BATCH_CLUSTERS) {
-        max_clusters = MAX_BATCH_CLUSTERS;
+    *clusters_read = done;
+    return FAT32_OK;
+}
+
+/**
+ * 顺序预读
+ *
+ * 磁盘读是同步的，小块顺序读每次都要等一次完整的设备往返。读位置紧接上次读的末尾时
+ * 视为顺序读，在消费者追到已预读区域的后半段之前，把后面一个窗口的数据成块读进缓存，
+ * 之后的读直接命中缓存。每发起一次预读窗口翻倍，直到 FAT32_READAHEAD_MAX；
+ * 一旦出现随机访问窗口清零，重新从 FAT32_READAHEAD_MIN 开始。
+ */
+static void
+fat32_file_readahead(fat32_disk_t          *disk,
+                     const fat32_fs_info_t *fs_info,
+                     fat32_file_handle_t   *file_handle,
+                     uint32_t               size)
+{
+    uint32_t pos = file_handle->file_position;
+
+    if (pos != file_handle->ra_next) {
+        file_handle->ra_window = 0;
+        file_handle->ra_end    = 0;
     }
+    file_handle->ra_next = pos + size;
 
-    // 检查连续的簇
-    uint32_t current_cluster      = start_cluster;
-    uint32_t consecutive_clusters = 1;
-    uint32_t expected_next        = start_cluster + 1;
+    // 大块读本身已经合并成大的磁盘请求
+    if (size >= FAT32_READAHEAD_MAX) {
+        return;
+    }
+
+    if (file_handle->ra_window == 0) {
+        file_handle->ra_window = FAT32_READAHEAD_MIN;
+    }
+    if (file_handle->ra_end >= file_handle->file_size ||
+        (file_handle->ra_end > pos + size &&
+         file_handle->ra_end - (pos + size) >= file_handle->ra_window / 2)) {
+        return;
+    }
+
+    uint32_t start = file_handle->ra_end > pos ? file_handle->ra_end : pos;
+    uint32_t end   = file_handle->file_size;
+    if (end - (pos + size) > file_handle->ra_window) {
+        end = pos + size + file_handle->ra_window;
+    }
+    file_handle->ra_end = end;
+    if (file_handle->ra_window < FAT32_READAHEAD_MAX) {
+        file_handle->ra_window *= 2;
+    }
 
-    for (uint32_t i = 1; i < max_clusters; i++) {
-        uint32_t      next;
-        fat32_error_t result = fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next);
-        if (result != FAT32_OK || next < 2) {
-            break;  // 簇链结束或错误
+    // 按区段拆成磁盘上连续的若干段，预读失败只是少了缓存，留给真正的读报告错误
+    uint32_t index = start / fs_info->bytes_per_cluster;
+    uint32_t last  = (end - 1) / fs_info->bytes_per_cluster;
+    while (start < end && index <= last) {
+        uint32_t cluster, run;
+        if (fat32_file_map_cluster(disk, fs_info, file_handle, index, &cluster, &run) != FAT32_OK) {
+            break;
         }
+        if (run > last - index + 1) {
+            run = last - index + 1;
+        }
+        if (fat32_cache_prefetch(disk,
+                                 fat32_boot_cluster_to_sector(fs_info, cluster),
+                                 run * fs_info->sectors_per_cluster) != FAT32_OK) {
+            break;
+        }
+        index += run;
+    }
+}
+
+/**
+ * 立即分配簇并写入数据
+ */
+static fat32_error_t
+fat32_file_write_direct(fat32_disk_t        *disk,
+                        fat32_fs_info_t     *fs_info,
+                        fat32_file_handle_t *file_handle,
+                        const void          *buffer,
+                        uint32_t             size,
+                        uint32_t            *bytes_written)
+{
+    // 计算写入后的文件大小
+    uint32_t start_position = file_handle->file_position;
+    uint32_t end_position   = file_handle->file_position + size;
 
-        // 检查是否连续
-        if (next == expected_next) {
-            consecutive_clusters++;
-            current_cluster = next;
-            expected_next   = next + 1;
+    // 如果需要扩展文件，先分配足够的簇
+    if (end_position > file_handle->file_size) {
+        fat32_error_t result =
+            fat32_file_extend_if_needed(disk, fs_info, file_handle, end_position);
+        if (result != FAT32_OK) {
+            return result;
+        }
+    }
+
+    const uint8_t *write_buffer    = (const uint8_t *) buffer;
+    uint32_t       total_written   = 0;
+    uint32_t       current_cluster = file_handle->current_cluster;
+    uint32_t       cluster_offset  = file_handle->cluster_offset;
+
+    // 如果文件为空或当前簇无效，需要分配第一个簇
+    if (current_cluster < 2) {
+        if (file_handle->first_cluster < 2) {
+            // 分配第一个簇
+            fat32_error_t result = fat32_fat_allocate_cluster(disk, fs_info, &current_cluster);
+            if (result != FAT32_OK) {
+                return result;
+            }
+            file_handle->first_cluster   = current_cluster;
+            file_handle->current_cluster = current_cluster;
         } else {
-            // 不连续，停止批量读取
+            current_cluster              = file_handle->first_cluster;
+            file_handle->current_cluster = current_cluster;
+        }
+        cluster_offset              = 0;
+        file_handle->cluster_offset = 0;
+    }
+
+    while (total_written < size && current_cluster >= 2) {
+        fat32_error_t result;
+
+        // 当前簇已写满才移到下一个簇，簇链到头时再分配，写到簇边界为止不会多分配一个簇
+        if (cluster_offset >= fs_info->bytes_per_cluster) {
+            uint32_t next_cluster;
+            result = fat32_fat_get_next_cluster(disk, fs_info, current_cluster, &next_cluster);
+            if (result != FAT32_OK) {
+                break;
+            }
+
+            if (next_cluster == 0) {
+                // 需要分配新簇
+                result =
+                    fat32_fat_extend_cluster_chain(disk, fs_info, current_cluster, &next_cluster);
+                if (result != FAT32_OK) {
+                    break;
+                }
+            }
+
+            current_cluster = next_cluster;
+            cluster_offset  = 0;
+        }
+
+        uint32_t bytes_in_cluster     = size - total_written;
+        uint32_t remaining_in_cluster = fs_info->bytes_per_cluster - cluster_offset;
+
+        if (bytes_in_cluster > remaining_in_cluster) {
+            bytes_in_cluster = remaining_in_cluster;
+        }
+
+        uint32_t cluster_bytes_written;
+        result = fat32_file_write_cluster_data(disk,
+                                               fs_info,
+                                               current_cluster,
+                                               cluster_offset,
+                                               write_buffer + total_written,
+                                               bytes_in_cluster,
+                                               &cluster_bytes_written);
+        if (result != FAT32_OK) {
             break;
         }
+
+        total_written += cluster_bytes_written;
+        cluster_offset += cluster_bytes_written;
+
+        if (cluster_bytes_written < bytes_in_cluster) {
+            break;  // 写入不完整
+        }
     }
 
-    if (consecutive_clusters > 1) {
-        // 可以进行批量读取
-        uint32_t first_sector  = fat32_boot_cluster_to_sector(fs_info, start_cluster);
-        uint32_t total_sectors = consecutive_clusters * fs_info->sectors_per_cluster;
-        uint32_t total_bytes   = consecutive_clusters * fs_info->bytes_per_cluster;
+    // 更新文件句柄状态
+    file_handle->file_position += total_written;
+    file_handle->current_cluster = current_cluster;
+    file_handle->cluster_offset  = cluster_offset;
 
-        // 只在大批量读取时显示信息
-        // if (consecutive_clusters >= 32) {
-        //     logger_info("FAT32: Large multi-cluster read: %u clusters (%u KB) from cluster %u\n",
-        //                 consecutive_clusters,
-        //                 total_bytes / 1024,
-        //                 start_cluster);
-        // }
+    // 更新文件大小
+    if (file_handle->file_position > file_handle->file_size) {
+        file_handle->file_size = file_handle->file_position;
+    }
 
-        fat32_error_t result = fat32_disk_read_sectors(disk, first_sector, total_sectors, buffer);
-        if (result == FAT32_OK) {
-            *bytes_read = total_bytes;
-            // 设置下一个簇
-            fat32_fat_get_next_cluster(disk, fs_info, current_cluster, next_cluster);
+    // 标记文件为已修改，已缓存的页同步更新
+    if (total_written > 0) {
+        file_handle->modified = 1;
+        fat32_pagecache_update(file_handle, start_position, buffer, total_written);
+    }
+
+    *bytes_written = total_written;
+    return FAT32_OK;
+}
+
+/**
+ * 延迟分配
+ *
+ * 小块追加写超出簇链的部分先放进句柄的缓冲区，既不分配簇也不写缓存。刷新时文件的
+ * 最终长度已经确定，一次分配所需的簇并成块写入。有延迟数据时 file_position 总等于
+ * file_size，current_cluster 和 cluster_offset 在刷新前无效；定位、截断、预分配、
+ * 关闭和 sync 都会先刷新。
+ */
+static fat32_error_t
+fat32_file_delay_append(fat32_file_handle_t *file_handle, const uint8_t *buffer, uint32_t size)
+{
+    if (file_handle->delay_buf == NULL) {
+        file_handle->delay_buf = (uint8_t *) kalloc_pages(FAT32_DELALLOC_MAX / PAGE_SIZE);
+        if (file_handle->delay_buf == NULL) {
+            return FAT32_ERROR_NO_SPACE;
         }
-        return result;
     }
 
-    // 回退到单簇读取
-    return FAT32_ERROR_NOT_FOUND;  // 表示无法批量读取
+    uint32_t start_position = file_handle->file_position;
+
+    memcpy(file_handle->delay_buf + file_handle->delay_len, buffer, size);
+    file_handle->delay_len += size;
+    file_handle->file_position += size;
+    file_handle->file_size = file_handle->file_position;
+    file_handle->modified  = 1;
+    fat32_pagecache_update(file_handle, start_position, buffer, size);
+    return FAT32_OK;
 }
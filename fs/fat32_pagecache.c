@@ -0,0 +1,273 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file fat32_pagecache.c
+ * @brief FAT32文件页缓存实现
+ *
+ * 每个缓存的文件保存一份私有的只读句柄，缺页时用它定位读取。页框一旦映射到
+ * 进程就不能回收，所以只回收引用计数为零的文件；失效但仍被映射的文件从查找表中
+ * 摘下，等最后一个映射解除时再释放。
+ */
+
+#include "fs/fat32.h"
+#include "fs/fat32_pagecache.h"
+#include "lib/avatar_string.h"
+#include "mem/mem.h"
+#include "mem/kallocator.h"
+#include "io.h"
+
+struct _fat32_pagecache_t
+{
+    fat32_file_handle_t handle;  // 私有只读句柄
+    uint32_t            first_cluster;
+    uint32_t            refs;
+    uint32_t            npages;  // pages 数组长度
+    uint32_t            cached;  // 已读入的页数
+    uint64_t            last_use;
+    bool                in_use;
+    bool                stale;  // 已失效，只等引用归零
+    void              **pages;
+};
+
+static fat32_pagecache_t g_pagecache[FAT32_PAGECACHE_FILES];
+static uint32_t          g_pagecache_pages;
+static uint64_t          g_pagecache_clock;
+
+static uint32_t
+pagecache_npages(uint32_t size)
+{
+    return (size + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+static void
+pagecache_free(fat32_pagecache_t *pc)
+{
+    for (uint32_t i = 0; i < pc->npages; i++) {
+        if (pc->pages[i])
+            kfree_pages(pc->pages[i], 1);
+    }
+    g_pagecache_pages -= pc->cached;
+    if (pc->pages)
+        kfree(pc->pages);
+    fat32_file_map_reset(&pc->handle);
+    memset(pc, 0, sizeof(*pc));
+}
+
+// pages 数组跟随文件大小增长
+static bool
+pagecache_grow(fat32_pagecache_t *pc, uint32_t npages)
+{
+    if (npages <= pc->npages)
+        return true;
+
+    void **pages = kalloc(npages * sizeof(void *), 8);
+    if (!pages)
+        return false;
+
+    memset(pages, 0, npages * sizeof(void *));
+    if (pc->pages) {
+        memcpy(pages, pc->pages, pc->npages * sizeof(void *));
+        kfree(pc->pages);
+    }
+    pc->pages  = pages;
+    pc->npages = npages;
+    return true;
+}
+
+// 回收最久未用、没有引用的文件，返回是否回收了
+static bool
+pagecache_evict_one(const fat32_pagecache_t *keep)
+{
+    fat32_pagecache_t *victim = NULL;
+
+    for (int i = 0; i < FAT32_PAGECACHE_FILES; i++) {
+        fat32_pagecache_t *pc = &g_pagecache[i];
+        if (!pc->in_use || pc->refs || pc == keep)
+            continue;
+        if (!victim || pc->last_use < victim->last_use)
+            victim = pc;
+    }
+
+    if (!victim)
+        return false;
+    pagecache_free(victim);
+    return true;
+}
+
+static fat32_pagecache_t *
+pagecache_lookup(uint32_t first_cluster)
+{
+    for (int i = 0; i < FAT32_PAGECACHE_FILES; i++) {
+        fat32_pagecache_t *pc = &g_pagecache[i];
+        if (pc->in_use && !pc->stale && pc->first_cluster == first_cluster)
+            return pc;
+    }
+    return NULL;
+}
+
+fat32_pagecache_t *
+fat32_pagecache_get(fat32_file_handle_t *file_handle)
+{
+    // 延迟分配的数据要先有簇，私有句柄才能读到
+    if (fat32_file_flush(g_fat32_context.disk, &g_fat32_context.fs_info, file_handle) != FAT32_OK)
+        return NULL;
+    if (file_handle->first_cluster < 2 || file_handle->file_size == 0)
+        return NULL;
+
+    fat32_pagecache_t *pc = pagecache_lookup(file_handle->first_cluster);
+    if (!pc) {
+        for (int i = 0; i < FAT32_PAGECACHE_FILES && !pc; i++) {
+            if (!g_pagecache[i].in_use)
+                pc = &g_pagecache[i];
+        }
+        if (!pc && pagecache_evict_one(NULL)) {
+            for (int i = 0; i < FAT32_PAGECACHE_FILES && !pc; i++) {
+                if (!g_pagecache[i].in_use)
+                    pc = &g_pagecache[i];
+            }
+        }
+        if (!pc) {
+            logger_warn("FAT32: page cache full, %s not cached\n", file_handle->filename);
+            return NULL;
+        }
+
+        memset(pc, 0, sizeof(*pc));
+        pc->handle                 = *file_handle;
+        pc->handle.flags           = FAT32_O_RDONLY;
+        pc->handle.modified        = 0;
+        pc->handle.file_position   = 0;
+        pc->handle.current_cluster = file_handle->first_cluster;
+        pc->handle.cluster_offset  = 0;
+        pc->first_cluster          = file_handle->first_cluster;
+        // 区段表属于原句柄，私有句柄自己建立
+        pc->handle.extents         = NULL;
+        pc->handle.extent_count    = 0;
+        pc->handle.extent_pages    = 0;
+        pc->handle.mapped_clusters = 0;
+        pc->handle.ra_next         = 0;
+        pc->handle.ra_end          = 0;
+        pc->handle.ra_window       = 0;
+        pc->handle.delay_buf       = NULL;
+        pc->handle.delay_len       = 0;
+        pc->in_use                 = true;
+
+        if (!pagecache_grow(pc, pagecache_npages(file_handle->file_size))) {
+            memset(pc, 0, sizeof(*pc));
+            return NULL;
+        }
+    }
+
+    pc->refs++;
+    pc->last_use = ++g_pagecache_clock;
+    return pc;
+}
+
+void
+fat32_pagecache_hold(fat32_pagecache_t *pc)
+{
+    pc->refs++;
+}
+
+void
+fat32_pagecache_put(fat32_pagecache_t *pc)
+{
+    if (--pc->refs == 0 && pc->stale)
+        pagecache_free(pc);
+}
+
+void *
+fat32_pagecache_page(fat32_pagecache_t *pc, uint32_t index)
+{
+    uint32_t size = pc->handle.file_size;
+
+    if (index >= pagecache_npages(size) || !pagecache_grow(pc, pagecache_npages(size)))
+        return NULL;
+
+    pc->last_use = ++g_pagecache_clock;
+    if (pc->pages[index])
+        return pc->pages[index];
+
+    if (g_pagecache_pages >= FAT32_PAGECACHE_MAX_PAGES)
+        pagecache_evict_one(pc);
+
+    uint8_t *page = kalloc_pages(1);
+    if (!page)
+        return NULL;
+
+    uint32_t pos  = index * PAGE_SIZE;
+    uint32_t want = size - pos < PAGE_SIZE ? size - pos : PAGE_SIZE;
+    uint32_t got  = 0;
+
+    if (fat32_file_seek(&pc->handle, (int32_t) pos, FAT32_SEEK_SET, NULL) != FAT32_OK ||
+        fat32_file_read(g_fat32_context.disk,
+                        &g_fat32_context.fs_info,
+                        &pc->handle,
+                        page,
+                        want,
+                        &got) != FAT32_OK ||
+        got != want) {
+        logger_warn("FAT32: page cache read of %s page %u failed\n", pc->handle.filename, index);
+        kfree_pages(page, 1);
+        return NULL;
+    }
+    memset(page + got, 0, PAGE_SIZE - got);
+
+    pc->pages[index] = page;
+    pc->cached++;
+    g_pagecache_pages++;
+    return page;
+}
+
+uint32_t
+fat32_pagecache_size(const fat32_pagecache_t *pc)
+{
+    return pc->handle.file_size;
+}
+
+void
+fat32_pagecache_update(const fat32_file_handle_t *file_handle,
+                       uint32_t                   pos,
+                       const void                *buffer,
+                       uint32_t                   size)
+{
+    fat32_pagecache_t *pc = pagecache_lookup(file_handle->first_cluster);
+    if (!pc || size == 0)
+        return;
+
+    if (file_handle->file_size > pc->handle.file_size)
+        pc->handle.file_size = file_handle->file_size;
+
+    const uint8_t *src = (const uint8_t *) buffer;
+    uint32_t       end = pos + size;
+
+    // 只更新已读入的页，其余的页以后从磁盘读到的就是新数据
+    for (uint32_t index = pos / PAGE_SIZE; index < pc->npages && index * PAGE_SIZE < end;
+         index++) {
+        uint8_t *page = pc->pages[index];
+        if (!page)
+            continue;
+
+        uint32_t page_start = index * PAGE_SIZE;
+        uint32_t from       = pos > page_start ? pos - page_start : 0;
+        uint32_t to         = end - page_start < PAGE_SIZE ? end - page_start : PAGE_SIZE;
+        memcpy(page + from, src + (page_start + from - pos), to - from);
+    }
+}
+
+void
+fat32_pagecache_invalidate(uint32_t first_cluster)
+{
+    fat32_pagecache_t *pc = pagecache_lookup(first_cluster);
+    if (!pc)
+        return;
+
+    if (pc->refs == 0) {
+        pagecache_free(pc);
+    } else {
+        // 进程还映射着这些页，先摘下，最后一个引用释放时回收
+        pc->stale = true;
+    }
+}
@@ -29,17 +29,21 @@ typedef struct {
     const char *initrd_path;    // initrd文件路径（可选）
     bool        needs_dtb;      // 是否需要DTB
     bool        needs_initrd;   // 是否需要initrd
+    bool        lazy_initrd;    // initrd按需加载（stage-2缺页时才从文件读入）
 } guest_files_t;
 
 // Guest 运行时配置
 typedef struct {
-    guest_type_t    type;           // Guest类型
-    const char     *name;           // Guest名称
-    uint64_t        bin_loadaddr;   // 内核加载地址
-    uint64_t        dtb_loadaddr;   // DTB加载地址
-    uint64_t        fs_loadaddr;    // initrd加载地址
-    uint32_t        smp_num;        // vCPU数量
-    guest_files_t   files;          // 文件路径配置
+    guest_type_t        type;              // Guest类型
+    const char         *name;              // Guest名称
+    uint64_t            bin_loadaddr;      // 内核加载地址
+    uint64_t            dtb_loadaddr;      // DTB加载地址
+    uint64_t            fs_loadaddr;       // initrd加载地址
+    uint32_t            smp_num;           // vCPU数量
+    uint32_t            isolated_cpus;     // 独占的pCPU位图，0表示与其他任务共享pCPU
+    const char *const  *boot_markers;      // 启动阶段控制台标记，NULL结尾（可选）
+    const char         *userspace_marker;  // 该标记所在行之后的输出视为用户态输出（可选）
+    guest_files_t       files;             // 文件路径配置
 } guest_manifest_t;
 
 // Guest 加载结果
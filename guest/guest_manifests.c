@@ -1,17 +1,29 @@
 #include "guest_manifest.h"
 
+// Linux 启动阶段的控制台标记，用于 guest boottime
+static const char *const linux_boot_markers[] = {"Booting Linux on physical CPU",
+                                                 "Memory: ",
+                                                 "smp: Brought up",
+                                                 "Freeing unused kernel memory",
+                                                 "Run /init as init process",
+                                                 NULL};
+
 // Linux Guest配置
-static const guest_manifest_t linux_manifest = {.type         = GUEST_TYPE_LINUX,
-                                                .name         = "Linux",
-                                                .bin_loadaddr = 0x70200000UL,
-                                                .dtb_loadaddr = 0x70000000UL,
-                                                .fs_loadaddr  = 0x78000000UL,
-                                                .smp_num      = 1,
-                                                .files = {.kernel_path  = "/GUESTS/LINUX/LINUX.BIN",
-                                                          .dtb_path     = "/GUESTS/LINUX/LINUX.DTB",
-                                                          .initrd_path  = "/GUESTS/LINUX/INITRD.GZ",
-                                                          .needs_dtb    = true,
-                                                          .needs_initrd = true}};
+static const guest_manifest_t linux_manifest = {
+    .type             = GUEST_TYPE_LINUX,
+    .name             = "Linux",
+    .bin_loadaddr     = 0x70200000UL,
+    .dtb_loadaddr     = 0x70000000UL,
+    .fs_loadaddr      = 0x78000000UL,
+    .smp_num          = 1,
+    .boot_markers     = linux_boot_markers,
+    .userspace_marker = "Run /init as init process",
+    .files            = {.kernel_path  = "/GUESTS/LINUX/LINUX.BIN",
+                         .dtb_path     = "/GUESTS/LINUX/LINUX.DTB",
+                         .initrd_path  = "/GUESTS/LINUX/INITRD.GZ",
+                         .needs_dtb    = true,
+                         .needs_initrd = true,
+                         .lazy_initrd  = true}};
 
 // NimbOS Guest配置
 static const guest_manifest_t nimbos_manifest = {
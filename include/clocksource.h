@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file clocksource.h
+ * @brief Implementation of clocksource.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __CLOCKSOURCE_H__
+#define __CLOCKSOURCE_H__
+
+#include "avatar_types.h"
+#include "time_page.h"
+#include "mem/page.h"
+
+// 时间页基准的刷新周期，(cycles - cycle_base) * mult 在此期间不会溢出
+#define CLOCKSOURCE_UPDATE_SEC 1
+// 计算 mult/shift 时允许的最大未刷新时间
+#define CLOCKSOURCE_MAX_SEC 600
+
+void
+clocksource_init(void);
+void
+clocksource_init_local(void);
+
+uint64_t
+clocksource_cyc2ns(uint64_t cycles);
+uint64_t
+ktime_get_ns(void);
+uint64_t
+ktime_get_real_ns(void);
+void
+clocksource_set_realtime(uint64_t real_ns);
+
+int32_t
+clocksource_map_time_page(pte_t *page_dir);
+
+#endif  // __CLOCKSOURCE_H__
@@ -14,6 +14,8 @@
 #ifndef _ELF
 #define _ELF
 
+#include "avatar_types.h"
+
 #pragma pack(1)
 
 // ELF Header
@@ -24,6 +26,11 @@
 #define EM_AARCH64 183 /* ARM 64-bit architecture (AARCH64) */
 #define PT_LOAD    1   // 可加载类型
 
+// 段标志 p_flags
+#define PF_X 0x1  // 可执行
+#define PF_W 0x2  // 可写
+#define PF_R 0x4  // 可读
+
 // ELF 头部和程序头部定义（AArch64版）
 typedef struct
 {
@@ -57,4 +64,16 @@ typedef struct
 
 #pragma pack()
 
+// 只做 pro.c/pro_exec.c 加载需要的检查：AArch64 可执行文件且带程序头
+static inline bool
+elf_header_valid(const Elf64_Ehdr *hdr)
+{
+    if (hdr->e_ident[0] != ELF_MAGIC || hdr->e_ident[1] != 'E' || hdr->e_ident[2] != 'L' ||
+        hdr->e_ident[3] != 'F')
+        return false;
+    if (hdr->e_type != ET_EXEC || hdr->e_machine != EM_AARCH64 || hdr->e_entry == 0)
+        return false;
+    return hdr->e_phentsize != 0 && hdr->e_phoff != 0;
+}
+
 #endif  // _ELF
\ No newline at end of file
@@ -22,7 +22,8 @@
 #define ESR_EC_HVC           0x16  // HVC instruction execution
 #define ESR_EC_SMC           0x17  // SMC instruction execution
 #define ESR_EC_SYSREG        0x18  // System register access
-#define ESR_EC_ILLEGAL_STATE 0x20  // Illegal Execution State
+#define ESR_EC_ILLEGAL_STATE 0x0E  // Illegal Execution State
+#define ESR_EC_INST_ABORT    0x20  // Instruction Abort from lower EL
 #define ESR_EC_DATA_ABORT    0x24  // Data Abort from lower EL
 
 typedef struct
@@ -124,16 +125,14 @@ union esr_el2 {
 
     struct esr_sysreg
     {
-        uint32_t op2 : 3;       /* Op2 */
-        uint32_t op1 : 3;       /* Op1 */
-        uint32_t crn : 4;       /* CRn */
-        uint32_t rt : 5;        /* Rt */
+        uint32_t direction : 1; /* Direction (0=MSR, 1=MRS) */
         uint32_t crm : 4;       /* CRm */
-        uint32_t direction : 1; /* Direction (0=MRS, 1=MSR) */
+        uint32_t rt : 5;        /* Rt */
+        uint32_t crn : 4;       /* CRn */
+        uint32_t op1 : 3;       /* Op1 */
+        uint32_t op2 : 3;       /* Op2 */
         uint32_t op0 : 2;       /* Op0 */
         uint32_t res0 : 3;      /* Reserved */
-        uint32_t cc : 4;        /* Condition Code */
-        uint32_t ccvalid : 1;   /* CC Valid */
         uint32_t len : 1;       /* Instruction length */
         uint32_t ec : 6;        /* Exception Class */
     } sysreg;                   /* ESR_EC_SYSREG */
@@ -176,6 +175,14 @@ read_esr_el1(void)
     return esr;
 }
 
+static inline uint64_t
+read_far_el1(void)
+{
+    uint64_t far;
+    __asm__ volatile("mrs %0, far_el1" : "=r"(far));
+    return far;
+}
+
 static inline uint32_t
 read_esr_el2(void)
 {
@@ -230,9 +237,24 @@ advance_pc(union esr_el2 *esr, trap_frame_t *context);
 void
 advance_pc_legacy(stage2_fault_info_t *info, trap_frame_t *context);
 
+// Maximum number of interrupt vectors
+#define MAX_IRQ_VECTORS 512
+
+// 中断处理函数属性
+#define IRQ_F_PREEMPTIBLE (1U << 0)  // 处理期间打开 IRQ，允许更高优先级的中断抢占
+
 void
 irq_install(int32_t vector, void (*h)(uint64_t *));
+void
+irq_install_prio(int32_t vector, irq_handler_t h, uint32_t prio, uint32_t flags);
+uint32_t
+irq_get_flags(int32_t vector);
+void
+irq_steer_spis(uint32_t cpu_mask, int32_t cpu);
 irq_handler_t *
 get_g_handler_vec();
 
+uint32_t
+el2_irq_depth(void);
+
 #endif  // __ECCEPTION_FRAME_H__
\ No newline at end of file
@@ -120,6 +120,14 @@ fat32_mount(void);
 fat32_error_t
 fat32_unmount(void);
 
+/**
+ * @brief 把缓存中的脏数据和FSInfo写回磁盘
+ * 
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_sync(void);
+
 /**
  * @brief 清理FAT32文件系统
  * 
@@ -130,6 +138,19 @@ fat32_unmount(void);
 fat32_error_t
 fat32_cleanup(void);
 
+/**
+ * @brief 串行化文件系统访问
+ *
+ * FAT32 各层本身不加锁。本文件的对外接口（fat32_open/read/write/stat/sync 等）
+ * 自己持有这把锁；直接调用 fat32_file_*、fat32_dir_* 或页缓存的调用者要在前后
+ * 持有它。锁可递归，持有者可以再次获取。竞争时会调度出去，不能在中断或 EL2 陷入处理中调用。
+ */
+void
+fat32_lock(void);
+
+void
+fat32_unlock(void);
+
 /* ============================================================================
  * 兼容性接口函数（与ramfs接口兼容）
  * ============================================================================ */
@@ -183,6 +204,16 @@ fat32_read(int32_t fd, void *buf, size_t count);
 size_t
 fat32_write(int32_t fd, const void *buf, size_t count);
 
+/**
+ * @brief 预分配文件空间（兼容接口）
+ *
+ * @param fd 文件描述符
+ * @param size 预计的文件大小
+ * @return int32_t 0表示成功，-1表示失败
+ */
+int32_t
+fat32_preallocate(int32_t fd, size_t size);
+
 /**
  * @brief 定位文件指针（兼容接口）
  * 
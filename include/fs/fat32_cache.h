@@ -12,16 +12,16 @@
 
 /**
  * @file fat32_cache.h
- * @brief FAT32缓存管理头文件
- * 
- * 本文件定义了FAT32文件系统的缓存管理功能。
- * 为了简化实现，当前版本提供基本的缓存接口，但实际缓存功能有限。
- * 主要用于保持代码结构的完整性，便于将来扩展。
- * 
- * 简化说明：
- * - 当前实现主要是接口占位，实际缓存逻辑较简单
- * - 重点在于提供统一的缓存访问接口
- * - 可以在此基础上扩展更复杂的缓存策略
+ * @brief FAT32缓冲区缓存头文件
+ *
+ * 以扇区为单位缓存磁盘内容，FAT、目录和文件数据的扇区读写都经过这里。
+ *
+ * 设计说明：
+ * - 按扇区号散列查找，LRU 链表侵入在缓冲区头中，命中时 O(1) 移到链尾
+ * - 写入只修改缓冲区并标记为脏，在淘汰、脏缓冲过多或 sync 时写回磁盘
+ * - 写回时把扇区号连续的脏缓冲合并成一次磁盘写
+ * - 超长的连续未命中直接在调用者缓冲区和磁盘之间传输，不挤占缓存
+ * - 文件顺序读时由文件层调用 fat32_cache_prefetch 成块预读
  */
 
 #ifndef FAT32_CACHE_H
@@ -29,43 +29,59 @@
 
 #include "fat32_types.h"
 #include "fat32_disk.h"
+#include "lib/list.h"
+#include "spinlock.h"
 
 /* ============================================================================
  * 缓存配置常量
  * ============================================================================ */
 
-#define FAT32_CACHE_SIZE       16    // 缓存块数量
-#define FAT32_CACHE_BLOCK_SIZE 4096  // 缓存块大小（一个簇）
+#ifndef FAT32_CACHE_SIZE_MB
+#define FAT32_CACHE_SIZE_MB 8  // 缓存总大小（MB），可在编译时覆盖
+#endif
 
-/* 缓存块状态 */
-#define FAT32_CACHE_CLEAN 0  // 干净（与磁盘同步）
-#define FAT32_CACHE_DIRTY 1  // 脏（需要写回磁盘）
-#define FAT32_CACHE_FREE  2  // 空闲
+#define FAT32_CACHE_BUFFERS        (FAT32_CACHE_SIZE_MB * 1024 * 1024 / FAT32_SECTOR_SIZE)
+#define FAT32_CACHE_HASH_BUCKETS   4096  // 2 的幂
+#define FAT32_CACHE_BYPASS_SECTORS 256   // 连续未命中超过该扇区数时绕过缓存
+#define FAT32_CACHE_WB_BATCH       64    // 一次写回合并的最大扇区数
+#define FAT32_CACHE_RA_BATCH       256   // 预读一次磁盘读的最大扇区数
+#define FAT32_CACHE_SG_SEGS        16    // 分散读一次提交给磁盘的最大段数
+#define FAT32_CACHE_DIRTY_LIMIT    (FAT32_CACHE_BUFFERS / 4)  // 脏缓冲超过该值时整体写回
 
 /* ============================================================================
  * 缓存数据结构
  * ============================================================================ */
 
 /**
- * @brief 缓存块结构
+ * @brief 扇区缓冲区
  */
-typedef struct
+typedef struct _fat32_buf_t
 {
-    uint32_t cluster_num;  // 缓存的簇号
-    uint8_t *data;         // 缓存数据
-    uint8_t  status;       // 缓存状态
-    uint32_t access_time;  // 最后访问时间（简化的LRU）
-    uint8_t  in_use;       // 是否在使用中
-} fat32_cache_block_t;
+    uint32_t             sector;     // 缓存的扇区号
+    uint8_t              dirty;      // 是否需要写回
+    uint8_t              in_use;     // 是否在散列表中
+    struct _fat32_buf_t *hash_next;  // 散列桶链
+    list_node_t          lru_node;   // LRU 链表节点，链首最久未用
+    uint8_t             *data;       // FAT32_SECTOR_SIZE 字节
+} fat32_buf_t;
 
 /**
  * @brief 缓存管理器结构
  */
 typedef struct
 {
-    fat32_cache_block_t blocks[FAT32_CACHE_SIZE];  // 缓存块数组
-    uint32_t            access_counter;            // 访问计数器
-    uint8_t             initialized;               // 初始化标志
+    fat32_buf_t  *bufs;         // 缓冲区头数组
+    fat32_buf_t **hash;         // 散列桶
+    list_t        lru;          // 所有在用的缓冲区
+    uint32_t      nbufs;        // 已启用的缓冲区数，按需增长到 capacity
+    uint32_t      capacity;     // 缓冲区总数
+    uint32_t      dirty_count;  // 脏缓冲区数
+    uint64_t      hits;         // 命中扇区数
+    uint64_t      misses;       // 未命中扇区数
+    uint64_t      writebacks;   // 写回磁盘的次数
+    uint64_t      readahead;    // 预读进缓存的扇区数
+    spinlock_t    lock;         // 进程和 guest 缺页都可能读盘
+    uint8_t       initialized;  // 初始化标志
 } fat32_cache_manager_t;
 
 /* ============================================================================
@@ -74,9 +90,9 @@ typedef struct
 
 /**
  * @brief 初始化缓存管理器
- * 
- * 分配缓存内存并初始化缓存管理结构。
- * 
+ *
+ * 分配缓冲区头和散列表，数据区在使用时按页分配。
+ *
  * @param cache_mgr 缓存管理器指针
  * @return fat32_error_t 错误码
  */
@@ -85,9 +101,9 @@ fat32_cache_init(fat32_cache_manager_t *cache_mgr);
 
 /**
  * @brief 清理缓存管理器
- * 
- * 刷新所有脏缓存块并释放内存。
- * 
+ *
+ * 刷新所有脏缓冲区并释放内存。
+ *
  * @param cache_mgr 缓存管理器指针
  * @param disk 磁盘句柄
  * @param fs_info 文件系统信息
@@ -99,96 +115,119 @@ fat32_cache_cleanup(fat32_cache_manager_t *cache_mgr,
                     const fat32_fs_info_t *fs_info);
 
 /**
- * @brief 读取簇数据（通过缓存）
- * 
- * 从缓存中读取簇数据，如果缓存中没有则从磁盘读取。
- * 
- * @param cache_mgr 缓存管理器指针
+ * @brief 经缓存读取扇区
+ *
+ * 与 fat32_disk_read_sectors 用法相同。命中的扇区从缓存复制，连续未命中的扇区合并成
+ * 一次磁盘读。缓存未初始化时直接读磁盘。
+ *
  * @param disk 磁盘句柄
- * @param fs_info 文件系统信息
- * @param cluster_num 簇号
+ * @param sector_num 起始扇区号
+ * @param sector_count 扇区数量
  * @param buffer 数据缓冲区
  * @return fat32_error_t 错误码
  */
 fat32_error_t
-fat32_cache_read_cluster(fat32_cache_manager_t *cache_mgr,
-                         fat32_disk_t          *disk,
-                         const fat32_fs_info_t *fs_info,
-                         uint32_t               cluster_num,
-                         void                  *buffer);
+fat32_cache_read_sectors(fat32_disk_t *disk,
+                         uint32_t      sector_num,
+                         uint32_t      sector_count,
+                         void         *buffer);
 
 /**
- * @brief 写入簇数据（通过缓存）
- * 
- * 将数据写入缓存，标记为脏块。
- * 
- * @param cache_mgr 缓存管理器指针
+ * @brief 读取扇区，未命中的部分直接读进调用者缓冲区且不进缓存
+ *
+ * 用于整簇以上的文件数据读：已缓存的扇区（包括尚未写回的脏扇区）照常从缓存复制，
+ * 其余扇区由设备直接读进 buffer，不经过中转也不挤占缓存。
+ *
  * @param disk 磁盘句柄
- * @param fs_info 文件系统信息
- * @param cluster_num 簇号
+ * @param sector_num 起始扇区号
+ * @param sector_count 扇区数量
  * @param buffer 数据缓冲区
  * @return fat32_error_t 错误码
  */
 fat32_error_t
-fat32_cache_write_cluster(fat32_cache_manager_t *cache_mgr,
-                          fat32_disk_t          *disk,
-                          const fat32_fs_info_t *fs_info,
-                          uint32_t               cluster_num,
-                          const void            *buffer);
+fat32_cache_read_direct(fat32_disk_t *disk,
+                        uint32_t      sector_num,
+                        uint32_t      sector_count,
+                        void         *buffer);
 
 /**
- * @brief 刷新缓存
- * 
- * 将所有脏缓存块写回磁盘。
- * 
- * @param cache_mgr 缓存管理器指针
+ * @brief 分散读取多段扇区，未命中的部分直接读进调用者缓冲区且不进缓存
+ *
+ * 与 fat32_cache_read_direct 相同，但各段在磁盘上不必相邻：所有段中未命中的扇区
+ * 合在一起，每 FAT32_CACHE_SG_SEGS 段交给磁盘层一次。
+ *
  * @param disk 磁盘句柄
- * @param fs_info 文件系统信息
+ * @param segs 段数组
+ * @param nsegs 段数
  * @return fat32_error_t 错误码
  */
 fat32_error_t
-fat32_cache_flush(fat32_cache_manager_t *cache_mgr,
-                  fat32_disk_t          *disk,
-                  const fat32_fs_info_t *fs_info);
+fat32_cache_read_segments(fat32_disk_t *disk, const fat32_disk_seg_t *segs, uint32_t nsegs);
 
 /**
- * @brief 刷新指定簇的缓存
- * 
- * 将指定簇的缓存块写回磁盘（如果是脏块）。
- * 
- * @param cache_mgr 缓存管理器指针
+ * @brief 经缓存写入扇区
+ *
+ * 与 fat32_disk_write_sectors 用法相同。数据写入缓存并标记为脏，延迟写回；
+ * 超过 FAT32_CACHE_BYPASS_SECTORS 的写直接写盘，同时更新已缓存的扇区。
+ *
  * @param disk 磁盘句柄
- * @param fs_info 文件系统信息
- * @param cluster_num 簇号
+ * @param sector_num 起始扇区号
+ * @param sector_count 扇区数量
+ * @param buffer 数据缓冲区
  * @return fat32_error_t 错误码
  */
 fat32_error_t
-fat32_cache_flush_cluster(fat32_cache_manager_t *cache_mgr,
-                          fat32_disk_t          *disk,
-                          const fat32_fs_info_t *fs_info,
-                          uint32_t               cluster_num);
+fat32_cache_write_sectors(fat32_disk_t *disk,
+                          uint32_t      sector_num,
+                          uint32_t      sector_count,
+                          const void   *buffer);
 
 /**
- * @brief 使缓存块无效
- * 
- * 将指定簇的缓存块标记为无效，强制下次从磁盘重新读取。
- * 
+ * @brief 把扇区预读进缓存
+ *
+ * 已缓存的扇区跳过，其余按连续段成块读入，不论长度都进缓存。只是提示，
+ * 缓存未初始化时什么也不做。
+ *
+ * @param disk 磁盘句柄
+ * @param sector_num 起始扇区号
+ * @param sector_count 扇区数量
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_cache_prefetch(fat32_disk_t *disk, uint32_t sector_num, uint32_t sector_count);
+
+/**
+ * @brief 刷新缓存
+ *
+ * 将所有脏缓冲区写回磁盘。
+ *
  * @param cache_mgr 缓存管理器指针
- * @param cluster_num 簇号
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
  * @return fat32_error_t 错误码
  */
 fat32_error_t
-fat32_cache_invalidate_cluster(fat32_cache_manager_t *cache_mgr, uint32_t cluster_num);
+fat32_cache_flush(fat32_cache_manager_t *cache_mgr,
+                  fat32_disk_t          *disk,
+                  const fat32_fs_info_t *fs_info);
+
+/**
+ * @brief 丢弃所有缓冲区（包括脏缓冲区）
+ *
+ * 磁盘被绕过缓存整体改写（如格式化）后调用。
+ *
+ * @param cache_mgr 缓存管理器指针
+ */
+void
+fat32_cache_invalidate_all(fat32_cache_manager_t *cache_mgr);
 
 /**
  * @brief 获取缓存统计信息
- * 
- * 获取缓存的命中率、脏块数量等统计信息。
- * 
+ *
  * @param cache_mgr 缓存管理器指针
- * @param total_blocks 返回总缓存块数
- * @param used_blocks 返回已使用的缓存块数
- * @param dirty_blocks 返回脏缓存块数
+ * @param total_blocks 返回缓冲区总数
+ * @param used_blocks 返回已使用的缓冲区数
+ * @param dirty_blocks 返回脏缓冲区数
  * @return fat32_error_t 错误码
  */
 fat32_error_t
@@ -203,7 +242,7 @@ fat32_cache_get_stats(const fat32_cache_manager_t *cache_mgr,
 
 /**
  * @brief 检查缓存管理器是否已初始化
- * 
+ *
  * @param cache_mgr 缓存管理器指针
  * @return uint8_t 1表示已初始化，0表示未初始化
  */
@@ -213,59 +252,13 @@ fat32_cache_is_initialized(const fat32_cache_manager_t *cache_mgr)
     return (cache_mgr != NULL && cache_mgr->initialized);
 }
 
-/**
- * @brief 检查缓存块是否为脏块
- * 
- * @param block 缓存块指针
- * @return uint8_t 1表示脏块，0表示干净块
- */
-static inline uint8_t
-fat32_cache_is_dirty_block(const fat32_cache_block_t *block)
-{
-    return (block->status == FAT32_CACHE_DIRTY);
-}
-
-/**
- * @brief 检查缓存块是否空闲
- * 
- * @param block 缓存块指针
- * @return uint8_t 1表示空闲，0表示已使用
- */
-static inline uint8_t
-fat32_cache_is_free_block(const fat32_cache_block_t *block)
-{
-    return (block->status == FAT32_CACHE_FREE);
-}
-
-/**
- * @brief 标记缓存块为脏块
- * 
- * @param block 缓存块指针
- */
-static inline void
-fat32_cache_mark_dirty(fat32_cache_block_t *block)
-{
-    block->status = FAT32_CACHE_DIRTY;
-}
-
-/**
- * @brief 标记缓存块为干净块
- * 
- * @param block 缓存块指针
- */
-static inline void
-fat32_cache_mark_clean(fat32_cache_block_t *block)
-{
-    block->status = FAT32_CACHE_CLEAN;
-}
-
 /* ============================================================================
  * 全局缓存管理器访问函数
  * ============================================================================ */
 
 /**
  * @brief 获取全局缓存管理器实例
- * 
+ *
  * @return fat32_cache_manager_t* 缓存管理器指针
  */
 fat32_cache_manager_t *
@@ -273,7 +266,7 @@ fat32_get_cache_manager(void);
 
 /**
  * @brief 初始化全局缓存管理器
- * 
+ *
  * @return fat32_error_t 错误码
  */
 fat32_error_t
@@ -281,7 +274,7 @@ fat32_init_global_cache(void);
 
 /**
  * @brief 清理全局缓存管理器
- * 
+ *
  * @param disk 磁盘句柄
  * @param fs_info 文件系统信息
  * @return fat32_error_t 错误码
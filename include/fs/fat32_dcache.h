@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file fat32_dcache.h
+ * @brief Implementation of fat32_dcache.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef FAT32_DCACHE_H
+#define FAT32_DCACHE_H
+
+#include "fat32_types.h"
+
+/* ============================================================================
+ * 目录项缓存
+ *
+ * 按（父目录起始簇号，8.3 短名）缓存目录项及其在目录中的序号，查找不存在的
+ * 名字时记一条负项。路径解析、打开文件和 shell 切换目录重复查找同一个名字时
+ * 不再逐项读目录。
+ *
+ * 目录项的所有修改都经过 fat32_dir_write_entry，由它调用 fat32_dcache_update
+ * 保持缓存一致；删除目录时丢弃以它为父目录的全部缓存项。
+ *
+ * 所有接口都要求调用者持有 fat32_lock。
+ * ============================================================================ */
+
+#define FAT32_DCACHE_ENTRIES 512  // 缓存项总数
+#define FAT32_DCACHE_BUCKETS 256  // 2 的幂
+
+typedef enum
+{
+    FAT32_DCACHE_MISS = 0,  // 未缓存，需要读目录
+    FAT32_DCACHE_HIT,       // 目录项存在
+    FAT32_DCACHE_NEGATIVE,  // 已确认目录中没有这个名字
+} fat32_dcache_result_t;
+
+/**
+ * @brief 查找目录项
+ *
+ * @param parent 父目录起始簇号
+ * @param short_name 11 字节短名
+ * @param dir_entry 命中时返回目录项
+ * @param entry_index 命中时返回目录项序号，可为 NULL
+ */
+fat32_dcache_result_t
+fat32_dcache_lookup(uint32_t           parent,
+                    const uint8_t     *short_name,
+                    fat32_dir_entry_t *dir_entry,
+                    uint32_t          *entry_index);
+
+/**
+ * @brief 记录一次目录查找的结果
+ *
+ * @param dir_entry 找到的目录项，NULL 表示目录中没有这个名字
+ */
+void
+fat32_dcache_insert(uint32_t                 parent,
+                    const uint8_t           *short_name,
+                    const fat32_dir_entry_t *dir_entry,
+                    uint32_t                 entry_index);
+
+/**
+ * @brief 目录项已被改写
+ *
+ * 旧名字变成负项，新内容若是有效目录项则更新为正项。
+ *
+ * @param old_entry 改写前的目录项
+ * @param new_entry 改写后的目录项
+ */
+void
+fat32_dcache_update(uint32_t                 parent,
+                    uint32_t                 entry_index,
+                    const fat32_dir_entry_t *old_entry,
+                    const fat32_dir_entry_t *new_entry);
+
+/**
+ * @brief 丢弃父目录为 parent 的全部缓存项
+ *
+ * 目录被删除、簇号可能被重新使用时调用。
+ */
+void
+fat32_dcache_invalidate_dir(uint32_t parent);
+
+/**
+ * @brief 清空缓存，挂载、卸载和格式化时调用
+ */
+void
+fat32_dcache_clear(void);
+
+/**
+ * @brief 打印命中统计
+ */
+void
+fat32_dcache_print_stats(void);
+
+#endif  // FAT32_DCACHE_H
@@ -53,6 +53,18 @@
  * 磁盘状态结构
  * ============================================================================ */
 
+/**
+ * @brief 分散读的一段
+ *
+ * 从 sector 开始的 count 个扇区读进 buffer。
+ */
+typedef struct
+{
+    uint32_t sector;  // 起始扇区号
+    uint32_t count;   // 扇区数量
+    void    *buffer;  // 数据缓冲区
+} fat32_disk_seg_t;
+
 /**
  * @brief 虚拟磁盘状态结构
  * 
@@ -119,6 +131,19 @@ fat32_disk_read_sectors(fat32_disk_t *disk,
                         uint32_t      sector_count,
                         void         *buffer);
 
+/**
+ * @brief 分散读取多段扇区
+ *
+ * 各段在磁盘上不必相邻。VirtIO 块设备上所有段作为一批请求提交，只等待一次。
+ *
+ * @param disk 磁盘状态结构指针
+ * @param segs 段数组
+ * @param nsegs 段数
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_disk_read_segments(fat32_disk_t *disk, const fat32_disk_seg_t *segs, uint32_t nsegs);
+
 /**
  * @brief 写入磁盘扇区
  * 
@@ -29,6 +29,45 @@
 #include "fat32_types.h"
 #include "fat32_disk.h"
 
+#ifndef FAT32_FAT_PRELOAD_KB
+#define FAT32_FAT_PRELOAD_KB 4096  // FAT 不超过该大小时挂载时整表读入，否则按页读入
+#endif
+
+/* ============================================================================
+ * 内存FAT表管理函数
+ * ============================================================================ */
+
+/**
+ * @brief 挂载时建立内存中的FAT表
+ *
+ * 表项读写之后都在内存中进行，需要在 fat32_fat_table_flush 时写回。
+ * 同时建立空闲簇位图，并按扫描结果重新计算 free_cluster_count。
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_fat_table_load(fat32_disk_t *disk, fat32_fs_info_t *fs_info);
+
+/**
+ * @brief 把修改过的FAT扇区写回所有FAT副本
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_fat_table_flush(fat32_disk_t *disk, const fat32_fs_info_t *fs_info);
+
+/**
+ * @brief 释放内存中的FAT表
+ *
+ * 未写回的修改会丢失，卸载时应先调用 fat32_fat_table_flush。
+ */
+void
+fat32_fat_table_release(void);
+
 /* ============================================================================
  * FAT表操作函数
  * ============================================================================ */
@@ -93,7 +132,7 @@ fat32_fat_write_entry(fat32_disk_t          *disk,
  * @return fat32_error_t 错误码
  * 
  * 功能说明：
- * - 从next_free_cluster开始查找空闲簇
+ * - 从next_free_cluster开始在空闲簇位图中按字查找空闲簇
  * - 将找到的簇标记为簇链结束
  * - 更新FSInfo中的空闲簇信息
  */
@@ -130,7 +169,7 @@ fat32_fat_free_cluster(fat32_disk_t *disk, fat32_fs_info_t *fs_info, uint32_t cl
  * @return fat32_error_t 错误码
  * 
  * 功能说明：
- * - 分配指定数量的簇
+ * - 分配指定数量的簇，按最佳适配尽量整段连续分配
  * - 将簇连接成链表
  * - 最后一个簇标记为簇链结束
  */
@@ -140,6 +179,48 @@ fat32_fat_allocate_cluster_chain(fat32_disk_t    *disk,
                                  uint32_t         cluster_count,
                                  uint32_t        *first_cluster);
 
+/**
+ * @brief 分配一段连续的簇
+ *
+ * goal 空闲时从 goal 开始分配，否则在空闲簇位图中找不短于 max_count 的最短空闲段；
+ * 没有这么长的段时取最长的一段。分配出的簇连接成一条以簇链结束标记收尾的链。
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @param goal 希望的起始簇号，0 表示不指定
+ * @param max_count 最多分配的簇数
+ * @param first_cluster 返回第一个簇的簇号
+ * @param count 返回实际分配的簇数，至少为 1
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_fat_allocate_extent(fat32_disk_t    *disk,
+                          fat32_fs_info_t *fs_info,
+                          uint32_t         goal,
+                          uint32_t         max_count,
+                          uint32_t        *first_cluster,
+                          uint32_t        *count);
+
+/**
+ * @brief 在簇链末尾追加簇
+ *
+ * 按段分配 cluster_count 个簇接到 last_cluster 之后，每段都优先紧接上一段。
+ * 失败时这次追加的簇全部释放，原簇链不变。
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @param last_cluster 簇链的最后一个簇，0 表示新建簇链
+ * @param cluster_count 追加的簇数
+ * @param first_new 返回追加的第一个簇，可以为 NULL
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_fat_append_clusters(fat32_disk_t    *disk,
+                          fat32_fs_info_t *fs_info,
+                          uint32_t         last_cluster,
+                          uint32_t         cluster_count,
+                          uint32_t        *first_new);
+
 /**
  * @brief 释放簇链
  * 
@@ -35,6 +35,10 @@
 
 #define FAT32_MAX_OPEN_FILES 32  // 最大同时打开的文件数
 
+#define FAT32_READAHEAD_MIN (16 * 1024)   // 初始预读窗口
+#define FAT32_READAHEAD_MAX (512 * 1024)  // 预读窗口上限，不小于它的读请求本身就是大块读
+#define FAT32_DELALLOC_MAX  (64 * 1024)   // 每个句柄延迟分配缓冲的上限，页大小的整数倍
+
 /* 文件打开标志 */
 #define FAT32_O_RDONLY 0x01  // 只读
 #define FAT32_O_WRONLY 0x02  // 只写
@@ -165,7 +169,7 @@ fat32_file_tell(const fat32_file_handle_t *file_handle);
 /**
  * @brief 刷新文件缓存
  * 
- * 将文件的缓存数据写入磁盘。
+ * 为延迟分配的数据分配簇并写入缓冲区缓存。磁盘写回由 fat32_sync 统一完成。
  * 
  * @param disk 磁盘句柄
  * @param fs_info 文件系统信息
@@ -175,6 +179,68 @@ fat32_file_tell(const fat32_file_handle_t *file_handle);
 fat32_error_t
 fat32_file_flush(fat32_disk_t *disk, fat32_fs_info_t *fs_info, fat32_file_handle_t *file_handle);
 
+/**
+ * @brief 刷新所有打开的文件
+ *
+ * fat32_sync 在写回 FAT 表之前调用。
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @return fat32_error_t 第一个失败的错误码
+ */
+fat32_error_t
+fat32_file_flush_all(fat32_disk_t *disk, fat32_fs_info_t *fs_info);
+
+/**
+ * @brief 查找文件第 cluster_index 个簇的簇号
+ *
+ * 第一次调用时沿簇链建立区段表，之后在区段表中二分查找；簇链在末尾增长后，
+ * 查找超出范围时从区段表末尾接着补。
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @param file_handle 文件句柄
+ * @param cluster_index 文件内的簇序号
+ * @param cluster 返回簇号
+ * @param run_length 返回从该簇开始在磁盘上连续的簇数，可以为 NULL
+ * @return fat32_error_t 错误码，超出簇链时返回 FAT32_ERROR_END_OF_FILE
+ */
+fat32_error_t
+fat32_file_map_cluster(fat32_disk_t          *disk,
+                       const fat32_fs_info_t *fs_info,
+                       fat32_file_handle_t   *file_handle,
+                       uint32_t               cluster_index,
+                       uint32_t              *cluster,
+                       uint32_t              *run_length);
+
+/**
+ * @brief 丢弃文件句柄的区段表
+ *
+ * 簇链被截短或替换后调用，下次查找时重新建立。
+ *
+ * @param file_handle 文件句柄
+ */
+void
+fat32_file_map_reset(fat32_file_handle_t *file_handle);
+
+/**
+ * @brief 预分配文件空间
+ *
+ * 按最终大小为文件一次分配簇，尽量整段连续，文件大小不变。写入没有用到的簇在
+ * 关闭文件时释放。适合写入前已知大小的场景，如复制文件。
+ *
+ * @param disk 磁盘句柄
+ * @param fs_info 文件系统信息
+ * @param file_handle 文件句柄
+ * @param size 预计的文件大小
+ * @return fat32_error_t 错误码
+ */
+fat32_error_t
+fat32_file_preallocate(fat32_disk_t        *disk,
+                       fat32_fs_info_t     *fs_info,
+                       fat32_file_handle_t *file_handle,
+                       uint32_t             size);
+
 /**
  * @brief 截断文件
  * 
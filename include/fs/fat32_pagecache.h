@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file fat32_pagecache.h
+ * @brief Implementation of fat32_pagecache.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef FAT32_PAGECACHE_H
+#define FAT32_PAGECACHE_H
+
+#include "fat32_types.h"
+
+/* ============================================================================
+ * 文件页缓存
+ *
+ * 按文件的起始簇号缓存整页数据，页框可以直接映射到进程（mmap、共享代码段），
+ * 第一次访问时才从磁盘读入。fat32_file_write 写入的数据同步更新到已缓存的页，
+ * 截断和删除会使缓存失效。
+ *
+ * 所有接口都要求调用者持有 fat32_lock。
+ * ============================================================================ */
+
+#define FAT32_PAGECACHE_FILES     32     // 同时缓存的文件数
+#define FAT32_PAGECACHE_MAX_PAGES 16384  // 缓存页总数超过该值时回收未被引用的文件（64MB）
+
+typedef struct _fat32_pagecache_t fat32_pagecache_t;
+
+/**
+ * @brief 取得文件的页缓存并增加引用
+ *
+ * @param file_handle 已打开的文件句柄
+ * @return fat32_pagecache_t* 空文件或缓存表满时返回 NULL
+ */
+fat32_pagecache_t *
+fat32_pagecache_get(fat32_file_handle_t *file_handle);
+
+/**
+ * @brief 增加引用（fork 复制映射时使用）
+ */
+void
+fat32_pagecache_hold(fat32_pagecache_t *pc);
+
+/**
+ * @brief 释放引用；引用归零后页仍留在缓存中，直到被回收或失效
+ */
+void
+fat32_pagecache_put(fat32_pagecache_t *pc);
+
+/**
+ * @brief 取得文件第 index 页的内核地址，不在缓存中时从磁盘读入
+ *
+ * @return void* 超出文件范围或读失败时返回 NULL
+ */
+void *
+fat32_pagecache_page(fat32_pagecache_t *pc, uint32_t index);
+
+/**
+ * @brief 文件当前大小（字节）
+ */
+uint32_t
+fat32_pagecache_size(const fat32_pagecache_t *pc);
+
+/**
+ * @brief 把刚写入文件的数据同步到已缓存的页
+ *
+ * @param file_handle 写入用的句柄，写入后的状态
+ * @param pos 本次写入的起始位置
+ */
+void
+fat32_pagecache_update(const fat32_file_handle_t *file_handle,
+                       uint32_t                   pos,
+                       const void                *buffer,
+                       uint32_t                   size);
+
+/**
+ * @brief 文件的簇链即将释放，丢弃对应的缓存
+ *
+ * 仍被映射的页延迟到最后一个引用释放时回收。
+ */
+void
+fat32_pagecache_invalidate(uint32_t first_cluster);
+
+#endif  // FAT32_PAGECACHE_H
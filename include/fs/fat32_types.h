@@ -193,6 +193,18 @@ typedef struct
     uint8_t  mounted;             // 挂载状态标志
 } fat32_fs_info_t;
 
+/**
+ * @brief 簇链区段
+ *
+ * 文件中从第 file_index 簇开始的 length 个簇在磁盘上从 cluster 开始连续存放。
+ */
+typedef struct
+{
+    uint32_t file_index;  // 区段第一个簇在文件中的簇序号
+    uint32_t cluster;     // 区段第一个簇的簇号
+    uint32_t length;      // 连续的簇数
+} fat32_extent_t;
+
 /**
  * @brief 文件句柄结构
  * 
@@ -209,9 +221,25 @@ typedef struct
     uint8_t  flags;                         // 打开标志（读/写/追加等）
     uint8_t  in_use;                        // 句柄是否在使用中
     uint8_t  modified;                      // 文件是否被修改过
+    uint8_t  preallocated;                  // 簇链可能长于文件，关闭时截掉多余的簇
     uint32_t dir_cluster;                   // 文件所在目录的簇号
     uint32_t dir_entry_index;               // 文件在目录中的索引
     char     filename[FAT32_MAX_FILENAME];  // 文件名（用于调试）
+
+    /* 区段表，第一次按位置查找簇时建立，簇链增长时从末尾接着补 */
+    fat32_extent_t *extents;          // 按 file_index 递增排列
+    uint32_t        extent_count;     // 区段数
+    uint32_t        extent_pages;     // extents 占用的页数
+    uint32_t        mapped_clusters;  // 区段表覆盖的簇数
+
+    /* 顺序预读状态 */
+    uint32_t ra_next;    // 下一次顺序读应从这里开始
+    uint32_t ra_end;     // 已预读到的文件位置
+    uint32_t ra_window;  // 预读窗口（字节），连续顺序读时翻倍，随机访问时清零
+
+    /* 延迟分配：追加到簇链之外的数据先留在内存，刷新时按最终长度分配簇 */
+    uint8_t *delay_buf;  // FAT32_DELALLOC_MAX 字节，第一次需要时分配
+    uint32_t delay_len;  // 缓冲的字节数，即文件末尾簇链之外的部分
 } fat32_file_handle_t;
 
 /* ============================================================================
@@ -100,6 +100,50 @@
 #define GICH_LR_NUM       4
 #define GICH_LR_PID_SHIFT 10
 
+/* GICv3 distributor 扩展寄存器（亲和性路由） */
+#define GICD_IROUTER(x) (GICD_BASE_ADDR + (0x6000 + 0x008 * (x)))  // 64 位，x 为中断号
+#define GICD_PIDR2      (GICD_BASE_ADDR + 0xffe8)
+
+#define GICD_CTLR_RWP       (1U << 31)  // 寄存器写操作未完成
+#define GICD_CTLR_ARE       (1U << 4)   // 亲和性路由使能 (单安全状态)
+#define GICD_IROUTER_IRM    (1ULL << 31)
+#define GICD_PIDR2_ARCH(v)  (((v) >> 4) & 0xf)
+
+/* GICv3 redistributor：每个 CPU 一个 RD_base 帧 + 一个 SGI_base 帧 */
+#define GICR_SGI_OFFSET 0x10000
+#define GICR_CTLR       0x0000
+#define GICR_IIDR       0x0004
+#define GICR_TYPER      0x0008  // 64 位
+#define GICR_STATUSR    0x0010
+#define GICR_WAKER      0x0014
+#define GICR_PIDR2      0xffe8
+
+#define GICR_IGROUPR0   (GICR_SGI_OFFSET + 0x0080)
+#define GICR_ISENABLER0 (GICR_SGI_OFFSET + 0x0100)
+#define GICR_ICENABLER0 (GICR_SGI_OFFSET + 0x0180)
+#define GICR_ISPENDR0   (GICR_SGI_OFFSET + 0x0200)
+#define GICR_ICPENDR0   (GICR_SGI_OFFSET + 0x0280)
+#define GICR_ISACTIVER0 (GICR_SGI_OFFSET + 0x0300)
+#define GICR_ICACTIVER0 (GICR_SGI_OFFSET + 0x0380)
+#define GICR_IPRIORITYR (GICR_SGI_OFFSET + 0x0400)
+#define GICR_ICFGR0     (GICR_SGI_OFFSET + 0x0c00)
+#define GICR_ICFGR1     (GICR_SGI_OFFSET + 0x0c04)
+#define GICR_IGRPMODR0  (GICR_SGI_OFFSET + 0x0d00)
+
+#define GICR_TYPER_LAST         (1ULL << 4)
+#define GICR_TYPER_AFFINITY(t)  ((uint32_t) ((t) >> 32))
+#define GICR_TYPER_PROC_SHIFT   8
+#define GICR_WAKER_PROC_SLEEP   (1U << 1)
+#define GICR_WAKER_CHILD_ASLEEP (1U << 2)
+
+/* ICC_SGI1R_EL1 字段 */
+#define ICC_SGI1R_TARGET_LIST(v) ((uint32_t) ((v) & 0xffff))
+#define ICC_SGI1R_AFF1(v)        ((uint32_t) (((v) >> 16) & 0xff))
+#define ICC_SGI1R_INTID(v)       ((uint32_t) (((v) >> 24) & 0xf))
+#define ICC_SGI1R_AFF2(v)        ((uint32_t) (((v) >> 32) & 0xff))
+#define ICC_SGI1R_IRM            (1ULL << 40)
+#define ICC_SGI1R_AFF3(v)        ((uint32_t) (((v) >> 48) & 0xff))
+
 /*  GICD 操作掩码 */
 
 #define GICD_CTRL_ENABLE_GROUP0    (1 << 0)   // 启用组0中断
@@ -120,6 +164,33 @@
 
 #define GICC_IAR_INT_ID_MASK 0x3ff
 
+/*
+ * 物理中断优先级档位，作为 gic_set_ipriority 的 pri 参数（数值越小优先级越高）。
+ * 写入的优先级字节为 0x80 | (pri << 3)，相邻档位至少相差 2，保证在最小 BPR 下
+ * 属于不同的抢占组。调度类中断放在最低档，永远不会嵌套进其他处理函数。
+ */
+#define IRQ_PRIO_PASSTHROUGH 0  // 直通给 guest 的设备中断
+#define IRQ_PRIO_IPI         2  // 跨核函数调用
+#define IRQ_PRIO_DEVICE      4  // hypervisor 自用设备，如 UART
+#define IRQ_PRIO_SCHED       8  // 调度 IPI、tick 定时器
+
+/*
+ * 列表寄存器的值类型：GICv2 的 GICH_LR 为 32 位 MMIO 寄存器，
+ * GICv3 的 ICH_LR<n>_EL2 为 64 位系统寄存器
+ */
+#if GIC_VERSION == 3
+typedef uint64_t gic_lr_t;
+    #define GIC_LR_FMT "0x%016llx"
+#else
+typedef uint32_t gic_lr_t;
+    #define GIC_LR_FMT "0x%08x"
+#endif
+
+/* LR 的 State 字段 */
+#define GIC_LR_STATE_INVALID 0
+#define GIC_LR_STATE_PENDING 1
+#define GIC_LR_STATE_ACTIVE  2
+
 typedef struct gic_t
 {
     uint32_t irq_nr;
@@ -188,6 +259,8 @@ gic_write_dir(uint32_t irqstat);
 
 void
 gic_ipi_send_single(int32_t irq, int32_t cpu);
+void
+gic_ipi_send_mask(int32_t irq, uint32_t cpu_mask);
 
 void
 gic_enable_int(int32_t vector, int32_t enabled);
@@ -210,21 +283,25 @@ void
 gic_set_icfgr(uint32_t int_id, uint8_t cfg);
 
 
-uint32_t
+gic_lr_t
 gic_make_virtual_hardware_interrupt(uint32_t vector, uint32_t pintvec, int32_t pri, bool grp1);
-uint32_t
+gic_lr_t
 gic_make_virtual_software_interrupt(uint32_t vector, int32_t pri, bool grp1);
-uint32_t
+gic_lr_t
 gic_make_virtual_software_sgi(uint32_t vector, int32_t cpu_id, int32_t pri, bool grp1);
 
-uint32_t
+gic_lr_t
 gic_read_lr(int32_t n);
 int32_t
-gic_lr_read_pri(uint32_t lr_value);
+gic_lr_read_pri(gic_lr_t lr_value);
+uint32_t
+gic_lr_read_vid(gic_lr_t lr_value);
 uint32_t
-gic_lr_read_vid(uint32_t lr_value);
+gic_lr_read_state(gic_lr_t lr_value);
+gic_lr_t
+gic_lr_clear_pending(gic_lr_t lr_value);
 void
-gic_write_lr(int32_t n, uint32_t mask);
+gic_write_lr(int32_t n, gic_lr_t mask);
 void
 gic_set_np_int(void);
 void
@@ -232,9 +309,23 @@ gic_clear_np_int(void);
 
 uint32_t
 gic_apr();
+void
+gic_write_apr(uint32_t apr);
 uint32_t
 gic_elsr0();
 uint32_t
 gic_elsr1();
+uint32_t
+gic_read_vmcr(void);
+void
+gic_write_vmcr(uint32_t vmcr);
+uint32_t
+gic_read_hcr(void);
+void
+gic_write_hcr(uint32_t hcr);
+
+// 返回 cpu 的亲和性值 (Aff3.Aff2.Aff1.Aff0，与 GICR_TYPER[63:32] 格式一致)
+uint32_t
+gic_cpu_affinity(int32_t cpu);
 
 #endif  // __GIC_H__
\ No newline at end of file
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file hrtimer.h
+ * @brief Implementation of hrtimer.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __HRTIMER_H__
+#define __HRTIMER_H__
+
+#include "avatar_types.h"
+
+/*
+ * 高精度定时器：每个 CPU 一条按到期时间排序的队列，到期时间为 CNTPCT 绝对值。
+ * 比较器（HV=1 为 CNTHP，否则为 CNTP）以 one-shot 方式编程为队首的到期时间，
+ * 回调在定时器中断中、关 IRQ 的状态下执行。
+ *
+ * 回调里不能调度切走，需要调度时调用 hrtimer_request_resched()，
+ * 由中断处理在重新编程比较器之后统一调用 schedule()。
+ */
+
+typedef enum
+{
+    HRTIMER_NORESTART = 0,  // 到期后不再排队
+    HRTIMER_RESTART,        // 回调已更新 expires，重新排队
+} hrtimer_restart_t;
+
+typedef struct _hrtimer_t hrtimer_t;
+
+typedef hrtimer_restart_t (*hrtimer_fn_t)(hrtimer_t *timer);
+
+struct _hrtimer_t
+{
+    hrtimer_t   *next;     // 队列中的下一个定时器
+    uint64_t     expires;  // 到期时刻（CNTPCT 计数）
+    hrtimer_fn_t fn;
+    void        *data;
+    uint32_t     cpu;     // 所在队列的 CPU
+    bool         queued;  // 是否在队列中
+};
+
+void
+hrtimer_init_local(void);
+void
+hrtimer_interrupt(uint64_t *ctx);
+
+void
+hrtimer_init(hrtimer_t *timer, hrtimer_fn_t fn, void *data);
+void
+hrtimer_start(hrtimer_t *timer, uint64_t expires);
+void
+hrtimer_start_us(hrtimer_t *timer, uint64_t us);
+bool
+hrtimer_cancel(hrtimer_t *timer);
+void
+hrtimer_forward_now(hrtimer_t *timer, uint64_t interval);
+void
+hrtimer_request_resched(void);
+
+uint64_t
+hrtimer_us_to_ticks(uint64_t us);
+uint64_t
+hrtimer_ticks_to_us(uint64_t ticks);
+
+static inline bool
+hrtimer_is_queued(hrtimer_t *timer)
+{
+    return timer->queued;
+}
+
+#endif  // __HRTIMER_H__
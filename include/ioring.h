@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file ioring.h
+ * @brief Implementation of ioring.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __IORING_H__
+#define __IORING_H__
+
+#include "avatar_types.h"
+
+/*
+ * 提交/完成队列，内核和进程共享同一组物理页，映射在 IORING_USER_VA。
+ *
+ *   进程：填 sqes[sq_tail & mask]，release 写 sq_tail，然后 SYS_ring_enter
+ *   内核：从 sq_head 取到 sq_tail，逐个执行，结果写入 cqes[cq_tail & mask]
+ *   进程：从 cq_head 读到 cq_tail，处理完 release 写 cq_head
+ *
+ * 每个头/尾指针只有一方写，另一方 acquire 读，不需要锁。一次 ring_enter
+ * 可以提交一批操作，并等待至少 min_complete 个完成，摊薄陷入开销。
+ * 本头文件同时给内核和 app 使用。
+ */
+
+#define IORING_USER_VA    0xbffe0000UL  // 紧挨时间页下方
+#define IORING_PAGES      2
+#define IORING_ENTRIES    64  // 2 的幂
+#define IORING_CQ_ENTRIES (IORING_ENTRIES * 2)
+
+/* 操作码 */
+#define IORING_OP_NOP     0
+#define IORING_OP_READ    1  // fd, addr = 缓冲区, len, off
+#define IORING_OP_WRITE   2  // fd, addr = 缓冲区, len, off
+#define IORING_OP_TIMEOUT 3  // len = 超时（us），到期后完成，res = 0
+#define IORING_OP_OPEN    4  // addr = 路径, len = O_* 标志，res = fd
+#define IORING_OP_CLOSE   5  // fd
+
+/* off 取该值时读写从文件当前位置开始并推进位置，否则按 off 定位 */
+#define IORING_OFF_CUR (~0ULL)
+
+/* ring_enter 标志 */
+#define IORING_ENTER_GETEVENTS (1 << 0)  // 等待 min_complete 个完成
+
+typedef struct
+{
+    uint8_t  opcode;
+    uint8_t  flags;
+    uint16_t rsvd;
+    int32_t  fd;
+    uint64_t addr;
+    uint64_t len;
+    uint64_t off;
+    uint64_t user_data;  // 原样带回完成项
+} ioring_sqe_t;
+
+typedef struct
+{
+    uint64_t user_data;
+    int64_t  res;  // 成功时为字节数或 fd，失败为 -1
+} ioring_cqe_t;
+
+typedef struct _ioring_t
+{
+    volatile uint32_t sq_head;      // 内核写
+    volatile uint32_t sq_tail;      // 进程写
+    volatile uint32_t cq_head;      // 进程写
+    volatile uint32_t cq_tail;      // 内核写
+    volatile uint32_t cq_overflow;  // 完成队列满时丢弃的完成项数
+    uint32_t          sq_entries;
+    uint32_t          cq_entries;
+    uint32_t          rsvd;
+
+    ioring_sqe_t sqes[IORING_ENTRIES];
+    ioring_cqe_t cqes[IORING_CQ_ENTRIES];
+} ioring_t;
+
+static inline uint32_t
+ioring_load_acquire(const volatile uint32_t *p)
+{
+    uint32_t val;
+    __asm__ __volatile__("ldar %w0, [%1]" : "=r"(val) : "r"(p) : "memory");
+    return val;
+}
+
+static inline void
+ioring_store_release(volatile uint32_t *p, uint32_t val)
+{
+    __asm__ __volatile__("stlr %w0, [%1]" : : "r"(val), "r"(p) : "memory");
+}
+
+// EL0 使用：取一个空闲提交项，队列满时返回 NULL
+static inline ioring_sqe_t *
+ioring_get_sqe(ioring_t *ring)
+{
+    uint32_t tail = ring->sq_tail;
+
+    if (tail - ioring_load_acquire(&ring->sq_head) >= IORING_ENTRIES)
+        return NULL;
+    return &ring->sqes[tail & (IORING_ENTRIES - 1)];
+}
+
+// EL0 使用：发布已填好的 n 个提交项
+static inline void
+ioring_advance_sq(ioring_t *ring, uint32_t n)
+{
+    ioring_store_release(&ring->sq_tail, ring->sq_tail + n);
+}
+
+// EL0 使用：查看下一个完成项，没有时返回 NULL
+static inline ioring_cqe_t *
+ioring_peek_cqe(ioring_t *ring)
+{
+    uint32_t head = ring->cq_head;
+
+    if (head == ioring_load_acquire(&ring->cq_tail))
+        return NULL;
+    return &ring->cqes[head & (IORING_CQ_ENTRIES - 1)];
+}
+
+// EL0 使用：归还已处理的完成项
+static inline void
+ioring_cqe_seen(ioring_t *ring)
+{
+    ioring_store_release(&ring->cq_head, ring->cq_head + 1);
+}
+
+#endif  // __IORING_H__
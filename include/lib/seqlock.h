@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file seqlock.h
+ * @brief Implementation of seqlock.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __SEQLOCK_H__
+#define __SEQLOCK_H__
+
+#include "avatar_types.h"
+
+/*
+ * 顺序计数：写者更新前后各加一，奇数表示正在更新。读者不加锁，
+ * 读到的序号为奇数或前后不一致时重读。只依赖内存屏障，EL0 也可以使用。
+ * 多个写者时由调用者自行加锁互斥。
+ */
+typedef struct
+{
+    volatile uint32_t sequence;
+} seqcount_t;
+
+static inline void
+seqcount_init(seqcount_t *s)
+{
+    s->sequence = 0;
+}
+
+static inline uint32_t
+read_seqcount_begin(const seqcount_t *s)
+{
+    uint32_t seq;
+
+    while ((seq = s->sequence) & 1) {
+        // 写者正在更新
+    }
+    __asm__ __volatile__("dmb ishld" : : : "memory");
+    return seq;
+}
+
+static inline bool
+read_seqcount_retry(const seqcount_t *s, uint32_t start)
+{
+    __asm__ __volatile__("dmb ishld" : : : "memory");
+    return s->sequence != start;
+}
+
+static inline void
+write_seqcount_begin(seqcount_t *s)
+{
+    s->sequence++;
+    __asm__ __volatile__("dmb ishst" : : : "memory");
+}
+
+static inline void
+write_seqcount_end(seqcount_t *s)
+{
+    __asm__ __volatile__("dmb ishst" : : : "memory");
+    s->sequence++;
+}
+
+#endif  // __SEQLOCK_H__
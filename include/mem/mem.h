@@ -71,5 +71,11 @@ int32_t
 memory_copy_uvm_4level(pte_t *dst_pgd, pte_t *src_pgd);
 int32_t
 memory_create_map(pte_t *page_dir, uint64_t vaddr, uint64_t paddr, int32_t count, uint64_t perm);
+int32_t
+memory_map_cache_page(pte_t *page_dir, uint64_t vaddr, uint64_t paddr, uint64_t perm);
+void
+memory_unmap_page(pte_t *page_dir, uint64_t vaddr);
+bool
+memory_user_page_ok(pte_t *page_dir, uint64_t vaddr, bool write);
 
 #endif  // MEM_H
\ No newline at end of file
@@ -117,6 +117,9 @@ typedef union {
     uint64_t pte;
 } pte_t;
 
+// l3_page.soft_reserved：页框属于页缓存，不随进程页表释放或复制
+#define PTE_SOFT_CACHE 0x1
+
 // 安全获取缓存行大小的函数声明
 size_t
 get_cacheline_size(void);
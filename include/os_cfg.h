@@ -28,14 +28,24 @@
     #define SMP_NUM 1
 #endif
 
+/* GIC 版本配置：2 = GICv2 (MMIO CPU 接口)，3 = GICv3 (系统寄存器 CPU 接口) */
+#ifndef GIC_VERSION
+    #define GIC_VERSION 2
+#endif
+
 /* 设备基地址配置 */
 // UART
 #define UART0_BASE_ADDR 0x09000000UL  // PL011 UART 基地址
+// RTC
+#define RTC_BASE_ADDR 0x09010000UL  // PL031 RTC 基地址，RTCDR 为自 1970 年起的秒数
 // GIC
 #define GICD_BASE_ADDR 0x8000000UL  // unsigned long 64 位
 #define GICC_BASE_ADDR 0x8010000UL
 #define GICH_BASE_ADDR 0x8030000UL
 #define GICV_BASE_ADDR 0x8040000UL
+// GICv3 redistributor (qemu virt)，每个 CPU 一个 RD_base + SGI_base 共 128KB 的帧
+#define GICR_BASE_ADDR 0x80A0000UL
+#define GICR_STRIDE    0x20000UL
 
 /* 内存配置 */
 #define KERNEL_RAM_START (0x40000000UL)
@@ -100,6 +110,7 @@
 
 #define MMIO_AREA_GICD  0x8000000UL
 #define MMIO_AREA_GICC  0x8010000UL
+#define MMIO_AREA_GICR  0x80A0000UL
 #define MMIO_AREA_PL011 0x09000000UL
 
 #if HV == 1
@@ -123,6 +134,7 @@ extern char __heap_flag[];
 /* 调度配置 */
 #define SCHEDULE_TIME_SLICE_MS     100
 #define SCHEDULE_PREEMPT_THRESHOLD 5
+#define HOUSEKEEPING_CPU           0  // 启动核：shell、宿主任务和设备中断所在，不能被 VM 独占
 
 /* 内存池配置 */
 #define MEMORY_POOL_SIZE      (64 * 1024 * 1024)  // 64MB
@@ -131,7 +143,11 @@ extern char __heap_flag[];
 
 /* 虚拟化配置 */
 #define VM_NUM_MAX   4
-#define VCPU_NUM_MAX 8
+#if GIC_VERSION == 3
+    #define VCPU_NUM_MAX 16  // 亲和性路由，不再受 GICv2 8 个 CPU 接口的限制
+#else
+    #define VCPU_NUM_MAX 8
+#endif
 
 /* Guest内存配置 */
 #define GUEST_RAM_SIZE 0x40000000  // 1GB
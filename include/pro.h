@@ -20,6 +20,27 @@
 #include "lib/list.h"
 
 #define PRO_MAX_NAME_LEN 64
+#define PRO_MAX_FILES    16  // 每个进程的文件描述符数，0-2 固定为控制台
+#define PRO_FD_FIRST     3
+#define PRO_OFF_CUR      (~0ULL)  // 读写从文件当前位置开始
+#define PRO_MAX_VMAS     16
+#define PRO_MMAP_BASE    0x1000000000UL  // mmap 区域起点，远离各 app 的加载地址
+#define PRO_USER_VA_END  0x1000000000000UL  // TTBR0 覆盖的 48 位用户地址空间
+
+struct _ioring_ctx_t;
+struct _fat32_pagecache_t;
+struct _file_stat_t;
+
+// 文件映射区域，页在第一次访问时由 pro_mmap_fault 映射
+typedef struct
+{
+    uint64_t                   start;  // 0 表示空闲
+    uint64_t                   end;
+    uint64_t                   pgoff;  // 区域起点对应的文件页号
+    uint32_t                   prot;
+    uint32_t                   flags;
+    struct _fat32_pagecache_t *file;
+} pro_vma_t;
 
 typedef struct _tcb_t tcb_t;
 
@@ -39,6 +60,13 @@ typedef struct _process_t
     tcb_t   *main_thread;  // 主线程
 
     struct _process_t *parent;
+
+    void                 *files[PRO_MAX_FILES];  // fd -> FAT32 文件句柄
+    struct _ioring_ctx_t *ioring;                // SYS_ring_setup 之后有效
+    pro_vma_t             vmas[PRO_MAX_VMAS];
+    uint64_t              mmap_next;  // 下一个 mmap 区域的起点
+
+    struct _fat32_pagecache_t *image;  // 从 FAT32 加载时的映像，只读段映射自它的页缓存
 } process_t;
 
 typedef struct _process_manager_t
@@ -59,4 +87,55 @@ pro_execve(char *name, char **__argv, char **__envp);
 int32_t
 pro_fork(void);
 
+// 进程文件描述符，fd 0 读控制台，fd 1/2 写控制台
+int64_t
+pro_file_open(process_t *pro, const char *path, uint32_t flags);
+int64_t
+pro_file_read(process_t *pro, int32_t fd, void *buf, uint64_t len, uint64_t off);
+int64_t
+pro_file_write(process_t *pro, int32_t fd, const void *buf, uint64_t len, uint64_t off);
+int64_t
+pro_file_lseek(process_t *pro, int32_t fd, int64_t offset, int32_t whence);
+int64_t
+pro_file_stat(process_t *pro, const char *path, struct _file_stat_t *st);
+int64_t
+pro_file_fstat(process_t *pro, int32_t fd, struct _file_stat_t *st);
+int64_t
+pro_file_close(process_t *pro, int32_t fd);
+void
+pro_file_close_all(process_t *pro);
+
+// 文件映射
+int64_t
+pro_mmap(process_t *pro, uint64_t len, uint32_t prot, uint32_t flags, int32_t fd, uint64_t off);
+int64_t
+pro_munmap(process_t *pro, uint64_t addr, uint64_t len);
+bool
+pro_mmap_fault(process_t *pro, uint64_t addr, bool is_write);
+void
+pro_mmap_fork(process_t *parent, process_t *child);
+void
+pro_mmap_release(process_t *pro);
+bool
+pro_user_range_ok(process_t *pro, uint64_t addr, uint64_t len, bool write);
+
+struct _fat32_pagecache_t *
+pro_exec_open(const char *path);
+uint64_t
+pro_exec_load(process_t *pro, struct _fat32_pagecache_t *image, void *page_dir);
+void
+pro_exec_fork(process_t *parent, process_t *child);
+void
+pro_exec_release(struct _fat32_pagecache_t *image);
+
+// 提交/完成队列，见 ioring.h
+int64_t
+pro_ioring_setup(process_t *pro);
+int64_t
+pro_ioring_enter(process_t *pro, uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+void
+pro_ioring_fork(process_t *parent, process_t *child);
+void
+pro_ioring_release(process_t *pro);
+
 #endif  // PRO_H
\ No newline at end of file
@@ -32,4 +32,25 @@ spin_trylock(spinlock_t *lock);
 extern void
 spin_unlock(spinlock_t *lock);
 
+// 先屏蔽本核 IRQ 再加锁，用于中断处理函数里也会获取的锁，返回原 DAIF
+static inline uint64_t
+spin_lock_irqsave(spinlock_t *lock)
+{
+    uint64_t daif;
+    __asm__ __volatile__("mrs %0, daif\n"
+                         "msr daifset, #2\n"
+                         : "=r"(daif)
+                         :
+                         : "memory");
+    spin_lock(lock);
+    return daif;
+}
+
+static inline void
+spin_unlock_irqrestore(spinlock_t *lock, uint64_t daif)
+{
+    spin_unlock(lock);
+    __asm__ __volatile__("msr daif, %0" : : "r"(daif) : "memory");
+}
+
 #endif  // SPINLOCK_H
\ No newline at end of file
@@ -14,6 +14,7 @@
 #ifndef SYSCALL_H
 #define SYSCALL_H
 #include "avatar_types.h"
+#include "syscall_num.h"
 
 char
 getc();
@@ -25,6 +26,34 @@ int32_t
 execve(char *name, char **__argv, char **__envp);
 int32_t
 fork();
+int64_t
+write(int32_t fd, const void *buf, uint64_t len);
+int32_t
+open(const char *path, uint32_t flags);
+int64_t
+read(int32_t fd, void *buf, uint64_t len);
+int32_t
+close(int32_t fd);
+int64_t
+lseek(int32_t fd, int64_t offset, int32_t whence);
+int32_t
+stat(const char *path, file_stat_t *st);
+int32_t
+fstat(int32_t fd, file_stat_t *st);
+void *
+mmap(void *addr, uint64_t len, uint32_t prot, uint32_t flags, int32_t fd, uint64_t off);
+int32_t
+munmap(void *addr, uint64_t len);
+
+void *
+ring_setup();
+int64_t
+ring_enter(uint32_t to_submit, uint32_t min_complete, uint32_t flags);
+
+uint64_t
+null_syscall();
+uint64_t
+null_syscall_frame();
 
 uint64_t
 mutex_test_add();
@@ -15,6 +15,11 @@
 #ifndef SYSCALL_NUM_H
 #define SYSCALL_NUM_H
 
+/*
+ * 系统调用 ABI：x8 为调用号，x0-x5 为参数，返回值在 x0。
+ * 本文件同时被 exception.S 包含，C 声明放在 __ASSEMBLER__ 之外。
+ */
+
 #define NR_SYSCALL 256
 
 #define SYS_putc   0
@@ -22,10 +27,75 @@
 #define SYS_sleep  2
 #define SYS_execve 3
 #define SYS_fork   4
+#define SYS_write  5
+
+#define SYS_ring_setup 6  // 建立提交/完成队列，返回映射地址
+#define SYS_ring_enter 7  // (to_submit, min_complete, flags)
+#define SYS_open       8  // (path, flags)
+#define SYS_read       9
+#define SYS_close      10
+#define SYS_lseek      11  // (fd, offset, whence)
+#define SYS_stat       12  // (path, file_stat_t *)
+#define SYS_fstat      13  // (fd, file_stat_t *)
+#define SYS_mmap       14  // (addr, len, prot, flags, fd, off)
+#define SYS_munmap     15  // (addr, len)
 
+#define SYS_null             250  // 空系统调用，用于测量往返开销
+#define SYS_null_frame       251  // 同上，但强制走完整 trap frame 路径作为对照
 #define SYS_mutex_test_print 252
 #define SYS_mutex_add        253
 #define SYS_mutex_minus      254
 #define SYS_debug            255
 
+/* 系统调用表项标志 */
+#define SYSCALL_F_FRAME_BIT 0
+#define SYSCALL_F_FRAME     (1 << SYSCALL_F_FRAME_BIT)  // 需要完整的 trap frame（fork 会复制它）
+
+/* 文件打开标志，取值与 FAT32_O_* 一致 */
+#define O_RDONLY 0x01
+#define O_WRONLY 0x02
+#define O_RDWR   0x03
+#define O_CREAT  0x04
+#define O_TRUNC  0x08
+#define O_APPEND 0x10
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+/* mmap */
+#define PROT_READ   0x1
+#define PROT_WRITE  0x2
+#define MAP_SHARED  0x1  // 直接映射页缓存，只读
+#define MAP_PRIVATE 0x2  // 可写时缺页复制出私有页
+#define MAP_FAILED  ((void *) -1)
+
+#ifndef __ASSEMBLER__
+#include "avatar_types.h"
+
+typedef uint64_t (*syscall_fn_t)(uint64_t a0,
+                                 uint64_t a1,
+                                 uint64_t a2,
+                                 uint64_t a3,
+                                 uint64_t a4,
+                                 uint64_t a5);
+
+/* 表项布局被 exception.S 直接使用：16 字节，fn 在前 */
+typedef struct
+{
+    syscall_fn_t fn;
+    uint64_t     flags;
+} syscall_entry_t;
+
+extern const syscall_entry_t syscall_table[NR_SYSCALL];
+
+typedef struct _file_stat_t
+{
+    uint64_t size;
+    uint32_t attr;  // FAT 目录项属性
+    uint32_t is_dir;
+} file_stat_t;
+
+#endif  // __ASSEMBLER__
+
 #endif  // SYSCALL_NUM_H
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file smp_call.h
+ * @brief Implementation of smp_call.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __SMP_CALL_H__
+#define __SMP_CALL_H__
+
+#include "avatar_types.h"
+
+// 每个核的调用队列长度，队列满时调用者自旋等待目标核处理
+#define SMP_CALL_QUEUE_LEN 32
+
+typedef void (*smp_call_func_t)(void *info);
+
+/**
+ * 当前核的跨核调用初始化：安装 IPI_CALL_FUNC 处理函数并使能该 SGI。
+ * SGI 的使能位按核独立，每个核都要调用一次。
+ */
+void
+smp_call_init_local(void);
+
+/**
+ * 在指定核上执行 func(info)
+ *
+ * 目标为当前核时直接在关中断状态下执行。
+ * 目标核队列原本非空时不再发送 SGI，由正在处理的那次中断一并执行。
+ *
+ * @param cpu 目标核
+ * @param wait true 表示等待 func 执行完成后返回；
+ *             false 时 info 必须在 func 执行前保持有效
+ * @return 0 成功，-1 参数错误
+ *
+ * wait 为 true 时，等待期间本核会执行其他核发来的请求，可以在关中断状态下调用
+ */
+int32_t
+smp_call_function_single(int32_t cpu, smp_call_func_t func, void *info, bool wait);
+
+/**
+ * 在 cpu_mask 中的所有核上执行 func(info)
+ *
+ * 所有远端请求先入队，再用一次 gic_ipi_send_mask 批量发送 SGI；
+ * cpu_mask 包含当前核时，在发出 SGI 之后于本地执行。
+ *
+ * @return 0 成功，-1 参数错误
+ */
+int32_t
+smp_call_function_many(uint32_t cpu_mask, smp_call_func_t func, void *info, bool wait);
+
+/**
+ * 执行其他核发给当前核的全部请求
+ *
+ * 关中断自旋等待其他核的状态时调用，对方可能同时在等待本核执行请求
+ */
+void
+smp_call_drain_local(void);
+
+#endif  // __SMP_CALL_H__
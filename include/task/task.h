@@ -15,6 +15,7 @@
 #define __TASK_H__
 
 #include "avatar_types.h"
+#include "hrtimer.h"
 #include "vmm/vcpu.h"
 #include "lib/list.h"
 #include "os_cfg.h"
@@ -22,7 +23,8 @@
 #include "pro.h"
 #include "vmm/vm.h"
 
-#define IPI_SCHED 2
+#define IPI_SCHED     2
+#define IPI_CALL_FUNC 3  // 跨核函数调用，见 task/smp_call.h
 
 // 任务入口函数类型定义
 typedef void (*entry_t)(void);
@@ -71,8 +73,9 @@ typedef enum _task_state_t
     TASK_STATE_CREATE = 1,  // 刚分配完 TCB，还没进入任何队列
     TASK_STATE_READY,       // 已进入 ready 队列，等待调度
     TASK_STATE_RUNNING,
-    TASK_STATE_WAITING,   // 睡眠状态（sleep tick 到期后可转 READY）
+    TASK_STATE_WAITING,   // 睡眠状态（sleep_timer 到期后可转 READY）
     TASK_STATE_WAIT_IRQ,  // 等待中断
+    TASK_STATE_STOPPED,   // 已被 task_stop 摘下调度，不在任何队列中
 } task_state_t;
 
 #pragma pack(1)
@@ -90,9 +93,10 @@ typedef struct _tcb_t
     int32_t task_id;  // 任务ID
     int32_t remaining_ticks;
 
-    int32_t  sleep_ticks;
     uint32_t reserved;
 
+    hrtimer_t sleep_timer;  // 睡眠到期定时器
+
 
     list_node_t run_node;    // 运行相关结点
     list_node_t wait_node;   // 等待队列
@@ -102,8 +106,16 @@ typedef struct _tcb_t
     list_node_t        process_node;  // 属于哪个进程
     struct _process_t *curr_pro;      // 当前进程
 
-    list_node_t   vm_node;  // 属于哪个虚拟机
     struct _vm_t *curr_vm;  // 当前虚拟机
+
+    // 运行时间统计（单位：CNTPCT 计数）
+    uint64_t run_start;    // 本次开始运行的时刻
+    uint64_t ready_since;  // 进入就绪队列的时刻，0 表示不在就绪队列
+    uint64_t runtime;      // 累计运行时间
+    uint64_t run_delay;    // 累计就绪等待时间（steal）
+    uint64_t nr_switches;  // 被调度上 CPU 的次数
+    uint64_t exits;        // 陷入 EL2 的次数（仅 vCPU 任务）
+    uint32_t last_cpu;     // 最近一次运行的 pCPU
 } tcb_t;
 #pragma pack()
 
@@ -121,26 +133,53 @@ typedef struct cpu_scheduler
     // 就绪队列（简单的循环链表）
     list_t ready_list;
 
-    // 睡眠队列（按唤醒时间排序的链表）
+    // 睡眠队列，到期顺序由各任务的 sleep_timer 在 hrtimer 队列中维护
     list_t sleep_list;
 
+    struct _vm_t *owner_vm;  // 独占该 pCPU 的虚拟机，NULL 表示共享
+
     // 统计信息
     uint64_t total_switches;  // 总切换次数
     uint64_t total_ticks;     // 总tick数
     uint64_t idle_ticks;      // idle时间
+    uint64_t busy_time;       // 非 idle 任务运行时间（CNTPCT 计数）
+    uint64_t idle_time;       // idle 任务运行时间（CNTPCT 计数）
 } cpu_scheduler_t;
 
+// 某一时刻的任务统计快照，包含正在运行的那一段时间
+typedef struct _task_stats_t
+{
+    uint64_t runtime;
+    uint64_t run_delay;
+    uint64_t nr_switches;
+    uint64_t exits;
+} task_stats_t;
+
+// 某一时刻的 pCPU 统计快照
+typedef struct _sched_stats_t
+{
+    uint64_t busy_time;
+    uint64_t idle_time;
+    uint64_t total_switches;
+    uint64_t total_ticks;
+    uint64_t idle_ticks;
+    uint32_t nr_ready;
+} sched_stats_t;
+
 
 typedef struct _task_manager_t
 {
     list_t          task_list;  // 所有已创建任务的队列
+    spinlock_t      task_lock;  // 保护 task_list，各核创建/回收任务和 top 遍历都要持有
     cpu_scheduler_t sched[SMP_NUM];
 } task_manager_t;
 
-void
-timer_tick_schedule(uint64_t *);
+bool
+sched_tick(void);
 void
 print_current_task_list();
+void
+task_list_add(tcb_t *task);
 
 static inline void
 flush(void)
@@ -168,8 +207,17 @@ can_run_on_core(uint32_t affinity, uint32_t coreid)
     return (affinity & (1U << coreid)) != 0;
 }
 
+// 亲和性位图中编号最小的 pCPU
+static inline uint32_t
+affinity_first_cpu(uint32_t affinity)
+{
+    return affinity ? (uint32_t) __builtin_ctz(affinity) : 0;
+}
+
 tcb_t *
 alloc_tcb();
+void
+free_tcb(tcb_t *task);
 
 tcb_t *
 create_task(entry_t task_func, uint64_t, uint32_t);
@@ -210,14 +258,40 @@ schedule();
 
 // 睡眠队列相关函数
 void
-task_set_sleep(tcb_t *task, uint64_t ticks);
+task_set_sleep(tcb_t *task, uint64_t us);
 void
 task_set_wakeup(tcb_t *task);
 void
 task_set_wakeup_remote(tcb_t *task, uint32_t core_id);
 
+// 停止任务
+void
+task_stop(tcb_t *task);
+void
+task_wait_off_cpu(tcb_t *task);
+
+// pCPU 独占分区
+int32_t
+sched_isolate_cpus(uint32_t cpu_mask, struct _vm_t *vm);
+uint32_t
+sched_release_cpus(struct _vm_t *vm);
+uint32_t
+sched_isolated_mask(void);
+bool
+sched_cpu_isolated(uint32_t core_id);
+uint32_t
+sched_housekeeping_affinity(uint32_t affinity);
+
+// 统计信息
+void
+task_get_stats(tcb_t *task, uint64_t now, task_stats_t *stats);
+void
+sched_get_stats(uint32_t core_id, uint64_t now, sched_stats_t *stats);
+
 // 系统调用
 void
+task_sleep_us(uint64_t us);
+void
 sys_sleep_tick(uint64_t ms);
 
 #endif  // __TASK_H__
\ No newline at end of file
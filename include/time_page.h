@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file time_page.h
+ * @brief Implementation of time_page.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __TIME_PAGE_H__
+#define __TIME_PAGE_H__
+
+#include "avatar_types.h"
+#include "lib/seqlock.h"
+
+/*
+ * 全系统共享的时间页，内核维护，只读映射到每个进程的 TIME_PAGE_USER_VA。
+ * EL0 直接读 CNTPCT 并按页中的参数换算，不需要系统调用：
+ *
+ *   mono_ns = base_ns + ((cntpct - cycle_base) * mult >> shift)
+ *   real_ns = mono_ns + wall_offset_ns
+ *
+ * 所有字段由 seq 顺序计数保护。本头文件同时给内核和 app 使用。
+ */
+
+#define TIME_PAGE_USER_VA 0xbfff0000UL
+
+#define NSEC_PER_SEC 1000000000ULL
+
+typedef struct _time_page_t
+{
+    seqcount_t seq;
+    uint32_t   shift;
+    uint64_t   mult;
+    uint64_t   freq;            // CNTFRQ，单位 Hz
+    uint64_t   cycle_base;      // 上次更新时的 CNTPCT
+    uint64_t   base_ns;         // cycle_base 对应的单调时间
+    uint64_t   wall_offset_ns;  // 墙上时间相对单调时间的偏移
+} time_page_t;
+
+static inline uint64_t
+time_page_read_counter(void)
+{
+    uint64_t val;
+    // isb 保证计数器不会被提前读取
+    __asm__ __volatile__("isb\n"
+                         "mrs %0, cntpct_el0"
+                         : "=r"(val)
+                         :
+                         : "memory");
+    return val;
+}
+
+// 单调时间（ns），从系统启动开始计
+static inline uint64_t
+time_page_mono_ns(const time_page_t *tp)
+{
+    uint32_t seq;
+    uint64_t ns;
+
+    do {
+        seq = read_seqcount_begin(&tp->seq);
+        ns  = tp->base_ns +
+             (((time_page_read_counter() - tp->cycle_base) * tp->mult) >> tp->shift);
+    } while (read_seqcount_retry(&tp->seq, seq));
+
+    return ns;
+}
+
+// 墙上时间（ns），自 1970-01-01 UTC
+static inline uint64_t
+time_page_real_ns(const time_page_t *tp)
+{
+    uint32_t seq;
+    uint64_t ns;
+
+    do {
+        seq = read_seqcount_begin(&tp->seq);
+        ns  = tp->base_ns + tp->wall_offset_ns +
+             (((time_page_read_counter() - tp->cycle_base) * tp->mult) >> tp->shift);
+    } while (read_seqcount_retry(&tp->seq, seq));
+
+    return ns;
+}
+
+// EL0 使用：读取映射到本进程的时间页
+static inline uint64_t
+user_clock_mono_ns(void)
+{
+    return time_page_mono_ns((const time_page_t *) TIME_PAGE_USER_VA);
+}
+
+static inline uint64_t
+user_clock_real_ns(void)
+{
+    return time_page_real_ns((const time_page_t *) TIME_PAGE_USER_VA);
+}
+
+#endif  // __TIME_PAGE_H__
@@ -80,6 +80,10 @@
 #define VIRTIO_BLK_S_IOERR  1
 #define VIRTIO_BLK_S_UNSUPP 2
 
+// 分散读
+#define VIRTIO_BLK_MAX_INFLIGHT    16   // 一次放进队列的最大请求数
+#define VIRTIO_BLK_MAX_REQ_SECTORS 128  // 单个请求的最大扇区数
+
 // VirtIO Block 特性位
 #define VIRTIO_BLK_F_SIZE_MAX 1
 #define VIRTIO_BLK_F_SEG_MAX  2
@@ -200,6 +204,14 @@ typedef struct
     uint64_t            capacity;
 } virtio_blk_device_t;
 
+// 分散读的一段：从 sector 开始的 count 个扇区读进 buffer
+typedef struct
+{
+    uint64_t sector;
+    void    *buffer;
+    uint32_t count;
+} virtio_blk_seg_t;
+
 
 // VirtIO 扫描配置
 #define VIRTIO_SCAN_BASE_ADDR 0x0a000000  // Start scanning from 0x0a00_0000
@@ -215,6 +227,10 @@ virtio_blk_init(virtio_blk_device_t *blk_dev, uint64_t base_addr, uint32_t devic
 int
 virtio_blk_read_sector(virtio_blk_device_t *blk_dev, uint64_t sector, void *buffer, uint32_t count);
 int
+virtio_blk_read_segments(virtio_blk_device_t    *blk_dev,
+                         const virtio_blk_seg_t *segs,
+                         uint32_t                nsegs);
+int
 virtio_blk_write_sector(virtio_blk_device_t *blk_dev,
                         uint64_t             sector,
                         const void          *buffer,
@@ -258,6 +274,8 @@ avatar_get_virtio_block_device(void);
 int
 avatar_virtio_block_read(uint64_t sector, void *buffer, uint32_t sector_count);
 int
+avatar_virtio_block_read_segments(const virtio_blk_seg_t *segs, uint32_t nsegs);
+int
 avatar_virtio_block_write(uint64_t sector, const void *buffer, uint32_t sector_count);
 int
 avatar_virtio_block_get_info(uint64_t *capacity, uint32_t *block_size);
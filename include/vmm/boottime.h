@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file boottime.h
+ * @brief Implementation of boottime.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __BOOTTIME_H__
+#define __BOOTTIME_H__
+
+#include "avatar_types.h"
+#include "../guest/guest_manifest.h"
+
+struct _vm_t;
+
+/* 每个 VM 最多跟踪的控制台标记数 */
+#define BOOTTIME_MARKER_MAX 8
+
+/* 控制台行缓冲，标记必须出现在同一行内且不超过该长度 */
+#define BOOTTIME_LINE_MAX 128
+
+/* 固定的启动事件 */
+typedef enum
+{
+    BOOT_EV_LOAD_START = 0,  // 开始从文件系统加载镜像
+    BOOT_EV_LOAD_END,        // 镜像加载完成
+    BOOT_EV_FIRST_INSN,      // 主 vCPU 第一次进入 guest
+    BOOT_EV_FIRST_OUTPUT,    // guest 第一次写控制台
+    BOOT_EV_USERSPACE,       // userspace_marker 所在行之后的第一个字符
+    BOOT_EV_MAX
+} boot_event_t;
+
+/**
+ * 启动阶段时间戳，全部为 CNTPCT 值，0 表示尚未发生。
+ * 标记来自 guest 配置清单，按控制台输出逐字符匹配。
+ */
+typedef struct _vm_boottime_t
+{
+    uint64_t events[BOOT_EV_MAX];
+    uint64_t markers[BOOTTIME_MARKER_MAX];
+
+    const char *const *marker_str;  // 指向清单中的标记字符串
+    uint32_t           marker_len[BOOTTIME_MARKER_MAX];
+    uint32_t           marker_cnt;
+    uint32_t           marker_hit;  // 已命中的标记数
+
+    const char *userspace_marker;
+    uint32_t    userspace_len;
+    bool        userspace_seen;   // 已看到 userspace_marker，等待行尾
+    bool        userspace_armed;  // 已到下一行，下一个字符即用户态输出
+
+    bool     done;  // 所有事件都已记录，不再匹配
+    uint32_t line_len;
+    char     line[BOOTTIME_LINE_MAX];
+} vm_boottime_t;
+
+/**
+ * 按配置清单初始化，清除所有时间戳
+ */
+void
+boottime_init(vm_boottime_t *bt, const guest_manifest_t *manifest);
+
+/**
+ * 记录一个固定事件，只保留第一次发生的时刻
+ */
+void
+boottime_record(vm_boottime_t *bt, boot_event_t ev);
+
+/**
+ * guest 写控制台时逐字符调用，匹配标记并记录输出相关事件
+ */
+void
+boottime_console_char(vm_boottime_t *bt, char c);
+
+/**
+ * 按时间顺序打印各阶段的时刻和相邻阶段的耗时
+ */
+void
+boottime_dump(struct _vm_t *vm);
+
+#endif  // __BOOTTIME_H__
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file guest_image_cache.h
+ * @brief Implementation of guest_image_cache.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __GUEST_IMAGE_CACHE_H__
+#define __GUEST_IMAGE_CACHE_H__
+
+#include "avatar_types.h"
+#include "../guest/guest_manifest.h"
+
+/* 最多缓存镜像的配置清单数 */
+#define GUEST_IMAGE_CACHE_ENTRIES 8
+
+typedef enum
+{
+    GUEST_IMAGE_KERNEL = 0,
+    GUEST_IMAGE_DTB,
+    GUEST_IMAGE_INITRD,
+    GUEST_IMAGE_MAX
+} guest_image_kind_t;
+
+/* 一个镜像文件的原始副本 */
+typedef struct
+{
+    void    *data;   // kalloc_pages 分配，NULL 表示未缓存
+    size_t   size;   // 文件大小
+    uint32_t pages;  // data 占用的页数
+} guest_image_t;
+
+/* 每个配置清单一项，按清单指针查找 */
+typedef struct
+{
+    const guest_manifest_t *manifest;
+    guest_image_t           images[GUEST_IMAGE_MAX];
+    uint32_t                hits;  // 从缓存恢复的次数
+    uint32_t                busy;  // 正在锁外从副本拷贝的次数，非 0 时不能释放
+} guest_image_cache_entry_t;
+
+/**
+ * 把镜像复制到 load_addr，成功时返回 true 并通过 size 返回大小。
+ * 未缓存时返回 false，调用者需要从文件系统加载。
+ */
+bool
+guest_image_cache_restore(const guest_manifest_t *manifest,
+                          guest_image_kind_t      kind,
+                          uint64_t                load_addr,
+                          size_t                 *size);
+
+/**
+ * 把刚从文件读入的缓冲区交给缓存，成功后缓冲区归缓存所有。
+ * 超出 GUEST_IMAGE_CACHE_MAX 或表满时返回 false，缓冲区仍归调用者。
+ */
+bool
+guest_image_cache_put(const guest_manifest_t *manifest,
+                      guest_image_kind_t      kind,
+                      void                   *data,
+                      size_t                  size,
+                      uint32_t                pages);
+
+/**
+ * 该清单需要整体加载的镜像是否都已缓存（按需加载的 initrd 不计）
+ */
+bool
+guest_image_cache_complete(const guest_manifest_t *manifest);
+
+/**
+ * 丢弃缓存，manifest 为 NULL 时丢弃全部。磁盘上的镜像更新后需要调用
+ */
+void
+guest_image_cache_drop(const guest_manifest_t *manifest);
+
+/**
+ * 打印缓存内容和占用
+ */
+void
+guest_image_cache_dump(void);
+
+#endif  // __GUEST_IMAGE_CACHE_H__
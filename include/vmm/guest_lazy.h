@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file guest_lazy.h
+ * @brief Implementation of guest_lazy.h
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#ifndef __GUEST_LAZY_H__
+#define __GUEST_LAZY_H__
+
+#include "avatar_types.h"
+#include "exception.h"
+#include "fs/fat32_types.h"
+
+/* 最多同时存在的按需加载区域 */
+#define GUEST_LAZY_REGION_MAX 8
+
+/* 每次缺页时的预读窗口（页） */
+#define GUEST_LAZY_READAHEAD_PAGES 32
+
+/**
+ * 按需加载区域：一段 guest 物理内存由 FAT32 文件支撑，
+ * 对应的 stage-2 页表项在映射时被置为无效，首次访问时才从文件读入。
+ */
+typedef struct
+{
+    bool            in_use;
+    char            path[64];
+    paddr_t         gpa_start;    // 区域起始 GPA（页对齐）
+    size_t          file_size;    // 文件大小
+    size_t          region_size;  // 区域大小（页对齐）
+    /* 映射时解析好的簇链，缺页时不再访问 FAT 表 */
+    fat32_extent_t *extents;
+    uint32_t        extent_count;
+    /* 统计 */
+    uint32_t        faults;
+    uint32_t        pages_filled;
+} guest_lazy_region_t;
+
+/**
+ * 将文件映射为按需加载的 guest 内存区域
+ *
+ * @param filepath 文件路径
+ * @param gpa 区域起始 GPA（必须页对齐）
+ * @param mapped_size 输出参数，返回文件大小
+ * @return 0 成功，-1 失败
+ */
+int32_t
+guest_lazy_map_file(const char *filepath, paddr_t gpa, size_t *mapped_size);
+
+/**
+ * 解除与 [gpa, gpa + size) 重叠的所有按需加载区域，
+ * 未填充的页恢复为普通恒等映射
+ */
+void
+guest_lazy_unmap_range(paddr_t gpa, size_t size);
+
+/**
+ * 处理 stage-2 转换错误
+ *
+ * @return true 表示缺页已由按需加载区域处理，调用者应直接返回 guest
+ *         重新执行该指令（不推进 PC）
+ */
+bool
+guest_lazy_handle_fault(stage2_fault_info_t *info);
+
+/**
+ * 打印所有按需加载区域的状态
+ */
+void
+guest_lazy_dump(void);
+
+#endif  // __GUEST_LAZY_H__
@@ -120,7 +120,5 @@ save_cpu_ctx(trap_frame_t *);
 
 int32_t
 get_vcpuid(tcb_t *task);
-list_t *
-get_vcpus(tcb_t *task);  // if task==NULL, return current vm's vcpus
 
 #endif  // __VCPU_H__
\ No newline at end of file
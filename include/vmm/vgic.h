@@ -33,13 +33,17 @@ typedef struct _vgic_core_state_t
     uint32_t saved_elsr0;
     uint32_t saved_apr;
     uint32_t saved_hcr;
-    uint32_t saved_lr[GICH_LR_NUM];
+    gic_lr_t saved_lr[GICH_LR_NUM];
 
     uint32_t irq_pending_mask[SPI_ID_MAX / 32];  // 记录处于挂起状态的中断（IRQ）
     uint32_t pending_lr[SPI_ID_MAX];
 
     uint32_t sgi_ppi_isenabler;  // SGI+PPI enable register (GICD_ISENABLER(0))
     uint8_t  sgi_ppi_ipriorityr[GIC_FIRST_SPI];
+
+#if GIC_VERSION == 3
+    uint32_t gicr_waker;  // 虚拟 redistributor 的 GICR_WAKER
+#endif
 } vgic_core_state_t;
 
 typedef struct _vgic_t
@@ -62,12 +66,25 @@ typedef struct _vgic_t
     uint8_t  gicd_itargetsr[SPI_ID_MAX];
     uint32_t gicd_icfgr[SPI_ID_MAX / 16];
 
+#if GIC_VERSION == 3
+    // 亲和性路由 (GICD_IROUTER)
+    uint64_t gicd_irouter[SPI_ID_MAX];
+#endif
 } vgic_t;
 
 
 void
 intc_handler(stage2_fault_info_t *info, trap_frame_t *el2_ctx);
 
+#if GIC_VERSION == 3
+void
+vgicr_handler(stage2_fault_info_t *info, trap_frame_t *el2_ctx);
+void
+vgicd_banked_access(tcb_t *vcpu, stage2_fault_info_t *info, trap_frame_t *el2_ctx, paddr_t gpa);
+void
+vgic_sgi1r_write(uint64_t sgi1r);
+#endif
+
 void
 vgic_hw_inject_test(uint32_t vector);
 void
@@ -127,6 +144,29 @@ vgic_clear_irq_pending(vgic_core_state_t *vgicc, uint32_t irq_id)
     vgicc->irq_pending_mask[word_idx] &= ~(1U << bit_idx);
 }
 
+// vCPU 的亲和性 (Aff1.Aff0)，与 vmpidr_el1 和虚拟 GICR_TYPER 保持一致
+static inline uint32_t
+vgic_vcpu_affinity(int32_t vcpu_id)
+{
+#if GIC_VERSION == 3
+    // ICC_SGI1R_EL1 的 TargetList 只有 16 位，每 16 个 vCPU 换一个 Aff1
+    return ((uint32_t) (vcpu_id / 16) << 8) | (uint32_t) (vcpu_id % 16);
+#else
+    return (uint32_t) vcpu_id & 0xff;
+#endif
+}
+
+// vgic_vcpu_affinity 的逆运算：由 MPIDR 换算 vCPU 编号
+static inline uint32_t
+vgic_affinity_to_vcpu(uint64_t mpidr)
+{
+#if GIC_VERSION == 3
+    return (uint32_t) ((mpidr >> 8) & 0xff) * 16 + (uint32_t) (mpidr & 0xff);
+#else
+    return (uint32_t) (mpidr & 0xff);
+#endif
+}
+
 // 获取 SGI/PPI 的完整 pending 状态（软件 + 硬件）
 static uint32_t
 vgic_get_sgi_ppi_pending_status(vgic_core_state_t *vgicc)
@@ -138,14 +178,14 @@ vgic_get_sgi_ppi_pending_status(vgic_core_state_t *vgicc)
 
     // 2. 检查 GICH_LR 中的硬件注入 pending 状态
     for (int32_t lr = 0; lr < GICH_LR_NUM; lr++) {
-        uint32_t lr_val = vgicc->saved_lr[lr];
+        gic_lr_t lr_val = vgicc->saved_lr[lr];
         if (lr_val != 0)  // LR 不为空
         {
-            uint32_t vid   = lr_val & 0x3ff;        // Virtual ID
-            uint32_t state = (lr_val >> 28) & 0x3;  // State field
+            uint32_t vid   = gic_lr_read_vid(lr_val);    // Virtual ID
+            uint32_t state = gic_lr_read_state(lr_val);  // State field
 
             // 如果是 SGI/PPI 且处于 pending 状态
-            if (vid < 32 && (state == 1))  // state=1 表示 pending
+            if (vid < 32 && (state == GIC_LR_STATE_PENDING))
             {
                 pending_status |= (1U << vid);
             }
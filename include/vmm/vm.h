@@ -18,6 +18,7 @@
 
 #include "vcpu.h"
 #include "vgic.h"
+#include "boottime.h"
 #include "task/task.h"
 #include "../guest/guest_manifest.h"
 
@@ -37,8 +38,9 @@ struct _vm_t
 
     uint64_t entry;  // 虚拟机入口地址
     uint32_t vcpu_cnt;
-    list_t   vcpus;         // vcpu 列表
-    tcb_t   *primary_vcpu;  // 主 vcpu
+    tcb_t   *vcpu[VCPU_NUM_MAX];        // 按 vCPU 编号索引
+    void    *vcpu_stack[VCPU_NUM_MAX];  // vCPU 的 EL2 栈，VM_STACK_PAGES 页
+    tcb_t   *primary_vcpu;              // 主 vcpu，即 vcpu[0]
 
     vgic_t   *vgic;
     vtimer_t *vtimer;  // 虚拟定时器
@@ -48,6 +50,8 @@ struct _vm_t
     guest_type_t            guest_type;   // Guest类型
     const guest_manifest_t *manifest;     // Guest配置清单指针
     guest_load_result_t     load_result;  // 加载结果
+
+    vm_boottime_t boottime;  // 启动阶段时间戳
 };
 
 static inline uint64_t
@@ -66,6 +70,16 @@ read_hcr_el2()
     return value;
 }
 
+static inline void
+write_hcr_el2(uint64_t value)
+{
+    asm volatile("msr hcr_el2, %0\n"
+                 "isb"
+                 :
+                 : "r"(value)
+                 : "memory");
+}
+
 static inline uint64_t
 read_vttbr_el2()
 {
@@ -77,8 +91,18 @@ read_vttbr_el2()
 struct _vm_t *
 alloc_vm();
 void
+free_vm(struct _vm_t *vm);
+struct _vm_t *
+vm_get(uint32_t vm_id);
+uint32_t
+vm_count(void);
+int32_t
 vm_init_with_manifest(struct _vm_t *vm, const guest_manifest_t *manifest);
 void
 run_vm(struct _vm_t *vm);
+void
+vm_stop_vcpus(struct _vm_t *vm, tcb_t *except);
+void
+vm_release_cpus(struct _vm_t *vm);
 
 #endif  // __VM_H__
\ No newline at end of file
@@ -19,13 +19,20 @@
  * ============================================================================ */
 
 /* 虚拟机数量配置 */
-#define VCPU_NUM_MAX 8
+#if GIC_VERSION == 3
+    #define VCPU_NUM_MAX 16
+#else
+    #define VCPU_NUM_MAX 8
+#endif
 #define VM_NUM_MAX   4
+/* VM 结构体按需分配，VM 编号即 VTTBR 中的 8 位 VMID */
+#define VM_ID_MAX 256
 
 
 /* MMIO页面映射配置 */
 #define MMIO_PAGES_GICD  16
 #define MMIO_PAGES_GICC  16
+#define MMIO_PAGES_GICR  32  // 每个 vCPU 一个 redistributor 帧 (RD_base + SGI_base)
 #define MMIO_PAGES_PL011 1
 #define MMIO_PAGE_SIZE   0x1000
 
@@ -33,6 +40,9 @@
 #define PRIMARY_VCPU_PCPU_MASK   (1 << 0)  // 主vCPU绑定到pCPU 0
 #define SECONDARY_VCPU_PCPU_MASK (1 << 1)  // 从vCPU绑定到pCPU 1
 
+/* guest 镜像缓存：重启时从内存恢复内核/DTB/initrd 的总字节数上限 */
+#define GUEST_IMAGE_CACHE_MAX (256 * 1024 * 1024)
+
 /* 虚拟栈配置 */
 #define VM_STACK_PAGES 2                        // 每个vCPU分配2页栈空间
 #define VM_STACK_SIZE  (VM_STACK_PAGES * 4096)  // 8KB
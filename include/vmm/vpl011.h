@@ -93,6 +93,8 @@ typedef struct _vpl011_state_t
     uint8_t  rx_fifo[16];
     uint32_t tx_count;
     uint32_t rx_count;
+
+    struct _vm_t *vm; /* Owning virtual machine */
 } vpl011_state_t;
 
 
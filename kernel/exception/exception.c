@@ -18,22 +18,26 @@
 #include "timer.h"
 #include "vmm/vcpu.h"
 #include "thread.h"
+#include "syscall_num.h"
+#include "pro.h"
 
 // ESR_EL1 Exception Class definitions for EL1 exceptions
-#define ESR_EL1_EC_SVC 0x15  // SVC instruction execution
-#define ESR_EL1_EC_SMC 0x17  // SMC instruction execution
+#define ESR_EL1_EC_SVC      0x15  // SVC instruction execution
+#define ESR_EL1_EC_SMC      0x17  // SMC instruction execution
+#define ESR_EL1_EC_IABT_LOW 0x20  // Instruction abort from EL0
+#define ESR_EL1_EC_DABT_LOW 0x24  // Data abort from EL0
 
-// Maximum number of interrupt vectors
-#define MAX_IRQ_VECTORS 512
-
-// External symbol declarations
-extern void *syscall_table[];
+#define ESR_EL1_ISS_FSC_MASK  0x3F
+#define ESR_EL1_ISS_FSC_TRANS 0x04  // Translation fault, levels 0-3 are 0x04-0x07
+#define ESR_EL1_ISS_WNR       (1U << 6)
 
 // Static function declarations
 static void
 handle_svc_call(trap_frame_t *context, uint32_t esr);
 static void
 handle_smc_call_el1(trap_frame_t *context, uint32_t esr);
+static bool
+handle_user_abort(uint32_t esr, uint32_t ec);
 static void
 handle_unknown_sync_exception(trap_frame_t *context, uint32_t esr, uint32_t ec);
 static void
@@ -71,14 +75,42 @@ handle_sync_exception(uint64_t *stack_pointer)
             handle_smc_call_el1(context, esr_el1);
             break;
 
+        case ESR_EL1_EC_IABT_LOW:
+        case ESR_EL1_EC_DABT_LOW:
+            if (!handle_user_abort(esr_el1, ec))
+                handle_unknown_sync_exception(context, esr_el1, ec);
+            break;
+
         default:
             handle_unknown_sync_exception(context, esr_el1, ec);
             break;
     }
 }
 
+/**
+ * Resolve EL0 translation faults on file-backed mappings
+ * @return true if the page was mapped and the access can be retried
+ */
+static bool
+handle_user_abort(uint32_t esr, uint32_t ec)
+{
+    uint32_t fsc = esr & ESR_EL1_ISS_FSC_MASK;
+
+    if ((fsc & ~0x3U) != ESR_EL1_ISS_FSC_TRANS)
+        return false;
+
+    tcb_t *task = curr_task_el1();
+    if (!task)
+        return false;
+
+    bool is_write = ec == ESR_EL1_EC_DABT_LOW && (esr & ESR_EL1_ISS_WNR);
+    return pro_mmap_fault(task->curr_pro, read_far_el1(), is_write);
+}
+
 // Global interrupt handler vector table
 static irq_handler_t g_handler_vec[MAX_IRQ_VECTORS] = {0};
+// Per-vector handler flags (IRQ_F_*)
+static uint32_t g_irq_flags[MAX_IRQ_VECTORS] = {0};
 
 /**
  * Get the global interrupt handler vector table
@@ -112,6 +144,56 @@ irq_install(int32_t vector, void (*handler)(uint64_t *))
     // logger_debug("Installed IRQ handler for vector %d\n", vector);
 }
 
+/**
+ * Install an interrupt handler together with its GIC priority and flags.
+ * SGI/PPI priorities are banked per CPU, so call this on every CPU for them.
+ * @param vector: Interrupt vector number
+ * @param handler: Handler function pointer
+ * @param prio: Priority level (IRQ_PRIO_*)
+ * @param flags: IRQ_F_* flags
+ */
+void
+irq_install_prio(int32_t vector, irq_handler_t handler, uint32_t prio, uint32_t flags)
+{
+    irq_install(vector, handler);
+    if (vector < 0 || vector >= MAX_IRQ_VECTORS || !handler)
+        return;
+
+    g_irq_flags[vector] = flags;
+    gic_set_ipriority(vector, prio);
+}
+
+/**
+ * Get the flags of an installed interrupt handler
+ * @param vector: Interrupt vector number
+ * @return: IRQ_F_* flags, 0 for invalid vectors
+ */
+uint32_t
+irq_get_flags(int32_t vector)
+{
+    if (vector < 0 || vector >= MAX_IRQ_VECTORS)
+        return 0;
+    return g_irq_flags[vector];
+}
+
+/**
+ * Re-route every installed SPI currently targeting a CPU in cpu_mask to cpu.
+ * Used to keep device interrupts off CPUs dedicated to a VM.
+ * @param cpu_mask: Bitmap of CPUs to move interrupts away from
+ * @param cpu: New target CPU
+ */
+void
+irq_steer_spis(uint32_t cpu_mask, int32_t cpu)
+{
+    for (int32_t vector = GIC_FIRST_SPI; vector < MAX_IRQ_VECTORS; vector++) {
+        if (!g_handler_vec[vector] || !(gic_get_target(vector) & cpu_mask))
+            continue;
+
+        gic_set_target(vector, 1U << cpu);
+        logger_info("IRQ %d steered to CPU %d\n", vector, cpu);
+    }
+}
+
 /**
  * Handle IRQ exceptions from EL1
  * @param stack_pointer: Pointer to saved context on stack
@@ -199,6 +281,9 @@ invalid_exception(uint64_t *stack_pointer, uint64_t kind, uint64_t source)
 
 /**
  * Handle SVC (Supervisor Call) instructions from EL0
+ *
+ * 通用路径：带 SYSCALL_F_FRAME 的调用和快速路径无法处理的调用号（越界、空表项）
+ * 走这里，此时 trap frame 是完整的
  */
 static void
 handle_svc_call(trap_frame_t *context, uint32_t esr)
@@ -206,22 +291,19 @@ handle_svc_call(trap_frame_t *context, uint32_t esr)
     // Extract SVC number from X8 register (ARM64 calling convention)
     uint64_t svc_number = context->r[8];
 
-    // logger_debug("SVC call: number=%lu\n", svc_number);
-
-    // Validate SVC number (assuming syscall_table has reasonable bounds)
-    if (!syscall_table || !syscall_table[svc_number]) {
+    if (svc_number >= NR_SYSCALL || !syscall_table[svc_number].fn) {
         logger_error("Invalid SVC number: %lu\n", svc_number);
         context->r[0] = -1;  // Return error
         return;
     }
 
-    // Call the system call handler
-    // The context pointer contains all arguments in r[0]-r[7]
-    uint64_t (*syscall_func)(void *) = (uint64_t (*)(void *)) syscall_table[svc_number];
-    uint64_t result                  = syscall_func((void *) context);
-
-    // Store return value in X0
-    context->r[0] = result;
+    // Arguments are passed in x0-x5, return value goes back in x0
+    context->r[0] = syscall_table[svc_number].fn(context->r[0],
+                                                 context->r[1],
+                                                 context->r[2],
+                                                 context->r[3],
+                                                 context->r[4],
+                                                 context->r[5]);
 }
 
 /**
@@ -17,9 +17,11 @@
 #include "gic.h"
 #include "mem/stage2page.h"
 #include "vmm/vcpu.h"
+#include "vmm/vgic.h"
 #include "vmm/vtimer.h"
 #include "psci.h"
 #include "vmm/vpsci.h"
+#include "vmm/guest_lazy.h"
 #include "task/task.h"
 #include "thread.h"
 
@@ -35,6 +37,8 @@ handle_sysreg_access(union esr_el2 *esr, trap_frame_t *ctx);
 static void
 handle_illegal_execution_state(union esr_el2 *esr, trap_frame_t *ctx);
 static void
+handle_inst_abort(union esr_el2 *esr, trap_frame_t *ctx);
+static void
 handle_data_abort(union esr_el2 *esr, trap_frame_t *ctx);
 static void
 handle_unknown_exception(uint32_t ec, union esr_el2 *esr, trap_frame_t *ctx);
@@ -159,6 +163,10 @@ handle_sync_exception_el2(uint64_t *stack_pointer)
             handle_illegal_execution_state(&esr, ctx_el2);
             break;
 
+        case ESR_EC_INST_ABORT:
+            handle_inst_abort(&esr, ctx_el2);
+            break;
+
         case ESR_EC_DATA_ABORT:
             handle_data_abort(&esr, ctx_el2);
             break;
@@ -241,10 +249,19 @@ handle_smc_call(union esr_el2 *esr, trap_frame_t *ctx)
             ctx->r[0] = vpsci_cpu_on(ctx);
             break;
 
+        case PSCI_0_2_FN_SYSTEM_OFF:
+            logger_info("PSCI SYSTEM_OFF call\n");
+            ctx->r[0] = vpsci_system_off(ctx);
+            break;
+
         case PSCI_0_2_FN_SYSTEM_RESET:
             logger_info("PSCI CPU_RESET call\n");
-            ctx->r[0]    = vpsci_cpu_reset(ctx);
-            need_advance = false;
+            // 成功时 guest 从内核入口重新执行，x0 已设置为 DTB 地址
+            if (vpsci_cpu_reset(ctx) == PSCI_RET_SUCCESS) {
+                need_advance = false;
+            } else {
+                ctx->r[0] = PSCI_RET_INTERNAL_FAILURE;
+            }
             break;
 
         case PSCI_0_2_FN64_CPU_ON:
@@ -278,7 +295,7 @@ handle_smc_call(union esr_el2 *esr, trap_frame_t *ctx)
 static void
 handle_sysreg_access(union esr_el2 *esr, trap_frame_t *ctx)
 {
-    logger_info("System register access trapped\n");
+    logger_debug("System register access trapped\n");
 
     // Extract system register information
     uint32_t op0      = esr->sysreg.op0;
@@ -287,7 +304,7 @@ handle_sysreg_access(union esr_el2 *esr, trap_frame_t *ctx)
     uint32_t crm      = esr->sysreg.crm;
     uint32_t op2      = esr->sysreg.op2;
     uint32_t rt       = esr->sysreg.rt;
-    bool     is_write = esr->sysreg.direction;
+    bool     is_write = !esr->sysreg.direction;
 
     logger_debug("SysReg access: op0=%d, op1=%d, CRn=%d, CRm=%d, op2=%d, Rt=%d, %s\n",
                  op0,
@@ -298,6 +315,15 @@ handle_sysreg_access(union esr_el2 *esr, trap_frame_t *ctx)
                  rt,
                  is_write ? "write" : "read");
 
+#if GIC_VERSION == 3
+    // ICC_SGI1R_EL1 (S3_0_C12_C11_5)：HCR_EL2.IMO 置位时 guest 发送 SGI 会陷入
+    if (op0 == 3 && op1 == 0 && crn == 12 && crm == 11 && op2 == 5 && is_write) {
+        vgic_sgi1r_write(rt == 31 ? 0 : ctx->r[rt]);
+        advance_pc(esr, ctx);
+        return;
+    }
+#endif
+
     // TODO: Implement virtual timer register handling
     // if (handle_vtimer_sysreg_access(op0, op1, crn, crm, op2, rt, is_write, ctx)) {
     //     advance_pc(esr, ctx);
@@ -332,6 +358,32 @@ handle_illegal_execution_state(union esr_el2 *esr, trap_frame_t *ctx)
     }
 }
 
+/**
+ * Handle instruction abort exceptions from lower EL
+ */
+static void
+handle_inst_abort(union esr_el2 *esr, trap_frame_t *ctx)
+{
+    stage2_fault_info_t fault_info = {.esr = *esr, .reason = STAGE2_FAULT_PREFETCH};
+
+    uint64_t hpfar = read_hpfar_el2();
+    uint64_t far   = read_far_el2();
+
+    fault_info.gpa = (far & 0xFFF) | (hpfar << 8);
+    fault_info.gva = far;
+
+    // Instruction fetch from a lazily backed region: fill and retry, PC unchanged
+    if (guest_lazy_handle_fault(&fault_info)) {
+        return;
+    }
+
+    logger_error("Instruction abort: GVA=0x%lx, GPA=0x%lx, ESR=0x%x\n",
+                 fault_info.gva,
+                 fault_info.gpa,
+                 esr->bits);
+    handle_unknown_exception(ESR_EC_INST_ABORT, esr, ctx);
+}
+
 /**
  * Handle data abort exceptions from lower EL
  */
@@ -358,6 +410,11 @@ handle_data_abort(union esr_el2 *esr, trap_frame_t *ctx)
     //              fault_info.is_write ? "write" : "read",
     //              fault_info.access_size);
 
+    // Lazily backed guest memory: fill the page and re-execute the access
+    if (guest_lazy_handle_fault(&fault_info)) {
+        return;
+    }
+
     // Handle the stage2 page fault
     data_abort_handler(&fault_info, ctx);
 
@@ -385,6 +442,20 @@ handle_unknown_exception(uint32_t ec, union esr_el2 *esr, trap_frame_t *ctx)
     }
 }
 
+// 每核 EL2 中断嵌套深度：只在可抢占处理函数运行期间非零
+static uint32_t _irq_depth[SMP_NUM];
+
+/**
+ * Get the EL2 interrupt nesting depth of the current CPU.
+ * Non-zero means a preemptible handler is running and the current
+ * exception frame belongs to the hypervisor, not to the vCPU.
+ */
+uint32_t
+el2_irq_depth(void)
+{
+    return _irq_depth[get_current_cpu_id()];
+}
+
 /**
  * Handle IRQ exceptions trapped to EL2
  * @param stack_pointer: Pointer to saved context on stack
@@ -393,6 +464,7 @@ void
 handle_irq_exception_el2(uint64_t *stack_pointer)
 {
     trap_frame_t *ctx_el2 = (trap_frame_t *) stack_pointer;
+    uint32_t      cpu     = get_current_cpu_id();
 
     // Read interrupt acknowledge register to get the interrupt ID
     uint32_t iar    = gic_read_iar();
@@ -400,31 +472,64 @@ handle_irq_exception_el2(uint64_t *stack_pointer)
 
     // logger_debug("IRQ exception: IRQ_ID=%d\n", irq_id);
 
-    // Acknowledge the interrupt (End of Interrupt)
-    gic_write_eoir(iar);
+    // Spurious interrupt (1023) or out of table: nothing was acknowledged
+    if (irq_id >= MAX_IRQ_VECTORS) {
+        if (irq_id < 1020)
+            logger_warn("Invalid IRQ vector: %d\n", irq_id);
+        return;
+    }
+
+    irq_handler_t *handler_vec = get_g_handler_vec();
+    irq_handler_t  handler     = handler_vec ? handler_vec[irq_id] : NULL;
+    bool           preempt     = handler && (irq_get_flags(irq_id) & IRQ_F_PREEMPTIBLE);
 
     /*
+     * 不可抢占的处理函数（包括可能调度切走、不再返回这里的调度类中断）：
+     * 立即写 EOIR 做优先级下降，并写 DIR 失活。
+     *
      * IMPORTANT: For virtual interrupts injected to guests, do NOT write DIR in EL2!
      * Writing DIR would mark the interrupt as inactive immediately, preventing the
      * guest from receiving it. Only write DIR for interrupts that should be handled
      * entirely in the hypervisor.
      */
-    if (irq_id != 78 && irq_id != 79) {
-        gic_write_dir(iar);
-    } else {
-        logger_warn("should not write dir\n");
+    if (!preempt) {
+        gic_write_eoir(iar);
+        if (irq_id != 78 && irq_id != 79) {
+            gic_write_dir(iar);
+        } else {
+            logger_warn("should not write dir\n");
+        }
     }
 
-    // Save CPU context for interrupt handling
-    save_cpu_ctx(ctx_el2);
+    // 嵌套时 ctx_el2 是被抢占的处理函数的现场，不能覆盖任务保存的上下文
+    if (_irq_depth[cpu] == 0)
+        save_cpu_ctx(ctx_el2);
 
-    // Dispatch to the registered interrupt handler
-    irq_handler_t *handler_vec = get_g_handler_vec();
-    if (handler_vec && handler_vec[irq_id]) {
-        handler_vec[irq_id]((uint64_t *) ctx_el2);
-    } else {
+    if (!handler) {
         logger_warn("No handler registered for IRQ %d\n", irq_id);
+        return;
     }
+
+    if (!preempt) {
+        handler((uint64_t *) ctx_el2);
+        return;
+    }
+
+    /*
+     * 可抢占的处理函数：运行优先级保持为本中断的优先级，打开 IRQ 后
+     * 只有更高优先级的中断能够抢占。调度类中断处于最低优先级，不会在这里嵌套。
+     */
+    _irq_depth[cpu]++;
+    enable_interrupts();
+
+    handler((uint64_t *) ctx_el2);
+
+    disable_interrupts();
+    _irq_depth[cpu]--;
+
+    // 处理结束后才做优先级下降和失活
+    gic_write_eoir(iar);
+    gic_write_dir(iar);
 }
 
 /**
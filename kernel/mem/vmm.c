@@ -22,6 +22,7 @@
 #include "lib/avatar_string.h"
 #include "lib/avatar_assert.h"
 #include "mem/pmm.h"
+#include "mem/barrier.h"
 
 /* 内存管理宏定义现在由 mem/mem_utils.h 提供 */
 
@@ -147,6 +148,48 @@ find_pte(pte_t   *page_dir,  // 虚拟地址
     return &pte_base[GET_PTE_INDEX(vaddr)];
 }
 
+// perm: 0 EL0 读写，1 仅 EL1，2 设备内存，3 只读不可执行，4 EL0 只读可执行
+static void
+pte_set_perm(pte_t *pte, uint64_t perm)
+{
+    if (perm == 0) {
+        pte->l3_page.AF         = 1;
+        pte->l3_page.SH         = 3;  // Inner shareable
+        pte->l3_page.AP         = 1;
+        pte->l3_page.UXN        = 0;
+        pte->l3_page.PXN        = 1;
+        pte->l3_page.attr_index = 1;  // Normal memory
+    } else if (perm == 1) {
+        pte->l3_page.AF         = 1;
+        pte->l3_page.SH         = 3;  // Inner shareable
+        pte->l3_page.AP         = 0;
+        pte->l3_page.UXN        = 0;
+        pte->l3_page.PXN        = 0;
+        pte->l3_page.attr_index = 1;  // Normal memory
+    } else if (perm == 2) {
+        pte->l3_page.AF         = 1;
+        pte->l3_page.SH         = 3;  // Inner shareable
+        pte->l3_page.AP         = 0;
+        pte->l3_page.UXN        = 0;
+        pte->l3_page.PXN        = 0;
+        pte->l3_page.attr_index = 0;  // device memory
+    } else if (perm == 3) {
+        pte->l3_page.AF         = 1;
+        pte->l3_page.SH         = 3;  // Inner shareable
+        pte->l3_page.AP         = 3;  // EL0/EL1 只读
+        pte->l3_page.UXN        = 1;
+        pte->l3_page.PXN        = 1;
+        pte->l3_page.attr_index = 1;  // Normal memory
+    } else if (perm == 4) {
+        pte->l3_page.AF         = 1;
+        pte->l3_page.SH         = 3;  // Inner shareable
+        pte->l3_page.AP         = 3;  // EL0/EL1 只读
+        pte->l3_page.UXN        = 0;  // 共享代码页，EL0 可执行
+        pte->l3_page.PXN        = 1;
+        pte->l3_page.attr_index = 1;  // Normal memory
+    }
+}
+
 int32_t
 memory_create_map(pte_t *page_dir, uint64_t vaddr, uint64_t paddr, int32_t count, uint64_t perm)
 {
@@ -188,29 +231,7 @@ memory_create_map(pte_t *page_dir, uint64_t vaddr, uint64_t paddr, int32_t count
         pte_entry->l3_page.is_table = 1;
         pte_entry->l3_page.pfn      = (paddr >> 12) & 0xFFFFFFFFF;  // 36 bits PFN Page Frame Number
 
-        // 设置权限
-        if (perm == 0) {
-            pte_entry->l3_page.AF         = 1;
-            pte_entry->l3_page.SH         = 3;  // Inner shareable
-            pte_entry->l3_page.AP         = 1;
-            pte_entry->l3_page.UXN        = 0;
-            pte_entry->l3_page.PXN        = 1;
-            pte_entry->l3_page.attr_index = 1;  // Normal memory
-        } else if (perm == 1) {
-            pte_entry->l3_page.AF         = 1;
-            pte_entry->l3_page.SH         = 3;  // Inner shareable
-            pte_entry->l3_page.AP         = 0;
-            pte_entry->l3_page.UXN        = 0;
-            pte_entry->l3_page.PXN        = 0;
-            pte_entry->l3_page.attr_index = 1;  // Normal memory
-        } else if (perm == 2) {
-            pte_entry->l3_page.AF         = 1;
-            pte_entry->l3_page.SH         = 3;  // Inner shareable
-            pte_entry->l3_page.AP         = 0;
-            pte_entry->l3_page.UXN        = 0;
-            pte_entry->l3_page.PXN        = 0;
-            pte_entry->l3_page.attr_index = 0;  // device memory
-        }
+        pte_set_perm(pte_entry, perm);
 
         // 输出映射后的权限和地址信息
         // logger("Mapped PTE entry: is_valid=%d, pfn=0x%llx, AF=%d, SH=%d, AP=%d, UXN=%d, PXN=%d, attr_index=%d\n",
@@ -225,6 +246,49 @@ memory_create_map(pte_t *page_dir, uint64_t vaddr, uint64_t paddr, int32_t count
     return 0;
 }
 
+// 映射页缓存中的页：打上 PTE_SOFT_CACHE，释放和复制页表时都不碰这个页框
+int32_t
+memory_map_cache_page(pte_t *page_dir, uint64_t vaddr, uint64_t paddr, uint64_t perm)
+{
+    pte_t *pte = find_pte(page_dir, vaddr, 1);
+    if (pte == NULL || pte->l3_page.is_valid)
+        return -1;
+
+    pte->l3_page.pfn = (paddr >> 12) & 0xFFFFFFFFF;
+    pte_set_perm(pte, perm);
+    pte->l3_page.soft_reserved = PTE_SOFT_CACHE;
+    dsb(ishst);
+    pte->l3_page.is_table = 1;
+    pte->l3_page.is_valid = 1;  // 最后置有效位，其他核不会看到半成品
+    dsb(ishst);
+    isb();
+    return 0;
+}
+
+// 解除一页用户映射，非页缓存的页框一并释放
+void
+memory_unmap_page(pte_t *page_dir, uint64_t vaddr)
+{
+    pte_t *pte = find_pte(page_dir, vaddr, 0);
+    if (pte == NULL || !pte->l3_page.is_valid)
+        return;
+
+    uint64_t paddr  = pte->l3_page.pfn << 12;
+    bool     cached = pte->l3_page.soft_reserved & PTE_SOFT_CACHE;
+
+    pte->pte = 0;
+    __asm__ __volatile__("dsb ishst\n"
+                         "tlbi vaae1is, %0\n"
+                         "dsb ish\n"
+                         "isb"
+                         :
+                         : "r"(vaddr >> 12)
+                         : "memory");
+
+    if (!cached)
+        pmm_free_pages(&g_pmm, paddr, 1);
+}
+
 pte_t *
 current_page_dir()  // 返回物理地址
 {
@@ -243,6 +307,18 @@ memory_get_paddr(pte_t *page_dir, uint64_t vaddr)  // 返回物理地址
     return (pte->l3_page.pfn << 12) + (vaddr & (PAGE_SIZE - 1));
 }
 
+// vaddr 所在页已映射且 EL0 可访问；write 时还要求可写。AP[1] 置位表示 EL0 可访问，
+// AP[2] 置位表示只读
+bool
+memory_user_page_ok(pte_t *page_dir, uint64_t vaddr, bool write)
+{
+    pte_t *pte = find_pte(page_dir, vaddr, 0);
+
+    if (pte == NULL || !pte->l3_page.is_valid || !(pte->l3_page.AP & 1))
+        return false;
+    return !write || !(pte->l3_page.AP & 2);
+}
+
 uint64_t
 memory_alloc_page(pte_t   *page_dir,  // 虚拟地址
                   uint64_t vaddr,
@@ -350,6 +426,10 @@ _destroy_page_table_vm(pte_t *table, int32_t level)
         //        level, i, entry->table.is_valid, entry->l3_page.is_table, next_table_phys);
 
         if (level == 3) {
+            // 页缓存的页框由页缓存管理
+            if (entry->l3_page.soft_reserved & PTE_SOFT_CACHE)
+                continue;
+
             // PTE 层：释放实际映射的物理页
             uint64_t page_phys = entry->l3_page.pfn << 12;
             // logger("Level %d, Freeing physical page: 0x%llx\n", level, page_phys);
@@ -437,6 +517,12 @@ _copy_page_table(pte_t *src_table, pte_t *dst_table, int32_t level)
             // 第4级页表：实际映射的物理页
             uint64_t src_phys = src_entry->l3_page.pfn << 12;
 
+            // 页缓存的页父子进程共享，引用由映射它的 vma 计数
+            if (src_entry->l3_page.soft_reserved & PTE_SOFT_CACHE) {
+                dst_table[i].pte = src_entry->pte;
+                continue;
+            }
+
             uint64_t start = (uint64_t) (void *) __kernal_start;
             uint64_t end   = (uint64_t) (void *) __heap_flag + 0x900000ULL;
             end            = UP2(end, PAGE_SIZE);
@@ -23,6 +23,7 @@
 #include "../app/app.h"
 #include "sys/sys.h"
 #include "lib/avatar_assert.h"
+#include "clocksource.h"
 static process_t g_pro_dec[MAX_TASKS];
 
 process_t *
@@ -102,22 +103,9 @@ load_elf_file(process_t *pro, const char *elf_file_addr, pte_t *page_dir)
     Elf64_Ehdr *elf_hdr = (Elf64_Ehdr *) elf_file_addr;
     Elf64_Phdr  elf_phdr;
 
-    // ELF头部校验
-    if ((elf_hdr->e_ident[0] != 0x7f) || (elf_hdr->e_ident[1] != 'E') ||
-        (elf_hdr->e_ident[2] != 'L') || (elf_hdr->e_ident[3] != 'F')) {
-        logger("check elf indent failed.");
-        return 0;
-    }
-
-    // 确保是可执行文件并且是AArch64架构
-    if ((elf_hdr->e_type != 2) || (elf_hdr->e_machine != EM_AARCH64) || (elf_hdr->e_entry == 0)) {
-        logger("check elf type or entry failed.");
-        return 0;
-    }
-
-    // 必须有程序头
-    if ((elf_hdr->e_phentsize == 0) || (elf_hdr->e_phoff == 0)) {
-        logger("no program header");
+    // 校验魔数、类型、架构和程序头
+    if (!elf_header_valid(elf_hdr)) {
+        logger("check elf header failed.");
         return 0;
     }
 
@@ -128,7 +116,7 @@ load_elf_file(process_t *pro, const char *elf_file_addr, pte_t *page_dir)
         elf_phdr = *(Elf64_Phdr *) (elf_file_addr + e_phoff);
 
         // 确保该段是可加载类型，并且地址在用户空间范围内
-        if (elf_phdr.p_type != 1) {
+        if (elf_phdr.p_type != PT_LOAD) {
             continue;
         }
 
@@ -154,10 +142,16 @@ prepare_vm(process_t **process, void *elf_addr)
 
     pro->pg_base = (void *) create_uvm();
 
-    pro->entry =
-        load_elf_file(pro, elf_addr, (pte_t *) pro->pg_base);  // map data 区的一块内存 将来优化这里
+    if (pro->image)
+        pro->entry = pro_exec_load(pro, pro->image, pro->pg_base);
+    else
+        pro->entry = load_elf_file(pro, elf_addr, (pte_t *) pro->pg_base);
     logger("process entry: 0x%llx\n", pro->entry);
 
+    // 只读时间页，EL0 读时间不需要系统调用
+    if (clocksource_map_time_page((pte_t *) pro->pg_base) < 0)
+        logger("map time page failed\n");
+
     // 处理 EL1 的栈
     pro->el1_stack = kalloc_pages(2);
     // list_node_t * iter = list_first(&get_task_manager()->task_list);
@@ -206,7 +200,7 @@ run_process(process_t *pro)
     while (iter) {
         tcb_t *task = list_node_parent(iter, tcb_t, process_node);
         logger("run processs: task: 0x%x\n", task);
-        task_add_to_readylist_tail_remote(task, task->affinity - 1);
+        task_add_to_readylist_tail_remote(task, affinity_first_cpu(task->affinity));
         // task_add_to_readylist_tail(task);
         iter = list_node_next(iter);
     }
@@ -218,7 +212,11 @@ exit_process(process_t *pro)
     // 释放内存，把状态设置为退出
     // 这里 elf 物理地址释放的时候会有问题
     // 这里 el1 栈释放会重复释放
+    pro_file_close_all(pro);
+    pro_ioring_release(pro);
+    pro_mmap_release(pro);
     destroy_uvm_4level(pro->pg_base);
+    pro_exec_release(pro->image);
 
     free_process(pro);
 }
@@ -237,18 +235,28 @@ pro_execve(char *name, char **__argv, char **__envp)
         logger("argv[%d]: %s\n", i, __envp[i]);
     }
 
-    void *elf_addr = NULL;
-    strcpy(pro->process_name, get_file_name(name));  // 先把名字换过来
-    if (strcmp(pro->process_name, "add") == 0) {
+    void                      *elf_addr = NULL;
+    struct _fat32_pagecache_t *image    = NULL;
+
+    // 内置的 app 优先，其余的按路径从 FAT32 加载
+    if (strcmp(get_file_name(name), "add") == 0) {
         elf_addr = (void *) __add_bin_start;
-    } else if (strcmp(pro->process_name, "sub") == 0) {
+    } else if (strcmp(get_file_name(name), "sub") == 0) {
         elf_addr = (void *) __sub_bin_start;
-    } else {
+    } else if ((image = pro_exec_open(name)) == NULL) {
         logger("[warning]: app not support\n");
         return -1;
     }
+    strcpy(pro->process_name, get_file_name(name));  // 先把名字换过来
+
+    uint64_t                   old_page_dir = (uint64_t) pro->pg_base;
+    struct _fat32_pagecache_t *old_image    = pro->image;
+
+    pro->image = image;
 
-    uint64_t old_page_dir = (uint64_t) pro->pg_base;
+    // 队列页和文件映射随旧页表一起释放，新映像需要重新建立；打开的文件保留
+    pro_ioring_release(pro);
+    pro_mmap_release(pro);
 
     // 设置新的页表并切过去
     prepare_vm(&pro, elf_addr);
@@ -268,6 +276,7 @@ pro_execve(char *name, char **__argv, char **__envp)
     isb();
 
     destroy_uvm_4level((pte_t *) (void *) old_page_dir);  // 再释放掉了原进程的空间
+    pro_exec_release(old_image);                          // 旧映像的代码页已不再映射
     extern void exec_ret(void *);
     exec_ret(task);  // 这里有问题，原来的栈被破坏了。
 
@@ -296,7 +305,7 @@ pro_fork(void)
     tcb_t *child_task           = alloc_tcb();
     child_task->remaining_ticks = SYS_TASK_TICK;
     child_task->affinity        = curr->affinity;
-    list_insert_last(&get_task_manager()->task_list, &child_task->all_node);
+    task_list_add(child_task);
 
     memcpy((void *) (stack_top - sizeof(trap_frame_t)), curr->cpu_info->pctx, sizeof(trap_frame_t));
 
@@ -312,6 +321,9 @@ pro_fork(void)
 
     list_insert_last(&child_pro->threads, &child_task->process_node);
     child_pro->parent = pro;
+    pro_ioring_fork(pro, child_pro);
+    pro_mmap_fork(pro, child_pro);
+    pro_exec_fork(pro, child_pro);
 
     run_process(child_pro);
 
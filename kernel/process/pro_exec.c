@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file pro_exec.c
+ * @brief Implementation of pro_exec.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+/*
+ * 从 FAT32 加载 ELF 映像
+ *
+ * 映像通过文件页缓存读取，进程持有缓存的一个引用直到退出或再次 execve。
+ * 不可写的段整页直接映射缓存页框，同一个程序的多个进程共用一份代码，磁盘也只读
+ * 一次；可写段和含 bss 的尾页复制成进程私有页。
+ *
+ * 所有检查都在 pro_exec_open 里做完，execve 在拆掉旧映像之前就能失败返回。
+ */
+
+#include "pro.h"
+#include "elf.h"
+#include "io.h"
+#include "fs/fat32.h"
+#include "fs/fat32_pagecache.h"
+#include "mem/mem.h"
+#include "mem/kallocator.h"
+#include "lib/avatar_string.h"
+#include "ioring.h"
+
+// 段只能落在加载窗口内：app 链接在窗口起点，窗口上方依次是队列页、时间页，
+// mmap 区域和内核地址都在更高处
+#define EXEC_LOAD_BASE 0x80000000UL
+#define EXEC_LOAD_END  IORING_USER_VA
+#define EXEC_MAX_MEMSZ (64UL << 20)  // 所有段合计
+
+static bool
+exec_check_image(fat32_pagecache_t *pc)
+{
+    uint32_t          size = fat32_pagecache_size(pc);
+    const Elf64_Ehdr *hdr  = fat32_pagecache_page(pc, 0);
+
+    if (!hdr || size < sizeof(Elf64_Ehdr) || !elf_header_valid(hdr))
+        return false;
+
+    // 程序头表要求落在第一页内
+    uint64_t ph_end = hdr->e_phoff + (uint64_t) hdr->e_phnum * hdr->e_phentsize;
+    if (hdr->e_phentsize < sizeof(Elf64_Phdr) || ph_end > PAGE_SIZE || ph_end > size)
+        return false;
+
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < hdr->e_phnum; i++) {
+        const Elf64_Phdr *phdr =
+            (const Elf64_Phdr *) ((const char *) hdr + hdr->e_phoff + i * hdr->e_phentsize);
+
+        if (phdr->p_type != PT_LOAD)
+            continue;
+        if ((phdr->p_vaddr & (PAGE_SIZE - 1)) || (phdr->p_offset & (PAGE_SIZE - 1)) ||
+            phdr->p_filesz > phdr->p_memsz || phdr->p_filesz > size ||
+            phdr->p_offset > size - phdr->p_filesz)
+            return false;
+
+        // 先比较长度再做减法，p_vaddr + p_memsz 不会回绕
+        if (phdr->p_memsz > EXEC_MAX_MEMSZ || phdr->p_vaddr < EXEC_LOAD_BASE ||
+            phdr->p_vaddr > EXEC_LOAD_END - phdr->p_memsz)
+            return false;
+        total += phdr->p_memsz;
+        if (total > EXEC_MAX_MEMSZ)
+            return false;
+    }
+    return hdr->e_entry >= EXEC_LOAD_BASE && hdr->e_entry < EXEC_LOAD_END;
+}
+
+struct _fat32_pagecache_t *
+pro_exec_open(const char *path)
+{
+    fat32_file_handle_t *handle;
+    fat32_pagecache_t   *pc = NULL;
+
+    if (!path || !fat32_is_mounted())
+        return NULL;
+
+    fat32_lock();
+    if (fat32_file_open(g_fat32_context.disk,
+                        &g_fat32_context.fs_info,
+                        path,
+                        FAT32_O_RDONLY,
+                        &handle) == FAT32_OK) {
+        // 页缓存保留了自己的句柄，打开的文件可以立即关闭
+        pc = fat32_pagecache_get(handle);
+        fat32_file_close(g_fat32_context.disk, &g_fat32_context.fs_info, handle);
+    }
+    if (pc && !exec_check_image(pc)) {
+        logger_warn("exec: %s is not a loadable AArch64 executable\n", path);
+        fat32_pagecache_put(pc);
+        pc = NULL;
+    }
+    fat32_unlock();
+
+    return pc;
+}
+
+static int32_t
+exec_load_segment(fat32_pagecache_t *pc, const Elf64_Phdr *phdr, pte_t *page_dir)
+{
+    bool     shared = !(phdr->p_flags & PF_W);
+    uint64_t perm   = (phdr->p_flags & PF_X) ? 4 : 3;
+    uint64_t npages = (phdr->p_memsz + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    for (uint64_t i = 0; i < npages; i++) {
+        uint64_t va  = phdr->p_vaddr + i * PAGE_SIZE;
+        uint64_t off = i * PAGE_SIZE;
+        void    *src = NULL;
+
+        if (off < phdr->p_filesz) {
+            src = fat32_pagecache_page(pc, (phdr->p_offset + off) / PAGE_SIZE);
+            if (!src)
+                return -1;
+        }
+
+        // 只读段的页要么整页来自文件，要么段没有 bss，尾部多出的文件内容无害
+        bool whole = off + PAGE_SIZE <= phdr->p_filesz || phdr->p_memsz == phdr->p_filesz;
+        if (shared && src && whole) {
+            if (memory_map_cache_page(page_dir, va, virt_to_phys(src), perm) < 0)
+                return -1;
+            continue;
+        }
+
+        uint8_t *page = kalloc_pages(1);
+        if (!page)
+            return -1;
+
+        uint64_t n = 0;
+        if (src) {
+            n = phdr->p_filesz - off < PAGE_SIZE ? phdr->p_filesz - off : PAGE_SIZE;
+            memcpy(page, src, n);
+        }
+        memset(page + n, 0, PAGE_SIZE - n);
+
+        if (memory_create_map(page_dir, va, virt_to_phys(page), 1, shared ? perm : 0) < 0) {
+            kfree_pages(page, 1);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+uint64_t
+pro_exec_load(process_t *pro, struct _fat32_pagecache_t *image, void *page_dir)
+{
+    uint64_t entry = 0;
+
+    fat32_lock();
+    const Elf64_Ehdr *hdr = fat32_pagecache_page(image, 0);
+    if (!hdr)
+        goto out;
+
+    for (uint32_t i = 0; i < hdr->e_phnum; i++) {
+        const Elf64_Phdr *phdr =
+            (const Elf64_Phdr *) ((const char *) hdr + hdr->e_phoff + i * hdr->e_phentsize);
+
+        if (phdr->p_type != PT_LOAD)
+            continue;
+
+        if (exec_load_segment(image, phdr, (pte_t *) page_dir) < 0) {
+            logger("load program header failed");
+            goto out;
+        }
+
+        pro->heap_start = (void *) (phdr->p_vaddr + phdr->p_memsz);
+        pro->heap_end   = pro->heap_start;
+    }
+    entry = hdr->e_entry;
+
+out:
+    fat32_unlock();
+    return entry;
+}
+
+void
+pro_exec_fork(process_t *parent, process_t *child)
+{
+    child->image = parent->image;
+    if (child->image) {
+        fat32_lock();
+        fat32_pagecache_hold(child->image);
+        fat32_unlock();
+    }
+}
+
+// 调用前映像的页表项必须已经拆掉
+void
+pro_exec_release(struct _fat32_pagecache_t *image)
+{
+    if (!image)
+        return;
+
+    fat32_lock();
+    fat32_pagecache_put(image);
+    fat32_unlock();
+}
@@ -0,0 +1,299 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file pro_file.c
+ * @brief Implementation of pro_file.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+/*
+ * 进程文件描述符
+ *
+ * 每个进程一张 fd 表，表项直接保存 FAT32 文件句柄；fd 0-2 不占表项，
+ * 固定指向控制台。FAT32 层本身没有锁，所有文件操作都在 fat32_lock 下进行。
+ *
+ * 进程传入的地址先用 pro_user_range_ok 检查并缺页映射好。FAT32 会把缓冲区交给
+ * 块设备做 DMA，只认内核线性地址，所以文件数据经内核的中转页复制，路径先复制到内核。
+ */
+
+#include "pro.h"
+#include "io.h"
+#include "syscall_num.h"
+#include "fs/fat32.h"
+#include "fs/fat32_dir.h"
+#include "mem/mem.h"
+#include "mem/kallocator.h"
+#include "lib/avatar_string.h"
+
+#define PRO_BOUNCE_PAGES 16  // 单次中转的最大页数
+
+static fat32_file_handle_t *
+pro_file_get(process_t *pro, int32_t fd)
+{
+    if (fd < PRO_FD_FIRST || fd >= PRO_MAX_FILES)
+        return NULL;
+    return (fat32_file_handle_t *) pro->files[fd];
+}
+
+// 按 off 定位；PRO_OFF_CUR 表示沿用当前位置
+static bool
+pro_file_seek(fat32_file_handle_t *handle, uint64_t off)
+{
+    if (off == PRO_OFF_CUR)
+        return true;
+    if (off > 0x7fffffffULL)
+        return false;
+    return fat32_file_seek(handle, (int32_t) off, FAT32_SEEK_SET, NULL) == FAT32_OK;
+}
+
+// 把进程的路径字符串复制到 kbuf，逐页检查可读；超过 size 或地址非法时失败
+static bool
+pro_user_path(process_t *pro, const char *upath, char *kbuf, uint32_t size)
+{
+    uint64_t addr = (uint64_t) upath;
+
+    for (uint32_t i = 0; i < size; i++, addr++) {
+        if ((i == 0 || (addr & (PAGE_SIZE - 1)) == 0) && !pro_user_range_ok(pro, addr, 1, false))
+            return false;
+        kbuf[i] = *(const char *) addr;
+        if (kbuf[i] == '\0')
+            return true;
+    }
+    return false;
+}
+
+// 经中转页在文件和进程缓冲区之间复制 len 字节，调用者已检查过 buf。
+// 返回实际读写的字节数，第一块就失败时返回 -1
+static int64_t
+pro_file_xfer(fat32_file_handle_t *handle, void *buf, uint64_t len, uint64_t off, bool write)
+{
+    uint64_t size   = len < PRO_BOUNCE_PAGES * PAGE_SIZE ? len : PRO_BOUNCE_PAGES * PAGE_SIZE;
+    uint64_t pages  = UP2(size, PAGE_SIZE) / PAGE_SIZE;
+    uint64_t done   = 0;
+    char    *bounce = NULL;
+    bool     ok;
+
+    if (len > 0) {
+        bounce = kalloc_pages(pages);
+        if (!bounce)
+            return -1;
+    }
+
+    fat32_lock();
+    ok = pro_file_seek(handle, off);
+    while (ok && done < len) {
+        uint32_t chunk = len - done < size ? len - done : size;
+        uint32_t n     = 0;
+
+        if (write) {
+            memcpy(bounce, (char *) buf + done, chunk);
+            ok = fat32_file_write(
+                     g_fat32_context.disk, &g_fat32_context.fs_info, handle, bounce, chunk, &n) ==
+                 FAT32_OK;
+        } else {
+            ok = fat32_file_read(
+                     g_fat32_context.disk, &g_fat32_context.fs_info, handle, bounce, chunk, &n) ==
+                 FAT32_OK;
+            if (ok)
+                memcpy((char *) buf + done, bounce, n);
+        }
+        if (!ok)
+            break;
+        done += n;
+        if (n < chunk)
+            break;
+    }
+    fat32_unlock();
+
+    if (bounce)
+        kfree_pages(bounce, pages);
+    return ok || done ? (int64_t) done : -1;
+}
+
+int64_t
+pro_file_open(process_t *pro, const char *path, uint32_t flags)
+{
+    fat32_file_handle_t *handle;
+    int32_t              fd;
+    char                *kpath;
+
+    if (!path || !fat32_is_mounted())
+        return -1;
+
+    for (fd = PRO_FD_FIRST; fd < PRO_MAX_FILES; fd++) {
+        if (!pro->files[fd])
+            break;
+    }
+    if (fd == PRO_MAX_FILES)
+        return -1;
+
+    flags &= O_RDWR | O_CREAT | O_TRUNC | O_APPEND;
+    if (!(flags & O_RDWR))
+        flags |= O_RDONLY;
+
+    kpath = kalloc(FAT32_MAX_PATH, 8);
+    if (!kpath)
+        return -1;
+    if (!pro_user_path(pro, path, kpath, FAT32_MAX_PATH)) {
+        kfree(kpath);
+        return -1;
+    }
+
+    fat32_lock();
+    fat32_error_t err = fat32_file_open(g_fat32_context.disk,
+                                        &g_fat32_context.fs_info,
+                                        kpath,
+                                        flags,
+                                        &handle);
+    fat32_unlock();
+    kfree(kpath);
+
+    if (err != FAT32_OK)
+        return -1;
+
+    pro->files[fd] = handle;
+    return fd;
+}
+
+int64_t
+pro_file_read(process_t *pro, int32_t fd, void *buf, uint64_t len, uint64_t off)
+{
+    fat32_file_handle_t *handle;
+
+    if (!pro_user_range_ok(pro, (uint64_t) buf, len, true))
+        return -1;
+
+    // 控制台没有缓冲，一次返回一个字符
+    if (fd == 0) {
+        if (len == 0)
+            return 0;
+        *(char *) buf = getc();
+        return 1;
+    }
+
+    handle = pro_file_get(pro, fd);
+    if (!handle)
+        return -1;
+    if (len > 0xffffffffULL)
+        len = 0xffffffffULL;
+
+    return pro_file_xfer(handle, buf, len, off, false);
+}
+
+int64_t
+pro_file_write(process_t *pro, int32_t fd, const void *buf, uint64_t len, uint64_t off)
+{
+    fat32_file_handle_t *handle;
+
+    if (!pro_user_range_ok(pro, (uint64_t) buf, len, false))
+        return -1;
+
+    if (fd == 1 || fd == 2) {
+        const char *p = (const char *) buf;
+        for (uint64_t i = 0; i < len; i++)
+            putc(p[i]);
+        return len;
+    }
+
+    handle = pro_file_get(pro, fd);
+    if (!handle)
+        return -1;
+    if (len > 0xffffffffULL)
+        len = 0xffffffffULL;
+
+    return pro_file_xfer(handle, (void *) buf, len, off, true);
+}
+
+int64_t
+pro_file_lseek(process_t *pro, int32_t fd, int64_t offset, int32_t whence)
+{
+    fat32_file_handle_t *handle = pro_file_get(pro, fd);
+    uint32_t             pos;
+
+    if (!handle || offset > 0x7fffffffLL || offset < -0x7fffffffLL)
+        return -1;
+
+    fat32_lock();
+    fat32_error_t err = fat32_file_seek(handle, (int32_t) offset, whence, &pos);
+    fat32_unlock();
+
+    return err == FAT32_OK ? (int64_t) pos : -1;
+}
+
+int64_t
+pro_file_stat(process_t *pro, const char *path, file_stat_t *st)
+{
+    fat32_dir_entry_t entry;
+    char             *kpath;
+
+    if (!path || !fat32_is_mounted())
+        return -1;
+    if (!st || !pro_user_range_ok(pro, (uint64_t) st, sizeof(*st), true))
+        return -1;
+
+    kpath = kalloc(FAT32_MAX_PATH, 8);
+    if (!kpath)
+        return -1;
+    if (!pro_user_path(pro, path, kpath, FAT32_MAX_PATH)) {
+        kfree(kpath);
+        return -1;
+    }
+
+    fat32_lock();
+    fat32_error_t err = fat32_stat(kpath, &entry);
+    fat32_unlock();
+    kfree(kpath);
+
+    if (err != FAT32_OK)
+        return -1;
+
+    st->size   = entry.file_size;
+    st->attr   = entry.attr;
+    st->is_dir = fat32_dir_is_directory(&entry);
+    return 0;
+}
+
+int64_t
+pro_file_fstat(process_t *pro, int32_t fd, file_stat_t *st)
+{
+    fat32_file_handle_t *handle = pro_file_get(pro, fd);
+
+    if (!handle || !st || !pro_user_range_ok(pro, (uint64_t) st, sizeof(*st), true))
+        return -1;
+
+    st->size   = handle->file_size;
+    st->attr   = handle->attr;
+    st->is_dir = 0;
+    return 0;
+}
+
+int64_t
+pro_file_close(process_t *pro, int32_t fd)
+{
+    fat32_file_handle_t *handle = pro_file_get(pro, fd);
+
+    if (!handle)
+        return -1;
+
+    pro->files[fd] = NULL;
+
+    fat32_lock();
+    fat32_error_t err = fat32_file_close(g_fat32_context.disk, &g_fat32_context.fs_info, handle);
+    fat32_unlock();
+
+    return err == FAT32_OK ? 0 : -1;
+}
+
+void
+pro_file_close_all(process_t *pro)
+{
+    for (int32_t fd = PRO_FD_FIRST; fd < PRO_MAX_FILES; fd++) {
+        if (pro->files[fd])
+            pro_file_close(pro, fd);
+    }
+}
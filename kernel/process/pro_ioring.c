@@ -0,0 +1,255 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file pro_ioring.c
+ * @brief Implementation of pro_ioring.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+/*
+ * 进程的提交/完成队列
+ *
+ * 队列页由内核分配，同时映射到进程的 IORING_USER_VA，内核通过自己的线性地址
+ * 访问。读写、打开、关闭在 ring_enter 中同步执行并立即产生完成项；超时只记录
+ * 截止时间，由之后的 ring_enter 检查到期，需要等待时按最早的截止时间睡眠。
+ *
+ * 队列页挂在进程页表上，随 destroy_uvm_4level 一起释放；这里只管理内核侧状态。
+ */
+
+#include "pro.h"
+#include "ioring.h"
+#include "hrtimer.h"
+#include "timer.h"
+#include "io.h"
+#include "task/task.h"
+#include "mem/mem.h"
+#include "mem/barrier.h"
+#include "mem/kallocator.h"
+#include "lib/avatar_string.h"
+
+#define IORING_MAX_TIMEOUTS 16
+
+_Static_assert(sizeof(ioring_t) <= IORING_PAGES * PAGE_SIZE, "ioring_t must fit IORING_PAGES");
+_Static_assert(IORING_OFF_CUR == PRO_OFF_CUR, "sqe->off is passed to pro_file_* unchanged");
+
+typedef struct
+{
+    uint64_t user_data;
+    uint64_t deadline;  // CNTPCT
+} ioring_timeout_t;
+
+typedef struct _ioring_ctx_t
+{
+    ioring_t        *ring;  // 内核线性地址
+    uint32_t         ntimeouts;
+    ioring_timeout_t timeouts[IORING_MAX_TIMEOUTS];
+} ioring_ctx_t;
+
+int64_t
+pro_ioring_setup(process_t *pro)
+{
+    if (pro->ioring)
+        return IORING_USER_VA;
+
+    ioring_ctx_t *ctx  = kalloc(sizeof(ioring_ctx_t), 8);
+    ioring_t     *ring = kalloc_pages(IORING_PAGES);
+    if (!ctx || !ring)
+        goto fail;
+
+    memset(ring, 0, IORING_PAGES * PAGE_SIZE);
+    ring->sq_entries = IORING_ENTRIES;
+    ring->cq_entries = IORING_CQ_ENTRIES;
+
+    if (memory_create_map(pro->pg_base, IORING_USER_VA, virt_to_phys(ring), IORING_PAGES, 0) < 0)
+        goto fail;
+    dsb(ishst);
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ring   = ring;
+    pro->ioring = ctx;
+    return IORING_USER_VA;
+
+fail:
+    logger_warn("ioring: setup failed for process %u\n", pro->process_id);
+    if (ring)
+        kfree_pages(ring, IORING_PAGES);
+    if (ctx)
+        kfree(ctx);
+    return -1;
+}
+
+static void
+ioring_post(ioring_ctx_t *ctx, uint64_t user_data, int64_t res)
+{
+    ioring_t *ring = ctx->ring;
+    uint32_t  tail = ring->cq_tail;
+
+    if (tail - ioring_load_acquire(&ring->cq_head) >= IORING_CQ_ENTRIES) {
+        ring->cq_overflow++;
+        return;
+    }
+
+    ioring_cqe_t *cqe = &ring->cqes[tail & (IORING_CQ_ENTRIES - 1)];
+    cqe->user_data    = user_data;
+    cqe->res          = res;
+    ioring_store_release(&ring->cq_tail, tail + 1);
+}
+
+static uint32_t
+ioring_cq_ready(ioring_ctx_t *ctx)
+{
+    return ctx->ring->cq_tail - ioring_load_acquire(&ctx->ring->cq_head);
+}
+
+// 为到期的超时产生完成项，返回最早的未到期截止时间，没有时返回 0
+static uint64_t
+ioring_reap_timeouts(ioring_ctx_t *ctx)
+{
+    uint64_t now   = read_cntpct_el0();
+    uint64_t first = 0;
+
+    for (uint32_t i = 0; i < ctx->ntimeouts;) {
+        ioring_timeout_t *t = &ctx->timeouts[i];
+        if (t->deadline <= now) {
+            ioring_post(ctx, t->user_data, 0);
+            *t = ctx->timeouts[--ctx->ntimeouts];
+            continue;
+        }
+        if (!first || t->deadline < first)
+            first = t->deadline;
+        i++;
+    }
+    return first;
+}
+
+static void
+ioring_issue(process_t *pro, ioring_ctx_t *ctx, const ioring_sqe_t *sqe)
+{
+    int64_t res;
+
+    switch (sqe->opcode) {
+        case IORING_OP_NOP:
+            res = 0;
+            break;
+
+        case IORING_OP_READ:
+            res = pro_file_read(pro, sqe->fd, (void *) sqe->addr, sqe->len, sqe->off);
+            break;
+
+        case IORING_OP_WRITE:
+            res = pro_file_write(pro, sqe->fd, (const void *) sqe->addr, sqe->len, sqe->off);
+            break;
+
+        case IORING_OP_OPEN:
+            res = pro_file_open(pro, (const char *) sqe->addr, (uint32_t) sqe->len);
+            break;
+
+        case IORING_OP_CLOSE:
+            res = pro_file_close(pro, sqe->fd);
+            break;
+
+        case IORING_OP_TIMEOUT:
+            if (ctx->ntimeouts == IORING_MAX_TIMEOUTS) {
+                res = -1;
+                break;
+            }
+            ctx->timeouts[ctx->ntimeouts].user_data = sqe->user_data;
+            ctx->timeouts[ctx->ntimeouts].deadline =
+                read_cntpct_el0() + hrtimer_us_to_ticks(sqe->len);
+            ctx->ntimeouts++;
+            return;  // 到期时才产生完成项
+
+        default:
+            res = -1;
+            break;
+    }
+
+    ioring_post(ctx, sqe->user_data, res);
+}
+
+int64_t
+pro_ioring_enter(process_t *pro, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+{
+    ioring_ctx_t *ctx = pro->ioring;
+    if (!ctx)
+        return -1;
+
+    ioring_t *ring  = ctx->ring;
+    uint32_t  head  = ring->sq_head;
+    uint32_t  avail = ioring_load_acquire(&ring->sq_tail) - head;
+
+    if (avail > IORING_ENTRIES)
+        return -1;  // sq_tail 被写坏
+    if (to_submit > avail)
+        to_submit = avail;
+
+    for (uint32_t i = 0; i < to_submit; i++) {
+        // 先复制出来再归还槽位，执行期间进程改写该槽位不影响本次操作
+        ioring_sqe_t sqe = ring->sqes[head & (IORING_ENTRIES - 1)];
+        ioring_store_release(&ring->sq_head, ++head);
+        ioring_issue(pro, ctx, &sqe);
+    }
+
+    uint64_t next = ioring_reap_timeouts(ctx);
+
+    if (flags & IORING_ENTER_GETEVENTS) {
+        // 其他操作都已同步完成，还能等到的只有超时
+        while (ioring_cq_ready(ctx) < min_complete && next) {
+            uint64_t now = read_cntpct_el0();
+            if (next > now)
+                task_sleep_us(hrtimer_ticks_to_us(next - now) + 1);
+            next = ioring_reap_timeouts(ctx);
+        }
+    }
+
+    return to_submit;
+}
+
+// 子进程的页表是父进程的副本，但队列页是逐页复制的，物理上不连续，而内核按线性
+// 地址访问整个 ioring_t。换成一组连续的新页映射到 IORING_USER_VA，再复制父进程的队列
+void
+pro_ioring_fork(process_t *parent, process_t *child)
+{
+    if (!parent->ioring)
+        return;
+
+    ioring_ctx_t *ctx  = kalloc(sizeof(ioring_ctx_t), 8);
+    ioring_t     *ring = kalloc_pages(IORING_PAGES);
+    if (!ctx || !ring)
+        goto fail;
+
+    // 复制出来的页随解除映射释放
+    for (uint32_t i = 0; i < IORING_PAGES; i++)
+        memory_unmap_page(child->pg_base, IORING_USER_VA + i * PAGE_SIZE);
+    if (memory_create_map(child->pg_base, IORING_USER_VA, virt_to_phys(ring), IORING_PAGES, 0) < 0)
+        goto fail;
+
+    memcpy(ring, parent->ioring->ring, IORING_PAGES * PAGE_SIZE);
+    dsb(ishst);
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->ring     = ring;
+    child->ioring = ctx;
+    return;
+
+fail:
+    logger_warn("ioring: process %u starts without a ring\n", child->process_id);
+    if (ring)
+        kfree_pages(ring, IORING_PAGES);
+    if (ctx)
+        kfree(ctx);
+}
+
+void
+pro_ioring_release(process_t *pro)
+{
+    if (pro->ioring) {
+        kfree(pro->ioring);
+        pro->ioring = NULL;
+    }
+}
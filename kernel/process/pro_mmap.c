@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file pro_mmap.c
+ * @brief Implementation of pro_mmap.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+/*
+ * 文件映射
+ *
+ * mmap 只登记区域，不建页表；进程第一次访问某页时触发缺页，由 pro_mmap_fault
+ * 从文件页缓存取页并映射。共享映射直接映射缓存页框（只读，多个进程看到同一份），
+ * 私有可写映射在缺页时复制一份，写入不回写文件。
+ *
+ * 区域地址从 PRO_MMAP_BASE 向上顺序分配，munmap 只接受整个区域。
+ */
+
+#include "pro.h"
+#include "io.h"
+#include "syscall_num.h"
+#include "fs/fat32.h"
+#include "fs/fat32_pagecache.h"
+#include "mem/mem.h"
+#include "mem/page.h"
+#include "mem/kallocator.h"
+#include "lib/avatar_string.h"
+
+#define PAGE_ALIGN_UP(x) (((x) + PAGE_SIZE - 1) & ~((uint64_t) PAGE_SIZE - 1))
+
+static pro_vma_t *
+pro_vma_find(process_t *pro, uint64_t addr)
+{
+    for (int32_t i = 0; i < PRO_MAX_VMAS; i++) {
+        pro_vma_t *vma = &pro->vmas[i];
+        if (vma->start && addr >= vma->start && addr < vma->end)
+            return vma;
+    }
+    return NULL;
+}
+
+int64_t
+pro_mmap(process_t *pro, uint64_t len, uint32_t prot, uint32_t flags, int32_t fd, uint64_t off)
+{
+    fat32_file_handle_t *handle;
+    pro_vma_t           *vma = NULL;
+
+    if (len == 0 || (off & (PAGE_SIZE - 1)) || !(prot & PROT_READ))
+        return -1;
+    if ((flags & (MAP_SHARED | MAP_PRIVATE)) == 0 ||
+        (flags & (MAP_SHARED | MAP_PRIVATE)) == (MAP_SHARED | MAP_PRIVATE))
+        return -1;
+    // 共享映射直接用缓存页框，写入无法回写到磁盘，只支持只读
+    if ((flags & MAP_SHARED) && (prot & PROT_WRITE))
+        return -1;
+    if (fd < PRO_FD_FIRST || fd >= PRO_MAX_FILES || !pro->files[fd])
+        return -1;
+    handle = (fat32_file_handle_t *) pro->files[fd];
+
+    for (int32_t i = 0; i < PRO_MAX_VMAS; i++) {
+        if (!pro->vmas[i].start) {
+            vma = &pro->vmas[i];
+            break;
+        }
+    }
+    if (!vma)
+        return -1;
+
+    fat32_lock();
+    fat32_pagecache_t *pc = fat32_pagecache_get(handle);
+    fat32_unlock();
+    if (!pc)
+        return -1;
+
+    if (!pro->mmap_next)
+        pro->mmap_next = PRO_MMAP_BASE;
+
+    len          = PAGE_ALIGN_UP(len);
+    vma->start   = pro->mmap_next;
+    vma->end     = vma->start + len;
+    vma->pgoff   = off / PAGE_SIZE;
+    vma->prot    = prot;
+    vma->flags   = flags;
+    vma->file    = pc;
+    // 区域之间留一页空洞，越界访问直接出错
+    pro->mmap_next = vma->end + PAGE_SIZE;
+
+    return vma->start;
+}
+
+bool
+pro_mmap_fault(process_t *pro, uint64_t addr, bool is_write)
+{
+    if (!pro)
+        return false;
+
+    pro_vma_t *vma = pro_vma_find(pro, addr);
+    if (!vma || (is_write && !(vma->prot & PROT_WRITE)))
+        return false;
+
+    uint64_t va    = addr & ~((uint64_t) PAGE_SIZE - 1);
+    uint64_t index = vma->pgoff + (va - vma->start) / PAGE_SIZE;
+    bool     copy  = (vma->flags & MAP_PRIVATE) && (vma->prot & PROT_WRITE);
+    int32_t  ret;
+
+    fat32_lock();
+    void *page = index <= 0xffffffffULL ? fat32_pagecache_page(vma->file, index) : NULL;
+
+    if (copy || !page) {
+        // 私有可写页复制一份；超出文件末尾的部分给零页
+        void *priv = kalloc_pages(1);
+        if (!priv) {
+            fat32_unlock();
+            return false;
+        }
+        if (page)
+            memcpy(priv, page, PAGE_SIZE);
+        else
+            memset(priv, 0, PAGE_SIZE);
+        fat32_unlock();
+
+        ret = memory_create_map(pro->pg_base, va, virt_to_phys(priv), 1, copy ? 0 : 3);
+        if (ret < 0)
+            kfree_pages(priv, 1);
+    } else {
+        ret = memory_map_cache_page(pro->pg_base, va, virt_to_phys(page), 3);
+        fat32_unlock();
+    }
+
+    return ret >= 0;
+}
+
+// [addr, addr + len) 整段都是进程可访问的用户地址。文件映射中还没建立的页在这里
+// 缺页映射好，之后内核直接访问不会在 EL1 触发缺页。缺页要取 fat32_lock，
+// 调用者必须在加锁之前检查
+bool
+pro_user_range_ok(process_t *pro, uint64_t addr, uint64_t len, bool write)
+{
+    if (len == 0)
+        return true;
+    if (!pro || !addr || len > PRO_USER_VA_END || addr > PRO_USER_VA_END - len)
+        return false;
+
+    uint64_t va  = addr & ~((uint64_t) PAGE_SIZE - 1);
+    uint64_t end = addr + len;
+    for (; va < end; va += PAGE_SIZE) {
+        if (memory_user_page_ok(pro->pg_base, va, write))
+            continue;
+        if (!pro_mmap_fault(pro, va, write) || !memory_user_page_ok(pro->pg_base, va, write))
+            return false;
+    }
+    return true;
+}
+
+int64_t
+pro_munmap(process_t *pro, uint64_t addr, uint64_t len)
+{
+    pro_vma_t *vma = pro_vma_find(pro, addr);
+
+    if (!vma || vma->start != addr || PAGE_ALIGN_UP(len) != vma->end - vma->start)
+        return -1;
+
+    for (uint64_t va = vma->start; va < vma->end; va += PAGE_SIZE)
+        memory_unmap_page(pro->pg_base, va);
+
+    fat32_lock();
+    fat32_pagecache_put(vma->file);
+    fat32_unlock();
+
+    memset(vma, 0, sizeof(*vma));
+    return 0;
+}
+
+// 已映射的页随页表一起复制（缓存页共享），这里只复制区域并增加缓存引用
+void
+pro_mmap_fork(process_t *parent, process_t *child)
+{
+    fat32_lock();
+    for (int32_t i = 0; i < PRO_MAX_VMAS; i++) {
+        child->vmas[i] = parent->vmas[i];
+        if (child->vmas[i].start)
+            fat32_pagecache_hold(child->vmas[i].file);
+    }
+    fat32_unlock();
+    child->mmap_next = parent->mmap_next;
+}
+
+// 页表项由 destroy_uvm_4level 处理，缓存页不会被释放
+void
+pro_mmap_release(process_t *pro)
+{
+    fat32_lock();
+    for (int32_t i = 0; i < PRO_MAX_VMAS; i++) {
+        if (pro->vmas[i].start)
+            fat32_pagecache_put(pro->vmas[i].file);
+    }
+    fat32_unlock();
+
+    memset(pro->vmas, 0, sizeof(pro->vmas));
+    pro->mmap_next = 0;
+}
@@ -19,53 +19,180 @@
 #include "mem/mem.h"
 #include "pro.h"
 
-uint64_t
-_debug(void *args)
+// 参数直接来自 x0-x5。除带 SYSCALL_F_FRAME 的调用外，都在 exception.S 的快速路径中
+// 执行：入口只保存调用者保存寄存器，trap frame 中 x19-x29 的位置未填写
+// 指针参数原样转给 pro_file_*，由它们用 pro_user_range_ok 检查并缺页映射
+
+_Static_assert(sizeof(syscall_entry_t) == 16, "exception.S indexes syscall_table with lsl #4");
+
+static uint64_t
+sys_debug(uint64_t a, uint64_t b, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
 {
-    logger("[syscall] sys_debug: %c, %c\n", *(uint64_t *) args, *((uint64_t *) args + 1));
+    logger("[syscall] sys_debug: %c, %c\n", a, b);
     return 0;
 }
 
-uint64_t
-_putc(void *args)
+static uint64_t
+sys_putc(uint64_t c, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
 {
-    putc(*(char *) args);
+    putc((char) c);
     return 0;
 }
 
-uint64_t
-_getc(void *args)
+static uint64_t
+sys_getc(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
 {
     return getc();
 }
 
-void
-_sleep_tick(void *args)
+static uint64_t
+sys_sleep(uint64_t ms, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    sys_sleep_tick(ms);
+    return 0;
+}
+
+// 一次输出整段缓冲区，代替逐字符的 SYS_putc
+static uint64_t
+sys_write(uint64_t fd, uint64_t buf, uint64_t len, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_file_write(pro, (int32_t) fd, (const void *) buf, len, PRO_OFF_CUR);
+}
+
+static uint64_t
+sys_open(uint64_t path, uint64_t flags, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_file_open(pro, (const char *) path, (uint32_t) flags);
+}
+
+static uint64_t
+sys_read(uint64_t fd, uint64_t buf, uint64_t len, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_file_read(pro, (int32_t) fd, (void *) buf, len, PRO_OFF_CUR);
+}
+
+static uint64_t
+sys_close(uint64_t fd, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
 {
-    sys_sleep_tick(*(uint64_t *) args);
+    return (uint64_t) pro_file_close(curr_task_el1()->curr_pro, (int32_t) fd);
 }
 
-int32_t
-_pro_execve(void *args)
+static uint64_t
+sys_lseek(uint64_t fd, uint64_t offset, uint64_t whence, uint64_t a3, uint64_t a4, uint64_t a5)
 {
-    return pro_execve(*(char **) args, *((char ***) args + 1), *((char ***) args + 2));
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_file_lseek(pro, (int32_t) fd, (int64_t) offset, (int32_t) whence);
 }
 
-int32_t
-_pro_fork(void *args)
+static uint64_t
+sys_stat(uint64_t path, uint64_t st, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
 {
-    return pro_fork();
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_file_stat(pro, (const char *) path, (file_stat_t *) st);
 }
 
-const void *syscall_table[NR_SYSCALL] = {
-    [SYS_putc]   = _putc,
-    [SYS_getc]   = _getc,
-    [SYS_sleep]  = _sleep_tick,
-    [SYS_execve] = _pro_execve,
-    [SYS_fork]   = _pro_fork,
+static uint64_t
+sys_fstat(uint64_t fd, uint64_t st, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_file_fstat(pro, (int32_t) fd, (file_stat_t *) st);
+}
+
+// addr 只是提示，区域总是由内核挑选
+static uint64_t
+sys_mmap(uint64_t addr, uint64_t len, uint64_t prot, uint64_t flags, uint64_t fd, uint64_t off)
+{
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_mmap(pro, len, (uint32_t) prot, (uint32_t) flags, (int32_t) fd, off);
+}
+
+static uint64_t
+sys_munmap(uint64_t addr, uint64_t len, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return (uint64_t) pro_munmap(curr_task_el1()->curr_pro, addr, len);
+}
+
+static uint64_t
+sys_ring_setup(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return (uint64_t) pro_ioring_setup(curr_task_el1()->curr_pro);
+}
+
+static uint64_t
+sys_ring_enter(uint64_t to_submit,
+               uint64_t min_complete,
+               uint64_t flags,
+               uint64_t a3,
+               uint64_t a4,
+               uint64_t a5)
+{
+    process_t *pro = curr_task_el1()->curr_pro;
+    return (uint64_t) pro_ioring_enter(pro, to_submit, min_complete, flags);
+}
+
+static uint64_t
+sys_execve(uint64_t name, uint64_t argv, uint64_t envp, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return (uint64_t) (int64_t) pro_execve((char *) name, (char **) argv, (char **) envp);
+}
+
+static uint64_t
+sys_fork(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return (uint64_t) (int64_t) pro_fork();
+}
+
+static uint64_t
+sys_null(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return 0;
+}
+
+static uint64_t
+sys_mutex_test_print(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    mutex_test_print();
+    return 0;
+}
+
+static uint64_t
+sys_mutex_add(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return mutex_test_add();
+}
+
+static uint64_t
+sys_mutex_minus(uint64_t a0, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4, uint64_t a5)
+{
+    return mutex_test_minus();
+}
+
+const syscall_entry_t syscall_table[NR_SYSCALL] = {
+    [SYS_putc]   = {sys_putc, 0},
+    [SYS_getc]   = {sys_getc, 0},
+    [SYS_sleep]  = {sys_sleep, 0},
+    [SYS_execve] = {sys_execve, SYSCALL_F_FRAME},
+    [SYS_fork]   = {sys_fork, SYSCALL_F_FRAME},
+    [SYS_write]  = {sys_write, 0},
+
+    [SYS_ring_setup] = {sys_ring_setup, 0},
+    [SYS_ring_enter] = {sys_ring_enter, 0},
+    [SYS_open]       = {sys_open, 0},
+    [SYS_read]       = {sys_read, 0},
+    [SYS_close]      = {sys_close, 0},
+    [SYS_lseek]      = {sys_lseek, 0},
+    [SYS_stat]       = {sys_stat, 0},
+    [SYS_fstat]      = {sys_fstat, 0},
+    [SYS_mmap]       = {sys_mmap, 0},
+    [SYS_munmap]     = {sys_munmap, 0},
 
-    [SYS_mutex_test_print] = mutex_test_print,
-    [SYS_mutex_add]        = mutex_test_add,
-    [SYS_mutex_minus]      = mutex_test_minus,
-    [SYS_debug]            = _debug,
-};
\ No newline at end of file
+    [SYS_null]             = {sys_null, 0},
+    [SYS_null_frame]       = {sys_null, SYSCALL_F_FRAME},
+    [SYS_mutex_test_print] = {sys_mutex_test_print, 0},
+    [SYS_mutex_add]        = {sys_mutex_add, 0},
+    [SYS_mutex_minus]      = {sys_mutex_minus, 0},
+    [SYS_debug]            = {sys_debug, 0},
+};
@@ -33,11 +33,28 @@ mutex_init(mutex_t *mutex)
     spinlock_init(&mutex->lock);
 }
 
+static tcb_t *
+mutex_idle_task(void)
+{
+    return &get_task_manager()->sched[get_current_cpu_id()].idle_task;
+}
+
+// 持有者按当前异常级别的当前任务区分：EL2 上 tpidr_el0 是 guest 的值，不能用
+// curr_task_el1()。调度器启动前（如 EL2 启动核引导上下文里的 shell）没有当前任务，
+// 用本核的空闲任务代表，递归持有仍然按核区分
+static tcb_t *
+mutex_self(void)
+{
+    tcb_t *curr = curr_task();
+
+    return curr ? curr : mutex_idle_task();
+}
+
 // 定义一个函数，用于锁定互斥锁
 void
 mutex_lock(mutex_t *m)
 {
-    tcb_t *curr = curr_task_el1();
+    tcb_t *curr = mutex_self();
 
     // 1) 快速路径：0 -> 1，acquire
     if (atomic_cmpxchg_acquire(&m->locked_count, 0, 1) == 0) {
@@ -52,6 +69,14 @@ mutex_lock(mutex_t *m)
         return;
     }
 
+    // 没有任务可以切换出去，只能自旋等持有者释放
+    if (curr == mutex_idle_task()) {
+        while (atomic_cmpxchg_acquire(&m->locked_count, 0, 1) != 0) {
+        }
+        WRITE_ONCE(m->owner, curr);
+        return;
+    }
+
     // 3) 慢路径：入等待队列并阻塞
     spin_lock(&m->lock);
 
@@ -76,7 +101,7 @@ mutex_lock(mutex_t *m)
 void
 mutex_unlock(mutex_t *m)
 {
-    tcb_t *curr = curr_task_el1();
+    tcb_t *curr = mutex_self();
 
     if (READ_ONCE(m->owner) != curr) {
         return;
@@ -104,13 +129,13 @@ mutex_unlock(mutex_t *m)
     WRITE_ONCE(m->locked_count, 1);
     WRITE_ONCE(m->owner, task);
 
-    task_add_to_readylist_head_remote(task, task->affinity - 1);
+    task_add_to_readylist_head_remote(task, affinity_first_cpu(task->affinity));
     dsb(sy);
 
-    if (task->affinity - 1 == get_current_cpu_id())
+    if (affinity_first_cpu(task->affinity) == get_current_cpu_id())
         local_sched = true;
     else
-        target = task->affinity - 1;
+        target = affinity_first_cpu(task->affinity);
 
     spin_unlock(&m->lock);
 
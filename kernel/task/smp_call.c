@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file smp_call.c
+ * @brief Implementation of smp_call.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#include "task/smp_call.h"
+#include "task/task.h"
+#include "avatar_types.h"
+#include "exception.h"
+#include "gic.h"
+#include "io.h"
+#include "spinlock.h"
+#include "thread.h"
+#include "mem/atomic.h"
+#include "mem/barrier.h"
+
+typedef struct
+{
+    smp_call_func_t func;
+    void           *info;
+    volatile int   *pending;  // 调用者等待的剩余计数，NULL 表示不等待
+} smp_call_entry_t;
+
+// 每个核一个调用队列，其他核入队，本核在 IPI_CALL_FUNC 中断里出队执行
+typedef struct
+{
+    spinlock_t       lock;
+    uint32_t         head;
+    uint32_t         tail;
+    smp_call_entry_t slots[SMP_CALL_QUEUE_LEN];
+} smp_call_queue_t;
+
+static smp_call_queue_t _call_queue[SMP_NUM];
+
+// 关中断执行本地调用，恢复原来的中断状态
+static void
+smp_call_run_local(smp_call_func_t func, void *info)
+{
+    uint32_t daif = get_daif();
+
+    disable_interrupts();
+    func(info);
+    if (!(daif & (1 << 7)))
+        enable_interrupts();
+}
+
+// 入队一个请求。返回 true 表示队列原本为空，需要发送 SGI；
+// 否则目标核已有未处理的 SGI，会在同一次中断里处理本请求
+static bool
+smp_call_enqueue(int32_t cpu, smp_call_func_t func, void *info, volatile int *pending)
+{
+    smp_call_queue_t *q = &_call_queue[cpu];
+    bool              first;
+    uint64_t          daif;
+
+    // 中断处理函数里也可能发起跨核调用，持锁期间关本核 IRQ
+    for (;;) {
+        daif = spin_lock_irqsave(&q->lock);
+        if (q->tail - q->head < SMP_CALL_QUEUE_LEN)
+            break;
+        spin_unlock_irqrestore(&q->lock, daif);
+        // 队列满，等待目标核消费
+    }
+
+    smp_call_entry_t *slot = &q->slots[q->tail % SMP_CALL_QUEUE_LEN];
+    slot->func             = func;
+    slot->info             = info;
+    slot->pending          = pending;
+
+    first = (q->head == q->tail);
+    q->tail++;
+    spin_unlock_irqrestore(&q->lock, daif);
+
+    return first;
+}
+
+// 取空本核队列。smp_call_wait 在开中断的上下文里也会调用这里：持队列锁时
+// 来了 IPI_CALL_FUNC 会在本核上自锁，所以出队要关中断；回调也和在中断里执行时
+// 一样关中断运行，避免与本核的 sched_tick 交错。每个请求之间恢复中断状态
+void
+smp_call_drain_local(void)
+{
+    smp_call_queue_t *q = &_call_queue[get_current_cpu_id()];
+
+    for (;;) {
+        uint64_t daif = spin_lock_irqsave(&q->lock);
+        if (q->head == q->tail) {
+            spin_unlock_irqrestore(&q->lock, daif);
+            break;
+        }
+        smp_call_entry_t entry = q->slots[q->head % SMP_CALL_QUEUE_LEN];
+        q->head++;
+        spin_unlock(&q->lock);
+
+        entry.func(entry.info);
+
+        if (entry.pending)
+            atomic_dec_return_release(entry.pending);
+        if (!(daif & (1 << 7)))
+            enable_interrupts();
+    }
+}
+
+// IPI_CALL_FUNC 中断处理
+static void
+smp_call_ipi_handler(uint64_t *ctx)
+{
+    (void) ctx;
+    smp_call_drain_local();
+}
+
+void
+smp_call_init_local(void)
+{
+    irq_install_prio(IPI_CALL_FUNC, smp_call_ipi_handler, IRQ_PRIO_IPI, 0);
+    gic_enable_int(IPI_CALL_FUNC, 1);
+}
+
+// 等待期间处理发给本核的请求：调用者可能在关中断的异常处理里，
+// 两个核互相等待对方执行请求时不会死锁
+static void
+smp_call_wait(volatile int *pending)
+{
+    while (atomic_load_acquire(pending) > 0) {
+        smp_call_drain_local();
+    }
+}
+
+int32_t
+smp_call_function_single(int32_t cpu, smp_call_func_t func, void *info, bool wait)
+{
+    volatile int pending = 1;
+
+    if (cpu < 0 || cpu >= SMP_NUM || !func) {
+        logger_error("smp_call: invalid cpu %d or func %p\n", cpu, func);
+        return -1;
+    }
+
+    if (cpu == (int32_t) get_current_cpu_id()) {
+        smp_call_run_local(func, info);
+        return 0;
+    }
+
+    if (smp_call_enqueue(cpu, func, info, wait ? &pending : NULL)) {
+        // 保证队列内容先于 SGI 对目标核可见
+        dsb(sy);
+        gic_ipi_send_single(IPI_CALL_FUNC, cpu);
+    }
+
+    if (wait)
+        smp_call_wait(&pending);
+    return 0;
+}
+
+int32_t
+smp_call_function_many(uint32_t cpu_mask, smp_call_func_t func, void *info, bool wait)
+{
+    uint32_t     self     = get_current_cpu_id();
+    uint32_t     valid    = (SMP_NUM >= 32) ? ~0U : ((1U << SMP_NUM) - 1);
+    uint32_t     remote   = cpu_mask & valid & ~(1U << self);
+    uint32_t     ipi_mask = 0;
+    volatile int pending  = 0;
+
+    if (!func) {
+        logger_error("smp_call: invalid func\n");
+        return -1;
+    }
+    if (cpu_mask & ~valid)
+        logger_warn("smp_call: cpu mask 0x%x exceeds SMP_NUM %d\n", cpu_mask, SMP_NUM);
+
+    for (int32_t cpu = 0; cpu < SMP_NUM; cpu++) {
+        if (remote & (1U << cpu))
+            pending++;
+    }
+
+    for (int32_t cpu = 0; cpu < SMP_NUM; cpu++) {
+        if (!(remote & (1U << cpu)))
+            continue;
+        if (smp_call_enqueue(cpu, func, info, wait ? &pending : NULL))
+            ipi_mask |= 1U << cpu;
+    }
+
+    // 所有需要唤醒的核合并为一次 SGI 发送
+    if (ipi_mask) {
+        dsb(sy);
+        gic_ipi_send_mask(IPI_CALL_FUNC, ipi_mask);
+    }
+
+    // 远端核并行执行时，本核处理自己的部分
+    if (cpu_mask & (1U << self))
+        smp_call_run_local(func, info);
+
+    if (wait)
+        smp_call_wait(&pending);
+    return 0;
+}
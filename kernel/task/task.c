@@ -11,6 +11,7 @@
  */
 
 #include "task/task.h"
+#include "task/smp_call.h"
 #include "io.h"
 #include "gic.h"
 #include "vmm/vcpu.h"
@@ -22,8 +23,10 @@
 #include "mem/earlypage.h"
 #include "mem/page.h"
 #include "mem/mem.h"
+#include "mem/barrier.h"
 #include "lib/avatar_assert.h"
 #include "exception.h"
+#include "timer.h"
 
 // 下面三个变量仅仅在 alloc_tcb 和 free_tcb 使用
 tcb_t          g_task_dec[MAX_TASKS];
@@ -39,10 +42,12 @@ static task_manager_t task_manager;
 
 static tcb_t *
 task_next_run(void);
+cpu_scheduler_t *
+get_scheduler();
 void
 task_set_wakeup(tcb_t *task);
 void
-task_set_sleep(tcb_t *task, uint64_t ticks);
+task_set_sleep(tcb_t *task, uint64_t us);
 
 //
 tcb_t *
@@ -70,7 +75,6 @@ alloc_tcb()
             list_node_init(&task->wait_node);
 
             list_node_init(&task->process_node);
-            list_node_init(&task->vm_node);
             return task;
         }
     }
@@ -87,11 +91,25 @@ free_tcb(tcb_t *task)
     uint32_t core_id = get_current_cpu_id();
 
     // 从任务管理的任务列表中移除任务
+    uint64_t daif = spin_lock_irqsave(&task_manager.task_lock);
     list_delete(&task_manager.task_list, &task->all_node);
+    spin_unlock_irqrestore(&task_manager.task_lock, daif);
+
+    // 睡眠中的任务还挂在 hrtimer 队列上
+    hrtimer_cancel(&task->sleep_timer);
 
     memset(task, 0, sizeof(tcb_t));
 }
 
+// 加入全局任务队列，其他核可能同时在创建/回收任务
+void
+task_list_add(tcb_t *task)
+{
+    uint64_t daif = spin_lock_irqsave(&task_manager.task_lock);
+    list_insert_last(&task_manager.task_list, &task->all_node);
+    spin_unlock_irqrestore(&task_manager.task_lock, daif);
+}
+
 tcb_t *
 create_task(entry_t task_func, uint64_t stack_top, uint32_t affinity)
 {
@@ -101,8 +119,8 @@ create_task(entry_t task_func, uint64_t stack_top, uint32_t affinity)
         return NULL;  // 如果没有空闲的 TCB，返回 NULL
     }
     task->remaining_ticks = SYS_TASK_TICK;
-    task->affinity        = affinity;
-    list_insert_last(&task_manager.task_list, &task->all_node);
+    task->affinity        = sched_housekeeping_affinity(affinity);
+    task_list_add(task);
 
     task->cpu_info->ctx.elr  = (uint64_t) task_func;  // elr_el1
     task->cpu_info->ctx.spsr = SPSR_EL0_EL0t;         // spsr_el1
@@ -128,7 +146,7 @@ create_vm_task(entry_t task_func, uint64_t stack_top, uint32_t affinity, uint64_
     }
     task->remaining_ticks = SYS_TASK_TICK;
     task->affinity        = affinity;
-    list_insert_last(&task_manager.task_list, &task->all_node);
+    task_list_add(task);
 
     task->cpu_info->ctx.elr           = (uint64_t) task_func;  // elr_el2
     task->cpu_info->ctx.spsr          = SPSR_VALUE;            // spsr_el2
@@ -164,9 +182,15 @@ reset_task(tcb_t *task, entry_t task_func, uint64_t stack_top, uint32_t affinity
 void
 schedule_init_local(tcb_t *task, void *new_sp)
 {
-    irq_install(IPI_SCHED, schedule);
+    // 调度 IPI 处于最低优先级，不会嵌套进入其他中断处理函数
+    irq_install_prio(IPI_SCHED, schedule, IRQ_PRIO_SCHED, 0);
     gic_enable_int(IPI_SCHED, 1);
-    gic_set_ipriority(IPI_SCHED, 0x0);  // 最高优先级
+    smp_call_init_local();
+
+    task->run_start               = read_cntpct_el0();
+    task->ready_since             = 0;
+    task->last_cpu                = get_current_cpu_id();
+    get_scheduler()->current_task = task;
 
     if (get_el() == 2) {
         task->state = TASK_STATE_RUNNING;
@@ -251,6 +275,33 @@ task_next_run(void)
     }
 }
 
+// 切换时刻的运行时间记账：prev 结束一段运行，next 结束一段就绪等待
+static void
+sched_account_switch(cpu_scheduler_t *schde, tcb_t *prev, tcb_t *next, uint64_t now)
+{
+    if (prev->run_start != 0) {
+        uint64_t delta = now - prev->run_start;
+        prev->runtime += delta;
+        if (prev == &schde->idle_task) {
+            schde->idle_time += delta;
+        } else {
+            schde->busy_time += delta;
+        }
+    }
+    prev->run_start = 0;
+
+    if (next->ready_since != 0) {
+        next->run_delay += now - next->ready_since;
+        next->ready_since = 0;
+    }
+    next->run_start = now;
+    next->last_cpu  = schde->cpu_id;
+    next->nr_switches++;
+
+    schde->current_task = next;
+    schde->total_switches++;
+}
+
 // 将当前任务切换为 task_net_run
 void
 schedule()
@@ -261,6 +312,9 @@ schedule()
     tcb_t           *next_task = task_next_run();
     tcb_t           *prev_task = curr;
     if (next_task == curr) {
+        // 重新选中了自己，没有发生切换，不算就绪等待
+        curr->ready_since = 0;
+
         char buffer[512];
         int  offset = 0;
 
@@ -294,6 +348,7 @@ schedule()
 
     // logger("next_task page dir: 0x%llx\n", next_task->pgdir);
     next_task->state = TASK_STATE_RUNNING;
+    sched_account_switch(schde, prev_task, next_task, read_cntpct_el0());
 
     if (get_el() == 1) {
         uint64_t val = virt_to_phys(next_task->pgdir);
@@ -309,49 +364,37 @@ schedule()
     }
 }
 
-// 查看(该cpu)延时队列和counter
-void
-timer_tick_schedule(uint64_t *sp)
+// 调度 tick：更新统计并扣减时间片，返回是否需要调度。
+// 在定时器中断的 hrtimer 回调中执行，不能在这里切换任务
+bool
+sched_tick(void)
 {
     tcb_t *curr_task = curr_task();
 
-    // 睡眠处理 - 只处理当前CPU的睡眠队列
-    // 注意：在中断上下文中，当前CPU的中断已被禁用，且每个CPU只访问自己的睡眠队列
-    // 因此不需要加锁保护
-    cpu_scheduler_t *schde      = get_scheduler();
-    bool             has_wakeup = false;  // 标记是否有任务被唤醒
+    // 在中断上下文中，当前CPU的中断已被禁用，且只访问本核的调度器，不需要加锁
+    cpu_scheduler_t *schde = get_scheduler();
     // logger_task_debug("tick arrived!\n");
 
-    list_node_t *curr = list_first(&schde->sleep_list);
-    while (curr) {
-        list_node_t *next = list_node_next(curr);
+    schde->total_ticks++;
+    if (curr_task == &schde->idle_task) {
+        schde->idle_ticks++;
+    }
 
-        tcb_t *task = list_node_parent(curr, tcb_t, run_node);
-        if (--task->sleep_ticks <= 0) {
-            logger_task_debug("task %d sleep time arrive\n", task->task_id);
-            task_set_wakeup(task);  // 从当前CPU的睡眠队列移除
-            // 任务在当前CPU睡眠，唤醒后直接加入当前CPU的就绪队列头部（高优先级）
-            task_add_to_readylist_head(task);
-            task->remaining_ticks = SYS_TASK_TICK;
-            has_wakeup            = true;  // 有任务被唤醒
-        }
-        curr = next;
+    // 独占核上没有其他任务等待时不做时间片轮转，避免无意义的调度
+    if (schde->owner_vm && list_is_empty(&schde->ready_list)) {
+        curr_task->remaining_ticks = SYS_TASK_TICK;
+        return false;
     }
 
-    // 时间片处理
-    bool need_schedule = false;
+    // 时间片处理；已停止的任务等调度 IPI 把它切换出去，不能再放回就绪队列
     if (--curr_task->remaining_ticks <= 0) {
-        if (curr_task != get_idle()) {
+        if (curr_task != get_idle() && curr_task->state != TASK_STATE_STOPPED) {
             curr_task->remaining_ticks = SYS_TASK_TICK;
             task_add_to_readylist_tail(curr_task);  // 时间片耗尽，放到队尾
         }
-        need_schedule = true;  // 时间片耗尽需要调度
-    }
-
-    // 调度决策：有任务唤醒或时间片耗尽都需要调度
-    if (has_wakeup || need_schedule) {
-        schedule();
+        return true;  // 时间片耗尽需要调度
     }
+    return false;
 }
 
 // 保存栈上的内容到task cpu中
@@ -447,6 +490,7 @@ task_manager_init(void)
         scheduler_init(&task_manager.sched[i], i);
     }
     list_init(&task_manager.task_list);
+    spinlock_init(&task_manager.task_lock);
 }
 
 task_manager_t *
@@ -459,15 +503,33 @@ get_task_manager()
 // =========================================
 // ============ 就绪队列相关操作 ============
 
+// 独占核只运行所属虚拟机的 vCPU，其他任务转到 housekeeping 核
+static uint32_t
+sched_steer_cpu(tcb_t *task, uint32_t core_id)
+{
+    struct _vm_t *owner = task_manager.sched[core_id].owner_vm;
+
+    if (owner == NULL || task->curr_vm == owner)
+        return core_id;
+
+    logger_warn("task %d steered from isolated core %d to core %d\n",
+                task->task_id,
+                core_id,
+                HOUSEKEEPING_CPU);
+    return HOUSEKEEPING_CPU;
+}
+
 void
 task_add_to_readylist_tail_remote(tcb_t *task, uint32_t core_id)
 {
     if (core_id >= SMP_NUM)
         logger_error("error: wrong core id\n");
+    core_id                = sched_steer_cpu(task, core_id);
     cpu_scheduler_t *sched = &task_manager.sched[core_id];
     if (task != &sched->idle_task) {
         list_insert_last(&sched->ready_list, &task->run_node);
-        task->state = TASK_STATE_READY;
+        task->state       = TASK_STATE_READY;
+        task->ready_since = read_cntpct_el0();
     }
 }
 
@@ -476,10 +538,12 @@ task_add_to_readylist_head_remote(tcb_t *task, uint32_t core_id)
 {
     if (core_id >= SMP_NUM)
         logger_error("error: wrong core id\n");
+    core_id                = sched_steer_cpu(task, core_id);
     cpu_scheduler_t *sched = &task_manager.sched[core_id];
     if (task != &sched->idle_task) {
         list_insert_first(&sched->ready_list, &task->run_node);
-        task->state = TASK_STATE_READY;
+        task->state       = TASK_STATE_READY;
+        task->ready_since = read_cntpct_el0();
     }
 }
 
@@ -501,22 +565,171 @@ task_add_to_readylist_head(tcb_t *task)
 }
 
 
+// ============ pCPU 独占分区 ============
+
+// 把 cpu_mask 中的 pCPU 划给 vm 独占。housekeeping 核、已被独占的核、
+// 以及还有其他任务在运行或排队的核都不能划分
+int32_t
+sched_isolate_cpus(uint32_t cpu_mask, struct _vm_t *vm)
+{
+    if (vm == NULL || cpu_mask == 0 || (cpu_mask >> SMP_NUM) != 0 ||
+        (cpu_mask & (1U << HOUSEKEEPING_CPU))) {
+        logger_error("isolate: invalid cpu mask 0x%x\n", cpu_mask);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < SMP_NUM; i++) {
+        if (!(cpu_mask & (1U << i)))
+            continue;
+
+        cpu_scheduler_t *sched = &task_manager.sched[i];
+        if (sched->owner_vm != NULL) {
+            logger_error("isolate: core %d already owned by vm %d\n", i, sched->owner_vm->vm_id);
+            return -1;
+        }
+        if (sched->current_task != &sched->idle_task || !list_is_empty(&sched->ready_list)) {
+            logger_error("isolate: core %d still has runnable tasks\n", i);
+            return -1;
+        }
+    }
+
+    for (uint32_t i = 0; i < SMP_NUM; i++) {
+        if (cpu_mask & (1U << i))
+            task_manager.sched[i].owner_vm = vm;
+    }
+    return 0;
+}
+
+// 解除 vm 对 pCPU 的独占，返回被释放的 pCPU 位图
+uint32_t
+sched_release_cpus(struct _vm_t *vm)
+{
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < SMP_NUM; i++) {
+        if (vm != NULL && task_manager.sched[i].owner_vm == vm) {
+            task_manager.sched[i].owner_vm = NULL;
+            mask |= 1U << i;
+        }
+    }
+    return mask;
+}
+
+uint32_t
+sched_isolated_mask(void)
+{
+    uint32_t mask = 0;
+
+    for (uint32_t i = 0; i < SMP_NUM; i++) {
+        if (task_manager.sched[i].owner_vm != NULL)
+            mask |= 1U << i;
+    }
+    return mask;
+}
+
+bool
+sched_cpu_isolated(uint32_t core_id)
+{
+    return core_id < SMP_NUM && task_manager.sched[core_id].owner_vm != NULL;
+}
+
+// 去掉亲和性中被独占的 pCPU，全部被独占时退回 housekeeping 核
+uint32_t
+sched_housekeeping_affinity(uint32_t affinity)
+{
+    uint32_t shared = affinity & ~sched_isolated_mask();
+    return shared ? shared : (1U << HOUSEKEEPING_CPU);
+}
+
+// ============ 统计信息 ============
+
+// 读取任务统计；正在运行或正在就绪等待的那一段也计入
+void
+task_get_stats(tcb_t *task, uint64_t now, task_stats_t *stats)
+{
+    uint64_t run_start   = task->run_start;
+    uint64_t ready_since = task->ready_since;
+
+    stats->runtime     = task->runtime;
+    stats->run_delay   = task->run_delay;
+    stats->nr_switches = task->nr_switches;
+    stats->exits       = task->exits;
+
+    if (run_start != 0 && now > run_start) {
+        stats->runtime += now - run_start;
+    }
+    if (ready_since != 0 && now > ready_since) {
+        stats->run_delay += now - ready_since;
+    }
+}
+
+void
+sched_get_stats(uint32_t core_id, uint64_t now, sched_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (core_id >= SMP_NUM) {
+        return;
+    }
+
+    cpu_scheduler_t *sched = &task_manager.sched[core_id];
+    tcb_t           *curr  = sched->current_task;
+
+    stats->busy_time      = sched->busy_time;
+    stats->idle_time      = sched->idle_time;
+    stats->total_switches = sched->total_switches;
+    stats->total_ticks    = sched->total_ticks;
+    stats->idle_ticks     = sched->idle_ticks;
+
+    // 加上当前正在运行的那一段
+    if (curr != NULL && curr->run_start != 0 && now > curr->run_start) {
+        if (curr == &sched->idle_task) {
+            stats->idle_time += now - curr->run_start;
+        } else {
+            stats->busy_time += now - curr->run_start;
+        }
+    }
+
+    list_node_t *iter = list_first(&sched->ready_list);
+    while (iter) {
+        stats->nr_ready++;
+        iter = list_node_next(iter);
+    }
+}
+
 // ============ 延时队列相关操作 ============
 // =========================================
 
-// 将任务加入延时队列 - 加入到当前CPU的睡眠队列
+// 睡眠到期：在任务睡眠所在的 CPU 上、定时器中断的 hrtimer 回调中执行
+static hrtimer_restart_t
+task_sleep_timeout(hrtimer_t *timer)
+{
+    tcb_t *task = (tcb_t *) timer->data;
+
+    logger_task_debug("task %d sleep time arrive\n", task->task_id);
+    task_set_wakeup(task);  // 从当前CPU的睡眠队列移除
+    // 任务在当前CPU睡眠，唤醒后直接加入当前CPU的就绪队列头部（高优先级）
+    task_add_to_readylist_head(task);
+    task->remaining_ticks = SYS_TASK_TICK;
+    hrtimer_request_resched();  // 有任务被唤醒，中断结束时调度
+
+    return HRTIMER_NORESTART;
+}
+
+// 将任务加入延时队列 - 加入到当前CPU的睡眠队列，us 微秒后由 hrtimer 唤醒
 void
-task_set_sleep(tcb_t *task, uint64_t ticks)
+task_set_sleep(tcb_t *task, uint64_t us)
 {
-    if (ticks <= 0) {
+    if (us == 0) {
         return;
     }
 
-    task->sleep_ticks = ticks;
-    task->state       = TASK_STATE_WAITING;
+    task->state = TASK_STATE_WAITING;
 
     cpu_scheduler_t *schde = get_scheduler();
     list_insert_last(&schde->sleep_list, &task->run_node);
+
+    hrtimer_init(&task->sleep_timer, task_sleep_timeout, task);
+    hrtimer_start_us(&task->sleep_timer, us);
 }
 
 // 将任务从延时队列移除 - 从指定CPU的睡眠队列移除
@@ -536,21 +749,66 @@ task_set_wakeup(tcb_t *task)
     task_set_wakeup_remote(task, core_id);
 }
 
-void
-sys_sleep_tick(uint64_t ms)
+// 在每个核上执行：任务正在本核运行就标记停止，由调度 IPI 切换出去；
+// 在本核就绪队列里就直接摘下
+static void
+task_stop_local(void *info)
 {
-    // 至少延时1个tick
-    if (ms < SYS_TASK_TICK) {
-        ms = SYS_TASK_TICK;
+    tcb_t           *task  = (tcb_t *) info;
+    cpu_scheduler_t *sched = get_scheduler();
+
+    if (sched->current_task == task) {
+        task->state = TASK_STATE_STOPPED;
+        gic_ipi_send_single(IPI_SCHED, sched->cpu_id);
+        return;
     }
 
-    // 从就绪队列移除，加入睡眠队列
-    tcb_t *curr = curr_task_el1();
-    task_set_sleep(curr, ms / 10);
-    logger_task_debug("sleep %d ms, tick: %d\n", ms, curr->sleep_ticks);
+    list_node_t *iter = list_first(&sched->ready_list);
+    while (iter) {
+        if (iter == &task->run_node) {
+            list_delete(&sched->ready_list, iter);
+            task->state       = TASK_STATE_STOPPED;
+            task->ready_since = 0;
+            return;
+        }
+        iter = list_node_next(iter);
+    }
+}
 
-    // 进行一次调度
-    schedule();
+// 把任务摘下调度。返回时任务已不在任何核的就绪队列里；正在运行的任务只是被标记
+// 停止，由调度 IPI 异步切换出去，要改写它保存的现场先调用 task_wait_off_cpu。
+// 停止的是当前任务时，它在本次异常处理返回后切换出去。
+// 停止的任务只能重新加入就绪队列来恢复运行
+void
+task_stop(tcb_t *task)
+{
+    uint32_t all = (SMP_NUM >= 32) ? ~0U : ((1U << SMP_NUM) - 1);
+
+    smp_call_function_many(all, task_stop_local, task, true);
+}
+
+// 等待已被 task_stop 停下的任务离开其他核。它所在的核要先进入调度 IPI，
+// 陷入时保存现场和 vCPU 系统寄存器，再切换出去；在此之前改写这些状态会被覆盖。
+// 不能用来等待当前任务自己
+void
+task_wait_off_cpu(tcb_t *task)
+{
+    for (;;) {
+        bool running = false;
+
+        for (int32_t i = 0; i < SMP_NUM; i++) {
+            if (*(tcb_t *volatile *) &task_manager.sched[i].current_task == task) {
+                running = true;
+                break;
+            }
+        }
+        if (!running)
+            break;
+        // 对方可能正等待本核执行跨核调用，等待期间照常处理
+        smp_call_drain_local();
+    }
+    // 之后读写的现场不早于对方切换出去之前的写入
+    dmb(ish);
 }
 
 void
@@ -568,6 +826,39 @@ task_yield(void)
     schedule();
 }
 
+// 当前任务睡眠 us 微秒，精度由 hrtimer 决定而不是调度 tick
+void
+task_sleep_us(uint64_t us)
+{
+    if (us == 0) {
+        task_yield();
+        return;
+    }
+
+    // 从入睡眠队列、启动定时器到切换出去之间必须关中断：短睡眠的定时器可能在
+    // schedule() 之前到期，把仍是当前任务的自己重新放进就绪队列
+    uint32_t daif = get_daif();
+    disable_interrupts();
+
+    // 从就绪队列移除，加入睡眠队列
+    tcb_t *curr = curr_task();
+    task_set_sleep(curr, us);
+    logger_task_debug("sleep %llu us\n", us);
+
+    // 进行一次调度
+    schedule();
+
+    if (!(daif & (1 << 7))) {
+        enable_interrupts();
+    }
+}
+
+void
+sys_sleep_tick(uint64_t ms)
+{
+    task_sleep_us(ms * 1000);
+}
+
 // vwfi
 void
 task_wait_for_irq(void)
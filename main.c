@@ -27,6 +27,8 @@
 #include "app/app.h"
 #include "pro.h"
 #include "ramfs.h"
+#include "virtio_block_frontend.h"
+#include "fs/fat32.h"
 
 void
 test_mem()
@@ -70,6 +72,11 @@ main_entry()
     if (get_current_cpu_id() == 0) {
         alloctor_init();
         mutex_test_init();  // 初始化 mutex 测试模块
+
+        // 进程的文件系统调用落到 FAT32 上，先于进程启动挂载
+        avatar_virtio_block_init();
+        fat32_init();
+        fat32_mount();
         // kmem_test();
 
         // ramfs_test();
@@ -82,6 +89,11 @@ main_entry()
         process_init(pro2, __sub_bin_start, 2);
         run_process(pro2);
 
+        // 系统调用开销测试，放在最后一个核上，尽量不与 add/sub 争用
+        process_t *pro3 = alloc_process("sysbench");
+        process_init(pro3, __sysbench_bin_start, 1U << (SMP_NUM - 1));
+        run_process(pro3);
+
         print_current_task_list();
     }
     el1_idle_init();  // idle 任务每个核都有自己的el1栈， 代码公用
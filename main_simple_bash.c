@@ -18,8 +18,14 @@
 #include "lib/avatar_string.h"
 #include "guest/guest_manifest.h"
 #include "vmm/guest_loader.h"
+#include "vmm/guest_lazy.h"
+#include "vmm/guest_image_cache.h"
 #include "vmm/vm.h"
 #include "vmm/vpl011.h"
+#include "task/task.h"
+#include "timer.h"
+#include "clocksource.h"
+#include "uart_pl011.h"
 
 /* ============================================================================
  * 简单的Shell实现
@@ -895,6 +901,15 @@ shell_cmd_cp(int argc, char **args)
         return;
     }
 
+    // 按源文件大小一次分配目标文件的簇，让目标文件尽量连续
+    if (fat32_preallocate(dst_fd, src_info.file_size) != 0) {
+        logger("cp: no space for '%s'\n", dst_path);
+        fat32_close(src_fd);
+        fat32_close(dst_fd);
+        fat32_unlink(dst_path);
+        return;
+    }
+
     // 复制文件内容
     char   buffer[512];  // 使用512字节缓冲区
     size_t total_copied = 0;
@@ -992,6 +1007,15 @@ shell_cmd_mv(int argc, char **args)
         return;
     }
 
+    // 按源文件大小一次分配目标文件的簇，让目标文件尽量连续
+    if (fat32_preallocate(dst_fd, src_info.file_size) != 0) {
+        logger("mv: no space for '%s'\n", dst_path);
+        fat32_close(src_fd);
+        fat32_close(dst_fd);
+        fat32_unlink(dst_path);
+        return;
+    }
+
     // 复制文件内容
     char   buffer[512];
     size_t total_copied = 0;
@@ -1434,9 +1458,14 @@ shell_cmd_help(int argc, char **args)
     logger("  tree [path]         - Display directory tree structure\n");
     logger("  du [-ahs] [path]    - Display disk usage\n");
     logger("  fsinfo              - Show filesystem information\n");
+    logger("  sync                - Write cached filesystem data to disk\n");
     logger("  guest <subcmd>      - Guest management commands\n");
     logger("    guest config show - Show console configuration\n");
     logger("    guest config set  - Set console configuration\n");
+    logger("    guest boottime    - Show guest boot phase breakdown\n");
+    logger("    guest cache       - Show or drop cached guest images\n");
+    logger("  top [ms] [count]    - Live vCPU/pCPU utilization\n");
+    logger("  date [unix_seconds] - Show or set wall-clock time\n");
     logger("  clear               - Clear screen\n");
     logger("  help                - Show this help\n");
     logger("  exit                - Exit shell\n");
@@ -1454,6 +1483,20 @@ shell_cmd_fsinfo(int argc, char **args)
     fat32_print_fs_info();
 }
 
+// sync命令实现
+static void
+shell_cmd_sync(int argc, char **args)
+{
+    if (!fat32_is_mounted()) {
+        logger("Filesystem not mounted\n");
+        return;
+    }
+
+    if (fat32_sync() != FAT32_OK) {
+        logger("sync: failed to write back cached data\n");
+    }
+}
+
 // clear命令实现
 static void
 shell_cmd_clear(int argc, char **args)
@@ -1515,6 +1558,7 @@ shell_cmd_guest_info(int argc, char **args)
     if (manifest->files.needs_initrd) {
         logger("  Initrd Path:  %s\n", manifest->files.initrd_path);
         logger("  Initrd Addr:  0x%llx\n", manifest->fs_loadaddr);
+        logger("  Initrd Load:  %s\n", manifest->files.lazy_initrd ? "lazy (on demand)" : "eager");
     }
 
     // 检查文件是否存在
@@ -1611,7 +1655,8 @@ shell_cmd_guest_start(int argc, char **args)
         return;
     }
 
-    if (!guest_validate_files(manifest)) {
+    // 镜像都已缓存时从内存恢复，不再检查磁盘上的文件
+    if (!guest_image_cache_complete(manifest) && !guest_validate_files(manifest)) {
         logger("Error: Guest files validation failed\n");
         return;
     }
@@ -1626,7 +1671,11 @@ shell_cmd_guest_start(int argc, char **args)
     logger("VM allocated with ID: %u\n", vm->vm_id);
 
     // 使用新的manifest初始化VM
-    vm_init_with_manifest(vm, manifest);
+    if (vm_init_with_manifest(vm, manifest) < 0) {
+        logger("Error: Failed to initialize VM %u\n", vm->vm_id);
+        free_vm(vm);
+        return;
+    }
 
     // 启动VM
     logger("Starting VM...\n");
@@ -1722,6 +1771,20 @@ shell_cmd_guest_config(int argc, char **args)
     }
 }
 
+// guest boottime命令实现
+static void
+shell_cmd_guest_boottime(int argc, char **args)
+{
+    uint32_t      vm_id = argc > 1 ? atol(args[1]) : 0;
+    struct _vm_t *vm    = vm_get(vm_id);
+
+    if (!vm) {
+        logger("No such VM: %u\n", vm_id);
+        return;
+    }
+    boottime_dump(vm);
+}
+
 // guest主命令实现
 static void
 shell_cmd_guest(int argc, char **args)
@@ -1734,6 +1797,9 @@ shell_cmd_guest(int argc, char **args)
         logger("  validate <guest_id> - Validate guest files\n");
         logger("  start <guest_id>    - Start a guest VM\n");
         logger("  config <subcmd>     - Console configuration management\n");
+        logger("  lazy                - Show lazily backed guest memory regions\n");
+        logger("  cache [drop]        - Show or drop cached guest images\n");
+        logger("  boottime [vm_id]    - Show guest boot phase breakdown\n");
         return;
     }
 
@@ -1749,12 +1815,327 @@ shell_cmd_guest(int argc, char **args)
         shell_cmd_guest_start(argc - 1, args + 1);
     } else if (strcmp(subcmd, "config") == 0) {
         shell_cmd_guest_config(argc - 1, args + 1);
+    } else if (strcmp(subcmd, "lazy") == 0) {
+        logger("Lazy guest memory regions:\n");
+        guest_lazy_dump();
+    } else if (strcmp(subcmd, "cache") == 0) {
+        if (argc > 2 && strcmp(args[2], "drop") == 0) {
+            guest_image_cache_drop(NULL);
+            logger("Guest image cache dropped\n");
+        } else {
+            logger("Cached guest images:\n");
+            guest_image_cache_dump();
+        }
+    } else if (strcmp(subcmd, "boottime") == 0) {
+        shell_cmd_guest_boottime(argc - 1, args + 1);
     } else {
         logger("Unknown guest subcommand: %s\n", subcmd);
         logger("Type 'guest' for usage information.\n");
     }
 }
 
+// top命令实现
+typedef struct
+{
+    tcb_t       *task;
+    int32_t      task_id;
+    int32_t      vm_id;  // 非 vCPU 任务为 -1
+    int32_t      vcpu_id;
+    uint32_t     last_cpu;
+    task_state_t state;
+    task_stats_t stats;
+} top_sample_t;
+
+static top_sample_t  top_samples[MAX_TASKS];
+static uint32_t      top_sample_count;
+static top_sample_t  top_rows[MAX_TASKS];
+static sched_stats_t top_cpu_samples[SMP_NUM];
+
+static const char *
+top_state_name(task_state_t state)
+{
+    switch (state) {
+        case TASK_STATE_CREATE:
+            return "CREATE";
+        case TASK_STATE_READY:
+            return "READY";
+        case TASK_STATE_RUNNING:
+            return "RUN";
+        case TASK_STATE_WAITING:
+            return "SLEEP";
+        case TASK_STATE_WAIT_IRQ:
+            return "WFI";
+        case TASK_STATE_STOPPED:
+            return "STOP";
+        default:
+            return "?";
+    }
+}
+
+// 在上一次采样中查找同一个任务（TCB 可能被回收复用，所以同时比较 task_id）
+static const task_stats_t *
+top_find_prev(const top_sample_t *row)
+{
+    for (uint32_t i = 0; i < top_sample_count; i++) {
+        if (top_samples[i].task == row->task && top_samples[i].task_id == row->task_id) {
+            return &top_samples[i].stats;
+        }
+    }
+    return NULL;
+}
+
+// 百分比，保留一位小数（返回值为千分比）
+static inline uint64_t
+top_permille(uint64_t part, uint64_t whole)
+{
+    return whole ? (part * 1000) / whole : 0;
+}
+
+// 持任务队列锁拷贝一份快照，格式化和输出都在锁外做，避免其他核回收的 TCB 被读到一半
+static uint32_t
+top_snapshot(uint64_t now, top_sample_t *rows)
+{
+    task_manager_t *tm    = get_task_manager();
+    uint32_t        count = 0;
+
+    uint64_t     daif = spin_lock_irqsave(&tm->task_lock);
+    list_node_t *iter = list_first(&tm->task_list);
+    while (iter && count < MAX_TASKS) {
+        tcb_t        *task = list_node_parent(iter, tcb_t, all_node);
+        top_sample_t *row  = &rows[count++];
+
+        row->task     = task;
+        row->task_id  = task->task_id;
+        row->vm_id    = task->curr_vm ? (int32_t) task->curr_vm->vm_id : -1;
+        row->vcpu_id  = task->curr_vm ? get_vcpuid(task) : -1;
+        row->last_cpu = task->last_cpu;
+        row->state    = task->state;
+        task_get_stats(task, now, &row->stats);
+        iter = list_node_next(iter);
+    }
+    spin_unlock_irqrestore(&tm->task_lock, daif);
+
+    return count;
+}
+
+static void
+top_take_sample(uint64_t now)
+{
+    top_sample_count = top_snapshot(now, top_samples);
+
+    for (uint32_t cpu = 0; cpu < SMP_NUM; cpu++) {
+        sched_get_stats(cpu, now, &top_cpu_samples[cpu]);
+    }
+}
+
+static void
+top_print(uint64_t now, uint64_t elapsed, uint64_t freq, uint32_t interval_ms)
+{
+    logger("\033[2J\033[H");
+    logger("top - refresh every %u ms, press any key to quit\n\n", interval_ms);
+
+    logger("PCPU  BUSY%%   IDLE%%   SWITCH/s  TICKS  RUNQ\n");
+    for (uint32_t cpu = 0; cpu < SMP_NUM; cpu++) {
+        sched_stats_t cur;
+        sched_get_stats(cpu, now, &cur);
+
+        const sched_stats_t *prev   = &top_cpu_samples[cpu];
+        uint64_t             busy   = top_permille(cur.busy_time - prev->busy_time, elapsed);
+        uint64_t             idle   = top_permille(cur.idle_time - prev->idle_time, elapsed);
+        uint64_t             sw_sec = ((cur.total_switches - prev->total_switches) * freq) / elapsed;
+
+        logger("%4u  %3llu.%llu   %3llu.%llu   %8llu  %5llu  %4u\n",
+               cpu,
+               busy / 10,
+               busy % 10,
+               idle / 10,
+               idle % 10,
+               sw_sec,
+               cur.total_ticks - prev->total_ticks,
+               cur.nr_ready);
+    }
+
+    logger("\n VM  VCPU  TASK  PCPU  STATE    CPU%%  STEAL%%   EXITS/s  WAIT(us)\n");
+    uint32_t count = top_snapshot(now, top_rows);
+    for (uint32_t i = 0; i < count; i++) {
+        const top_sample_t *row = &top_rows[i];
+        const task_stats_t *cur = &row->stats;
+
+        const task_stats_t *prev = top_find_prev(row);
+        task_stats_t        zero = {0};
+        if (prev == NULL) {
+            prev = &zero;
+        }
+
+        uint64_t d_run    = cur->runtime - prev->runtime;
+        uint64_t d_delay  = cur->run_delay - prev->run_delay;
+        uint64_t d_switch = cur->nr_switches - prev->nr_switches;
+        uint64_t cpu_pm   = top_permille(d_run, elapsed);
+        uint64_t steal_pm = top_permille(d_delay, elapsed);
+        uint64_t exits    = ((cur->exits - prev->exits) * freq) / elapsed;
+        // 平均每次上 CPU 前在就绪队列中等待的时间
+        uint64_t wait_us = d_switch ? (d_delay * 1000000 / freq) / d_switch : 0;
+
+        if (row->vm_id >= 0) {
+            logger("%3d  %4d", row->vm_id, row->vcpu_id);
+        } else {
+            logger("  -     -");
+        }
+        logger("  %4d  %4u  %-6s  %3llu.%llu  %4llu.%llu  %8llu  %8llu\n",
+               row->task_id,
+               row->last_cpu,
+               top_state_name(row->state),
+               cpu_pm / 10,
+               cpu_pm % 10,
+               steal_pm / 10,
+               steal_pm % 10,
+               exits,
+               wait_us);
+    }
+}
+
+#define TOP_POLL_US 10000  // 等待刷新期间检查按键的间隔
+#define TOP_EVNTI   15     // 计数器事件流：CNTPCT 第 15 位翻转时产生 WFE 唤醒事件
+
+// 本核计数器控制寄存器：EL2 上是 CNTHCTL_EL2，EL1 上是 CNTKCTL_EL1，事件流的位定义相同
+static uint64_t
+top_cntctl_read(void)
+{
+    uint64_t val;
+
+    if (get_el() == 2) {
+        __asm__ __volatile__("mrs %0, cnthctl_el2" : "=r"(val));
+    } else {
+        __asm__ __volatile__("mrs %0, cntkctl_el1" : "=r"(val));
+    }
+    return val;
+}
+
+static void
+top_cntctl_write(uint64_t val)
+{
+    if (get_el() == 2) {
+        __asm__ __volatile__("msr cnthctl_el2, %0\n isb" : : "r"(val) : "memory");
+    } else {
+        __asm__ __volatile__("msr cntkctl_el1, %0\n isb" : : "r"(val) : "memory");
+    }
+}
+
+// 等待一个轮询片。本核有调度器在跑时睡眠让出 pCPU；shell 在启动核的引导上下文里
+// 没有任务可以切换，就用 WFE 等计数器事件流唤醒，同样不空转
+static void
+top_sleep_slice(void)
+{
+    if (get_task_manager()->sched[get_current_cpu_id()].current_task != NULL) {
+        task_sleep_us(TOP_POLL_US);
+        return;
+    }
+
+    uint64_t end = read_cntpct_el0() + read_cntfrq_el0() * TOP_POLL_US / 1000000;
+    while (read_cntpct_el0() < end) {
+        __asm__ __volatile__("wfe" : : : "memory");
+    }
+}
+
+static void
+shell_cmd_top(int argc, char **args)
+{
+    uint32_t interval_ms = 1000;
+    uint32_t iterations  = 0;  // 0 表示一直刷新直到按键
+
+    if (argc > 1) {
+        interval_ms = atol(args[1]);
+        if (interval_ms < 100) {
+            interval_ms = 100;
+        }
+    }
+    if (argc > 2) {
+        iterations = atol(args[2]);
+    }
+
+    uint64_t freq     = read_cntfrq_el0();
+    uint64_t interval = (freq * interval_ms) / 1000;
+    uint64_t last     = read_cntpct_el0();
+    char     c;
+
+    // 丢弃残留输入
+    while (uart_getchar_nb(&c)) {
+    }
+
+    // 打开事件流（EVNTEN，EVNTI = TOP_EVNTI），退出时恢复
+    uint64_t cntctl = top_cntctl_read();
+    top_cntctl_write((cntctl & ~0xfcULL) | (1ULL << 2) | ((uint64_t) TOP_EVNTI << 4));
+    top_take_sample(last);
+
+    for (uint32_t n = 0; iterations == 0 || n < iterations; n++) {
+        bool quit = false;
+        // 分片睡眠等待下一次刷新，每片醒来检查一次按键，不占着 pCPU 空转
+        while (read_cntpct_el0() - last < interval) {
+            if (uart_getchar_nb(&c)) {
+                quit = true;
+                break;
+            }
+            top_sleep_slice();
+        }
+        if (quit) {
+            break;
+        }
+
+        uint64_t now = read_cntpct_el0();
+        top_print(now, now - last, freq, interval_ms);
+        top_take_sample(now);
+        last = now;
+    }
+    top_cntctl_write(cntctl);
+    logger("\n");
+}
+
+// 自 1970-01-01 起的天数转换为公历年月日
+static void
+date_from_days(int64_t days, int64_t *year, uint32_t *month, uint32_t *day)
+{
+    days += 719468;  // 以 0000-03-01 为起点
+    int64_t  era = (days >= 0 ? days : days - 146096) / 146097;
+    uint32_t doe = (uint32_t) (days - era * 146097);
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp  = (5 * doy + 2) / 153;
+
+    *day   = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year  = (int64_t) yoe + era * 400 + (*month <= 2);
+}
+
+static void
+shell_cmd_date(int argc, char **args)
+{
+    // date <秒>：按 Unix 时间戳设置墙上时间
+    if (argc > 1) {
+        int64_t sec = atol(args[1]);
+        if (sec < 0) {
+            logger("Usage: date [unix_seconds]\n");
+            return;
+        }
+        clocksource_set_realtime((uint64_t) sec * NSEC_PER_SEC);
+    }
+
+    uint64_t real = ktime_get_real_ns();
+    uint64_t mono = ktime_get_ns();
+    uint64_t sec  = real / NSEC_PER_SEC;
+    int64_t  year;
+    uint32_t month, day;
+
+    date_from_days((int64_t) (sec / 86400), &year, &month, &day);
+    logger("%04lld-%02u-%02u %02llu:%02llu:%02llu UTC\n",
+           year,
+           month,
+           day,
+           (sec % 86400) / 3600,
+           (sec % 3600) / 60,
+           sec % 60);
+    logger("uptime: %llu.%06llu s\n", mono / NSEC_PER_SEC, (mono % NSEC_PER_SEC) / 1000);
+}
+
 // 命令表
 typedef struct
 {
@@ -1779,8 +2160,11 @@ static const shell_command_t shell_commands[] = {
     {"tree", shell_cmd_tree, "Display directory tree structure"},
     {"du", shell_cmd_du, "Display disk usage"},
     {"guest", shell_cmd_guest, "Guest management commands"},
+    {"top", shell_cmd_top, "Show live vCPU and pCPU utilization"},
+    {"date", shell_cmd_date, "Show or set wall-clock time"},
     {"help", shell_cmd_help, "Show help"},
     {"fsinfo", shell_cmd_fsinfo, "Show filesystem info"},
+    {"sync", shell_cmd_sync, "Write cached filesystem data to disk"},
     {"clear", shell_cmd_clear, "Clear screen"},
     {NULL, NULL, NULL}};
 
@@ -1866,5 +2250,9 @@ avatar_simple_shell(void)
         }
     }
 
+    // FAT 表和脏扇区都在内存中，退出前写回
+    if (fat32_is_mounted() && fat32_sync() != FAT32_OK) {
+        logger("Warning: failed to sync filesystem\n");
+    }
     logger("Shell exited.\n");
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file boottime.c
+ * @brief Implementation of boottime.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+/*
+ * guest 启动阶段分析
+ *
+ * 加载器和 vCPU 入口处直接打时间戳；guest 内部的阶段没有别的观测手段，
+ * 只能靠控制台输出：配置清单列出若干标记字符串，vpl011 每输出一个字符就在
+ * 当前行的末尾匹配一次，第一次命中时记录 CNTPCT。
+ */
+
+#include "vmm/boottime.h"
+#include "vmm/vm.h"
+#include "hrtimer.h"
+#include "timer.h"
+#include "lib/avatar_string.h"
+#include "io.h"
+
+static const char *const _event_names[BOOT_EV_MAX] = {
+    "image load start",
+    "image load end",
+    "first guest instruction",
+    "first console output",
+    "first userspace output",
+};
+
+void
+boottime_init(vm_boottime_t *bt, const guest_manifest_t *manifest)
+{
+    memset(bt, 0, sizeof(*bt));
+
+    bt->marker_str = manifest->boot_markers;
+    while (bt->marker_str && bt->marker_str[bt->marker_cnt]) {
+        if (bt->marker_cnt >= BOOTTIME_MARKER_MAX) {
+            logger_warn("boottime: only the first %d markers are tracked\n", BOOTTIME_MARKER_MAX);
+            break;
+        }
+        bt->marker_len[bt->marker_cnt] = strlen(bt->marker_str[bt->marker_cnt]);
+        bt->marker_cnt++;
+    }
+
+    bt->userspace_marker = manifest->userspace_marker;
+    if (bt->userspace_marker)
+        bt->userspace_len = strlen(bt->userspace_marker);
+}
+
+void
+boottime_record(vm_boottime_t *bt, boot_event_t ev)
+{
+    if (ev < BOOT_EV_MAX && bt->events[ev] == 0)
+        bt->events[ev] = read_cntpct_el0();
+}
+
+// 当前行是否以 str 结尾
+static bool
+boottime_line_ends_with(vm_boottime_t *bt, const char *str, uint32_t len)
+{
+    if (len == 0 || len > bt->line_len)
+        return false;
+    return memcmp(bt->line + bt->line_len - len, str, len) == 0;
+}
+
+static void
+boottime_update_done(vm_boottime_t *bt)
+{
+    bool userspace_done = !bt->userspace_marker || bt->events[BOOT_EV_USERSPACE];
+    bt->done            = userspace_done && bt->marker_hit == bt->marker_cnt;
+}
+
+void
+boottime_console_char(vm_boottime_t *bt, char c)
+{
+    if (bt->done)
+        return;
+
+    boottime_record(bt, BOOT_EV_FIRST_OUTPUT);
+
+    if (c == '\n' || c == '\r') {
+        bt->line_len = 0;
+        if (bt->userspace_seen)
+            bt->userspace_armed = true;
+        return;
+    }
+
+    if (bt->userspace_armed)
+        boottime_record(bt, BOOT_EV_USERSPACE);
+
+    // 行缓冲满时丢弃最早的字符，保留行尾用于匹配
+    if (bt->line_len == BOOTTIME_LINE_MAX) {
+        memmove(bt->line, bt->line + 1, BOOTTIME_LINE_MAX - 1);
+        bt->line_len--;
+    }
+    bt->line[bt->line_len++] = c;
+
+    for (uint32_t i = 0; i < bt->marker_cnt; i++) {
+        if (bt->markers[i] == 0 &&
+            boottime_line_ends_with(bt, bt->marker_str[i], bt->marker_len[i])) {
+            bt->markers[i] = read_cntpct_el0();
+            bt->marker_hit++;
+        }
+    }
+
+    if (!bt->userspace_seen &&
+        boottime_line_ends_with(bt, bt->userspace_marker, bt->userspace_len)) {
+        bt->userspace_seen = true;
+    }
+
+    boottime_update_done(bt);
+}
+
+typedef struct
+{
+    const char *name;
+    bool        is_marker;
+    uint64_t    ts;
+} boottime_entry_t;
+
+static void
+boottime_print_ms(uint64_t ticks)
+{
+    uint64_t us = hrtimer_ticks_to_us(ticks);
+    logger("%8llu.%03llu", us / 1000, us % 1000);
+}
+
+void
+boottime_dump(struct _vm_t *vm)
+{
+    vm_boottime_t   *bt = &vm->boottime;
+    boottime_entry_t entries[BOOT_EV_MAX + BOOTTIME_MARKER_MAX];
+    uint32_t         n = 0;
+
+    for (uint32_t i = 0; i < BOOT_EV_MAX; i++) {
+        entries[n].name      = _event_names[i];
+        entries[n].is_marker = false;
+        entries[n].ts        = bt->events[i];
+        n++;
+    }
+    for (uint32_t i = 0; i < bt->marker_cnt; i++) {
+        entries[n].name      = bt->marker_str[i];
+        entries[n].is_marker = true;
+        entries[n].ts        = bt->markers[i];
+        n++;
+    }
+
+    // 按发生时间插入排序，未发生的排在最后
+    for (uint32_t i = 1; i < n; i++) {
+        boottime_entry_t e = entries[i];
+        uint64_t         k = e.ts ? e.ts : ~0ULL;
+        uint32_t         j = i;
+        while (j > 0 && (entries[j - 1].ts ? entries[j - 1].ts : ~0ULL) > k) {
+            entries[j] = entries[j - 1];
+            j--;
+        }
+        entries[j] = e;
+    }
+
+    uint64_t base = bt->events[BOOT_EV_LOAD_START];
+    uint64_t prev = base;
+
+    logger("VM%u (%s) boot timeline, ms since image load start:\n", vm->vm_id, vm->vm_name);
+    logger("  %12s %12s  %s\n", "at", "delta", "phase");
+    for (uint32_t i = 0; i < n; i++) {
+        const char *prefix = entries[i].is_marker ? "marker: " : "";
+
+        if (entries[i].ts == 0 || base == 0) {
+            logger("  %12s %12s  %s%s\n", "-", "-", prefix, entries[i].name);
+            continue;
+        }
+        logger("  ");
+        boottime_print_ms(entries[i].ts - base);
+        logger(" ");
+        boottime_print_ms(entries[i].ts - prev);
+        logger("  %s%s\n", prefix, entries[i].name);
+        prev = entries[i].ts;
+    }
+}
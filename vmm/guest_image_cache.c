@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file guest_image_cache.c
+ * @brief Implementation of guest_image_cache.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+/*
+ * guest 镜像缓存
+ *
+ * 第一次从 FAT32 加载时，读文件用的中转缓冲区不再释放，而是作为原始副本留在
+ * 缓存里。之后同一配置清单的 guest start 和 PSCI SYSTEM_RESET 直接从副本
+ * memcpy 到加载地址，不再打开和读取文件。
+ *
+ * guest 会改写自己的内存（.data/.bss、释放后的 initrd 等），所以副本必须与
+ * guest 内存分开保存，不能直接共享页框。
+ */
+
+#include "vmm/guest_image_cache.h"
+#include "vmm/guest_lazy.h"
+#include "vmm/vmm_cfg.h"
+#include "mem/mem.h"
+#include "lib/avatar_string.h"
+#include "spinlock.h"
+#include "io.h"
+
+// shell 和 SMC 陷入处理（关中断）都会持锁，必须用 irqsave 版本；
+// 持锁期间只改表项，镜像拷贝和打印都放在锁外
+static guest_image_cache_entry_t g_image_cache[GUEST_IMAGE_CACHE_ENTRIES];
+static spinlock_t                g_image_cache_lock;
+static size_t                    g_image_cache_bytes;
+
+static const char *const _kind_names[GUEST_IMAGE_MAX] = {"kernel", "dtb", "initrd"};
+
+static guest_image_cache_entry_t *
+image_cache_find(const guest_manifest_t *manifest)
+{
+    for (int i = 0; i < GUEST_IMAGE_CACHE_ENTRIES; i++) {
+        if (g_image_cache[i].manifest == manifest) {
+            return &g_image_cache[i];
+        }
+    }
+    return NULL;
+}
+
+bool
+guest_image_cache_restore(const guest_manifest_t *manifest,
+                          guest_image_kind_t      kind,
+                          uint64_t                load_addr,
+                          size_t                 *size)
+{
+    guest_image_t image;
+
+    // 持锁取出副本并标记占用，防止拷贝期间被 guest_image_cache_drop 释放
+    uint64_t                   daif  = spin_lock_irqsave(&g_image_cache_lock);
+    guest_image_cache_entry_t *entry = image_cache_find(manifest);
+    if (!entry || !entry->images[kind].data) {
+        spin_unlock_irqrestore(&g_image_cache_lock, daif);
+        return false;
+    }
+    image = entry->images[kind];
+    entry->hits++;
+    entry->busy++;
+    spin_unlock_irqrestore(&g_image_cache_lock, daif);
+
+    // 目标地址可能残留上一次启动的按需加载区域，先解除
+    guest_lazy_unmap_range(load_addr, image.size);
+    memcpy((void *) load_addr, image.data, image.size);
+    *size = image.size;
+
+    daif = spin_lock_irqsave(&g_image_cache_lock);
+    entry->busy--;
+    spin_unlock_irqrestore(&g_image_cache_lock, daif);
+
+    logger_info("Restored cached %s of %s: %zu bytes to 0x%llx\n",
+                _kind_names[kind],
+                manifest->name,
+                *size,
+                load_addr);
+    return true;
+}
+
+bool
+guest_image_cache_put(const guest_manifest_t *manifest,
+                      guest_image_kind_t      kind,
+                      void                   *data,
+                      size_t                  size,
+                      uint32_t                pages)
+{
+    bool ok = false;
+
+    uint64_t                   daif  = spin_lock_irqsave(&g_image_cache_lock);
+    guest_image_cache_entry_t *entry = image_cache_find(manifest);
+    if (!entry) {
+        entry = image_cache_find(NULL);
+        if (entry) {
+            memset(entry, 0, sizeof(*entry));
+            entry->manifest = manifest;
+        }
+    }
+
+    // 已有副本时保留旧的，调用者释放新缓冲区
+    if (entry && !entry->images[kind].data &&
+        g_image_cache_bytes + (size_t) pages * PAGE_SIZE <= GUEST_IMAGE_CACHE_MAX) {
+        entry->images[kind].data  = data;
+        entry->images[kind].size  = size;
+        entry->images[kind].pages = pages;
+        g_image_cache_bytes += (size_t) pages * PAGE_SIZE;
+        ok = true;
+    }
+    spin_unlock_irqrestore(&g_image_cache_lock, daif);
+
+    if (!ok) {
+        logger_warn("Image cache: not caching %s of %s (%zu bytes)\n",
+                    _kind_names[kind],
+                    manifest->name,
+                    size);
+    }
+    return ok;
+}
+
+bool
+guest_image_cache_complete(const guest_manifest_t *manifest)
+{
+    bool complete;
+
+    uint64_t                   daif  = spin_lock_irqsave(&g_image_cache_lock);
+    guest_image_cache_entry_t *entry = image_cache_find(manifest);
+
+    complete = entry && entry->images[GUEST_IMAGE_KERNEL].data;
+    if (complete && manifest->files.needs_dtb && manifest->files.dtb_path)
+        complete = entry->images[GUEST_IMAGE_DTB].data != NULL;
+    if (complete && manifest->files.needs_initrd && manifest->files.initrd_path &&
+        !manifest->files.lazy_initrd)
+        complete = entry->images[GUEST_IMAGE_INITRD].data != NULL;
+    spin_unlock_irqrestore(&g_image_cache_lock, daif);
+
+    return complete;
+}
+
+void
+guest_image_cache_drop(const guest_manifest_t *manifest)
+{
+    guest_image_t dropped[GUEST_IMAGE_CACHE_ENTRIES * GUEST_IMAGE_MAX];
+    uint32_t      n    = 0;
+    uint32_t      busy = 0;
+
+    // 先从表中摘下，释放页面放在锁外；正在恢复的表项留到下次
+    uint64_t daif = spin_lock_irqsave(&g_image_cache_lock);
+    for (int i = 0; i < GUEST_IMAGE_CACHE_ENTRIES; i++) {
+        guest_image_cache_entry_t *entry = &g_image_cache[i];
+        if (!entry->manifest || (manifest && entry->manifest != manifest)) {
+            continue;
+        }
+        if (entry->busy) {
+            busy++;
+            continue;
+        }
+        for (int k = 0; k < GUEST_IMAGE_MAX; k++) {
+            if (entry->images[k].data) {
+                dropped[n++] = entry->images[k];
+                g_image_cache_bytes -= (size_t) entry->images[k].pages * PAGE_SIZE;
+            }
+        }
+        memset(entry, 0, sizeof(*entry));
+    }
+    spin_unlock_irqrestore(&g_image_cache_lock, daif);
+
+    for (uint32_t i = 0; i < n; i++) {
+        kfree_pages(dropped[i].data, dropped[i].pages);
+    }
+    if (busy) {
+        logger_warn("Image cache: %u entries in use by a restore, not dropped\n", busy);
+    }
+}
+
+void
+guest_image_cache_dump(void)
+{
+    guest_image_cache_entry_t snap[GUEST_IMAGE_CACHE_ENTRIES];
+    size_t                    bytes;
+    bool                      any = false;
+
+    // 持锁只拷贝表，打印在锁外
+    uint64_t daif = spin_lock_irqsave(&g_image_cache_lock);
+    memcpy(snap, g_image_cache, sizeof(snap));
+    bytes = g_image_cache_bytes;
+    spin_unlock_irqrestore(&g_image_cache_lock, daif);
+
+    for (int i = 0; i < GUEST_IMAGE_CACHE_ENTRIES; i++) {
+        guest_image_cache_entry_t *entry = &snap[i];
+        if (!entry->manifest) {
+            continue;
+        }
+        any = true;
+        logger("  %s: %u restores\n", entry->manifest->name, entry->hits);
+        for (int k = 0; k < GUEST_IMAGE_MAX; k++) {
+            if (entry->images[k].data) {
+                logger("    %-6s %zu bytes\n", _kind_names[k], entry->images[k].size);
+            }
+        }
+    }
+    logger("  total %zu KB of %u KB\n", bytes / 1024, (uint32_t) (GUEST_IMAGE_CACHE_MAX / 1024));
+
+    if (!any) {
+        logger("  (no cached images)\n");
+    }
+}
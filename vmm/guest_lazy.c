@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file guest_lazy.c
+ * @brief Implementation of guest_lazy.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+/*
+ * 按需加载的 guest 内存区域
+ *
+ * 大的 initrd / 根文件系统镜像往往只有一小部分会被 guest 访问，
+ * 启动时整体读入既浪费 I/O 也拖慢首条指令的执行时间。
+ * 这里把区域内的 stage-2 页表项置为无效，guest 首次访问时触发转换错误，
+ * 再从 FAT32 文件读入覆盖该页的簇（附带预读窗口），随后把页表项置为有效并返回
+ * guest 重新执行该指令。
+ *
+ * 缺页处理在 EL2 异常上下文中，不能取 fat32_lock，也不能用扇区缓存。映射时先
+ * fat32_sync 让磁盘上的内容是最新的，再在 fat32_lock 下把簇链一次解析成区段表；
+ * 之后缺页只按区段表直接读磁盘。文件在映射期间被视为不可变的镜像，映射之后
+ * 对它的修改 guest 不一定看得到。
+ *
+ * stage-2 目前是恒等映射 (GPA == HPA)，所以“新页框”就是 GPA 对应的物理页，
+ * 填充完成后直接恢复原来的映射即可。
+ */
+
+#include "vmm/guest_lazy.h"
+#include "mem/stage2page.h"
+#include "mem/page.h"
+#include "mem/mem.h"
+#include "mem/kallocator.h"
+#include "fs/fat32.h"
+#include "fs/fat32_dir.h"
+#include "fs/fat32_fat.h"
+#include "fs/fat32_boot.h"
+#include "fs/fat32_disk.h"
+#include "lib/avatar_string.h"
+#include "spinlock.h"
+#include "os_cfg.h"
+#include "io.h"
+
+static guest_lazy_region_t g_lazy_regions[GUEST_LAZY_REGION_MAX];
+static spinlock_t          g_lazy_lock;
+
+/* 转换错误: FSC = 0b0001xx (level 0-3) */
+#define FSC_TRANSLATION_MASK  0x3c
+#define FSC_TRANSLATION_FAULT 0x04
+
+static inline bool
+lazy_region_contains(const guest_lazy_region_t *region, paddr_t gpa)
+{
+    return region->in_use && region->gpa_start <= gpa &&
+           gpa < region->gpa_start + region->region_size;
+}
+
+static guest_lazy_region_t *
+lazy_find_region(paddr_t gpa)
+{
+    for (int i = 0; i < GUEST_LAZY_REGION_MAX; i++) {
+        if (lazy_region_contains(&g_lazy_regions[i], gpa)) {
+            return &g_lazy_regions[i];
+        }
+    }
+    return NULL;
+}
+
+// 批量修改 [gpa, gpa + size) 的 L3 页表项有效位，修改后统一刷新
+static void
+lazy_set_pages_valid(paddr_t gpa, size_t size, bool valid)
+{
+    lpae_t *first = get_ept_entry(gpa);
+    size_t  pages = size / PAGE_SIZE;
+
+    for (size_t i = 0; i < pages; i++) {
+        first[i].p2m.valid = valid ? 1 : 0;
+    }
+
+    clean_and_invalidate_dcache_va_range(first, pages * sizeof(lpae_t));
+    apply_ept(first);
+}
+
+// 查找包含文件第 index 个簇的区段，区段按 file_index 递增排列
+static const fat32_extent_t *
+lazy_extent_at(const guest_lazy_region_t *region, uint32_t index)
+{
+    uint32_t lo = 0;
+    uint32_t hi = region->extent_count;
+
+    while (lo < hi) {
+        uint32_t              mid = lo + (hi - lo) / 2;
+        const fat32_extent_t *ext = &region->extents[mid];
+        if (index < ext->file_index) {
+            hi = mid;
+        } else if (index >= ext->file_index + ext->length) {
+            lo = mid + 1;
+        } else {
+            return ext;
+        }
+    }
+    return NULL;
+}
+
+// 把文件的簇链解析成区段表，调用者持有 fat32_lock
+static fat32_error_t
+lazy_build_extents(uint32_t         first_cluster,
+                   size_t           file_size,
+                   fat32_extent_t **extents,
+                   uint32_t        *extent_count)
+{
+    fat32_context_t *ctx      = fat32_get_context();
+    uint32_t         bpc      = ctx->fs_info.bytes_per_cluster;
+    uint32_t         clusters = (file_size + bpc - 1) / bpc;
+    fat32_extent_t  *table    = NULL;
+    uint32_t         count    = 0;
+
+    // 第一遍只数区段，第二遍填表
+    for (int pass = 0; pass < 2; pass++) {
+        uint32_t cluster = first_cluster;
+
+        count = 0;
+        for (uint32_t index = 0; index < clusters; index++) {
+            if (index > 0) {
+                uint32_t      next;
+                fat32_error_t result =
+                    fat32_fat_get_next_cluster(ctx->disk, &ctx->fs_info, cluster, &next);
+                if (result != FAT32_OK) {
+                    kfree(table);
+                    return result;
+                }
+                if (next == 0) {
+                    kfree(table);
+                    return FAT32_ERROR_CORRUPTED;
+                }
+                bool contiguous = next == cluster + 1;
+                cluster         = next;
+                if (contiguous) {
+                    if (table) {
+                        table[count - 1].length++;
+                    }
+                    continue;
+                }
+            }
+            if (table) {
+                table[count].file_index = index;
+                table[count].cluster    = cluster;
+                table[count].length     = 1;
+            }
+            count++;
+        }
+
+        if (table == NULL) {
+            table = (fat32_extent_t *) kalloc(count * sizeof(fat32_extent_t), 8);
+            if (table == NULL) {
+                return FAT32_ERROR_NO_SPACE;
+            }
+        }
+    }
+
+    *extents      = table;
+    *extent_count = count;
+    return FAT32_OK;
+}
+
+/*
+ * 把文件 [start, end) 的内容读到区域对应的 guest 内存中。
+ * 调用者保证该范围内的页全部无效，因此整簇可以直接读到目标地址，
+ * 并且同一区段内的簇合并成一次磁盘请求；只有跨越窗口边界的簇才经过中转缓冲区。
+ * 这里运行在 stage-2 缺页处理中，只用区段表直接读磁盘，不访问 FAT 表和扇区缓存。
+ */
+static fat32_error_t
+lazy_read_range(guest_lazy_region_t *region, size_t start, size_t end)
+{
+    fat32_context_t *ctx          = fat32_get_context();
+    fat32_fs_info_t *fs_info      = &ctx->fs_info;
+    uint32_t         bpc          = fs_info->bytes_per_cluster;
+    uint8_t         *dst          = (uint8_t *) region->gpa_start;
+    uint8_t         *bounce       = NULL;
+    uint32_t         bounce_pages = (bpc + PAGE_SIZE - 1) / PAGE_SIZE;
+    fat32_error_t    result       = FAT32_OK;
+    size_t           pos          = start;
+
+    while (pos < end) {
+        uint32_t              index  = pos / bpc;
+        uint32_t              offset = pos % bpc;
+        const fat32_extent_t *ext    = lazy_extent_at(region, index);
+
+        if (ext == NULL) {
+            result = FAT32_ERROR_CORRUPTED;
+            break;
+        }
+        uint32_t cluster = ext->cluster + (index - ext->file_index);
+
+        if (offset == 0 && end - pos >= bpc) {
+            // 整簇读取，合并同一区段内的后续簇
+            uint32_t run = ext->file_index + ext->length - index;
+            if ((size_t) run * bpc > end - pos) {
+                run = (end - pos) / bpc;
+            }
+
+            result = fat32_disk_read_sectors(ctx->disk,
+                                             fat32_boot_cluster_to_sector(fs_info, cluster),
+                                             run * fs_info->sectors_per_cluster,
+                                             dst + pos);
+            if (result != FAT32_OK) {
+                break;
+            }
+            pos += (size_t) run * bpc;
+            continue;
+        }
+
+        // 部分簇：经中转缓冲区复制需要的部分
+        if (bounce == NULL) {
+            bounce = (uint8_t *) kalloc_pages(bounce_pages);
+            if (bounce == NULL) {
+                result = FAT32_ERROR_NO_SPACE;
+                break;
+            }
+        }
+
+        result = fat32_disk_read_sectors(ctx->disk,
+                                         fat32_boot_cluster_to_sector(fs_info, cluster),
+                                         fs_info->sectors_per_cluster,
+                                         bounce);
+        if (result != FAT32_OK) {
+            break;
+        }
+
+        size_t chunk = bpc - offset;
+        if (chunk > end - pos) {
+            chunk = end - pos;
+        }
+        memcpy(dst + pos, bounce + offset, chunk);
+        pos += chunk;
+    }
+
+    if (bounce != NULL) {
+        kfree_pages(bounce, bounce_pages);
+    }
+    return result;
+}
+
+// 填充包含 page_off 的页以及其后的预读窗口
+static void
+lazy_fill(guest_lazy_region_t *region, size_t page_off)
+{
+    size_t win_end = page_off + GUEST_LAZY_READAHEAD_PAGES * PAGE_SIZE;
+    if (win_end > region->region_size) {
+        win_end = region->region_size;
+    }
+
+    // 预读窗口遇到已填充的页即停止，避免覆盖 guest 已修改的数据
+    for (size_t off = page_off + PAGE_SIZE; off < win_end; off += PAGE_SIZE) {
+        if (get_ept_entry(region->gpa_start + off)->p2m.valid) {
+            win_end = off;
+            break;
+        }
+    }
+
+    size_t   data_end = win_end < region->file_size ? win_end : region->file_size;
+    uint8_t *dst      = (uint8_t *) region->gpa_start;
+
+    if (page_off < data_end) {
+        fat32_error_t result = lazy_read_range(region, page_off, data_end);
+        if (result != FAT32_OK) {
+            logger_error("Lazy region %s: read at offset 0x%lx failed: %s\n",
+                         region->path,
+                         page_off,
+                         fat32_get_error_string(result));
+            // 只映射出错的那一页（清零），让 guest 继续运行并自行发现数据错误
+            win_end  = page_off + PAGE_SIZE;
+            data_end = page_off;
+        }
+    } else {
+        data_end = page_off;
+    }
+
+    // 文件末尾之后的部分清零
+    if (data_end < win_end) {
+        memset(dst + data_end, 0, win_end - data_end);
+    }
+
+    // guest 可能在关闭缓存的情况下访问这段内存
+    clean_and_invalidate_dcache_va_range(dst + page_off, win_end - page_off);
+    lazy_set_pages_valid(region->gpa_start + page_off, win_end - page_off, true);
+
+    region->faults++;
+    region->pages_filled += (win_end - page_off) / PAGE_SIZE;
+}
+
+static void
+lazy_unmap_locked(paddr_t gpa, size_t size)
+{
+    for (int i = 0; i < GUEST_LAZY_REGION_MAX; i++) {
+        guest_lazy_region_t *region = &g_lazy_regions[i];
+        if (!region->in_use) {
+            continue;
+        }
+        if (region->gpa_start >= gpa + size || gpa >= region->gpa_start + region->region_size) {
+            continue;
+        }
+
+        lazy_set_pages_valid(region->gpa_start, region->region_size, true);
+        logger_info("Lazy region %s unmapped (%u faults, %u/%u pages filled)\n",
+                    region->path,
+                    region->faults,
+                    region->pages_filled,
+                    (uint32_t) (region->region_size / PAGE_SIZE));
+        kfree(region->extents);
+        memset(region, 0, sizeof(*region));
+    }
+}
+
+int32_t
+guest_lazy_map_file(const char *filepath, paddr_t gpa, size_t *mapped_size)
+{
+    if (!filepath || !mapped_size || (gpa & (PAGE_SIZE - 1)) != 0) {
+        logger_error("Invalid parameters for lazy mapping\n");
+        return -1;
+    }
+
+    *mapped_size = 0;
+
+    if (!fat32_is_mounted()) {
+        logger_error("File system not mounted\n");
+        return -1;
+    }
+
+    // 缺页时绕过扇区缓存直接读磁盘，先把缓存中的脏数据和 FAT 表写回
+    if (fat32_sync() != FAT32_OK) {
+        logger_warn("Failed to sync file system before lazy mapping %s\n", filepath);
+        return -1;
+    }
+
+    fat32_dir_entry_t entry;
+    fat32_extent_t   *extents      = NULL;
+    uint32_t          extent_count = 0;
+
+    fat32_lock();
+    if (fat32_stat(filepath, &entry) != FAT32_OK || fat32_dir_is_directory(&entry)) {
+        fat32_unlock();
+        logger_warn("Failed to stat file: %s\n", filepath);
+        return -1;
+    }
+
+    uint32_t first_cluster = fat32_dir_get_first_cluster(&entry);
+    size_t   file_size     = entry.file_size;
+    size_t   region_size   = (file_size + PAGE_SIZE - 1) & ~((size_t) PAGE_SIZE - 1);
+
+    if (file_size == 0 || first_cluster < 2) {
+        fat32_unlock();
+        logger_warn("File is empty: %s\n", filepath);
+        return -1;
+    }
+
+    fat32_error_t result = lazy_build_extents(first_cluster, file_size, &extents, &extent_count);
+    fat32_unlock();
+    if (result != FAT32_OK) {
+        logger_error("Failed to resolve clusters of %s: %s\n",
+                     filepath,
+                     fat32_get_error_string(result));
+        return -1;
+    }
+
+    if (gpa < GUEST_RAM_START || gpa + region_size > GUEST_RAM_END) {
+        kfree(extents);
+        logger_error("Lazy region 0x%llx+0x%lx outside guest RAM\n", gpa, region_size);
+        return -1;
+    }
+
+    spin_lock(&g_lazy_lock);
+
+    lazy_unmap_locked(gpa, region_size);
+
+    guest_lazy_region_t *region = NULL;
+    for (int i = 0; i < GUEST_LAZY_REGION_MAX; i++) {
+        if (!g_lazy_regions[i].in_use) {
+            region = &g_lazy_regions[i];
+            break;
+        }
+    }
+
+    if (region == NULL) {
+        spin_unlock(&g_lazy_lock);
+        kfree(extents);
+        logger_error("No free lazy region slot for %s\n", filepath);
+        return -1;
+    }
+
+    memset(region, 0, sizeof(*region));
+    strncpy(region->path, filepath, sizeof(region->path) - 1);
+    region->gpa_start     = gpa;
+    region->file_size     = file_size;
+    region->region_size   = region_size;
+    region->extents       = extents;
+    region->extent_count  = extent_count;
+    region->in_use        = true;
+
+    lazy_set_pages_valid(gpa, region_size, false);
+
+    spin_unlock(&g_lazy_lock);
+
+    *mapped_size = file_size;
+    logger_info("Lazy mapped %s: %zu bytes at 0x%llx (readahead %d pages)\n",
+                filepath,
+                file_size,
+                gpa,
+                GUEST_LAZY_READAHEAD_PAGES);
+    return 0;
+}
+
+void
+guest_lazy_unmap_range(paddr_t gpa, size_t size)
+{
+    spin_lock(&g_lazy_lock);
+    lazy_unmap_locked(gpa, size);
+    spin_unlock(&g_lazy_lock);
+}
+
+bool
+guest_lazy_handle_fault(stage2_fault_info_t *info)
+{
+    // 数据中止的 DFSC 与指令中止的 IFSC 位置相同
+    if ((info->esr.dabt.dfsc & FSC_TRANSLATION_MASK) != FSC_TRANSLATION_FAULT) {
+        return false;
+    }
+
+    paddr_t page_gpa = info->gpa & ~((paddr_t) PAGE_SIZE - 1);
+
+    spin_lock(&g_lazy_lock);
+
+    guest_lazy_region_t *region = lazy_find_region(page_gpa);
+    if (region == NULL) {
+        spin_unlock(&g_lazy_lock);
+        return false;
+    }
+
+    // 其他 vCPU 可能已经填充了这一页
+    if (!get_ept_entry(page_gpa)->p2m.valid) {
+        lazy_fill(region, page_gpa - region->gpa_start);
+    }
+
+    spin_unlock(&g_lazy_lock);
+    return true;
+}
+
+void
+guest_lazy_dump(void)
+{
+    bool any = false;
+
+    spin_lock(&g_lazy_lock);
+    for (int i = 0; i < GUEST_LAZY_REGION_MAX; i++) {
+        guest_lazy_region_t *region = &g_lazy_regions[i];
+        if (!region->in_use) {
+            continue;
+        }
+        any = true;
+        logger("  %s: GPA 0x%llx-0x%llx, %u faults, %u/%u pages filled\n",
+               region->path,
+               region->gpa_start,
+               region->gpa_start + region->region_size,
+               region->faults,
+               region->pages_filled,
+               (uint32_t) (region->region_size / PAGE_SIZE));
+    }
+    spin_unlock(&g_lazy_lock);
+
+    if (!any) {
+        logger("  (no lazy regions)\n");
+    }
+}
@@ -11,6 +11,8 @@
  */
 
 #include "vmm/guest_loader.h"
+#include "vmm/guest_lazy.h"
+#include "vmm/guest_image_cache.h"
 #include "fs/fat32.h"
 #include "mem/mem.h"
 #include "io.h"
@@ -19,9 +21,13 @@
 #include "fs/fat32_file.h"
 #include "timer.h"
 
-// 从文件系统加载文件到内存
-fat32_error_t
-guest_load_file_to_memory(const char *filepath, uint64_t load_addr, size_t *loaded_size)
+// 从文件系统加载文件到内存，并通过 buffer/pages 返回读文件用的缓冲区，由调用者释放或缓存
+static fat32_error_t
+guest_load_file_buffered(const char *filepath,
+                         uint64_t    load_addr,
+                         size_t     *loaded_size,
+                         void      **buffer,
+                         uint32_t   *pages)
 {
     if (!filepath || !loaded_size) {
         logger_error("Invalid parameters for file loading\n");
@@ -94,11 +100,15 @@ guest_load_file_to_memory(const char *filepath, uint64_t load_addr, size_t *load
         return FAT32_ERROR_DISK_ERROR;
     }
 
+    // 目标地址可能残留上一次启动的按需加载区域，先解除
+    guest_lazy_unmap_range(load_addr, file_size);
+
     // 复制到目标地址
     memcpy((void *) load_addr, temp_buffer, file_size);
-    kfree_pages(temp_buffer, pages_needed);
 
     *loaded_size = file_size;
+    *buffer      = temp_buffer;
+    *pages       = pages_needed;
 
     // 计算并报告性能（只包含实际文件读取时间）
     uint64_t duration_ticks = end_ticks - start_ticks;
@@ -114,6 +124,45 @@ guest_load_file_to_memory(const char *filepath, uint64_t load_addr, size_t *load
     return FAT32_OK;
 }
 
+// 从文件系统加载文件到内存
+fat32_error_t
+guest_load_file_to_memory(const char *filepath, uint64_t load_addr, size_t *loaded_size)
+{
+    void    *buffer;
+    uint32_t pages;
+
+    fat32_error_t result =
+        guest_load_file_buffered(filepath, load_addr, loaded_size, &buffer, &pages);
+    if (result == FAT32_OK) {
+        kfree_pages(buffer, pages);
+    }
+    return result;
+}
+
+// 优先从镜像缓存恢复；缓存未命中时从文件加载，并把读入的内容留作原始副本
+static fat32_error_t
+guest_load_image(const guest_manifest_t *manifest,
+                 guest_image_kind_t      kind,
+                 const char             *filepath,
+                 uint64_t                load_addr,
+                 size_t                 *loaded_size)
+{
+    void    *buffer;
+    uint32_t pages;
+
+    if (guest_image_cache_restore(manifest, kind, load_addr, loaded_size)) {
+        return FAT32_OK;
+    }
+
+    fat32_error_t result =
+        guest_load_file_buffered(filepath, load_addr, loaded_size, &buffer, &pages);
+    if (result == FAT32_OK &&
+        !guest_image_cache_put(manifest, kind, buffer, *loaded_size, pages)) {
+        kfree_pages(buffer, pages);
+    }
+    return result;
+}
+
 // 验证Guest文件是否存在
 bool
 guest_validate_files(const guest_manifest_t *manifest)
@@ -240,17 +289,19 @@ guest_load_from_manifest(const guest_manifest_t *manifest)
                 manifest->name,
                 guest_type_to_string(manifest->type));
 
-    // 验证文件存在性
-    if (!guest_validate_files(manifest)) {
+    // 验证文件存在性，镜像全部在缓存中时不再访问磁盘
+    if (!guest_image_cache_complete(manifest) && !guest_validate_files(manifest)) {
         logger_error("File validation failed for guest: %s\n", manifest->name);
         result.error = GUEST_LOAD_ERROR_FILE_SYSTEM_ERROR;
         return result;
     }
 
     // 1. 加载内核（必需）
-    fat32_error_t fs_result = guest_load_file_to_memory(manifest->files.kernel_path,
-                                                        manifest->bin_loadaddr,
-                                                        &result.kernel_size);
+    fat32_error_t fs_result = guest_load_image(manifest,
+                                               GUEST_IMAGE_KERNEL,
+                                               manifest->files.kernel_path,
+                                               manifest->bin_loadaddr,
+                                               &result.kernel_size);
 
     if (fs_result != FAT32_OK) {
         logger_error("Failed to load kernel: %s (error: %d)\n",
@@ -262,9 +313,11 @@ guest_load_from_manifest(const guest_manifest_t *manifest)
 
     // 2. 加载DTB（可选）
     if (manifest->files.needs_dtb && manifest->files.dtb_path) {
-        fs_result = guest_load_file_to_memory(manifest->files.dtb_path,
-                                              manifest->dtb_loadaddr,
-                                              &result.dtb_size);
+        fs_result = guest_load_image(manifest,
+                                     GUEST_IMAGE_DTB,
+                                     manifest->files.dtb_path,
+                                     manifest->dtb_loadaddr,
+                                     &result.dtb_size);
 
         if (fs_result != FAT32_OK) {
             logger_warn("Failed to load DTB: %s (error: %d)\n",
@@ -276,9 +329,19 @@ guest_load_from_manifest(const guest_manifest_t *manifest)
 
     // 3. 加载initrd（可选）
     if (manifest->files.needs_initrd && manifest->files.initrd_path) {
-        fs_result = guest_load_file_to_memory(manifest->files.initrd_path,
-                                              manifest->fs_loadaddr,
-                                              &result.initrd_size);
+        if (manifest->files.lazy_initrd &&
+            guest_lazy_map_file(manifest->files.initrd_path,
+                                manifest->fs_loadaddr,
+                                &result.initrd_size) == 0) {
+            fs_result = FAT32_OK;
+        } else {
+            // 按需映射失败时回退到整体加载
+            fs_result = guest_load_image(manifest,
+                                         GUEST_IMAGE_INITRD,
+                                         manifest->files.initrd_path,
+                                         manifest->fs_loadaddr,
+                                         &result.initrd_size);
+        }
 
         if (fs_result != FAT32_OK) {
             logger_warn("Failed to load initrd: %s (error: %d)\n",
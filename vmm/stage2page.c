@@ -219,12 +219,20 @@ data_abort_handler(stage2_fault_info_t *info, trap_frame_t *el2_ctx)
         return;
     }
 
+#if GIC_VERSION == 3
+    // GICv3 的 CPU 接口为系统寄存器，guest 只会访问 redistributor 帧
+    if (GICR_BASE_ADDR <= info->gpa && info->gpa < (GICR_BASE_ADDR + GICR_STRIDE * VCPU_NUM_MAX)) {
+        intc_handler(info, el2_ctx);
+        return;
+    }
+#else
     if (GICC_BASE_ADDR <= info->gpa && info->gpa < (GICC_BASE_ADDR + 0x0010000)) {
         info->gpa = info->gpa + 0x30000;
         handle_mmio(info, el2_ctx);
         gicc_save_core_state();
         return;
     }
+#endif
 
     // Handle PL011 UART MMIO access
     if (UART0_BASE_ADDR <= info->gpa && info->gpa < (UART0_BASE_ADDR + 0x1000)) {
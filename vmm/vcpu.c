@@ -37,18 +37,7 @@ get_vcpuid(tcb_t *task)
     if (!task) {
         task = curr_task_el2();
     }
-    return (task->cpu_info->sys_reg->mpidr_el1 & 0xff);
-}
-
-list_t *
-get_vcpus(tcb_t *task)
-{
-    struct _vm_t *vm = NULL;
-    if (!task) {
-        task = curr_task_el2();
-    }
-    vm = task->curr_vm;
-    return &vm->vcpus;
+    return vgic_affinity_to_vcpu(task->cpu_info->sys_reg->mpidr_el1);
 }
 
 // 这时候的 curr 已经是下一个任务了
@@ -63,9 +52,13 @@ vcpu_in()
     extern void vtimer_core_restore(tcb_t * task);
 
     // 先修改内存中的值
-    if (!curr->curr_vm)
+    // 从嵌套中断返回时仍处于被抢占的 EL2 处理函数中，不恢复 vCPU 状态
+    if (!curr->curr_vm || el2_irq_depth())
         return;
 
+    if (curr == curr->curr_vm->primary_vcpu)
+        boottime_record(&curr->curr_vm->boottime, BOOT_EV_FIRST_INSN);
+
     // 中断操作记录在内存
     vgic_try_inject_pending(curr);
 
@@ -87,9 +80,12 @@ vcpu_out()
     extern void save_sysregs(cpu_sysregs_t *);
     extern void gicc_save_core_state();
     extern void vtimer_core_save(tcb_t * task);
-    if (!curr->curr_vm)
+    // 嵌套中断打断的是 EL2 处理函数，vCPU 状态已在最外层保存
+    if (!curr->curr_vm || el2_irq_depth())
         return;
 
+    curr->exits++;
+
     save_sysregs(curr->cpu_info->sys_reg);
 
     gicc_save_core_state();
@@ -21,15 +21,10 @@
 #include "thread.h"
 #include "mmio.h"
 #include "lib/avatar_string.h"
+#include "mem/kallocator.h"
 #include "lib/bit_utils.h"
 #include "exception.h"
 
-static vgic_t   _vgic[VM_NUM_MAX];
-static uint32_t _vgic_num = 0;
-
-static vgic_core_state_t _state[VCPU_NUM_MAX];
-static uint32_t          _state_num = 0;
-
 
 vgic_core_state_t *
 get_vgicc_by_vcpu(tcb_t *task);  // if task==NULL, return current task's core state structure
@@ -37,11 +32,11 @@ get_vgicc_by_vcpu(tcb_t *task);  // if task==NULL, return current task's core st
 vgic_t *
 alloc_vgic()
 {
-    if (_vgic_num >= VM_NUM_MAX) {
+    vgic_t *vgic = kalloc(sizeof(vgic_t), 8);
+    if (vgic == NULL) {
         logger_error("No more VGIC can be allocated!\n");
         return NULL;
     }
-    vgic_t *vgic = &_vgic[_vgic_num++];
     memset(vgic, 0, sizeof(vgic_t));
     return vgic;
 }
@@ -49,7 +44,13 @@ alloc_vgic()
 vgic_core_state_t *
 alloc_gicc()
 {
-    return &_state[_state_num++];
+    vgic_core_state_t *state = kalloc(sizeof(vgic_core_state_t), 8);
+    if (state == NULL) {
+        logger_error("No more VGICC can be allocated!\n");
+        return NULL;
+    }
+    memset(state, 0, sizeof(vgic_core_state_t));
+    return state;
 }
 
 vgic_core_state_t *
@@ -59,20 +60,12 @@ get_vgicc_by_vcpu(tcb_t *task)
         task = curr_task_el2();
     }
     struct _vm_t      *vm    = task->curr_vm;
-    vgic_t            *vgic  = vm->vgic;
+    uint32_t           id    = get_vcpuid(task);
     vgic_core_state_t *vgicc = NULL;
 
-    list_node_t *iter = list_first(&vm->vcpus);
-    int32_t      i    = 0;
-    while (iter) {
-        tcb_t *iter_vcpu = list_node_parent(iter, tcb_t, vm_node);
-        if (task == iter_vcpu) {
-            vgicc = vgic->core_state[i];
-            break;  // 找到了，直接退出
-        }
-        i++;
-        iter = list_node_next(iter);
-    }
+    // vCPU 编号由 MPIDR 直接换算，不用遍历 vCPU 列表
+    if (id < vm->vcpu_cnt && vm->vcpu[id] == task)
+        vgicc = vm->vgic->core_state[id];
     if (!vgicc) {
         logger_error("VGIC: failed to find vgicc for task %d in vm %d\n", task->task_id, vm->vm_id);
         while (1) {
@@ -97,7 +90,7 @@ vgicc_dump(vgic_core_state_t *vgicc)
     logger_info("HCR   = 0x%08x\n", vgicc->saved_hcr);
 
     for (int32_t i = 0; i < GICH_LR_NUM; i++) {
-        logger_info("LR[%1d] = 0x%08x\n", i, vgicc->saved_lr[i]);
+        logger_info("LR[%1d] = " GIC_LR_FMT "\n", i, vgicc->saved_lr[i]);
     }
 
     logger_info("Pending IRQs:\n");
@@ -115,43 +108,33 @@ vgicc_hw_dump(void)
 {
     logger_info("====== VGICC HW Dump ======\n");
 
-    uint32_t vmcr  = mmio_read32((void *) (GICH_VMCR));
-    uint32_t elsr0 = mmio_read32((void *) (GICH_ELSR0));
-    uint32_t elsr1 = mmio_read32((void *) (GICH_ELSR1));
-    uint32_t apr   = mmio_read32((void *) (GICH_APR));
-    uint32_t hcr   = mmio_read32((void *) (GICH_HCR));
-    uint32_t vtr   = mmio_read32((void *) (GICH_VTR));
-    uint32_t misr  = mmio_read32((void *) (GICH_MISR));
+    uint32_t vmcr  = gic_read_vmcr();
+    uint32_t elsr0 = gic_elsr0();
+    uint32_t elsr1 = gic_elsr1();
+    uint32_t apr   = gic_apr();
+    uint32_t hcr   = gic_read_hcr();
 
     logger_info("VMCR  = 0x%08x\n", vmcr);
     logger_info("ELSR0 = 0x%08x\n", elsr0);
     logger_info("ELSR1 = 0x%08x\n", elsr1);
     logger_info("APR   = 0x%08x\n", apr);
     logger_info("HCR   = 0x%08x\n", hcr);
-    logger_info("VTR   = 0x%08x\n", vtr);
-    logger_info("MISR  = 0x%08x\n", misr);
+#if GIC_VERSION != 3
+    logger_info("VTR   = 0x%08x\n", mmio_read32((void *) (GICH_VTR)));
+    logger_info("MISR  = 0x%08x\n", mmio_read32((void *) (GICH_MISR)));
+#endif
 
     for (int32_t i = 0; i < GICH_LR_NUM; i++) {
-        uint32_t lr = mmio_read32((void *) (GICH_LR(i)));
+        gic_lr_t lr = gic_read_lr(i);
         if (lr != 0) {
-            uint32_t vid   = lr & 0x3ff;
-            uint32_t pid   = (lr >> 10) & 0x3ff;
-            uint32_t pri   = (lr >> 23) & 0x1f;
-            uint32_t state = (lr >> 28) & 0x3;
-            uint32_t grp1  = (lr >> 30) & 0x1;
-            uint32_t hw    = (lr >> 31) & 0x1;
-
-            logger_info("LR[%1d] = 0x%08x (VID=%d, PID=%d, PRI=%d, STATE=%d, GRP1=%d, HW=%d)\n",
+            logger_info("LR[%1d] = " GIC_LR_FMT " (VID=%d, PRI=0x%x, STATE=%d)\n",
                         i,
                         lr,
-                        vid,
-                        pid,
-                        pri,
-                        state,
-                        grp1,
-                        hw);
+                        gic_lr_read_vid(lr),
+                        gic_lr_read_pri(lr),
+                        gic_lr_read_state(lr));
         } else {
-            logger_info("LR[%1d] = 0x%08x (empty)\n", i, lr);
+            logger_info("LR[%1d] = " GIC_LR_FMT " (empty)\n", i, lr);
         }
     }
 
@@ -164,7 +147,7 @@ vgicc_dump_if_changed(vgic_core_state_t *state, uint32_t vcpu_id, uint32_t task_
     static uint32_t last_vmcr[8]            = {0};
     static uint32_t last_elsr0[8]           = {0};
     static uint32_t last_hcr[8]             = {0};
-    static uint32_t last_lr[8][GICH_LR_NUM] = {0};
+    static gic_lr_t last_lr[8][GICH_LR_NUM] = {0};
     static bool     initialized[8]          = {false};
 
     if (vcpu_id >= 8)
@@ -202,7 +185,7 @@ vgicc_dump_if_changed(vgic_core_state_t *state, uint32_t vcpu_id, uint32_t task_
 
         for (int32_t i = 0; i < GICH_LR_NUM; i++) {
             if (state->saved_lr[i] != 0) {
-                logger_vgic_debug("LR[%d]: 0x%08x\n", i, state->saved_lr[i]);
+                logger_vgic_debug("LR[%d]: " GIC_LR_FMT "\n", i, state->saved_lr[i]);
             }
         }
         logger_vgic_debug("==========================================\n");
@@ -462,9 +445,7 @@ vgic_try_inject_pending(tcb_t *task)
             }
 
             // 防止重复注入：判断 saved_lr 中是否已经有相同中断
-            uint32_t val = vgicc->saved_lr[lr];
-            uint32_t vid = (val >> GICH_LR_PID_SHIFT) & 0x3ff;
-            if (vid == i) {
+            if (gic_lr_read_vid(vgicc->saved_lr[lr]) == i) {
                 freelr = -1;
                 break;
             }
@@ -477,7 +458,7 @@ vgic_try_inject_pending(tcb_t *task)
         }
 
         int32_t  vcpu_id = get_vcpuid(task);
-        uint32_t lr_val;
+        gic_lr_t lr_val;
 
         // 根据中断类型创建不同的 LR 值
         if (i < 16) {
@@ -497,7 +478,8 @@ vgic_try_inject_pending(tcb_t *task)
         vgic_clear_irq_pending(vgicc, i);
 
         const char *irq_type = (i < 16) ? "SGI" : "PPI";
-        logger_vgic_debug("Injected %s %d into LR%d for vCPU %d (task %d), LR value: 0x%x\n",
+        logger_vgic_debug("Injected %s %d into LR%d for vCPU %d (task %d), LR value: " GIC_LR_FMT
+                          "\n",
                           irq_type,
                           i,
                           freelr,
@@ -531,9 +513,7 @@ vgic_try_inject_pending(tcb_t *task)
             }
 
             // 防止重复注入：判断 saved_lr 中是否已经有相同中断
-            uint32_t val = vgicc->saved_lr[lr];
-            uint32_t vid = (val >> GICH_LR_PID_SHIFT) & 0x3ff;
-            if (vid == i) {
+            if (gic_lr_read_vid(vgicc->saved_lr[lr]) == i) {
                 freelr = -1;
                 break;
             }
@@ -545,7 +525,7 @@ vgic_try_inject_pending(tcb_t *task)
         }
 
         // SPI: 使用硬件中断格式
-        uint32_t lr_val = gic_make_virtual_hardware_interrupt(i, i, 0, 0);
+        gic_lr_t lr_val = gic_make_virtual_hardware_interrupt(i, i, 0, 0);
 
         // 将虚拟中断写入到内存中的 LR
         vgicc->saved_lr[freelr] = lr_val;
@@ -555,7 +535,8 @@ vgic_try_inject_pending(tcb_t *task)
         // 清除 pending 标志
         vgic_clear_irq_pending(vgicc, i);
 
-        logger_vgic_debug("Injected SPI %d into LR%d for vCPU %d (task %d), LR value: 0x%x\n",
+        logger_vgic_debug("Injected SPI %d into LR%d for vCPU %d (task %d), LR value: " GIC_LR_FMT
+                          "\n",
                           i,
                           freelr,
                           get_vcpuid(task),
@@ -581,10 +562,11 @@ gicc_save_core_state()
         return;
     vgic_core_state_t *state = get_vgicc_by_vcpu(curr);
 
-    state->vmcr        = mmio_read32((void *) GICH_VMCR);
-    state->saved_elsr0 = mmio_read32((void *) GICH_ELSR0);
-    state->saved_apr   = mmio_read32((void *) GICH_APR);
-    state->saved_hcr   = mmio_read32((void *) GICH_HCR);
+    // GICv2 为 GICH MMIO 访问，GICv3 为 ICH_*_EL2 系统寄存器访问
+    state->vmcr        = gic_read_vmcr();
+    state->saved_elsr0 = gic_elsr0();
+    state->saved_apr   = gic_apr();
+    state->saved_hcr   = gic_read_hcr();
 
     for (int32_t i = 0; i < GICH_LR_NUM; i++)
         state->saved_lr[i] = gic_read_lr(i);
@@ -598,10 +580,10 @@ gicc_restore_core_state()
         return;
     vgic_core_state_t *state = get_vgicc_by_vcpu(curr);
 
-    mmio_write32(state->vmcr, (void *) GICH_VMCR);
-    mmio_write32(state->saved_elsr0, (void *) GICH_ELSR0);
-    mmio_write32(state->saved_apr, (void *) GICH_APR);
-    mmio_write32(state->saved_hcr, (void *) GICH_HCR);
+    // ELSR 为只读寄存器，由硬件根据 LR 状态重新计算
+    gic_write_vmcr(state->vmcr);
+    gic_write_apr(state->saved_apr);
+    gic_write_hcr(state->saved_hcr);
 
     for (int32_t i = 0; i < GICH_LR_NUM; i++)
         gic_write_lr(i, state->saved_lr[i]);
@@ -634,7 +616,7 @@ vgic_hw_inject_test(uint32_t vector)
         return;
     }
 
-    uint32_t mask = gic_make_virtual_hardware_interrupt(vector, vector, 0, 0);
+    gic_lr_t mask = gic_make_virtual_hardware_interrupt(vector, vector, 0, 0);
 
     uint32_t elsr0 = gic_elsr0();
     uint32_t elsr1 = gic_elsr1();
@@ -659,10 +641,10 @@ vgic_hw_inject_test(uint32_t vector)
             continue;
         }
 
-        uint32_t lr_val          = gic_read_lr(i);
-        uint32_t existing_vector = (lr_val >> GICH_LR_PID_SHIFT) & 0x3ff;
+        gic_lr_t lr_val          = gic_read_lr(i);
+        uint32_t existing_vector = gic_lr_read_vid(lr_val);
         if (existing_vector == vector) {
-            logger_vgic_debug("vgic inject, vector %d already in lr%d (val=0x%x)\n",
+            logger_vgic_debug("vgic inject, vector %d already in lr%d (val=" GIC_LR_FMT ")\n",
                               vector,
                               i,
                               lr_val);
@@ -675,7 +657,7 @@ vgic_hw_inject_test(uint32_t vector)
         return;
     }
 
-    logger_vgic_debug("Injecting vector %d into LR%d, mask=0x%x\n", vector, freelr, mask);
+    logger_vgic_debug("Injecting vector %d into LR%d, mask=" GIC_LR_FMT "\n", vector, freelr, mask);
     gic_write_lr(freelr, mask);
 
     // 确保写入生效
@@ -683,8 +665,8 @@ vgic_hw_inject_test(uint32_t vector)
     isb();
 
     // 验证写入
-    uint32_t written_val = gic_read_lr(freelr);
-    logger_vgic_debug("LR%d written value: 0x%x\n", freelr, written_val);
+    gic_lr_t written_val = gic_read_lr(freelr);
+    logger_vgic_debug("LR%d written value: " GIC_LR_FMT "\n", freelr, written_val);
 }
 
 void
@@ -699,7 +681,7 @@ vgic_sw_inject_test(uint32_t vector)
         return;
     }
 
-    uint32_t mask = gic_make_virtual_software_sgi(vector, /*cpu_id=*/0, 0, 0);
+    gic_lr_t mask = gic_make_virtual_software_sgi(vector, /*cpu_id=*/0, 0, 0);
 
     uint32_t elsr0 = gic_elsr0();
     uint32_t elsr1 = gic_elsr1();
@@ -724,10 +706,10 @@ vgic_sw_inject_test(uint32_t vector)
             continue;
         }
 
-        uint32_t lr_val          = gic_read_lr(i);
-        uint32_t existing_vector = (lr_val >> GICH_LR_PID_SHIFT) & 0x3ff;
+        gic_lr_t lr_val          = gic_read_lr(i);
+        uint32_t existing_vector = gic_lr_read_vid(lr_val);
         if (existing_vector == vector) {
-            logger_vgic_debug("vgic inject, vector %d already in lr%d (val=0x%x)\n",
+            logger_vgic_debug("vgic inject, vector %d already in lr%d (val=" GIC_LR_FMT ")\n",
                               vector,
                               i,
                               lr_val);
@@ -740,7 +722,7 @@ vgic_sw_inject_test(uint32_t vector)
         return;
     }
 
-    logger_vgic_debug("Injecting vector %d into LR%d, mask=0x%x\n", vector, freelr, mask);
+    logger_vgic_debug("Injecting vector %d into LR%d, mask=" GIC_LR_FMT "\n", vector, freelr, mask);
     gic_write_lr(freelr, mask);
 
     // 确保写入生效
@@ -748,6 +730,6 @@ vgic_sw_inject_test(uint32_t vector)
     isb();
 
     // 验证写入
-    uint32_t written_val = gic_read_lr(freelr);
-    logger_vgic_debug("LR%d written value: 0x%x\n", freelr, written_val);
+    gic_lr_t written_val = gic_read_lr(freelr);
+    logger_vgic_debug("LR%d written value: " GIC_LR_FMT "\n", freelr, written_val);
 }
\ No newline at end of file
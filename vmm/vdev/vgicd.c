@@ -363,12 +363,12 @@ handle_gicd_icpender0_write(tcb_t               *curr,
 
             // 同时需要清除 GICH_LR 中对应的 pending 状态
             for (int32_t lr = 0; lr < GICH_LR_NUM; lr++) {
-                uint32_t lr_val = vgicc->saved_lr[lr];
-                uint32_t vid    = lr_val & 0x3ff;         // Virtual ID
-                if (vid == bit && (lr_val & (1U << 28)))  // 检查是否是 pending 状态
-                {
-                    // 清除 LR 中的 pending 位 (bit 28)
-                    vgicc->saved_lr[lr] &= ~(1U << 28);
+                gic_lr_t lr_val = vgicc->saved_lr[lr];
+                uint32_t vid    = gic_lr_read_vid(lr_val);  // Virtual ID
+                // 检查是否是 pending 状态
+                if (vid == bit && (gic_lr_read_state(lr_val) & GIC_LR_STATE_PENDING)) {
+                    // 清除 LR 中的 pending 位
+                    vgicc->saved_lr[lr] = gic_lr_clear_pending(lr_val);
                     // 标记该 LR 为空闲
                     vgicc->saved_elsr0 |= (1U << lr);
                     logger_vgic_debug("Cleared LR%d for SGI/PPI %d\n", lr, bit);
@@ -518,31 +518,26 @@ handle_gicd_sgir_write(stage2_fault_info_t *info, trap_frame_t *el2_ctx)
 
     uint32_t curr_id = get_vcpuid(curr);
 
-    list_node_t *iter = list_first(&vm->vcpus);
-    while (iter) {
-        tcb_t   *task   = list_node_parent(iter, tcb_t, vm_node);
-        uint32_t vcpuid = get_vcpuid(task);
-        switch (target_list_filter) {
-            case 0:  // 指定目标 CPU
-                if ((cpu_target_list >> vcpuid) & 1) {
-                    vgic_inject_sgi(task, sgi_int_id);
-                }
-                break;
-            case 1:  // 其他 CPU
-                if (vcpuid != curr_id) {
-                    vgic_inject_sgi(task, sgi_int_id);
-                }
-                break;
-            case 2:  // 当前 CPU
-                if (vcpuid == curr_id) {
-                    vgic_inject_sgi(task, sgi_int_id);
-                }
-                break;
-            default:
-                logger_error("SGIR: invalid target_list_filter = %d\n", target_list_filter);
-                break;
-        }
-        iter = list_node_next(iter);
+    // vCPU 编号即 vm->vcpu[] 下标，目标位直接对应下标
+    switch (target_list_filter) {
+        case 0:  // 指定目标 CPU
+            for (uint32_t id = 0; id < vm->vcpu_cnt; id++) {
+                if ((cpu_target_list >> id) & 1)
+                    vgic_inject_sgi(vm->vcpu[id], sgi_int_id);
+            }
+            break;
+        case 1:  // 其他 CPU
+            for (uint32_t id = 0; id < vm->vcpu_cnt; id++) {
+                if (id != curr_id)
+                    vgic_inject_sgi(vm->vcpu[id], sgi_int_id);
+            }
+            break;
+        case 2:  // 当前 CPU
+            vgic_inject_sgi(curr, sgi_int_id);
+            break;
+        default:
+            logger_error("SGIR: invalid target_list_filter = %d\n", target_list_filter);
+            break;
     }
     logger_vgic_debug("GICD_SGIR write completed\n");
 }
@@ -571,6 +566,10 @@ handle_gicd_typer_read(vgic_t *vgic, stage2_fault_info_t *info, trap_frame_t *el
     if (vcpu_count > 0) {
         typer |= ((vcpu_count - 1) & 0x7) << 5;
     }
+#if GIC_VERSION == 3
+    // 不模拟 ITS，隐藏 LPIS (bit 17) 和 MBIS (bit 16)
+    typer &= ~((1U << 17) | (1U << 16));
+#endif
     vgicd_read(info, el2_ctx, &typer);
     logger_vgic_debug("GICD_TYPER read: typer=0x%x, vcpu_cnt=%d\n", typer, vcpu_count);
 }
@@ -877,6 +876,79 @@ handle_gicd_read_operations(tcb_t               *curr,
     }
 }
 
+#if GIC_VERSION == 3
+// ============================================================================================================================
+// ======================= GICv3 IROUTER PIDR2 ============================
+// ============================================================================================================================
+
+// GICD_IROUTER 为 64 位寄存器，guest 可能用一次 64 位或两次 32 位访问
+static void
+handle_gicd_irouter_access(vgic_t              *vgic,
+                           stage2_fault_info_t *info,
+                           trap_frame_t        *el2_ctx,
+                           paddr_t              gpa)
+{
+    reg_access_params_t params = parse_reg_access(info, el2_ctx);
+    uint32_t            offset = gpa - GICD_IROUTER(0);
+    uint32_t            int_id = offset / 8;
+    uint32_t            shift  = (offset % 8) * 8;
+    uint64_t            mask   = (params.len == 8) ? ~0ULL : (0xffffffffULL << shift);
+
+    if (int_id < GIC_FIRST_SPI || int_id >= SPI_ID_MAX)
+        return;
+
+    if (info->esr.dabt.write) {
+        uint64_t value = (params.len == 8) ? el2_ctx->r[params.reg_num]
+                                           : ((uint64_t) params.value << shift);
+        vgic->gicd_irouter[int_id] = (vgic->gicd_irouter[int_id] & ~mask) | (value & mask);
+        logger_vgic_debug("GICD_IROUTER(%d) write: 0x%llx\n", int_id, vgic->gicd_irouter[int_id]);
+    } else if (params.reg_num != 30) {
+        el2_ctx->r[params.reg_num] = (vgic->gicd_irouter[int_id] & mask) >> shift;
+    }
+}
+
+// 处理 GICv3 新增的分发器寄存器，返回 false 表示交给 GICv2 兼容路径处理
+static bool
+handle_gicd_v3_access(vgic_t *vgic, stage2_fault_info_t *info, trap_frame_t *el2_ctx, paddr_t gpa)
+{
+    if (GICD_IROUTER(0) <= gpa && gpa < GICD_IROUTER(SPI_ID_MAX)) {
+        handle_gicd_irouter_access(vgic, info, el2_ctx, gpa);
+        return true;
+    }
+
+    // guest 驱动通过 PIDR2.ArchRev 确认 GIC 版本
+    if (gpa == GICD_PIDR2) {
+        if (!info->esr.dabt.write) {
+            uint32_t pidr2 = read32((void *) GICD_PIDR2);
+            vgicd_read(info, el2_ctx, &pidr2);
+        }
+        return true;
+    }
+
+    // 亲和性路由模式下 GICD 中的 SGI/PPI 寄存器为 RAZ/WI，由 redistributor 负责
+    if (gpa == GICD_SGIR || (GICD_ITARGETSR(0) <= gpa && gpa < GICD_ICFGR(0))) {
+        if (!info->esr.dabt.write) {
+            uint32_t zero = 0;
+            vgicd_read(info, el2_ctx, &zero);
+        }
+        return true;
+    }
+    return false;
+}
+
+// redistributor SGI_base 帧中与 GICD 同偏移的 SGI/PPI 寄存器，按所属 vCPU 访问
+void
+vgicd_banked_access(tcb_t *vcpu, stage2_fault_info_t *info, trap_frame_t *el2_ctx, paddr_t gpa)
+{
+    struct _vm_t *vm = vcpu->curr_vm;
+
+    if (info->esr.dabt.write)
+        handle_gicd_write_operations(vcpu, vm, vm->vgic, info, el2_ctx, gpa);
+    else
+        handle_gicd_read_operations(vcpu, vm, vm->vgic, info, el2_ctx, gpa);
+}
+#endif
+
 // handle gicd emu
 void
 intc_handler(stage2_fault_info_t *info, trap_frame_t *el2_ctx)
@@ -886,6 +958,16 @@ intc_handler(stage2_fault_info_t *info, trap_frame_t *el2_ctx)
     vgic_t       *vgic = vm->vgic;
 
     paddr_t gpa = info->gpa;
+#if GIC_VERSION == 3
+    if (GICR_BASE_ADDR <= gpa && gpa < (GICR_BASE_ADDR + GICR_STRIDE * VCPU_NUM_MAX)) {
+        vgicr_handler(info, el2_ctx);
+        return;
+    }
+    if (GICD_BASE_ADDR <= gpa && gpa < (GICD_BASE_ADDR + 0x0010000) &&
+        handle_gicd_v3_access(vgic, info, el2_ctx, gpa)) {
+        return;
+    }
+#endif
     if (GICD_BASE_ADDR <= gpa && gpa < (GICD_BASE_ADDR + 0x0010000)) {
         if (info->esr.dabt.write) {  // 寄存器写到内存
             handle_gicd_write_operations(curr, vm, vgic, info, el2_ctx, gpa);
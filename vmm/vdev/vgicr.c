@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2024 Avatar Project
+ *
+ * Licensed under the MIT License.
+ * See LICENSE file in the project root for full license information.
+ *
+ * @file vgicr.c
+ * @brief Implementation of vgicr.c
+ * @author Avatar Project Team
+ * @date 2024
+ */
+
+
+#include "vmm/vgic.h"
+#include "avatar_types.h"
+#include "io.h"
+#include "mmio.h"
+#include "vmm/vcpu.h"
+
+// GICv3 虚拟 redistributor：vCPU n 的帧位于 GICR_BASE_ADDR + n * GICR_STRIDE，
+// 与物理布局一致。SGI/PPI 的使能、挂起、优先级和配置寄存器与 GICD 同偏移，
+// 直接复用 vgicd 的处理函数，其余寄存器在这里模拟。
+#if GIC_VERSION == 3
+
+// 根据帧号找到对应的 vCPU
+static tcb_t *
+vgicr_frame_to_vcpu(struct _vm_t *vm, uint32_t frame)
+{
+    return frame < vm->vcpu_cnt ? vm->vcpu[frame] : NULL;
+}
+
+// 把 64 位寄存器的值按访问偏移和宽度返回给 guest
+static void
+vgicr_read_value(stage2_fault_info_t *info, trap_frame_t *el2_ctx, uint64_t value, uint32_t shift)
+{
+    uint32_t reg_num = info->esr.dabt.reg;
+    uint32_t len     = 1U << (info->esr.dabt.size & 0x3U);
+
+    if (reg_num == 30U)
+        return;
+
+    value >>= shift;
+    if (len < 8)
+        value &= (1ULL << (len * 8)) - 1;
+    el2_ctx->r[reg_num] = value;
+}
+
+// 虚拟 GICR_TYPER：亲和性与 vmpidr_el1 一致，最后一个 vCPU 置 Last
+static uint64_t
+vgicr_typer(struct _vm_t *vm, uint32_t frame)
+{
+    uint64_t typer = ((uint64_t) vgic_vcpu_affinity(frame) << 32) |
+                     ((uint64_t) frame << GICR_TYPER_PROC_SHIFT);
+    if (frame == vm->vcpu_cnt - 1)
+        typer |= GICR_TYPER_LAST;
+    return typer;
+}
+
+static void
+vgicr_rd_access(tcb_t               *vcpu,
+                uint32_t             frame,
+                stage2_fault_info_t *info,
+                trap_frame_t        *el2_ctx,
+                uint32_t             offset)
+{
+    struct _vm_t      *vm       = vcpu->curr_vm;
+    vgic_core_state_t *vgicc    = get_vgicc_by_vcpu(vcpu);
+    bool               is_write = info->esr.dabt.write;
+
+    switch (offset) {
+        case GICR_TYPER:
+        case GICR_TYPER + 4: {
+            uint32_t shift = (offset - GICR_TYPER) * 8;
+            if (!is_write)
+                vgicr_read_value(info, el2_ctx, vgicr_typer(vm, frame), shift);
+            break;
+        }
+        case GICR_WAKER:
+            if (is_write) {
+                // ChildrenAsleep 跟随 ProcessorSleep，立即生效
+                uint32_t sleep    = el2_ctx->r[info->esr.dabt.reg] & GICR_WAKER_PROC_SLEEP;
+                vgicc->gicr_waker = sleep ? (sleep | GICR_WAKER_CHILD_ASLEEP) : 0;
+                logger_vgic_debug("GICR_WAKER(vcpu %d) write: 0x%x\n", frame, vgicc->gicr_waker);
+            } else {
+                vgicr_read_value(info, el2_ctx, vgicc->gicr_waker, 0);
+            }
+            break;
+        case GICR_IIDR:
+        case GICR_PIDR2:
+            if (!is_write)
+                vgicr_read_value(info, el2_ctx, read32((void *) (GICR_BASE_ADDR + offset)), 0);
+            break;
+        default:
+            // GICR_CTLR、GICR_STATUSR 以及 LPI 相关寄存器：RAZ/WI
+            if (!is_write)
+                vgicr_read_value(info, el2_ctx, 0, 0);
+            break;
+    }
+}
+
+static void
+vgicr_sgi_access(tcb_t *vcpu, stage2_fault_info_t *info, trap_frame_t *el2_ctx, uint32_t offset)
+{
+    bool is_write = info->esr.dabt.write;
+
+    if (offset == GICR_ISENABLER0 || offset == GICR_ICENABLER0 || offset == GICR_ISPENDR0 ||
+        offset == GICR_ICPENDR0 ||
+        (GICR_IPRIORITYR <= offset && offset < GICR_IPRIORITYR + GIC_FIRST_SPI) ||
+        (GICR_ICFGR0 <= offset && offset <= GICR_ICFGR1)) {
+        vgicd_banked_access(vcpu, info, el2_ctx, GICD_BASE_ADDR + (offset - GICR_SGI_OFFSET));
+        return;
+    }
+
+    switch (offset) {
+        case GICR_IGROUPR0:
+            // guest 的 SGI/PPI 全部视为 Group1
+            if (!is_write)
+                vgicr_read_value(info, el2_ctx, 0xffffffff, 0);
+            break;
+        default:
+            // IGRPMODR0、ISACTIVER0/ICACTIVER0、NSACR：RAZ/WI
+            if (!is_write)
+                vgicr_read_value(info, el2_ctx, 0, 0);
+            break;
+    }
+}
+
+void
+vgicr_handler(stage2_fault_info_t *info, trap_frame_t *el2_ctx)
+{
+    tcb_t        *curr   = curr_task_el2();
+    struct _vm_t *vm     = curr->curr_vm;
+    paddr_t       gpa    = info->gpa;
+    uint32_t      frame  = (gpa - GICR_BASE_ADDR) / GICR_STRIDE;
+    uint32_t      offset = (gpa - GICR_BASE_ADDR) % GICR_STRIDE;
+    tcb_t        *vcpu   = vgicr_frame_to_vcpu(vm, frame);
+
+    // 超出 vCPU 数量的帧不存在
+    if (!vcpu) {
+        if (!info->esr.dabt.write)
+            vgicr_read_value(info, el2_ctx, 0, 0);
+        logger_warn("VGICR: access to absent frame %d, gpa=0x%llx\n", frame, gpa);
+        return;
+    }
+
+    if (offset < GICR_SGI_OFFSET)
+        vgicr_rd_access(vcpu, frame, info, el2_ctx, offset);
+    else
+        vgicr_sgi_access(vcpu, info, el2_ctx, offset);
+}
+
+// guest 写 ICC_SGI1R_EL1 陷入 EL2，按亲和性把 SGI 注入目标 vCPU
+void
+vgic_sgi1r_write(uint64_t sgi1r)
+{
+    tcb_t        *curr    = curr_task_el2();
+    struct _vm_t *vm      = curr->curr_vm;
+    uint32_t      int_id  = ICC_SGI1R_INTID(sgi1r);
+    uint32_t      aff1    = ICC_SGI1R_AFF1(sgi1r);
+    uint32_t      targets = ICC_SGI1R_TARGET_LIST(sgi1r);
+    bool          all     = (sgi1r & ICC_SGI1R_IRM) != 0;
+    int32_t       curr_id = get_vcpuid(curr);
+
+    // 虚拟亲和性只使用 Aff1.Aff0
+    if (!all && (ICC_SGI1R_AFF2(sgi1r) != 0 || ICC_SGI1R_AFF3(sgi1r) != 0))
+        return;
+
+    if (all) {
+        // IRM=1：除自身外的所有 vCPU
+        for (uint32_t id = 0; id < vm->vcpu_cnt; id++) {
+            if ((int32_t) id != curr_id)
+                vgic_inject_sgi(vm->vcpu[id], int_id);
+        }
+    } else {
+        // 目标 vCPU 编号为 Aff1 * 16 + TargetList 中的位号，与 vgic_vcpu_affinity 对应
+        while (targets) {
+            uint32_t id = aff1 * 16 + __builtin_ctz(targets);
+            if (id < vm->vcpu_cnt)
+                vgic_inject_sgi(vm->vcpu[id], int_id);
+            targets &= targets - 1;
+        }
+    }
+    logger_vgic_debug("ICC_SGI1R_EL1 write: 0x%llx\n", sgi1r);
+}
+
+#endif  // GIC_VERSION == 3
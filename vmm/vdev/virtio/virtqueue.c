@@ -170,10 +170,12 @@ virtio_inject_irq(virtio_device_t *dev, uint32_t int_type)
     dev->interrupt_status |= int_type;
 
     // 向VM注入中断 - 使用SPI中断
-    // 需要找到当前VM的任务
+    // 当前任务属于该 VM 时注入当前 vCPU，否则直接取 vcpu[0]，不再丢弃中断
     tcb_t *task = curr_task_el2();
+    if (!task || task->curr_vm != dev->vm)
+        task = dev->vm->vcpu[0];
 
-    if (task && task->curr_vm == dev->vm) {
+    if (task) {
         // 使用现有的vgic_inject_spi函数
         extern void vgic_inject_spi(tcb_t * task, int32_t irq_id);
         vgic_inject_spi(task, dev->irq);
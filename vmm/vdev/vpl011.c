@@ -16,17 +16,11 @@
 #include "uart_pl011.h"
 #include "io.h"
 #include "lib/avatar_string.h"
+#include "mem/kallocator.h"
 #include "thread.h"
 #include "vmm/vgic.h"
-#include "timer.h"
 
-/* Virtual PL011 management structures */
-static vpl011_t _vpl011s[VM_NUM_MAX];
-static uint32_t _vpl011_num = 0;
-
-/* Virtual PL011 state pool (one per VM) */
-static vpl011_state_t _vpl011_states[VM_NUM_MAX];
-static uint32_t       _vpl011_state_num = 0;
+/* vpl011 structures are allocated per VM and reached through vm->vpl011 */
 
 /* VM Console Switching */
 static uint32_t current_console_vm        = 0; /* Currently active VM for console I/O */
@@ -42,12 +36,6 @@ typedef enum
 
 static console_output_strategy_t console_output_strategy = VPL011_OUTPUT_ACTIVE_ONLY;
 
-/* String matching buffer for timestamp detection */
-#define MATCH_BUFFER_SIZE 256
-#define TARGET_STRING     "Run /init as init process"
-static char     match_buffer[MATCH_BUFFER_SIZE];
-static uint32_t match_buffer_pos = 0;
-
 /* --------------------------------------------------------
  * ==================    函数声明    ==================
  * -------------------------------------------------------- */
@@ -56,70 +44,11 @@ static void
 vpl011_handle_hypervisor_command(char c);
 static void
 vpl011_execute_hypervisor_command(const char *cmd);
-static uint32_t
-find_vm_id_by_vuart(vpl011_state_t *vuart);
+static struct _vm_t *
+vpl011_console_vm(uint32_t vm_id);
 static void
 vpl011_output_char_with_prefix(vpl011_state_t *vuart, char c);
 
-/* --------------------------------------------------------
- * ==================    辅助函数    ==================
- * -------------------------------------------------------- */
-
-/* 格式化时间戳为 [   37.268662] 格式 */
-static void
-format_timestamp(char *buffer, size_t buffer_size)
-{
-    uint64_t current_ticks = read_cntpct_el0();
-    uint64_t frequency     = read_cntfrq_el0();
-
-    if (frequency == 0) {
-        my_snprintf(buffer, buffer_size, "[    0.000000] ");
-        return;
-    }
-
-    /* 计算秒和微秒 */
-    uint64_t seconds         = current_ticks / frequency;
-    uint64_t remaining_ticks = current_ticks % frequency;
-    uint64_t microseconds    = (remaining_ticks * 1000000) / frequency;
-
-    /* 格式化为 [   37.268662] 格式 */
-    my_snprintf(buffer, buffer_size, "[%4llu.%06llu] ", seconds, microseconds);
-}
-
-/* 检查字符串匹配并输出时间戳 */
-static void
-check_string_match_and_output_timestamp(char c)
-{
-    /* 将字符添加到匹配缓冲区 */
-    if (match_buffer_pos < MATCH_BUFFER_SIZE - 1) {
-        match_buffer[match_buffer_pos++] = c;
-        match_buffer[match_buffer_pos]   = '\0';
-    } else {
-        /* 缓冲区满了，移动内容 */
-        memmove(match_buffer, match_buffer + 1, MATCH_BUFFER_SIZE - 2);
-        match_buffer[MATCH_BUFFER_SIZE - 2] = c;
-        match_buffer[MATCH_BUFFER_SIZE - 1] = '\0';
-        match_buffer_pos                    = MATCH_BUFFER_SIZE - 1;
-    }
-
-    /* 检查是否匹配目标字符串 */
-    if (strstr(match_buffer, TARGET_STRING) != NULL) {
-        char timestamp[32];
-        format_timestamp(timestamp, sizeof(timestamp));
-
-        /* 输出时间戳到物理UART */
-        uart_putstr("\n");
-        uart_putstr(timestamp);
-        uart_putstr("Detected target string: ");
-        uart_putstr(TARGET_STRING);
-        uart_putstr("\n");
-
-        /* 清空匹配缓冲区 */
-        match_buffer_pos = 0;
-        match_buffer[0]  = '\0';
-    }
-}
-
 /* --------------------------------------------------------
  * ==================    初始化函数    ==================
  * -------------------------------------------------------- */
@@ -127,11 +56,6 @@ check_string_match_and_output_timestamp(char c)
 void
 vpl011_global_init(void)
 {
-    memset(_vpl011s, 0, sizeof(_vpl011s));
-    memset(_vpl011_states, 0, sizeof(_vpl011_states));
-    _vpl011_num       = 0;
-    _vpl011_state_num = 0;
-
     /* Initialize console switching */
     current_console_vm        = 0; /* Start with VM 0 */
     console_switching_enabled = true;
@@ -144,27 +68,25 @@ vpl011_global_init(void)
 vpl011_t *
 alloc_vpl011(void)
 {
-    if (_vpl011_num >= VM_NUM_MAX) {
+    vpl011_t *vpl011 = kalloc(sizeof(vpl011_t), 8);
+    if (vpl011 == NULL) {
         logger_error("No more vpl011 can be allocated!\n");
         return NULL;
     }
 
-    vpl011_t *vpl011 = &_vpl011s[_vpl011_num++];
     memset(vpl011, 0, sizeof(vpl011_t));
-
-    logger_info("Allocated vpl011 %d\n", _vpl011_num - 1);
     return vpl011;
 }
 
 vpl011_state_t *
 alloc_vpl011_state(void)
 {
-    if (_vpl011_state_num >= VM_NUM_MAX) {
+    vpl011_state_t *vuart = kalloc(sizeof(vpl011_state_t), 8);
+    if (vuart == NULL) {
         logger_error("No more vpl011 state can be allocated!\n");
         return NULL;
     }
 
-    vpl011_state_t *vuart = &_vpl011_states[_vpl011_state_num++];
     vpl011_state_init(vuart);
     return vuart;
 }
@@ -345,8 +267,10 @@ vpl011_write(vpl011_state_t *vuart, uint32_t offset, uint32_t value)
                 /* Forward to physical UART with VM prefix if not current console */
                 vpl011_output_char_with_prefix(vuart, output_char);
 
-                /* 检查字符串匹配并可能输出时间戳 */
-                // check_string_match_and_output_timestamp(output_char);
+                /* 启动阶段分析：记到这个 UART 所属的 VM，而不是当前在跑的任务 */
+                if (vuart->vm) {
+                    boottime_console_char(&vuart->vm->boottime, output_char);
+                }
 
                 /* Simulate immediate transmission - remove from TX FIFO */
                 vuart->tx_count--;
@@ -496,17 +420,10 @@ vpl011_update_interrupts(vpl011_state_t *vuart)
 
     /* Inject interrupt to guest if any masked interrupts are pending */
     if (vuart->mis != 0) {
-        /* Find the VM that owns this UART */
-        for (uint32_t i = 0; i < _vpl011_num; i++) {
-            if (_vpl011s[i].state == vuart && _vpl011s[i].vm) {
-                /* Get the primary vCPU of this VM */
-                tcb_t *primary_vcpu = _vpl011s[i].vm->primary_vcpu;
-                if (primary_vcpu) {
-                    // logger_info("VUART: Injecting SPI 33 to VM %d\n", _vpl011s[i].vm->vm_id);
-                    vgic_inject_spi(primary_vcpu, 33); /* PL011 IRQ is 33 */
-                }
-                break;
-            }
+        /* Inject to the primary vCPU of the VM that owns this UART */
+        if (vuart->vm && vuart->vm->primary_vcpu) {
+            // logger_info("VUART: Injecting SPI 33 to VM %d\n", vuart->vm->vm_id);
+            vgic_inject_spi(vuart->vm->primary_vcpu, 33); /* PL011 IRQ is 33 */
         }
     }
 }
@@ -585,9 +502,9 @@ vpl011_handle_physical_uart_rx(char c)
     }
 
     /* Forward to the currently active VM only */
-    if (current_console_vm < _vpl011_num && _vpl011s[current_console_vm].state &&
-        _vpl011s[current_console_vm].vm) {
-        vpl011_inject_rx_char(_vpl011s[current_console_vm].state, c);
+    struct _vm_t *vm = vpl011_console_vm(current_console_vm);
+    if (vm && vm->vpl011->state) {
+        vpl011_inject_rx_char(vm->vpl011->state, c);
     }
 }
 
@@ -598,7 +515,8 @@ vpl011_handle_physical_uart_rx(char c)
 void
 vpl011_switch_to_vm(uint32_t vm_id)
 {
-    if (vm_id >= _vpl011_num || !_vpl011s[vm_id].vm) {
+    struct _vm_t *vm = vpl011_console_vm(vm_id);
+    if (!vm) {
         uart_putstr("\r\n[CONSOLE] Invalid VM ID: ");
         uart_putchar('0' + vm_id);
         uart_putstr("\r\n");
@@ -609,8 +527,8 @@ vpl011_switch_to_vm(uint32_t vm_id)
     uart_putstr("\r\n[CONSOLE] Switched to VM ");
     uart_putchar('0' + vm_id);
     uart_putstr(" (");
-    if (_vpl011s[vm_id].vm->vm_name[0] != '\0') {
-        uart_putstr(_vpl011s[vm_id].vm->vm_name);
+    if (vm->vm_name[0] != '\0') {
+        uart_putstr(vm->vm_name);
     } else {
         uart_putstr("unnamed");
     }
@@ -650,13 +568,14 @@ vpl011_show_status(void)
     }
 
     uart_putstr("Available VMs:\r\n");
-    for (uint32_t i = 0; i < _vpl011_num; i++) {
-        if (_vpl011s[i].vm) {
+    for (uint32_t i = 0; i < vm_count(); i++) {
+        struct _vm_t *vm = vpl011_console_vm(i);
+        if (vm) {
             uart_putstr("  VM ");
             uart_putchar('0' + i);
             uart_putstr(": ");
-            if (_vpl011s[i].vm->vm_name[0] != '\0') {
-                uart_putstr(_vpl011s[i].vm->vm_name);
+            if (vm->vm_name[0] != '\0') {
+                uart_putstr(vm->vm_name);
             } else {
                 uart_putstr("unnamed");
             }
@@ -688,22 +607,22 @@ vpl011_set_console_switching(bool enabled)
  * ==================    输出处理    ==================
  * -------------------------------------------------------- */
 
-static uint32_t
-find_vm_id_by_vuart(vpl011_state_t *vuart)
+/* VM whose console can be selected: allocated and with its vpl011 set up */
+static struct _vm_t *
+vpl011_console_vm(uint32_t vm_id)
 {
-    for (uint32_t i = 0; i < _vpl011_num; i++) {
-        if (_vpl011s[i].state == vuart) {
-            return i;
-        }
+    struct _vm_t *vm = vm_get(vm_id);
+    if (!vm || !vm->vpl011->vm) {
+        return NULL;
     }
-    return 0xFFFFFFFF; /* Not found */
+    return vm;
 }
 
 static void
 vpl011_output_char_with_prefix(vpl011_state_t *vuart, char c)
 {
     static bool at_line_start = true;
-    uint32_t    vm_id         = find_vm_id_by_vuart(vuart);
+    uint32_t    vm_id         = vuart->vm ? vuart->vm->vm_id : 0xFFFFFFFF;
 
     /* If this is the current console VM, output directly without prefix */
     if (vm_id == current_console_vm) {
@@ -794,13 +713,14 @@ vpl011_execute_hypervisor_command(const char *cmd)
         vpl011_show_status();
     } else if (strcmp(cmd, "list") == 0) {
         uart_putstr("VM List:\r\n");
-        for (uint32_t i = 0; i < _vpl011_num; i++) {
-            if (_vpl011s[i].vm) {
+        for (uint32_t i = 0; i < vm_count(); i++) {
+            struct _vm_t *vm = vpl011_console_vm(i);
+            if (vm) {
                 uart_putstr("  VM ");
                 uart_putchar('0' + i);
                 uart_putstr(": ");
-                if (_vpl011s[i].vm->vm_name[0] != '\0') {
-                    uart_putstr(_vpl011s[i].vm->vm_name);
+                if (vm->vm_name[0] != '\0') {
+                    uart_putstr(vm->vm_name);
                 } else {
                     uart_putstr("unnamed");
                 }
@@ -811,7 +731,7 @@ vpl011_execute_hypervisor_command(const char *cmd)
         uint32_t vm_id = cmd[3] - '0';
         vpl011_switch_to_vm(vm_id);
     } else if (strcmp(cmd, "exit") == 0) {
-        if (_vpl011_num > 0) {
+        if (vm_count() > 0) {
             vpl011_switch_to_vm(0); /* Switch to VM 0 by default */
         } else {
             uart_putstr("No VMs available to switch to\r\n");
@@ -831,7 +751,7 @@ vpl011_execute_hypervisor_command(const char *cmd)
 void
 vpl011_set_active_vm(uint32_t vm_id)
 {
-    if (vm_id < _vpl011_num && _vpl011s[vm_id].vm) {
+    if (vpl011_console_vm(vm_id)) {
         current_console_vm = vm_id;
     }
 }
@@ -16,6 +16,11 @@
 #include "task/task.h"
 #include "thread.h"
 #include "io.h"
+#include "vmm/vtimer.h"
+#include "vmm/guest_loader.h"
+#include "vmm/vm.h"
+#include "vmm/guest_image_cache.h"
+#include "vmm/vpl011.h"
 
 // vpsci_cpu_on: 启动 guest vcpu
 // ctx_el2: 当前 trap_frame_t
@@ -51,28 +56,18 @@ vpsci_cpu_on(trap_frame_t *ctx_el2)
         return PSCI_RET_INTERNAL_FAILURE;
     }
 
-    list_node_t *iter        = list_first(&vm->vcpus);
-    tcb_t       *target_task = NULL;
-    int32_t      found       = 0;
-
-    // 查找目标 vCPU
-    while (iter) {
-        tcb_t *task = list_node_parent(iter, tcb_t, vm_node);
-        if ((task->cpu_info->sys_reg->mpidr_el1 & 0xff) == cpu_id) {
-            target_task = task;
-            found       = 1;
-            logger_info("           found vcpu for cpu_id: %d, task_id: %d\n",
-                        cpu_id,
-                        task->task_id);
-            break;
-        }
-        iter = list_node_next(iter);
-    }
+    // 由 MPIDR 直接换算 vCPU 编号，再核对完整的 Aff2.Aff1.Aff0
+    uint32_t idx         = vgic_affinity_to_vcpu(cpu_id);
+    tcb_t   *target_task = idx < vm->vcpu_cnt ? vm->vcpu[idx] : NULL;
 
-    if (!found) {
+    if (!target_task ||
+        (target_task->cpu_info->sys_reg->mpidr_el1 & 0xffffff) != (cpu_id & 0xffffff)) {
         logger_warn("           vcpu not found for cpu_id: %d\n", cpu_id);
         return PSCI_RET_NOT_PRESENT;
     }
+    logger_info("           found vcpu for cpu_id: %d, task_id: %d\n",
+                cpu_id,
+                target_task->task_id);
 
     // 检查目标 CPU 当前状态
     switch (target_task->state) {
@@ -103,6 +98,11 @@ vpsci_cpu_on(trap_frame_t *ctx_el2)
             logger_info("           cpu_id: %d is in CREATE state, starting\n", cpu_id);
             break;
 
+        case TASK_STATE_STOPPED:
+            // guest 重启时被停下的 CPU
+            logger_info("           cpu_id: %d was stopped, starting\n", cpu_id);
+            break;
+
         default:
             logger_warn("           cpu_id: %d in unknown state: %d\n", cpu_id, target_task->state);
             return PSCI_RET_INTERNAL_FAILURE;
@@ -123,7 +123,7 @@ vpsci_cpu_on(trap_frame_t *ctx_el2)
     target_task->remaining_ticks = SYS_TASK_TICK;
 
     // 将 vCPU 添加到目标物理 CPU 的就绪队列
-    uint32_t target_core = target_task->affinity - 1;
+    uint32_t target_core = affinity_first_cpu(target_task->affinity);
     if (target_core >= SMP_NUM) {
         logger_error("           invalid affinity for task_id: %d, affinity: %d\n",
                      target_task->task_id,
@@ -141,6 +141,22 @@ vpsci_cpu_on(trap_frame_t *ctx_el2)
     return PSCI_RET_SUCCESS;
 }
 
+// 重启时镜像能否完全从内存恢复：缓存不全或 initrd 按需加载都要读文件系统，
+// 而 SMC 陷入处理在异常上下文里，不能做磁盘 I/O
+static bool
+vpsci_reset_in_memory(const guest_manifest_t *manifest)
+{
+    if (manifest->files.needs_initrd && manifest->files.initrd_path &&
+        manifest->files.lazy_initrd)
+        return false;
+    return guest_image_cache_complete(manifest);
+}
+
+// vpsci_cpu_reset: PSCI SYSTEM_RESET，重启 guest
+// guest 已改写过自己的内存，镜像需要从镜像缓存恢复为原始内容；镜像不能完全从
+// 内存恢复时拒绝重启。复制镜像前先停下其他 vCPU，它们还在执行即将被覆盖的代码。
+// 主 vCPU 从内核入口重新执行，x0 为 DTB 地址；发起调用的不是主 vCPU 时它自己也停下。
+// 返回值：PSCI 标准返回码，成功时调用者不应覆盖 x0
 int32_t
 vpsci_cpu_reset(trap_frame_t *ctx_el2)
 {
@@ -152,15 +168,83 @@ vpsci_cpu_reset(trap_frame_t *ctx_el2)
         return PSCI_RET_INTERNAL_FAILURE;
     }
 
+    if (!vpsci_reset_in_memory(vm->manifest)) {
+        logger_error("           %s: images not fully cached, reset refused\n", vm->vm_name);
+        return PSCI_RET_INTERNAL_FAILURE;
+    }
+
     tcb_t *target_task = vm->primary_vcpu;
 
+    vm_stop_vcpus(vm, curr);
+    // 停下的 vCPU 要等真正切换出去，否则它们还在执行即将被覆盖的代码，主 vCPU 陷入时
+    // 还会用旧值覆盖下面改写的现场和系统寄存器
+    for (uint32_t i = 0; i < vm->vcpu_cnt; i++) {
+        if (vm->vcpu[i] != NULL && vm->vcpu[i] != curr)
+            task_wait_off_cpu(vm->vcpu[i]);
+    }
+
+    // 恢复 guest 镜像，同时重新记录启动阶段
+    boottime_init(&vm->boottime, vm->manifest);
+    boottime_record(&vm->boottime, BOOT_EV_LOAD_START);
+    guest_load_result_t load = guest_load_from_manifest(vm->manifest);
+    if (load.error != GUEST_LOAD_SUCCESS) {
+        logger_error("           failed to restore images for %s\n", vm->vm_name);
+        return PSCI_RET_INTERNAL_FAILURE;
+    }
+    vm->load_result = load;
+    boottime_record(&vm->boottime, BOOT_EV_LOAD_END);
+
     // 重置系统寄存器
-    target_task->cpu_info->sys_reg->spsr_el1  = 0x30C50830;
-    target_task->cpu_info->sys_reg->sctlr_el1 = 0;
+    target_task->cpu_info->sys_reg->spsr_el1     = 0x30C50830;
+    target_task->cpu_info->sys_reg->sctlr_el1    = 0;
+    target_task->cpu_info->sys_reg->cntv_ctl_el0 = 0;
+
+    // 虚拟定时器回到初始状态
+    vtimer_core_state_t *vt = get_vtimer_by_vcpu(target_task);
+    if (vt)
+        vtimer_core_init(vt, vt->id);
+
+    // 虚拟串口回到复位值；vGIC 的分发器和 CPU 接口由 guest 启动时重新编程
+    if (vm->vpl011 && vm->vpl011->state) {
+        vpl011_state_init(vm->vpl011->state);
+        vm->vpl011->state->vm = vm;
+    }
 
-    // TODO: 重置设备
+    // 重置首核的返回地址：首核是自己时改写本次陷入的现场，否则改写它被停下时的现场
+    trap_frame_t *frame = ctx_el2;
+    if (target_task != curr) {
+        frame = target_task->cpu_info->pctx ? (trap_frame_t *) target_task->cpu_info->pctx
+                                            : (trap_frame_t *) target_task->ctx.sp_elx;
+    }
+    frame->elr  = vm->manifest->bin_loadaddr;
+    frame->r[0] = vm->manifest->dtb_loadaddr;
+
+    if (target_task != curr) {
+        target_task->remaining_ticks = SYS_TASK_TICK;
+        task_add_to_readylist_tail_remote(target_task, affinity_first_cpu(target_task->affinity));
+        task_stop(curr);
+    }
+    return PSCI_RET_SUCCESS;
+}
+
+// vpsci_system_off: PSCI SYSTEM_OFF，关闭 guest
+// 所有 vCPU 摘下调度（发起调用的 vCPU 在异常返回后切换出去），独占的 pCPU
+// 归还给宿主。VM 结构保留，不再运行。
+int32_t
+vpsci_system_off(trap_frame_t *ctx_el2)
+{
+    (void) ctx_el2;
+    tcb_t        *curr = curr_task_el2();
+    struct _vm_t *vm   = curr->curr_vm;
 
-    // 重置首核的返回地址
-    ctx_el2->elr  = vm->manifest->bin_loadaddr;
-    ctx_el2->r[0] = vm->manifest->dtb_loadaddr;
-}
\ No newline at end of file
+    if (!vm) {
+        logger_error("           current task has no VM context\n");
+        return PSCI_RET_INTERNAL_FAILURE;
+    }
+
+    vm_stop_vcpus(vm, NULL);
+    vm_release_cpus(vm);
+
+    logger_info("           VM%d (%s) powered off\n", vm->vm_id, vm->vm_name);
+    return PSCI_RET_SUCCESS;
+}
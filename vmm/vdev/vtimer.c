@@ -16,6 +16,7 @@
 #include "task/task.h"
 #include "io.h"
 #include "lib/avatar_string.h"
+#include "mem/kallocator.h"
 #include "thread.h"
 #include "os_cfg.h"
 #include "timer.h"
@@ -25,13 +26,7 @@
 #define CNTV_CTL_IMASK   (1U << 1)  // 中断屏蔽位
 #define CNTV_CTL_ISTATUS (1U << 2)  // 中断状态位
 
-// 虚拟定时器管理结构
-static vtimer_t _vtimers[VM_NUM_MAX];
-static uint32_t _vtimer_num = 0;
-
-// 虚拟定时器核心状态池
-static vtimer_core_state_t _vtimer_states[VM_NUM_MAX * VCPU_NUM_MAX];
-static uint32_t            _vtimer_state_num = 0;
+// vtimer 及其核心状态随 VM 动态分配，通过 vm->vtimer 访问
 
 // --------------------------------------------------------
 // ==================    初始化函数    ==================
@@ -40,30 +35,25 @@ static uint32_t            _vtimer_state_num = 0;
 void
 vtimer_global_init(void)
 {
-    memset(_vtimers, 0, sizeof(_vtimers));
-    memset(_vtimer_states, 0, sizeof(_vtimer_states));
-    _vtimer_num       = 0;
-    _vtimer_state_num = 0;
     logger_info("Virtual timer global initialized\n");
 }
 
 vtimer_t *
 alloc_vtimer(void)
 {
-    if (_vtimer_num >= VM_NUM_MAX) {
+    vtimer_t *vtimer = kalloc(sizeof(vtimer_t), 8);
+    if (vtimer == NULL) {
         logger_error("No more vtimer can be allocated!\n");
         return NULL;
     }
 
-    vtimer_t *vtimer = &_vtimers[_vtimer_num++];
     memset(vtimer, 0, sizeof(vtimer_t));
     vtimer->vcpu_cnt   = 0;
     vtimer->now_tick   = 0;                   // 虚拟时间从0开始
     vtimer->start_time = read_cntpct_el0();   // 记录VM启动时的物理时间
     vtimer->cntvoff    = vtimer->start_time;  // 设置偏移量，使虚拟时间从0开始
 
-    logger_info("Allocated vtimer %d, start_time=0x%llx, cntvoff=0x%llx\n",
-                _vtimer_num - 1,
+    logger_info("Allocated vtimer, start_time=0x%llx, cntvoff=0x%llx\n",
                 vtimer->start_time,
                 vtimer->cntvoff);
     return vtimer;
@@ -72,12 +62,10 @@ alloc_vtimer(void)
 vtimer_core_state_t *
 alloc_vtimer_core_state(uint32_t vcpu_id)
 {
-    if (_vtimer_state_num >= VM_NUM_MAX * VCPU_NUM_MAX) {
-        logger_error("No more vtimer core state can be allocated!\n");
+    vtimer_core_state_t *vt = alloc_vtimer_core();
+    if (vt == NULL)
         return NULL;
-    }
 
-    vtimer_core_state_t *vt = &_vtimer_states[_vtimer_state_num++];
     vtimer_core_init(vt, vcpu_id);
     return vt;
 }
@@ -85,12 +73,14 @@ alloc_vtimer_core_state(uint32_t vcpu_id)
 vtimer_core_state_t *
 alloc_vtimer_core(void)
 {
-    if (_vtimer_state_num >= VM_NUM_MAX * VCPU_NUM_MAX) {
+    vtimer_core_state_t *vt = kalloc(sizeof(vtimer_core_state_t), 8);
+    if (vt == NULL) {
         logger_error("No more vtimer core state can be allocated!\n");
         return NULL;
     }
 
-    return &_vtimer_states[_vtimer_state_num++];
+    memset(vt, 0, sizeof(vtimer_core_state_t));
+    return vt;
 }
 
 void
@@ -477,25 +467,10 @@ vtimer_inject_to_vcpu(tcb_t *task)
 tcb_t *
 get_task_by_vm_vcpu(struct _vm_t *vm, uint32_t vcpu_idx)
 {
-    if (!vm)
+    if (!vm || vcpu_idx >= vm->vcpu_cnt)
         return NULL;
 
-    // 遍历该 VM 的所有 vCPU，找到第 vcpu_idx 个
-    list_node_t *iter        = list_first(&vm->vcpus);
-    uint32_t     current_idx = 0;
-    while (iter) {
-        tcb_t *vcpu_task = list_node_parent(iter, tcb_t, vm_node);
-
-        if (current_idx == vcpu_idx) {
-            return vcpu_task;  // 找到匹配的 task
-        }
-
-        current_idx++;
-        iter = list_node_next(iter);
-    }
-
-    // 没有找到匹配的 task
-    return NULL;
+    return vm->vcpu[vcpu_idx];
 }
 
 // 保持原函数接口兼容性，但使用新的查找逻辑
@@ -504,26 +479,10 @@ get_task_by_vcpu_id(uint32_t vcpu_id)
 {
     // 这个函数现在已经不推荐使用，因为vcpu_id在不同VM中可能重复
     // 遍历所有 VM 的所有 vCPU 来查找匹配的 task
-    for (uint32_t vm_idx = 0; vm_idx < _vtimer_num; vm_idx++) {
-        vtimer_t *vtimer = &_vtimers[vm_idx];
-        if (!vtimer->vm)
-            continue;  // 跳过未初始化的 vtimer
-
-        struct _vm_t *vm = vtimer->vm;
-
-        // 遍历该 VM 的所有 vCPU
-        list_node_t *iter = list_first(&vm->vcpus);
-        while (iter) {
-            tcb_t *vcpu_task = list_node_parent(iter, tcb_t, vm_node);
-
-            // 检查该 task 的 vCPU ID 是否匹配
-            uint32_t task_vcpu_id = (vcpu_task->cpu_info->sys_reg->mpidr_el1 & 0xff);
-            if (task_vcpu_id == vcpu_id) {
-                return vcpu_task;  // 找到匹配的 task
-            }
-
-            iter = list_node_next(iter);
-        }
+    for (uint32_t vm_idx = 0; vm_idx < vm_count(); vm_idx++) {
+        tcb_t *vcpu_task = get_task_by_vm_vcpu(vm_get(vm_idx), vcpu_id);
+        if (vcpu_task)
+            return vcpu_task;  // 找到匹配的 task
     }
 
     // 没有找到匹配的 task
@@ -544,10 +503,14 @@ v_timer_tick(uint64_t now)
     // 虚拟时间的更新由 vtimer_core_save 在上下文切换时完成
 
     // Iterate over all VMs
-    for (uint32_t vm_idx = 0; vm_idx < _vtimer_num; vm_idx++) {
-        vtimer_t *vtimer = &_vtimers[vm_idx];
+    for (uint32_t vm_idx = 0; vm_idx < vm_count(); vm_idx++) {
+        struct _vm_t *vm = vm_get(vm_idx);
+        if (!vm)
+            continue;  // 编号空缺：尚未初始化完成或已释放
+
+        vtimer_t *vtimer = vm->vtimer;
         if (!vtimer->vm)
-            continue;
+            continue;  // 跳过尚未初始化完成的 VM
 
         // 获取当前时间
         uint64_t current_time = vtimer->now_tick;
@@ -558,13 +521,12 @@ v_timer_tick(uint64_t now)
             if (!vt)
                 continue;
 
-            // Find the corresponding task using VM and vCPU index
-            tcb_t *task = get_task_by_vm_vcpu(vtimer->vm, vcpu_idx);
+            tcb_t *task = vtimer->vm->vcpu[vcpu_idx];
             if (!task)
                 continue;
 
             // Only process vCPUs bound to the current pCPU
-            if (task->affinity - 1 != get_current_cpu_id()) {
+            if (affinity_first_cpu(task->affinity) != get_current_cpu_id()) {
                 continue;
             }
 
@@ -24,7 +24,12 @@
 #include "io.h"
 #include "vmm/vm.h"
 #include "mem/mem.h"
+#include "mem/kallocator.h"
+#include "mem/barrier.h"
 #include "task/task.h"
+#include "task/smp_call.h"
+#include "sys/sys.h"
+#include "exception.h"
 
 #include "../guest/guest_manifest.h"
 #include "vmm/guest_loader.h"
@@ -35,8 +40,12 @@
 // 每个核跑两个 vcpu， 共8个vcpu
 // 跑4个vm每个vm使用2个vcpu 或者 跑2个vm每个vm使用4个vcpu
 
-static struct _vm_t vms[VM_NUM_MAX];
-static uint32_t     vm_num = 0;
+// VM 结构体按需分配，按 VM 编号直接索引。编号在 alloc_vm 时占用，
+// 初始化完成后才放进 vms；初始化失败时由 free_vm 归还编号
+static struct _vm_t *vms[VM_ID_MAX];
+static bool          vm_id_used[VM_ID_MAX];
+static uint32_t      vm_num = 0;  // 已发布的最大编号 + 1
+static spinlock_t    vm_lock;     // 保护编号分配和发布
 
 void
 fake_timer()
@@ -88,6 +97,18 @@ mmio_map_gicc()
     }
 }
 
+// 每个 vCPU 一个 redistributor 帧，guest 访问全部陷入 vgicr_handler
+void
+mmio_map_gicr()
+{
+    for (int32_t i = 0; i < MMIO_PAGES_GICR * VCPU_NUM_MAX; i++) {
+        lpae_t *avr_entry    = get_ept_entry((uint64_t) MMIO_AREA_GICR + MMIO_PAGE_SIZE * i);
+        avr_entry->p2m.read  = 0;
+        avr_entry->p2m.write = 0;
+        apply_ept(avr_entry);
+    }
+}
+
 void
 mmio_map_pl011()
 {
@@ -111,20 +132,41 @@ test_mem_hypervisor()
     *(uint64_t *) MMIO_ARREA = 0x1234;
 }
 
+static void
+vm_put_id(uint32_t vm_id)
+{
+    spin_lock(&vm_lock);
+    vm_id_used[vm_id] = false;
+    spin_unlock(&vm_lock);
+}
+
 // 一个vm必定有多个vcpu，一个vgic。 先在这里初始化
 struct _vm_t *
 alloc_vm()
 {
-    if (vm_num >= VM_NUM_MAX) {
+    uint32_t vm_id;
+
+    // 两个 guest start 可能同时分配，占用编号必须在锁内完成
+    spin_lock(&vm_lock);
+    for (vm_id = 0; vm_id < VM_ID_MAX && vm_id_used[vm_id]; vm_id++)
+        ;
+    if (vm_id < VM_ID_MAX)
+        vm_id_used[vm_id] = true;
+    spin_unlock(&vm_lock);
+
+    if (vm_id == VM_ID_MAX) {
         logger_error("No more vm can be allocated!\n");
         return NULL;
     }
-    struct _vm_t *vm = &vms[vm_num++];
-    memset(vm, 0, sizeof(struct _vm_t));
-    vm->vm_id = vm_num - 1;
 
-    // 初始化 vcpu 列表
-    list_init(&vm->vcpus);
+    struct _vm_t *vm = kalloc(sizeof(struct _vm_t), 8);
+    if (vm == NULL) {
+        logger_error("alloc vm: out of memory\n");
+        vm_put_id(vm_id);
+        return NULL;
+    }
+    memset(vm, 0, sizeof(struct _vm_t));
+    vm->vm_id = vm_id;
 
     // 获取对应的 vgic 结构体
     vm->vgic = alloc_vgic();
@@ -135,10 +177,74 @@ alloc_vm()
     // 获取对应的 vpl011 结构体
     vm->vpl011 = alloc_vpl011();
 
+    if (!vm->vgic || !vm->vtimer || !vm->vpl011) {
+        logger_error("alloc vm: out of memory for virtual devices\n");
+        kfree(vm->vgic);
+        kfree(vm->vtimer);
+        kfree(vm->vpl011);
+        kfree(vm);
+        vm_put_id(vm_id);
+        return NULL;
+    }
+
     logger_warn("alloc vm: %d\n", vm->vm_id);
     return vm;
 }
 
+// 初始化完成的 VM 对按编号遍历的其他核可见
+static void
+vm_publish(struct _vm_t *vm)
+{
+    spin_lock(&vm_lock);
+    // 先发布指针再增加计数，按计数遍历的其他核不会看到未初始化的 VM
+    vms[vm->vm_id] = vm;
+    dmb(ish);
+    if (vm->vm_id >= vm_num)
+        WRITE_ONCE(vm_num, vm->vm_id + 1);
+    spin_unlock(&vm_lock);
+}
+
+// 释放初始化失败、尚未发布的 VM，已分配的部分逐项归还
+void
+free_vm(struct _vm_t *vm)
+{
+    if (vm == NULL)
+        return;
+
+    vm_release_cpus(vm);
+
+    for (int32_t i = 0; i < VCPU_NUM_MAX; i++) {
+        free_tcb(vm->vcpu[i]);
+        if (vm->vcpu_stack[i])
+            kfree_pages(vm->vcpu_stack[i], VM_STACK_PAGES);
+        kfree(vm->vgic->core_state[i]);
+        kfree(vm->vtimer->core_state[i]);
+    }
+    kfree(vm->vpl011->state);
+    kfree(vm->vgic);
+    kfree(vm->vtimer);
+    kfree(vm->vpl011);
+
+    logger_warn("free vm: %d\n", vm->vm_id);
+    vm_put_id(vm->vm_id);
+    kfree(vm);
+}
+
+struct _vm_t *
+vm_get(uint32_t vm_id)
+{
+    if (vm_id >= READ_ONCE(vm_num))
+        return NULL;
+    return vms[vm_id];
+}
+
+// 已分配的 VM 数，编号为 [0, vm_count())
+uint32_t
+vm_count(void)
+{
+    return READ_ONCE(vm_num);
+}
+
 // 首核以外的核先跑这个。
 extern void
 test_guest();
@@ -155,6 +261,74 @@ guest_trap_init(void)
     isb();
 }
 
+// 在独占核上执行：WFI/WFE 不再陷入，guest 空闲时直接让物理核进入低功耗等待
+static void
+vm_partition_cpu_enter(void *info)
+{
+    (void) info;
+    write_hcr_el2(read_hcr_el2() & ~(uint64_t) (HCR_TWI | HCR_TWE));
+}
+
+// 把 cpu_mask 中的 pCPU 划给 vm 独占：宿主任务和设备中断转到 housekeeping 核，
+// 独占核上不做时间片轮转，WFI 直通硬件
+static int32_t
+vm_partition_cpus(struct _vm_t *vm, uint32_t cpu_mask)
+{
+    if (sched_isolate_cpus(cpu_mask, vm) < 0)
+        return -1;
+
+    irq_steer_spis(cpu_mask, HOUSEKEEPING_CPU);
+    smp_call_function_many(cpu_mask, vm_partition_cpu_enter, NULL, true);
+
+    logger_info("VM%d: pCPU mask 0x%x isolated\n", vm->vm_id, cpu_mask);
+    return 0;
+}
+
+// 在解除独占的核上执行：恢复 WFI/WFE 陷入
+static void
+vm_partition_cpu_leave(void *info)
+{
+    (void) info;
+    write_hcr_el2(read_hcr_el2() | HCR_TWI | HCR_TWE);
+}
+
+// 归还 vm 独占的 pCPU，之后这些核可以分给其他 VM 或运行宿主任务
+void
+vm_release_cpus(struct _vm_t *vm)
+{
+    uint32_t cpu_mask = sched_release_cpus(vm);
+
+    if (cpu_mask == 0)
+        return;
+
+    smp_call_function_many(cpu_mask, vm_partition_cpu_leave, NULL, true);
+    logger_info("VM%d: pCPU mask 0x%x released\n", vm->vm_id, cpu_mask);
+}
+
+// 停止 vm 的所有 vCPU，except 除外（可为 NULL）
+void
+vm_stop_vcpus(struct _vm_t *vm, tcb_t *except)
+{
+    for (uint32_t i = 0; i < vm->vcpu_cnt; i++) {
+        if (vm->vcpu[i] != NULL && vm->vcpu[i] != except)
+            task_stop(vm->vcpu[i]);
+    }
+}
+
+// 第 idx 个 vCPU 的亲和性：独占时依次落在独占位图的各个 pCPU 上，否则使用共享的默认绑定
+static uint32_t
+vm_vcpu_affinity(const guest_manifest_t *manifest, int32_t idx, uint32_t shared)
+{
+    uint32_t mask = manifest->isolated_cpus;
+
+    if (mask == 0)
+        return sched_housekeeping_affinity(shared);
+
+    for (int32_t n = idx % __builtin_popcount(mask); n > 0; n--)
+        mask &= mask - 1;  // 去掉最低位
+    return mask & -mask;
+}
+
 // 旧的vm_init函数已被vm_init_with_manifest替代
 
 void
@@ -166,16 +340,18 @@ run_vm(struct _vm_t *vm)
     }
 
     // task_add_to_readylist_tail(vm->primary_vcpu);
-    task_add_to_readylist_tail_remote(vm->primary_vcpu, vm->primary_vcpu->affinity - 1);
+    uint32_t core_id = affinity_first_cpu(vm->primary_vcpu->affinity);
+    task_add_to_readylist_tail_remote(vm->primary_vcpu, core_id);
 }
 
-// 新的VM初始化函数，使用Guest配置清单
-void
+// 新的VM初始化函数，使用Guest配置清单。
+// 失败返回 -1，已分配的部分由调用者用 free_vm 释放
+int32_t
 vm_init_with_manifest(struct _vm_t *vm, const guest_manifest_t *manifest)
 {
     if (!vm || !manifest) {
         logger_error("Invalid parameters for VM initialization\n");
-        return;
+        return -1;
     }
 
     logger_info("Initializing VM with manifest: %s (type: %s)\n",
@@ -187,13 +363,16 @@ vm_init_with_manifest(struct _vm_t *vm, const guest_manifest_t *manifest)
     vm->guest_type = manifest->type;
 
     // 从文件系统加载Guest镜像
+    boottime_init(&vm->boottime, manifest);
+    boottime_record(&vm->boottime, BOOT_EV_LOAD_START);
     vm->load_result = guest_load_from_manifest(manifest);
     if (vm->load_result.error != GUEST_LOAD_SUCCESS) {
         logger_error("Failed to load guest manifest: %s (error: %s)\n",
                      manifest->name,
                      guest_load_error_to_string(vm->load_result.error));
-        return;
+        return -1;
     }
+    boottime_record(&vm->boottime, BOOT_EV_LOAD_END);
 
     // 设置VM配置
     strncpy(vm->vm_name, manifest->name, VM_NAME_MAX - 1);
@@ -210,73 +389,98 @@ vm_init_with_manifest(struct _vm_t *vm, const guest_manifest_t *manifest)
                 entry_addr,
                 vcpu_num);
 
+    if (vcpu_num <= 0 || vcpu_num > VCPU_NUM_MAX) {
+        logger_error("VM%d: invalid vcpu count %d (max %d)\n", vm->vm_id, vcpu_num, VCPU_NUM_MAX);
+        return -1;
+    }
+
     //(1) 设置hcr
     guest_trap_init();
 
     //(2) 设置ttbr,和vtcr
     // 这里在main_vmm.c中已经设置了
 
+    //(2.1) 独占 pCPU
+    if (manifest->isolated_cpus && vm_partition_cpus(vm, manifest->isolated_cpus) < 0) {
+        logger_error("VM%d: failed to isolate pCPU mask 0x%x\n",
+                     vm->vm_id,
+                     manifest->isolated_cpus);
+        return -1;
+    }
+
     //(3) 分配vcpu
     vm->vcpu_cnt = vcpu_num;
 
-    //(3.1) 首核 - 所有VM的首核都绑定到pCPU 0
+    //(3.1) 首核 - 未独占时所有VM的首核都绑定到pCPU 0
     void *stack = kalloc_pages(VM_STACK_PAGES);
     if (stack == NULL) {
         logger_error("Failed to allocate stack for primary vcpu\n");
-        return;
+        return -1;
     }
+    vm->vcpu_stack[0] = stack;
 
     tcb_t *task = create_vm_task((void *) entry_addr,
                                  (uint64_t) stack + VM_STACK_SIZE,
-                                 PRIMARY_VCPU_PCPU_MASK,
+                                 vm_vcpu_affinity(manifest, 0, PRIMARY_VCPU_PCPU_MASK),
                                  dtb_addr);
     if (task == NULL) {
         logger_error("Failed to create vcpu task\n");
-        kfree_pages(stack, VM_STACK_PAGES);
-        return;
+        return -1;
     }
 
-    list_insert_last(&vm->vcpus, &task->vm_node);
+    vm->vcpu[0]                        = task;
     task->curr_vm                      = vm;
-    task->cpu_info->sys_reg->mpidr_el1 = (1ULL << 31) | (uint64_t) (0 & 0xff);
+    task->cpu_info->sys_reg->mpidr_el1 = (1ULL << 31) | (uint64_t) vgic_vcpu_affinity(0);
     vm->primary_vcpu                   = task;
 
-    //(3.2) 其它核 - 所有VM的其他核都绑定到pCPU 1
+    //(3.2) 其它核 - 未独占时所有VM的其他核都绑定到pCPU 1
     for (int32_t i = 1; i < vcpu_num; i++) {
         void *stack = kalloc_pages(VM_STACK_PAGES);
         if (stack == NULL) {
             logger_error("Failed to allocate stack for vcpu %d\n", i);
-            return;
+            return -1;
         }
+        vm->vcpu_stack[i] = stack;
         tcb_t *task = create_vm_task(test_guest,
                                      (uint64_t) stack + VM_STACK_SIZE,
-                                     SECONDARY_VCPU_PCPU_MASK,
+                                     vm_vcpu_affinity(manifest, i, SECONDARY_VCPU_PCPU_MASK),
                                      0);
         if (task == NULL) {
             logger_error("Failed to create vcpu task %d\n", i);
-            kfree_pages(stack, VM_STACK_PAGES);
-            return;
+            return -1;
         }
-        list_insert_last(&vm->vcpus, &task->vm_node);
+        vm->vcpu[i]                        = task;
         task->curr_vm                      = vm;
-        task->cpu_info->sys_reg->mpidr_el1 = (1ULL << 31) | (uint64_t) (i & 0xff);
+        task->cpu_info->sys_reg->mpidr_el1 = (1ULL << 31) | (uint64_t) vgic_vcpu_affinity(i);
     }
 
     // 映射 MMIO 区域
     mmio_map_gicd();
+#if GIC_VERSION == 3
+    mmio_map_gicr();
+#else
     mmio_map_gicc();
+#endif
     mmio_map_pl011();
 
     // 初始化虚拟 GIC
     vm->vgic->vm = vm;
     for (int32_t i = 0; i < vm->vcpu_cnt; i++) {
         vgic_core_state_t *state = alloc_gicc();
+        if (state == NULL) {
+            logger_error("VM%d: failed to allocate vgicc for vCPU %d\n", vm->vm_id, i);
+            return -1;
+        }
 
         state->id          = i;
-        state->vmcr        = mmio_read32((void *) GICH_VMCR);
-        state->saved_elsr0 = mmio_read32((void *) GICH_ELSR0);
-        state->saved_apr   = mmio_read32((void *) GICH_APR);
+        state->vmcr        = gic_read_vmcr();
+        state->saved_elsr0 = gic_elsr0();
+        state->saved_apr   = gic_apr();
         state->saved_hcr   = 0x1;
+#if GIC_VERSION == 3
+        // redistributor 初始处于睡眠状态，guest 写 GICR_WAKER 唤醒
+        state->gicr_waker = GICR_WAKER_PROC_SLEEP | GICR_WAKER_CHILD_ASLEEP;
+#endif
 
         vm->vgic->core_state[i] = state;
     }
@@ -301,6 +505,7 @@ vm_init_with_manifest(struct _vm_t *vm, const guest_manifest_t *manifest)
     vm->vpl011->vm               = vm;
     vpl011_state_t *vpl011_state = alloc_vpl011_state();
     if (vpl011_state) {
+        vpl011_state->vm  = vm;
         vm->vpl011->state = vpl011_state;
         logger_info("Allocated vpl011 state for VM %d\n", vm->vm_id);
     } else {
@@ -308,8 +513,12 @@ vm_init_with_manifest(struct _vm_t *vm, const guest_manifest_t *manifest)
     }
 
     // 安装中断处理程序
-    irq_install(79, paththrough_irq79);
-    irq_install(78, paththrough_irq78);
+    irq_install_prio(79, paththrough_irq79, IRQ_PRIO_PASSTHROUGH, 0);
+    irq_install_prio(78, paththrough_irq78, IRQ_PRIO_PASSTHROUGH, 0);
+
+    // 初始化完成后才对其他核可见
+    vm_publish(vm);
 
     logger_info("VM %s initialization completed successfully\n", vm->vm_name);
+    return 0;
 }
\ No newline at end of file